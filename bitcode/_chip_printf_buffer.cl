@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2023 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Device side of the printf ring buffer. The printf() calls are lowered to
+// calls of these functions by HipPrintf.cpp and the records are formatted
+// by the runtime. See src/CHIPPrintf.hh for the buffer and record layouts.
+
+#define CHIP_PRINTF_WRITE_POS 0
+#define CHIP_PRINTF_READ_POS 1
+#define CHIP_PRINTF_CAPACITY 2
+#define CHIP_PRINTF_DROPPED 3
+#define CHIP_PRINTF_NUM_HEADER_WORDS 4
+
+#define CHIP_PRINTF_PADDING_RECORD (1u << 24)
+#define CHIP_PRINTF_PRINTF_RECORD (2u << 24)
+#define CHIP_PRINTF_MAX_RECORD_WORDS 0xffffffu
+
+#define CHIP_PRINTF_NULL_STRING 0xffffffffu
+
+// Reserve a record of 'NumWords' words in the buffer 'Buf' and return a
+// pointer to it. Returns null and counts the record as dropped if the
+// buffer is full.
+static __global uint *__attribute__((used))
+_chip_printf_reserve(__global uint *Buf, uint NumWords) {
+  if (!Buf)
+    return 0;
+  volatile __global uint *Header = Buf;
+  uint Capacity = Buf[CHIP_PRINTF_CAPACITY];
+  uint Mask = Capacity - 1;
+  uint Pos, Pad;
+  do {
+    Pos = Header[CHIP_PRINTF_WRITE_POS];
+    // A record does not wrap around: the space until the end of the data
+    // is skipped with a padding record instead.
+    uint Off = Pos & Mask;
+    Pad = Off + NumWords > Capacity ? Capacity - Off : 0;
+    if (NumWords > CHIP_PRINTF_MAX_RECORD_WORDS ||
+        Pos + Pad + NumWords - Header[CHIP_PRINTF_READ_POS] > Capacity) {
+      atomic_inc(&Header[CHIP_PRINTF_DROPPED]);
+      return 0;
+    }
+  } while (atomic_cmpxchg(&Header[CHIP_PRINTF_WRITE_POS], Pos,
+                          Pos + Pad + NumWords) != Pos);
+
+  volatile __global uint *Data = Header + CHIP_PRINTF_NUM_HEADER_WORDS;
+  if (Pad)
+    atomic_xchg(&Data[Pos & Mask], Pad | CHIP_PRINTF_PADDING_RECORD);
+  return Buf + CHIP_PRINTF_NUM_HEADER_WORDS + ((Pos + Pad) & Mask);
+}
+
+// Hand over a record filled after its header word to the host.
+static void __attribute__((used))
+_chip_printf_commit(__global uint *Rec, uint NumWords) {
+  mem_fence(CLK_GLOBAL_MEM_FENCE);
+  atomic_xchg((volatile __global uint *)Rec,
+              NumWords | CHIP_PRINTF_PRINTF_RECORD);
+}
+
+static uint __attribute__((used))
+_chip_printf_strlen(__generic const char *S) {
+  if (!S)
+    return CHIP_PRINTF_NULL_STRING;
+  uint Len = 0;
+  while (S[Len])
+    ++Len;
+  return Len;
+}
+
+// Write a string item of a 'Len' long string (given by _chip_printf_strlen)
+// and return the position after it.
+static __global uint *__attribute__((used))
+_chip_printf_put_str(__global uint *Pos, __generic const char *S, uint Len) {
+  *Pos++ = Len;
+  if (Len == CHIP_PRINTF_NULL_STRING)
+    return Pos;
+  __global char *Bytes = (__global char *)Pos;
+  for (uint I = 0; I < Len; I++)
+    Bytes[I] = S[I];
+  return Pos + (Len + 3) / 4;
+}
+
+static bool _chip_printf_is_conversion(char C) {
+  __constant const char *Conversions = "diouxXcsfFeEgGaApn";
+  for (uint I = 0; Conversions[I]; I++)
+    if (C == Conversions[I])
+      return true;
+  return false;
+}
+
+// Return a mask of the arguments of a format string consumed by %s
+// conversions. Bit N stands for the argument after the format string. The
+// conversion specifications are scanned the same way the host does.
+static uint __attribute__((used))
+_chip_printf_str_args(__generic const char *Fmt) {
+  if (!Fmt)
+    return 0;
+  uint Mask = 0, Arg = 0;
+  for (uint I = 0; Fmt[I]; I++) {
+    if (Fmt[I] != '%')
+      continue;
+    if (Fmt[++I] == '%')
+      continue;
+    for (; Fmt[I] && !_chip_printf_is_conversion(Fmt[I]); I++)
+      if (Fmt[I] == '*')
+        Arg++; // A width or precision argument.
+    if (!Fmt[I])
+      break;
+    if (Fmt[I] == 's' && Arg < 32)
+      Mask |= 1u << Arg;
+    Arg++;
+  }
+  return Mask;
+}
+
+// Return the number of words for a pointer argument of a printf() call with
+// a dynamic format string, as a string if 'IsStr' is set.
+static uint __attribute__((used))
+_chip_printf_ptr_arg_words(__generic const char *P, uint IsStr) {
+  if (!IsStr)
+    return 2;
+  uint Len = _chip_printf_strlen(P);
+  return Len == CHIP_PRINTF_NULL_STRING ? 1 : 1 + (Len + 3) / 4;
+}
+
+// Write a pointer argument of a printf() call with a dynamic format string
+// and return the position after it.
+static __global uint *__attribute__((used))
+_chip_printf_put_ptr_arg(__global uint *Pos, __generic const char *P,
+                         uint IsStr) {
+  if (IsStr)
+    return _chip_printf_put_str(Pos, P, _chip_printf_strlen(P));
+  ulong Value = (ulong)P;
+  Pos[0] = (uint)Value;
+  Pos[1] = (uint)(Value >> 32);
+  return Pos + 2;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+// __ballot implementation with sub_group_reduce_add() for targets without
+// sub_group_ballot().
+
+// SPIR-V requirements: 1.2+.
+// OpenCL requirements: cl_khr_subgroups.
+// Level0 requirements: none.
+
+#define OVERLOADED __attribute__((overloadable))
+
+// The lanes contribute distinct bits, so the sum of them is their union.
+OVERLOADED ulong __chip_ballot(int predicate) {
+  return sub_group_reduce_add(predicate ? 1ul << get_sub_group_local_id()
+                                        : 0ul);
+}
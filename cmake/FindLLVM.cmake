@@ -89,6 +89,22 @@ if(NOT DEFINED LLVM_LINK)
 endif()
 message(STATUS "Using llvm-link: ${LLVM_LINK}")
 
+if(NOT DEFINED LLVM_OPT)
+  find_program(LLVM_OPT NAMES opt NO_DEFAULT_PATH PATHS ${CLANG_ROOT_PATH_BIN} ENV PATH)
+  if(NOT LLVM_OPT)
+    message(FATAL_ERROR "Can't find opt. Please provide CMake argument -DLLVM_OPT=/path/to/opt<-version>")
+  endif()
+endif()
+message(STATUS "Using opt: ${LLVM_OPT}")
+
+if(NOT DEFINED LLVM_NM)
+  find_program(LLVM_NM NAMES llvm-nm NO_DEFAULT_PATH PATHS ${CLANG_ROOT_PATH_BIN} ENV PATH)
+  if(NOT LLVM_NM)
+    message(FATAL_ERROR "Can't find llvm-nm. Please provide CMake argument -DLLVM_NM=/path/to/llvm-nm<-version>")
+  endif()
+endif()
+message(STATUS "Using llvm-nm: ${LLVM_NM}")
+
 if(NOT DEFINED LLVM_SPIRV)
   find_program(LLVM_SPIRV NAMES llvm-spirv FIND_TARGET NO_DEFAULT_PATH PATHS ${CLANG_ROOT_PATH_BIN} ENV PATH)
   if(NOT LLVM_SPIRV)
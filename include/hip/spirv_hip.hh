@@ -52,6 +52,11 @@ __device__ void __chipspv_abort(int32_t *abort_flag);
 static inline __device__ void abort() {
   __chipspv_abort(&__chipspv_abort_called);
 }
+
+// A global variable included in all HIP device modules for passing the
+// printf buffer to kernels. Removed by the compiler if the printf() calls are
+// not lowered to printf buffer records.
+__attribute__((weak)) __device__ void *__chip_printf_buffer;
 }
 
 typedef int hipLaunchParm;
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file spirv_hip_ext.h
+ * @brief chipStar specific extensions to the HIP runtime API.
+ */
+
+#ifndef SPIRV_HIP_EXT_H
+#define SPIRV_HIP_EXT_H
+
+#include <hip/hip_runtime_api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enqueue a batch of memory copies into a stream.
+ *
+ * Copies Sizes[i] bytes from Srcs[i] to Dsts[i] for each i < Count. The
+ * batch is submitted to the device at once and it completes as a whole, which
+ * is considerably cheaper than calling hipMemcpyAsync() for each copy
+ * separately when the copies are small. The copies of a batch must not
+ * overlap each other.
+ *
+ * @param Dsts Array of Count destination pointers
+ * @param Srcs Array of Count source pointers
+ * @param Sizes Array of Count transfer sizes in bytes
+ * @param Count Number of copies in the batch
+ * @param Kind Kind of the transfers. Applies to all copies of the batch.
+ * @param Stream Stream to enqueue the batch into
+ * @return hipError_t
+ */
+hipError_t hipExtMemcpyBatchAsync(void **Dsts, const void **Srcs,
+                                  const size_t *Sizes, size_t Count,
+                                  hipMemcpyKind Kind, hipStream_t Stream);
+
+#ifdef __cplusplus
+}
+#endif // extern "C"
+
+#endif // SPIRV_HIP_EXT_H
@@ -41,6 +41,7 @@ THE SOFTWARE.
 #endif
 
 #include <hip/hip_runtime_api.h>
+#include <hip/spirv_hip_ext.h>
 #include <hip/spirv_hip.hh>
 #include <hip/spirv_hip_vector_types.h>
 #include <hip/spirv_math_fwd.h>
@@ -47,6 +47,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #define DEBUG_TYPE "hip-lower-gv"
 
@@ -78,79 +79,128 @@ static Instruction *createKernelStub(Module &M, StringRef Name,
   return B.CreateRetVoid();
 }
 
-// Emit a shadow kernel for relaying properties about the original variable.
-static void emitGlobalVarInfoShadowKernel(Module &M,
-                                          const GlobalVariable *GVar) {
-  // For original global variable in pseudo code:
-  //
-  //   SomeType Foo = SomeInit;
-  //
-  // Emit the following shadow kernel in pseudo code:
-  //
-  //   SomeType* <ChipVarPrefix>Foo; // *1
-  //   void <ChipVarInfoPrefix>Foo(int64_t *info) {
-  //     info[0] = sizeof(Foo);      // In bytes.
-  //     info[1] = alignof(Foo);     // In bytes.
-  //     info[2] = <HasInitializer>; // [0, 1].
-  //   }
-  //
-  // *1: Emitted by emitIndirectGlobalVariable().
-
-  auto Name = std::string(ChipVarInfoPrefix) + GVar->getName().str();
-  IRBuilder<> Builder(createKernelStub(
-#if LLVM_VERSION_MAJOR > 17
-      M, Name, {PointerType::get(M.getContext(), SpirvCrossWorkGroupAS)}));
-#else
-      M, Name, {Type::getInt64PtrTy(M.getContext(), SpirvCrossWorkGroupAS)}));
-#endif
-
-  const auto &DL = M.getDataLayout();
-  auto *InfoArg = Builder.GetInsertBlock()->getParent()->getArg(0);
-
+// Emit stores of the properties of the original variable to
+// info[FirstIdx..FirstIdx+2]. See CHIPVarInfo.
+static void emitGlobalVarInfoStores(IRBuilder<> &Builder, const DataLayout &DL,
+                                    Value *InfoArg, uint64_t FirstIdx,
+                                    const GlobalVariable *GVar) {
   // info[0] = sizeof(Foo);
   auto Size = DL.getTypeStoreSize(GVar->getValueType());
-  Builder.CreateStore(Builder.getInt64(Size), InfoArg);
+  Value *Ptr = Builder.CreateConstInBoundsGEP1_64(Builder.getInt64Ty(),
+                                                  InfoArg, FirstIdx);
+  Builder.CreateStore(Builder.getInt64(Size), Ptr);
 
   // info[1] = alignof(Foo);
   uint64_t Alignment = GVar->getAlign().valueOrOne().value();
-  Value *Ptr =
-      Builder.CreateConstInBoundsGEP1_64(Builder.getInt64Ty(), InfoArg, 1);
+  Ptr = Builder.CreateConstInBoundsGEP1_64(Builder.getInt64Ty(), InfoArg,
+                                           FirstIdx + 1);
   Builder.CreateStore(Builder.getInt64(Alignment), Ptr);
 
   // info[2] = <HasInitializer>;
-  Ptr = Builder.CreateConstInBoundsGEP1_64(Builder.getInt64Ty(), InfoArg, 2);
+  Ptr = Builder.CreateConstInBoundsGEP1_64(Builder.getInt64Ty(), InfoArg,
+                                           FirstIdx + 2);
   Builder.CreateStore(Builder.getInt64(GVar->hasInitializer()), Ptr);
 }
 
-// Emit a shadow kernel for setting the transformed global variable to point to
-// the actual allocation.
-static void emitGlobalVarBindShadowKernel(Module &M, GlobalVariable *GVar,
-                                          const GlobalVariable *OriginalGVar) {
-  // For original global variable in pseudo code:
+// Emit a shadow kernel for relaying the names and properties of all the
+// original variables in one launch.
+static void
+emitGlobalVarInfoTableShadowKernel(Module &M,
+                                   ArrayRef<GlobalVariable *> OriginalGVars) {
+  // For original global variables in pseudo code (sorted by name):
   //
-  //   SomeType Foo = SomeInit;
+  //   FooType Foo = FooInit;
+  //   BarType Bar;
+  //   ...
   //
   // Emit the following shadow kernel in pseudo code:
   //
-  //   SomeType* <ChipVarPrefix>Foo; // *1
-  //   void<ChipVarBindPrefix><GVar-name>(void *buffer) {
-  //     <ChipVarPrefix>Foo = (SomeType *)buffer;
+  //   void <ChipVarInfoTableKernelName>(int64_t *info, int64_t capacity) {
+  //     info[0] = <number of variables>;
+  //     info[1] = <size of the table in bytes>;
+  //     if (capacity < info[1]) return;
+  //     info[2] = sizeof(Foo);      // In bytes.
+  //     info[3] = alignof(Foo);     // In bytes.
+  //     info[4] = <HasInitializer>; // [0, 1].
+  //     info[5..7] = <properties of Bar>;
+  //     ...
+  //     memcpy(&info[2 + 3 * <number of variables>], "Foo\0Bar\0...", ...);
   //   }
-  //
-  // *1: Emitted by emitIndirectGlobalVariable().
+  std::string Names;
+  for (auto *GVar : OriginalGVars) {
+    Names += GVar->getName().str();
+    Names += '\0';
+  }
+  uint64_t NamesOffset = 2 + 3 * OriginalGVars.size();
+  uint64_t TableSize = NamesOffset * sizeof(int64_t) + Names.size();
 
-  auto Name = std::string(ChipVarBindPrefix) + OriginalGVar->getName().str();
-  IRBuilder<> Builder(createKernelStub(
+  auto *RetInst = createKernelStub(
+      M, ChipVarInfoTableKernelName,
 #if LLVM_VERSION_MAJOR > 17
-      M, Name, {PointerType::get(M.getContext(), SpirvCrossWorkGroupAS)}));
+      {PointerType::get(M.getContext(), SpirvCrossWorkGroupAS),
 #else
-      M, Name, {Type::getInt8PtrTy(M.getContext(), SpirvCrossWorkGroupAS)}));
+      {Type::getInt64PtrTy(M.getContext(), SpirvCrossWorkGroupAS),
 #endif
+       Type::getInt64Ty(M.getContext())});
+  IRBuilder<> Builder(RetInst);
+  auto *F = Builder.GetInsertBlock()->getParent();
+  auto *InfoArg = F->getArg(0);
+  auto *CapacityArg = F->getArg(1);
+
+  Builder.CreateStore(Builder.getInt64(OriginalGVars.size()), InfoArg);
+  Value *Ptr = Builder.CreateConstInBoundsGEP1_64(Builder.getInt64Ty(),
+                                                  InfoArg, 1);
+  Builder.CreateStore(Builder.getInt64(TableSize), Ptr);
+  auto *Fits = Builder.CreateICmpUGE(CapacityArg, Builder.getInt64(TableSize));
+  Builder.SetInsertPoint(SplitBlockAndInsertIfThen(Fits, RetInst, false));
+
+  for (size_t I = 0; I < OriginalGVars.size(); I++)
+    emitGlobalVarInfoStores(Builder, M.getDataLayout(), InfoArg, 2 + 3 * I,
+                            OriginalGVars[I]);
+
+  auto *NamesInit = ConstantDataArray::getString(M.getContext(), Names,
+                                                 /* AddNull = */ false);
+  auto *NamesGVar = new GlobalVariable(
+      M, NamesInit->getType(), /* IsConstant = */ true,
+      GlobalValue::PrivateLinkage, NamesInit,
+      std::string(ChipVarPrefix) + "_names", nullptr,
+      GlobalValue::NotThreadLocal, SpirvUniformConstantAS);
+  Ptr = Builder.CreateConstInBoundsGEP1_64(Builder.getInt64Ty(), InfoArg,
+                                           NamesOffset);
+  Builder.CreateMemCpy(Ptr, MaybeAlign(sizeof(int64_t)), NamesGVar,
+                       MaybeAlign(1), Names.size());
+}
 
-  Value *BindArg = Builder.GetInsertBlock()->getParent()->getArg(0);
-  BindArg = Builder.CreatePointerBitCastOrAddrSpaceCast(BindArg,
-                                                        GVar->getValueType());
-  Builder.CreateStore(BindArg, GVar);
+// Emit a shadow kernel for binding all the transformed global variables to
+// their allocations in one launch.
+static void emitGlobalVarBindTableShadowKernel(
+    Module &M, ArrayRef<GlobalVariable *> OriginalGVars, GVarMapT &GVarMap) {
+  // For original global variables Foo, Bar, ... (sorted by name) emit the
+  // following shadow kernel in pseudo code:
+  //
+  //   void <ChipVarBindTableKernelName>(void **buffers) {
+  //     <ChipVarPrefix>Foo = (FooType *)buffers[0];
+  //     <ChipVarPrefix>Bar = (BarType *)buffers[1];
+  //     ...
+  //   }
+#if LLVM_VERSION_MAJOR > 17
+  auto *ElemTy = PointerType::get(M.getContext(), SpirvCrossWorkGroupAS);
+  auto *ArgTy = ElemTy;
+#else
+  auto *ElemTy = Type::getInt8PtrTy(M.getContext(), SpirvCrossWorkGroupAS);
+  auto *ArgTy = PointerType::get(ElemTy, SpirvCrossWorkGroupAS);
+#endif
+  IRBuilder<> Builder(createKernelStub(M, ChipVarBindTableKernelName, {ArgTy}));
+  Value *BuffersArg = Builder.GetInsertBlock()->getParent()->getArg(0);
+
+  for (size_t I = 0; I < OriginalGVars.size(); I++) {
+    auto *GVar = GVarMap[OriginalGVars[I]];
+    Value *Ptr = Builder.CreateConstInBoundsGEP1_64(ElemTy, BuffersArg, I);
+    Value *Buffer = Builder.CreateLoad(ElemTy, Ptr);
+    Buffer = Builder.CreatePointerBitCastOrAddrSpaceCast(Buffer,
+                                                         GVar->getValueType());
+    Builder.CreateStore(Buffer, GVar);
+  }
 }
 
 // Returns a constant expression rewritten as instructions if needed.
@@ -239,26 +289,30 @@ static bool hasNoRuntimeConstants(Constant *C, const GVarMapT &GVarMap) {
   return false; // Default answer if we can't fully analyze the constant.
 }
 
-// Emit a shadow kernel for initialing the global variable.
-static void emitGlobalVarInitShadowKernel(Module &M, GlobalVariable *GVar,
-                                          GlobalVariable *OriginalGVar,
-                                          GVarMapT GVarMap) {
+// Emit code for initializing the global variable at the Builder's insertion
+// point.
+static void emitGlobalVarInit(Module &M, IRBuilder<> &Builder,
+                              GlobalVariable *GVar,
+                              GlobalVariable *OriginalGVar,
+                              GVarMapT &GVarMap) {
   // For original global variable in pseudo code:
   //
   //   SomeType Foo = SomeInit;
   //
-  // A) Emit the following shadow kernel in pseudo code:
+  // A) Emit the following into the init shadow kernel in pseudo code:
   //
   //   SomeType* <ChipVarPrefix>Foo; // *1
-  //   void <ChipVarInitPrefix>Foo() {
+  //   void <ChipVarInitTableKernelName>() {
   //     memcpy(<ChipVarPrefix>Foo, &Foo, sizeof(SomeType));
+  //     ...
   //   }
   //
-  // B) Emit the following shadow kernel in pseudo code:
+  // B) Emit the following into the init shadow kernel in pseudo code:
   //
   //   SomeType* <ChipVarPrefix>Foo; // *1
-  //   void <ChipVarInitPrefix>Foo() {
+  //   void <ChipVarInitTableKernelName>() {
   //     *<ChipVarPrefix>Foo = SomeInit;
+  //     ...
   //   }
   //
   // This alternative should be avoided as it may lead to bad native code-gen.
@@ -272,9 +326,6 @@ static void emitGlobalVarInitShadowKernel(Module &M, GlobalVariable *GVar,
   assert(GVar->getValueType()->isPointerTy());
   assert(OriginalGVar->hasInitializer());
 
-  auto Name = std::string(ChipVarInitPrefix) + OriginalGVar->getName().str();
-  IRBuilder<> Builder(createKernelStub(M, Name, {}));
-
   if (hasNoRuntimeConstants(OriginalGVar->getInitializer(), GVarMap)) {
     // Emit A)
     // <ChipVarPrefix>Foo
@@ -305,6 +356,19 @@ static void emitGlobalVarInitShadowKernel(Module &M, GlobalVariable *GVar,
   Builder.CreateStore(Init, Ptr);
 }
 
+// Emit a shadow kernel for initialing all the global variables which have an
+// initializer in one launch.
+static void
+emitGlobalVarInitTableShadowKernel(Module &M,
+                                   ArrayRef<GlobalVariable *> OriginalGVars,
+                                   GVarMapT &GVarMap) {
+  IRBuilder<> Builder(createKernelStub(M, ChipVarInitTableKernelName, {}));
+  for (auto *OriginalGVar : OriginalGVars)
+    if (OriginalGVar->hasInitializer())
+      emitGlobalVarInit(M, Builder, GVarMap[OriginalGVar], OriginalGVar,
+                        GVarMap);
+}
+
 static bool shouldLower(const GlobalVariable &GVar) {
   if (!GVar.hasName()) return false;
 
@@ -490,12 +554,23 @@ static bool lowerGlobalVariables(Module &M) {
   // Lower host accessible global device variables.
   GVarMapT GVarMap = emitIndirectGlobalVariables(M);
   if (!GVarMap.empty()) {
+    // Emit shadow kernels which process all the variables in one launch. The
+    // runtime finds the variables by name in the table of the info kernel
+    // and sets them up with a few launches instead of several per variable.
+    std::vector<GlobalVariable *> SortedGVars;
+    bool AnyInitializer = false;
     for (auto Kv : GVarMap) {
-      emitGlobalVarInfoShadowKernel(M, Kv.first);
-      emitGlobalVarBindShadowKernel(M, Kv.second, Kv.first);
-      if (Kv.first->hasInitializer())
-        emitGlobalVarInitShadowKernel(M, Kv.second, Kv.first, GVarMap);
+      SortedGVars.push_back(Kv.first);
+      AnyInitializer |= Kv.first->hasInitializer();
     }
+    llvm::sort(SortedGVars, [](GlobalVariable *LHS, GlobalVariable *RHS) {
+      return LHS->getName() < RHS->getName();
+    });
+    emitGlobalVarInfoTableShadowKernel(M, SortedGVars);
+    emitGlobalVarBindTableShadowKernel(M, SortedGVars, GVarMap);
+    if (AnyInitializer)
+      emitGlobalVarInitTableShadowKernel(M, SortedGVars, GVarMap);
+
     replaceGlobalVariableUses(GVarMap);
     eraseMappedGlobalVariables(GVarMap);
     Changed |= true;
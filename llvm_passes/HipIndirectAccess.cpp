@@ -0,0 +1,136 @@
+//===- HipIndirectAccess.cpp ----------------------------------------------===//
+//
+// Part of the chipStar Project, under the Apache License v2.0 with LLVM
+// Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+// Annotates kernels which access memory only through their pointer arguments.
+//
+// Without knowing better, the chipStar runtime assumes a kernel may access
+// any allocation indirectly, through a pointer which was not passed as a
+// kernel argument. So it makes all allocations resident for every kernel on
+// Level Zero and annotates all SVM pointers to every launch on OpenCL.
+//
+// A kernel can only get hold of such a pointer by loading it from memory or
+// by converting it from an integer. This pass finds the kernels which,
+// including the functions they call, do neither of these:
+//
+//  * no loads or atomic operations of values holding pointers,
+//  * no inttoptr instructions,
+//  * no calls through function pointers or to inline assembly,
+//  * no calls to external functions returning pointers and
+//  * no parameters which hold pointers but are not pointers themselves.
+//
+// Note that accesses to device variables count as indirect: they are lowered
+// to loads of pointers to their allocations by HipGlobalVariables.cpp.
+//
+// Such kernels are annotated with a global magic variable:
+//
+//    uint8_t __chip_no_indirect_access_<kernel-name>;
+//
+// The absence of the variable means the kernel may access memory indirectly.
+//
+// (c) 2024 chipStar developers
+//===----------------------------------------------------------------------===//
+
+#include "HipIndirectAccess.h"
+
+#include "LLVMSPIRV.h"
+#include "../src/common.hh"
+
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "hip-indirect-access"
+
+using namespace llvm;
+
+// Return true if a value of the type holds one or more pointers.
+static bool holdsPointers(Type *Ty) {
+  if (Ty->isPtrOrPtrVectorTy())
+    return true;
+  if (auto *ATy = dyn_cast<ArrayType>(Ty))
+    return holdsPointers(ATy->getElementType());
+  if (auto *STy = dyn_cast<StructType>(Ty))
+    return STy->isOpaque() || any_of(STy->elements(), holdsPointers);
+  return false;
+}
+
+// Return true if the instruction may produce a pointer the function was not
+// given. Calls to defined functions are accounted for by the caller.
+static bool mayProduceIndirectPointer(const Instruction &I) {
+  if (auto *Load = dyn_cast<LoadInst>(&I))
+    return holdsPointers(Load->getType());
+  if (auto *RMW = dyn_cast<AtomicRMWInst>(&I))
+    return holdsPointers(RMW->getType());
+  if (auto *CmpXchg = dyn_cast<AtomicCmpXchgInst>(&I))
+    return holdsPointers(CmpXchg->getNewValOperand()->getType());
+  if (isa<IntToPtrInst>(I))
+    return true;
+  if (auto *Call = dyn_cast<CallBase>(&I)) {
+    auto *Callee = Call->getCalledFunction();
+    if (!Callee)
+      return true; // An indirect call or inline assembly.
+    if (Callee->isDeclaration() && !Callee->isIntrinsic())
+      return holdsPointers(Call->getType());
+  }
+  return false;
+}
+
+static bool mayAccessIndirectly(const Function &F) {
+  for (const auto &BB : F)
+    for (const auto &I : BB)
+      if (mayProduceIndirectPointer(I)) {
+        LLVM_DEBUG(dbgs() << F.getName() << " may access indirectly: " << I
+                          << "\n");
+        return true;
+      }
+  return false;
+}
+
+static void annotateNoIndirectAccess(Function &F) {
+  auto *Int8Ty = Type::getInt8Ty(F.getContext());
+  auto *GV = new GlobalVariable(
+      *F.getParent(), Int8Ty, true,
+      // Mark the GV as external for keeping it alive at least until the
+      // chipStar runtime reads it.
+      GlobalValue::ExternalLinkage, ConstantInt::get(Int8Ty, 1),
+      Twine(ChipNoIndirectAccessVarPrefix) + F.getName(), nullptr,
+      GlobalValue::NotThreadLocal, SPIRV_CROSSWORKGROUP_AS);
+  LLVM_DEBUG(dbgs() << "Annotated no indirect access: " << *GV << "\n");
+  (void)GV;
+}
+
+PreservedAnalyses HipIndirectAccessPass::run(Module &M,
+                                             ModuleAnalysisManager &AM) {
+  // Find the functions which may access memory indirectly and propagate
+  // the property to their callers.
+  SetVector<const Function *> Indirect;
+  for (const auto &F : M)
+    if (mayAccessIndirectly(F))
+      Indirect.insert(&F);
+  for (size_t I = 0; I < Indirect.size(); I++)
+    for (const auto *U : Indirect[I]->users())
+      if (auto *Call = dyn_cast<CallBase>(U))
+        Indirect.insert(Call->getFunction());
+
+  bool Changed = false;
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getCallingConv() != CallingConv::SPIR_KERNEL ||
+        Indirect.count(&F))
+      continue;
+    if (any_of(F.args(), [](const Argument &Arg) {
+          return !Arg.getType()->isPointerTy() && holdsPointers(Arg.getType());
+        }))
+      continue;
+    annotateNoIndirectAccess(F);
+    Changed = true;
+  }
+  return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
@@ -0,0 +1,27 @@
+//===- HipIndirectAccess.h ------------------------------------------------===//
+//
+// Part of the chipStar Project, under the Apache License v2.0 with LLVM
+// Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+// Annotates kernels which access memory only through their pointer arguments.
+//
+// (c) 2024 chipStar developers
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PASSES_HIP_INDIRECT_ACCESS_H
+#define LLVM_PASSES_HIP_INDIRECT_ACCESS_H
+
+#include "llvm/IR/PassManager.h"
+
+using namespace llvm;
+
+class HipIndirectAccessPass : public PassInfoMixin<HipIndirectAccessPass> {
+public:
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+  static bool isRequired() { return true; }
+};
+
+#endif // LLVM_PASSES_HIP_INDIRECT_ACCESS_H
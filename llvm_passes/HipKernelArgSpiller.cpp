@@ -16,15 +16,19 @@
 // This pass modifies some of the kernel argument by converting them into
 // buffer pointers. For example (through CUDA analogy):
 //
-//   __global__ void aKernel(BigObj A, BigObj B, ...) { ... }
+//   __global__ void aKernel(BigObj A, const BigObj B, ...) { ... }
 //
 //   -->
 //
-//   __device__ void aKernel_original(BigObj A, BigObj B, ...) { ... }
-//   __global__ void aKernel(BigObj *A, BigObj *B, ...) {
-//     aKernel_original(*A, *B, ...);
+//   __global__ void aKernel(BigObj *APtr, const BigObj *B, ...) {
+//     BigObj A = *APtr;
+//     ...
 //   }
 //
+// The largest arguments are spilled first, preferring the ones that are never
+// written. Those are read from the buffer directly instead of making a private
+// copy of them.
+//
 // The chipStar runtime is let to know about the spilled arguments by annotating
 // their position and original size of the argument in a global magic array:
 //
@@ -134,8 +138,47 @@ static bool canSpill(const Argument &Arg) {
   return true;
 }
 
+/// Return true if the byval argument is only read by loads, possibly through
+/// GEPs and bitcasts. Such argument can be read from the spill buffer
+/// directly.
+static bool isReadOnlyByVal(const Argument &Arg) {
+  if (!Arg.hasByValAttr())
+    return false;
+
+  // The spill buffer is only guaranteed to have ABI alignment.
+  auto &DL = Arg.getParent()->getParent()->getDataLayout();
+  if (Arg.getParamAlign() &&
+      *Arg.getParamAlign() > DL.getABITypeAlign(Arg.getParamByValType()))
+    return false;
+
+  SmallVector<const Value *> WorkList{&Arg};
+  while (!WorkList.empty()) {
+    const Value *V = WorkList.pop_back_val();
+    for (const User *U : V->users()) {
+      if (auto *LI = dyn_cast<LoadInst>(U)) {
+        if (LI->isVolatile())
+          return false;
+        continue;
+      }
+      if ((isa<GetElementPtrInst>(U) || isa<BitCastInst>(U)) &&
+          U->getType()->isPointerTy()) {
+        WorkList.push_back(U);
+        continue;
+      }
+      return false; // Stored, escaped or something else.
+    }
+  }
+  return true;
+}
+
 using ArgSet = SmallPtrSet<const Argument *, 16>;
 
+struct SpillCandidate {
+  const Argument *Arg;
+  size_t Reduction; ///< Parameter list size reduction when spilled.
+  size_t Cost;      ///< Bytes to be copied per launch when spilled.
+};
+
 static ArgSet getSpillPlan(Function *F) {
   size_t ArgumentsSize = 0;
   for (const Argument &Arg : F->args()) {
@@ -162,17 +205,7 @@ static ArgSet getSpillPlan(Function *F) {
   // Arguments are spilled into a runtime managed buffer.
   auto &DL = F->getParent()->getDataLayout();
   auto PointerSize = DL.getPointerSize(SPIRV_CROSSWORKGROUP_AS);
-  ArgSet ArgsToSpill;
-
-  // TODO: Optimization. Prefer spilling largest arguments first so we have
-  //       fewest amount of copy instances.  Additionally, if we need to spill X
-  //       bytes to meet the limit and there are multiple arguments larger than
-  //       that, pick the smallest one to minimize amount of bytes to be
-  //       copied.
-
-  // TODO: Optimization. Prefer spilling readonly byval arguments first, which
-  //       are never modified. This gives opportunities to omit local copies.
-
+  SmallVector<SpillCandidate> Candidates;
   for (const auto &Arg : F->args()) {
     if (!canSpill(Arg)) {
       LLVM_DEBUG(dbgs() << "  Arg " << Arg.getArgNo() << ": Can't spill " << Arg
@@ -183,19 +216,57 @@ static ArgSet getSpillPlan(Function *F) {
     if (ParamSize <= PointerSize)
       continue; // No parameter size reduction when spilled.
 
-    auto Reduction = ParamSize - PointerSize;
-    LLVM_DEBUG(dbgs() << "  Arg " << Arg.getArgNo() << ": Spill. Reduction: -"
-                      << Reduction << " bytes.\n");
-    ArgumentsSize -= Reduction;
-    ArgsToSpill.insert(&Arg);
-    if (ArgumentsSize <= MAX_KERNEL_PARAM_LIST_SIZE)
-      break;
+    // The spilled argument is copied into the buffer at launch and, unless it
+    // is never written, to a private variable in the kernel.
+    size_t Cost = isReadOnlyByVal(Arg) ? ParamSize : 2 * ParamSize;
+    Candidates.push_back({&Arg, ParamSize - PointerSize, Cost});
   }
 
-  LLVM_DEBUG(dbgs() << "  Arg list after spilling: " << ArgumentsSize
-                    << " B\n");
+  // Spill the largest arguments first so we have fewest amount of copy
+  // instances.
+  llvm::stable_sort(Candidates, [](const SpillCandidate &LHS,
+                                   const SpillCandidate &RHS) {
+    if (LHS.Reduction != RHS.Reduction)
+      return LHS.Reduction > RHS.Reduction;
+    return LHS.Cost < RHS.Cost;
+  });
+
+  size_t Excess = ArgumentsSize - MAX_KERNEL_PARAM_LIST_SIZE;
+  size_t Reduced = 0;
+  ArgSet ArgsToSpill;
+  for (auto It = Candidates.begin(); It != Candidates.end(); ++It) {
+    if (Reduced + It->Reduction < Excess) {
+      Reduced += It->Reduction;
+      ArgsToSpill.insert(It->Arg);
+      LLVM_DEBUG(dbgs() << "  Arg " << It->Arg->getArgNo()
+                        << ": Spill. Reduction: -" << It->Reduction
+                        << " bytes.\n");
+      continue;
+    }
+
+    // This and possibly some of the smaller arguments would meet the limit.
+    // Pick the cheapest one of them to minimize amount of bytes to be copied.
+    auto Last = std::min_element(
+        It, Candidates.end(),
+        [&](const SpillCandidate &LHS, const SpillCandidate &RHS) {
+          bool LHSFits = Reduced + LHS.Reduction >= Excess;
+          bool RHSFits = Reduced + RHS.Reduction >= Excess;
+          if (LHSFits != RHSFits)
+            return LHSFits;
+          return LHS.Cost < RHS.Cost;
+        });
+    Reduced += Last->Reduction;
+    ArgsToSpill.insert(Last->Arg);
+    LLVM_DEBUG(dbgs() << "  Arg " << Last->Arg->getArgNo()
+                      << ": Spill. Reduction: -" << Last->Reduction
+                      << " bytes.\n");
+    break;
+  }
 
-  if (ArgumentsSize > MAX_KERNEL_PARAM_LIST_SIZE) {
+  LLVM_DEBUG(dbgs() << "  Arg list after spilling: "
+                    << ArgumentsSize - Reduced << " B\n");
+
+  if (Reduced < Excess) {
     LLVM_DEBUG(dbgs() << "  Bail out: arg list is still too large.\n");
     return ArgSet();
   }
@@ -209,14 +280,33 @@ static Type *getSpillType(const Argument &Arg) {
   return ArgTy->getPointerTo(SPIRV_CROSSWORKGROUP_AS);
 }
 
-/// Create an alloca placed in function's entry block.
-static AllocaInst *createEntryAlloca(llvm::IRBuilder<> &B, Type *Ty) {
-  auto SavedIP = B.saveIP();
-  B.SetInsertPoint(
-      B.GetInsertBlock()->getParent()->getEntryBlock().getFirstNonPHIOrDbg());
-  auto *AI = B.CreateAlloca(Ty);
-  B.restoreIP(SavedIP);
-  return AI;
+/// Return the pointer type in the address space AS with the pointee of PtrTy.
+static Type *getWithAddrSpace(Type *PtrTy, unsigned AS) {
+#if LLVM_VERSION_MAJOR < 17
+  return PointerType::getWithSamePointeeType(cast<PointerType>(PtrTy), AS);
+#else
+  return PointerType::get(PtrTy->getContext(), AS);
+#endif
+}
+
+/// Make the users of the byval argument, which isReadOnlyByVal() accepted, to
+/// read from the spilled argument pointer instead.
+static void readSpilledArgDirectly(Argument &Arg, Value *SpillPtr) {
+  unsigned AS = SpillPtr->getType()->getPointerAddressSpace();
+  SmallVector<Instruction *> WorkList;
+  for (Use &U : make_early_inc_range(Arg.uses())) {
+    U.set(SpillPtr);
+    WorkList.push_back(cast<Instruction>(U.getUser()));
+  }
+  while (!WorkList.empty()) {
+    auto *I = WorkList.pop_back_val();
+    if (isa<LoadInst>(I))
+      continue;
+    // A GEP or a bitcast deriving a pointer from the argument.
+    I->mutateType(getWithAddrSpace(I->getType(), AS));
+    for (User *U : I->users())
+      WorkList.push_back(cast<Instruction>(U));
+  }
 }
 
 /// Annotate the spilled arguments for the runtime.
@@ -257,10 +347,9 @@ static bool spillKernelArgs(Function *F) {
 
   // Implement the spill plan.
 
-  // Create new kernel which replaces the current one. Convert the current
-  // kernel into a function.
+  // Create new kernel which replaces the current one and move the body of
+  // the current kernel into it.
   SmallVector<Type *> NewArgTys;
-  ValueToValueMapTy ArgMap;
   for (auto &Arg : F->args()) {
     NewArgTys.push_back(ArgsToSpill.count(&Arg) ? getSpillType(Arg)
                                                 : Arg.getType());
@@ -271,44 +360,46 @@ static bool spillKernelArgs(Function *F) {
                                 "", F->getParent());
   NewF->copyAttributesFrom(F);
   NewF->takeName(F);
-
-  // Convert the original kernel into a regular function.
-  F->setName(NewF->getName() + ".original_kernel");
-  F->setCallingConv(CallingConv::SPIR_FUNC);
-  F->setLinkage(GlobalValue::InternalLinkage);
-
-  // Prepare IR builder.
-  IRBuilder<> B(BasicBlock::Create(F->getContext(), "entry", NewF));
-  auto *RI = B.CreateRetVoid();
-  B.SetInsertPoint(RI);
+#if LLVM_VERSION_MAJOR >= 16
+  NewF->splice(NewF->begin(), F);
+#else
+  NewF->getBasicBlockList().splice(NewF->begin(), F->getBasicBlockList());
+#endif
+  if (auto *SP = F->getSubprogram()) {
+    F->setSubprogram(nullptr);
+    NewF->setSubprogram(SP);
+  }
 
   // Add "reload" code for the spilled arguments.
+  IRBuilder<> B(NewF->getEntryBlock().getFirstNonPHIOrDbg());
   const auto &DL = F->getParent()->getDataLayout();
-  SmallVector<Value *> CallArgs;
   for (auto &OrigArg : F->args()) {
     auto *NewArg = NewF->getArg(OrigArg.getArgNo());
+    NewArg->takeName(&OrigArg);
     if (!ArgsToSpill.count(&OrigArg)) {
-      CallArgs.push_back(NewArg);
+      OrigArg.replaceAllUsesWith(NewArg);
       continue;
     }
 
-    // Emit copy from the spill buffer into a private variable to preserve
-    // private ownership of the original pass-by-value argument.
+    if (!OrigArg.hasByValAttr()) {
+      auto *ArgTy = OrigArg.getType();
+      OrigArg.replaceAllUsesWith(
+          B.CreateAlignedLoad(ArgTy, NewArg, DL.getABITypeAlign(ArgTy)));
+      continue;
+    }
 
-    if (NewArg->hasByValAttr())
-      NewArg->removeAttr(Attribute::ByVal);
+    NewArg->removeAttr(Attribute::ByVal);
 
-    // TODO: optimization. Skip local copy emission if a byval argument is never
-    //       modified (has readonly attribute).
+    if (isReadOnlyByVal(OrigArg)) {
+      readSpilledArgDirectly(OrigArg, NewArg);
+      continue;
+    }
 
-#if LLVM_VERSION_MAJOR < 16
-    auto *AllocaTy = NewArg->getType()->getNonOpaquePointerElementType();
-#else
-    auto *AllocaTy = OrigArg.hasByValAttr() ? OrigArg.getParamByValType()
-                                            : OrigArg.getType();
-#endif
+    // Emit copy from the spill buffer into a private variable to preserve
+    // private ownership of the original pass-by-value argument.
+    auto *AllocaTy = OrigArg.getParamByValType();
     auto SrcAlign = DL.getABITypeAlign(AllocaTy);
-    auto *LocalCopy = createEntryAlloca(B, AllocaTy);
+    auto *LocalCopy = B.CreateAlloca(AllocaTy);
     auto AllocSizeInBitsOpt = LocalCopy->getAllocationSizeInBits(DL);
     assert(AllocSizeInBitsOpt);
 #if LLVM_VERSION_MAJOR > 17
@@ -320,13 +411,15 @@ static bool spillKernelArgs(Function *F) {
     size_t AllocSize = AllocSizeInBits / 8u;
     B.CreateMemCpy(LocalCopy, LocalCopy->getAlign(), NewArg, SrcAlign,
                    AllocSize);
-    CallArgs.push_back(LocalCopy);
+    OrigArg.replaceAllUsesWith(LocalCopy);
   }
 
-  B.CreateCall(F, CallArgs); // Call the original kernel.
-
   annotateSpilledArgs(NewF, ArgsToSpill);
 
+  F->replaceAllUsesWith(
+      ConstantExpr::getPointerBitCastOrAddrSpaceCast(NewF, F->getType()));
+  F->eraseFromParent();
+
   return true;
 }
 
@@ -0,0 +1,252 @@
+//===- HipKernelInfo.cpp --------------------------------------------------===//
+//
+// Part of the chipStar Project, under the Apache License v2.0 with LLVM
+// Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+// Emits a table of the kernels and their parameters for the chipStar runtime.
+//
+// Without the table the runtime recovers the kernel parameter kinds and sizes
+// by decoding the types of the kernel functions in the SPIR-V binary. The
+// table lets it skip the function definitions, which make up the bulk of the
+// binary. The table is stored in a global magic array:
+//
+//    uint32_t __chip_kernel_info[] = {
+//      <format version>, <kernel count>,
+//      // For each kernel:
+//      <name word count>, <name as a nul-padded SPIR-V literal string>...,
+//      <parameter count>, <parameter>...,
+//      <spilled argument count>, <spilled argument annotation>...,
+//    };
+//
+// A parameter word packs the size in the bits 0-23, the SPVTypeKind in the
+// bits 24-27 and the SPVStorageClass in the bits 28-31 (15 for Unknown). The
+// sizes are computed the same way as the runtime computes them from SPIR-V
+// types. The spilled argument annotations are the ones emitted by
+// HipKernelArgSpiller.cpp.
+//
+// The table is not emitted if a kernel has a parameter the pass can't
+// describe. The runtime then decodes the SPIR-V types as before.
+//
+// (c) 2024 chipStar developers
+//===----------------------------------------------------------------------===//
+
+#include "HipKernelInfo.h"
+
+#include "LLVMSPIRV.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+
+#include <optional>
+
+#define PASS_NAME "hip-kernel-info"
+#define DEBUG_TYPE PASS_NAME
+
+using namespace llvm;
+
+namespace {
+
+constexpr uint32_t KernelInfoVersion = 1;
+
+// Mirrors SPVTypeKind and SPVStorageClass of the runtime.
+enum class ArgKind : uint32_t { POD = 1, Pointer = 2, Image = 4, Sampler = 5 };
+enum class StorageClass : uint32_t {
+  Private = 0,
+  CrossWorkgroup = 1,
+  UniformConstant = 2,
+  Workgroup = 3,
+  Unknown = 15
+};
+
+/// Size and alignment of a type as the runtime computes them from the SPIR-V
+/// types: aggregates have no tail padding.
+struct TypeLayout {
+  uint64_t Size;
+  uint64_t Align;
+};
+
+} // namespace
+
+static std::optional<TypeLayout> getLayout(Type *Ty, const DataLayout &DL) {
+  if (Ty->isIntegerTy() || Ty->isHalfTy() || Ty->isFloatTy() ||
+      Ty->isDoubleTy()) {
+    if (Ty->getPrimitiveSizeInBits() % 8)
+      return std::nullopt; // E.g. i1 is translated to OpTypeBool.
+    uint64_t Size = Ty->getPrimitiveSizeInBits() / 8;
+    return TypeLayout{Size, PowerOf2Ceil(Size)};
+  }
+
+  if (Ty->isPointerTy()) {
+    uint64_t Size = DL.getPointerTypeSize(Ty);
+    return TypeLayout{Size, PowerOf2Ceil(Size)};
+  }
+
+  if (auto *VTy = dyn_cast<FixedVectorType>(Ty)) {
+    auto Elt = getLayout(VTy->getElementType(), DL);
+    if (!Elt)
+      return std::nullopt;
+    uint64_t Size = Elt->Size * VTy->getNumElements();
+    return TypeLayout{Size, PowerOf2Ceil(Size)};
+  }
+
+  if (auto *ATy = dyn_cast<ArrayType>(Ty)) {
+    auto Elt = getLayout(ATy->getElementType(), DL);
+    if (!Elt)
+      return std::nullopt;
+    return TypeLayout{ATy->getNumElements() * alignTo(Elt->Size, Elt->Align),
+                      Elt->Align};
+  }
+
+  if (auto *STy = dyn_cast<StructType>(Ty)) {
+    if (STy->isOpaque())
+      return std::nullopt;
+    TypeLayout Layout{0, 1};
+    for (auto *MemberTy : STy->elements()) {
+      auto Member = getLayout(MemberTy, DL);
+      if (!Member)
+        return std::nullopt;
+      Layout.Size = alignTo(Layout.Size, Member->Align) + Member->Size;
+      Layout.Align = std::max(Layout.Align, Member->Align);
+    }
+    return Layout;
+  }
+
+  return std::nullopt;
+}
+
+static StorageClass getStorageClass(unsigned AS) {
+  switch (AS) {
+  case 0:
+    return StorageClass::Private; // Function storage class.
+  case SPIRV_CROSSWORKGROUP_AS:
+    return StorageClass::CrossWorkgroup;
+  case SPIRV_UNIFORMCONSTANT_AS:
+    return StorageClass::UniformConstant;
+  case SPIRV_WORKGROUP_AS:
+    return StorageClass::Workgroup;
+  default:
+    return StorageClass::Unknown;
+  }
+}
+
+static uint32_t encodeParam(ArgKind Kind, StorageClass SC, uint64_t Size) {
+  assert(Size >> 24u == 0 && "Doesn't fit in 24-bit field!");
+  return static_cast<uint32_t>(Size) |
+         (static_cast<uint32_t>(Kind) << 24u) |
+         (static_cast<uint32_t>(SC) << 28u);
+}
+
+static std::optional<uint32_t> describeParam(const Argument &Arg) {
+  const auto &DL = Arg.getParent()->getParent()->getDataLayout();
+  Type *Ty = Arg.getType();
+
+#if LLVM_VERSION_MAJOR >= 17
+  if (auto *TETy = dyn_cast<TargetExtType>(Ty)) {
+    if (TETy->getName() == "spirv.Image")
+      return encodeParam(ArgKind::Image, StorageClass::Unknown, 0);
+    if (TETy->getName() == "spirv.Sampler")
+      return encodeParam(ArgKind::Sampler, StorageClass::UniformConstant, 0);
+    return std::nullopt;
+  }
+#endif
+
+  if (Ty->isPointerTy()) {
+    auto SC = getStorageClass(Ty->getPointerAddressSpace());
+    if (Arg.hasByValAttr()) {
+      // The runtime treats the ByVal pointer parameters as POD.
+      auto Pointee = getLayout(Arg.getParamByValType(), DL);
+      if (!Pointee || Pointee->Size >> 24u)
+        return std::nullopt;
+      return encodeParam(ArgKind::POD, SC, Pointee->Size);
+    }
+    return encodeParam(ArgKind::Pointer, SC, DL.getPointerTypeSize(Ty));
+  }
+
+  auto Layout = getLayout(Ty, DL);
+  if (!Layout || Layout->Size >> 24u)
+    return std::nullopt;
+  return encodeParam(ArgKind::POD, StorageClass::Private, Layout->Size);
+}
+
+static void appendString(StringRef Str, SmallVectorImpl<uint32_t> &Table) {
+  // Nul-terminated and padded to the word boundary like SPIR-V literals.
+  SmallVector<char> Bytes(Str.begin(), Str.end());
+  Bytes.resize((Bytes.size() / 4 + 1) * 4, '\0');
+  Table.push_back(Bytes.size() / 4);
+  for (size_t I = 0; I < Bytes.size(); I += 4)
+    Table.push_back(uint32_t(uint8_t(Bytes[I])) |
+                    uint32_t(uint8_t(Bytes[I + 1])) << 8u |
+                    uint32_t(uint8_t(Bytes[I + 2])) << 16u |
+                    uint32_t(uint8_t(Bytes[I + 3])) << 24u);
+}
+
+static bool describeKernel(Function &F, SmallVectorImpl<uint32_t> &Table) {
+  appendString(F.getName(), Table);
+
+  Table.push_back(F.arg_size());
+  for (const auto &Arg : F.args()) {
+    auto Param = describeParam(Arg);
+    if (!Param) {
+      LLVM_DEBUG(dbgs() << "Can't describe parameter " << Arg.getArgNo()
+                        << " of " << F.getName() << "\n");
+      return false;
+    }
+    Table.push_back(*Param);
+  }
+
+  auto *Spilled = F.getParent()->getNamedGlobal(
+      (Twine("__chip_spilled_args_") + F.getName()).str());
+  auto *Annotations =
+      Spilled ? dyn_cast_or_null<ConstantDataArray>(Spilled->getInitializer())
+              : nullptr;
+  if (Spilled && !Annotations)
+    return false;
+  Table.push_back(Annotations ? Annotations->getNumElements() : 0);
+  for (unsigned I = 0; Annotations && I < Annotations->getNumElements(); I++)
+    Table.push_back(Annotations->getElementAsInteger(I));
+  return true;
+}
+
+PreservedAnalyses HipKernelInfoPass::run(Module &M,
+                                         ModuleAnalysisManager &AM) {
+#if LLVM_VERSION_MAJOR < 17
+  // Images and samplers are pointers to opaque types which can't be told
+  // apart from other pointers with opaque pointers.
+  return PreservedAnalyses::all();
+#endif
+  SmallVector<uint32_t> Table{KernelInfoVersion, 0};
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getCallingConv() != CallingConv::SPIR_KERNEL)
+      continue;
+    if (!describeKernel(F, Table))
+      return PreservedAnalyses::all(); // The runtime parses the SPIR-V.
+    Table[1]++;
+  }
+
+  // The word count of a SPIR-V instruction is a 16-bit field.
+  if (Table.size() > 0xffff - 3) {
+    LLVM_DEBUG(dbgs() << "The kernel info table of " << Table[1]
+                      << " kernels takes " << Table.size()
+                      << " words, too many for a SPIR-V instruction. The "
+                         "runtime parses the SPIR-V instead.\n");
+    return PreservedAnalyses::all();
+  }
+
+  auto *GVInit = ConstantDataArray::get(M.getContext(), Table);
+  auto *GV = new GlobalVariable(
+      M, GVInit->getType(), true,
+      // Mark the GV as external for keeping it alive at least until the
+      // chipStar runtime reads it.
+      GlobalValue::ExternalLinkage, GVInit, "__chip_kernel_info", nullptr,
+      GlobalValue::NotThreadLocal, SPIRV_CROSSWORKGROUP_AS);
+  LLVM_DEBUG(dbgs() << "Kernel info table of " << Table[1] << " kernels: "
+                    << *GV << "\n");
+  (void)GV;
+  return PreservedAnalyses::none();
+}
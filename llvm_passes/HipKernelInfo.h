@@ -0,0 +1,27 @@
+//===- HipKernelInfo.h ----------------------------------------------------===//
+//
+// Part of the chipStar Project, under the Apache License v2.0 with LLVM
+// Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+// Emits a table of the kernels and their parameters for the chipStar runtime.
+//
+// (c) 2024 chipStar developers
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PASSES_HIP_KERNEL_INFO_H
+#define LLVM_PASSES_HIP_KERNEL_INFO_H
+
+#include "llvm/IR/PassManager.h"
+
+using namespace llvm;
+
+class HipKernelInfoPass : public PassInfoMixin<HipKernelInfoPass> {
+public:
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+  static bool isRequired() { return true; }
+};
+
+#endif // LLVM_PASSES_HIP_KERNEL_INFO_H
@@ -29,6 +29,10 @@
 #include "HipSanityChecks.h"
 #include "HipLowerSwitch.h"
 #include "HipLowerMemset.h"
+#include "HipKernelInfo.h"
+#include "HipIndirectAccess.h"
+
+#include "chipStarConfig.hh"
 
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
@@ -122,7 +126,11 @@ static void addFullLinkTimePasses(ModulePassManager &MPM) {
   //
   //  Assertion `isa<X>(Val) && "cast<Ty>() argument of incompatible type!"'
   //  failed.
+#ifdef CHIP_PRINTF_BUFFER
+  MPM.addPass(HipPrintfToOpenCLPrintfPass(true));
+#else
   MPM.addPass(HipPrintfToOpenCLPrintfPass());
+#endif
   MPM.addPass(createModuleToFunctionPassAdaptor(HipDefrostPass()));
   MPM.addPass(createModuleToFunctionPassAdaptor(HipLowerMemsetPass()));
   MPM.addPass(HipAbortPass());
@@ -140,6 +148,10 @@ static void addFullLinkTimePasses(ModulePassManager &MPM) {
   MPM.addPass(createModuleToFunctionPassAdaptor(DCEPass()));
   MPM.addPass(GlobalDCEPass());
 
+  // Describe the kernels left after the above passes for the runtime.
+  MPM.addPass(HipIndirectAccessPass());
+  MPM.addPass(HipKernelInfoPass());
+
   MPM.addPass(createModuleToFunctionPassAdaptor(InferAddressSpacesPass(4)));
   MPM.addPass(HipFixOpenCLMDPass());
 }
@@ -42,10 +42,23 @@
 // Also counts the number of format args for replacing the return value of
 // the printf() call with it for rough CUDA-behavior emulation.
 //
+// Alternatively, with chipStar built with CHIP_PRINTF_BUFFER, the printf()
+// calls are lowered to stores of the format string (as an offset into a
+// format table of the module) and the raw arguments into a record in a ring
+// buffer which the runtime formats on the host (see src/CHIPPrintf.hh). The
+// strings of %s conversions are copied into the records, and dynamic format
+// strings are supported by copying them too. The format table is queried by
+// the runtime through the __chip_printf_formats shadow kernel. Calls with
+// arguments the records can't carry fall back to the OpenCL printf.
+//
 //===----------------------------------------------------------------------===//
 
 #include "HipPrintf.h"
 
+#include "../src/CHIPPrintf.hh"
+#include "../src/common.hh"
+
+#include "llvm/ADT/SmallBitVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
@@ -53,13 +66,16 @@
 #include "llvm/Pass.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
+#include <optional>
 #include <vector>
 #include <string>
 #include <iostream>
 
 #define DEBUG_TYPE "hip-printf"
 
+#define SPIRV_OPENCL_GLOBAL_AS 1
 #define SPIRV_OPENCL_CONSTANT_AS 2
 #define SPIRV_OPENCL_GENERIC_AS 4
 #define SPIRV_OPENCL_PRINTF_FMT_ARG_AS SPIRV_OPENCL_CONSTANT_AS
@@ -67,6 +83,10 @@
 #define ORIG_PRINTF_FUNC_NAME "_hip_printf"
 #define ORIG_PRINT_STRING_FUNC_NAME "_cl_print_str"
 
+// The conversion characters ending a conversion specification in the
+// printf buffer records. Must match src/CHIPPrintf.cc.
+#define PRINTF_CONVERSIONS "diouxXcsfFeEgGaApn"
+
 // The SPIR-V specification doesn't especially forbid %s
 // arguments that are not "literals" (in constant address
 // space as specified by OpenCL). Assume a SPIR-V printf
@@ -289,11 +309,356 @@ static Function *getCalledFunction(CallInst *CI) {
   return cast<Function>(Callee);
 }
 
+void HipPrintfToOpenCLPrintfPass::lowerToOpenCLPrintf(
+    CallInst &OrigCall, FunctionCallee OpenCLPrintfF) {
+  LLVMContext &Ctx = M_->getContext();
+  unsigned TotalFmtSpecCount;
+  auto FmtSpecPieces =
+      getFormatStringPieces(*OrigCall.args().begin(), TotalFmtSpecCount);
+
+  IRBuilder<> B(&OrigCall);
+
+  if (TotalFmtSpecCount > OrigCall.arg_size() - 1) {
+    // More specifiers than format arguments. Either the user forgot
+    // arguments or the format string has invalid specifiers - in either
+    // case this triggers UB.
+    LLVM_DEBUG(dbgs() << "  Invalid format string or missing arguments?\n");
+    Value *ErrorFmt =
+        getOrCreateStrLiteralArg("Error: Invalid printf format string\n", B);
+    CallInst::Create(OpenCLPrintfF, ArrayRef(ErrorFmt), "", &OrigCall);
+    auto *PoisonInt = PoisonValue::get(Type::getInt32Ty(Ctx));
+    OrigCall.replaceAllUsesWith(PoisonInt);
+    return;
+  }
+
+  auto OrigCallArgs = OrigCall.args();
+  auto OrigCallArgI = OrigCallArgs.begin();
+  // Skip the original format string arg and recreate it.
+  OrigCallArgI++;
+
+  for (auto FmtStr : FmtSpecPieces) {
+    unsigned FormatSpecCount = NumFormatSpecs(FmtStr);
+    std::vector<Value *> Args;
+
+    // TODO: handle a (compile time known) null ptr format string arg and
+    // return -1 like CUDA does.
+    if (FmtStr == "") {
+      // No output, the return value suffices.
+      continue;
+    } else if (FmtStr == "%s" || FmtStr == "%*s") {
+      // This is a string printout, we do not pass the format string
+      // in that case, but just call a string printer.
+      // We can use the normal printf if the %s arg can be resolved to
+      // a literal C string. However, it must be moved to constant AS
+      // for OpenCL compatibility.
+      Value *OrigArg = *OrigCallArgI++;
+      bool IsEmpty = false;
+      if (Value *ConstantSpaceCStr =
+              cloneStrArgToConstantAS(OrigArg, B, &IsEmpty)) {
+        if (IsEmpty)
+          continue; // empty str arg to a %s, no output needed
+        // We could copy the arg to constant space, printf it
+        // directly. No format string needed.
+        Args.push_back(ConstantSpaceCStr);
+        CallInst::Create(OpenCLPrintfF, Args, "", &OrigCall);
+      } else if (ASSUME_PRINTF_SUPPORTS_GLOBAL_STRING_ARGS) {
+        if (IsEmpty)
+          continue;
+        // Create a constant space format string for %s.
+        Args.push_back(getOrCreateStrLiteralArg("%s", B));
+        // ...and then assume the data arg can point to a generic
+        // address space string (eventually residing in global AS).
+        Args.push_back(OrigArg);
+        CallInst::Create(OpenCLPrintfF, Args, "", &OrigCall);
+      } else {
+        Args.push_back(OrigArg);
+        CallInst::Create(getOrCreatePrintStringF(), Args, "", &OrigCall);
+      }
+      continue;
+    }
+
+    // Handle as a normal printf() call.
+    Args.push_back(getOrCreateStrLiteralArg(FmtStr, B));
+    while (FormatSpecCount--) {
+      assert(OrigCallArgI != OrigCallArgs.end());
+      Value *OrigArg = *OrigCallArgI++;
+      Args.push_back(OrigArg);
+    }
+    CallInst::Create(OpenCLPrintfF, Args, "", &OrigCall);
+  }
+
+  // Instead of returning the success/failure from the OpenCL printf(),
+  // assume that the parsing succeeds and return the number of format
+  // strings. A slight improvement would be to return 0 in case of a
+  // failure, but it still would not necessarily match CUDA nor HIP
+  // since it should return the number of _valid_ format replacements.
+  IntegerType *Int32Ty = Type::getInt32Ty(Ctx);
+  ConstantInt *RV = ConstantInt::get(Int32Ty, TotalFmtSpecCount);
+  OrigCall.replaceAllUsesWith(RV);
+}
+
+// Return the format string of a printf() call if it is a constant.
+static std::optional<std::string> getConstantFormat(Value *FmtArg) {
+  auto *GV = dyn_cast<GlobalVariable>(FmtArg->stripPointerCasts());
+  if (!GV || !GV->isConstant() || !GV->hasDefinitiveInitializer())
+    return std::nullopt;
+  if (GV->getInitializer()->isZeroValue())
+    return std::string();
+  auto *Data = dyn_cast<ConstantDataSequential>(GV->getInitializer());
+  if (!Data || !Data->isCString())
+    return std::nullopt;
+  return Data->getAsCString().str();
+}
+
+// Return the arguments after the format string consumed by %s conversions.
+// The conversion specifications are scanned the same way the runtime does
+// (see src/CHIPPrintf.cc).
+static SmallBitVector getStrArgs(StringRef Fmt, unsigned NumArgs) {
+  SmallBitVector StrArgs(NumArgs);
+  unsigned Arg = 0;
+  for (size_t I = 0; I < Fmt.size(); I++) {
+    if (Fmt[I] != '%')
+      continue;
+    if (++I < Fmt.size() && Fmt[I] == '%')
+      continue;
+    for (; I < Fmt.size() && !StringRef(PRINTF_CONVERSIONS).contains(Fmt[I]);
+         I++)
+      if (Fmt[I] == '*')
+        Arg++; // A width or precision argument.
+    if (I == Fmt.size())
+      break;
+    if (Fmt[I] == 's' && Arg < NumArgs)
+      StrArgs.set(Arg);
+    Arg++;
+  }
+  return StrArgs;
+}
+
+uint32_t
+HipPrintfToOpenCLPrintfPass::getOrCreateFormatOffset(const std::string &Fmt) {
+  auto [It, Inserted] = FormatOffsets_.emplace(Fmt, Formats_.size());
+  if (Inserted) {
+    Formats_ += Fmt;
+    Formats_ += '\0';
+  }
+  return It->second;
+}
+
+// Lower a printf() call to a record in the printf buffer. Returns false if
+// the call has arguments the records can't carry.
+bool HipPrintfToOpenCLPrintfPass::lowerToPrintfBuffer(CallInst &OrigCall) {
+  Module &M = *M_;
+  GlobalVariable *BufferVar = M.getGlobalVariable(ChipPrintfBufferVarName);
+  Function *ReserveF = M.getFunction("_chip_printf_reserve");
+  Function *CommitF = M.getFunction("_chip_printf_commit");
+  Function *StrLenF = M.getFunction("_chip_printf_strlen");
+  Function *PutStrF = M.getFunction("_chip_printf_put_str");
+  if (!BufferVar || !ReserveF || !CommitF || !StrLenF || !PutStrF)
+    return false;
+
+  Value *FmtArg = OrigCall.getArgOperand(0);
+  unsigned NumArgs = OrigCall.arg_size() - 1;
+  std::optional<std::string> Fmt = getConstantFormat(FmtArg);
+  Function *StrArgsF = M.getFunction("_chip_printf_str_args");
+  Function *PtrArgWordsF = M.getFunction("_chip_printf_ptr_arg_words");
+  Function *PutPtrArgF = M.getFunction("_chip_printf_put_ptr_arg");
+  if (!Fmt && (!StrArgsF || !PtrArgWordsF || !PutPtrArgF))
+    return false;
+  // Let the OpenCL printf lowering report invalid format strings.
+  if (Fmt && NumFormatSpecs(*Fmt) > NumArgs)
+    return false;
+
+  // The type of generic strings and the record words in the helpers.
+  auto *StrTy = StrLenF->getFunctionType()->getParamType(0);
+  auto *WordPtrTy = ReserveF->getFunctionType()->getReturnType();
+
+  IRBuilder<> B(&OrigCall);
+  auto *Int32Ty = B.getInt32Ty();
+  auto *Int64Ty = B.getInt64Ty();
+
+  // Returns the words of a string item for a string of 'Len' bytes.
+  auto getStrWords = [&](Value *Len) -> Value * {
+    Value *IsNull =
+        B.CreateICmpEQ(Len, B.getInt32(chipstar::PrintfBuffer::NullString));
+    Value *DataWords = B.CreateLShr(B.CreateAdd(Len, B.getInt32(3)), 2);
+    return B.CreateSelect(IsNull, B.getInt32(1),
+                          B.CreateAdd(DataWords, B.getInt32(1)));
+  };
+
+  // Classify the arguments and compute the record size: a header word, the
+  // format and the arguments.
+  enum class ItemKind { Word, DWord, Str, PtrOrStr };
+  struct Item {
+    ItemKind Kind;
+    Value *V;
+    Value *Extra; // The length of Str and the string flag of PtrOrStr.
+  };
+  SmallVector<Item, 8> Items;
+  SmallBitVector StrArgs = Fmt ? getStrArgs(*Fmt, NumArgs) : SmallBitVector();
+  Value *StrArgMask = nullptr;
+  Value *FmtStr = nullptr, *FmtLen = nullptr;
+  Value *NumWords = B.getInt32(2);
+  if (!Fmt) {
+    FmtStr = B.CreatePointerBitCastOrAddrSpaceCast(FmtArg, StrTy);
+    FmtLen = B.CreateCall(StrLenF, {FmtStr});
+    NumWords = B.CreateAdd(NumWords, getStrWords(FmtLen));
+    StrArgMask = B.CreateCall(StrArgsF, {FmtStr});
+  }
+  for (unsigned I = 0; I < NumArgs; I++) {
+    Value *Arg = OrigCall.getArgOperand(I + 1);
+    Type *Ty = Arg->getType();
+    if (Ty->isPointerTy()) {
+      // Strings are read through generic pointers.
+      bool IsGeneric =
+          Ty->getPointerAddressSpace() != SPIRV_OPENCL_CONSTANT_AS;
+      if (Fmt && StrArgs.test(I)) {
+        if (!IsGeneric)
+          return false;
+        Value *Str = B.CreatePointerBitCastOrAddrSpaceCast(Arg, StrTy);
+        Value *Len = B.CreateCall(StrLenF, {Str});
+        NumWords = B.CreateAdd(NumWords, getStrWords(Len));
+        Items.push_back({ItemKind::Str, Str, Len});
+      } else if (!Fmt && IsGeneric) {
+        Value *IsStr = I < 32 ? B.CreateAnd(B.CreateLShr(StrArgMask, I), 1)
+                              : B.getInt32(0);
+        Value *Ptr = B.CreatePointerBitCastOrAddrSpaceCast(Arg, StrTy);
+        NumWords =
+            B.CreateAdd(NumWords, B.CreateCall(PtrArgWordsF, {Ptr, IsStr}));
+        Items.push_back({ItemKind::PtrOrStr, Ptr, IsStr});
+      } else {
+        NumWords = B.CreateAdd(NumWords, B.getInt32(2));
+        Items.push_back({ItemKind::DWord, B.CreatePtrToInt(Arg, Int64Ty)});
+      }
+    } else if (Fmt && StrArgs.test(I)) {
+      return false; // A %s conversion of a non-pointer.
+    } else if (Ty->isIntegerTy() && Ty->getIntegerBitWidth() <= 32) {
+      NumWords = B.CreateAdd(NumWords, B.getInt32(1));
+      Items.push_back({ItemKind::Word, B.CreateZExt(Arg, Int32Ty)});
+    } else if (Ty->isIntegerTy(64)) {
+      NumWords = B.CreateAdd(NumWords, B.getInt32(2));
+      Items.push_back({ItemKind::DWord, Arg});
+    } else if (Ty->isFloatTy() || Ty->isDoubleTy() || Ty->isHalfTy()) {
+      Value *Dbl = B.CreateFPExt(Arg, B.getDoubleTy());
+      NumWords = B.CreateAdd(NumWords, B.getInt32(2));
+      Items.push_back({ItemKind::DWord, B.CreateBitCast(Dbl, Int64Ty)});
+    } else {
+      return false;
+    }
+  }
+
+  // Fill in a record if one could be reserved.
+  Value *Buffer = B.CreateLoad(BufferVar->getValueType(), BufferVar);
+  Value *Record = B.CreateCall(
+      ReserveF,
+      {B.CreatePointerBitCastOrAddrSpaceCast(
+           Buffer, ReserveF->getFunctionType()->getParamType(0)),
+       NumWords});
+  B.SetInsertPoint(SplitBlockAndInsertIfThen(B.CreateIsNotNull(Record),
+                                             &OrigCall, false));
+  Value *Pos = B.CreateConstGEP1_32(Int32Ty, Record, 1);
+  auto putWord = [&](Value *Word) {
+    B.CreateStore(Word, Pos);
+    Pos = B.CreateConstGEP1_32(Int32Ty, Pos, 1);
+  };
+  auto putDWord = [&](Value *DWord) {
+    putWord(B.CreateTrunc(DWord, Int32Ty));
+    putWord(B.CreateTrunc(B.CreateLShr(DWord, 32), Int32Ty));
+  };
+  auto putItem = [&](Function *F, Value *V, Value *Extra) {
+    Pos = B.CreateCall(
+        F, {B.CreatePointerBitCastOrAddrSpaceCast(Pos, WordPtrTy), V, Extra});
+  };
+  if (Fmt) {
+    putWord(B.getInt32(getOrCreateFormatOffset(*Fmt)));
+  } else {
+    putWord(B.getInt32(chipstar::PrintfBuffer::InlineFormat));
+    putItem(PutStrF, FmtStr, FmtLen);
+  }
+  for (auto &Item : Items) {
+    switch (Item.Kind) {
+    case ItemKind::Word:
+      putWord(Item.V);
+      break;
+    case ItemKind::DWord:
+      putDWord(Item.V);
+      break;
+    case ItemKind::Str:
+      putItem(PutStrF, Item.V, Item.Extra);
+      break;
+    case ItemKind::PtrOrStr:
+      putItem(PutPtrArgF, Item.V, Item.Extra);
+      break;
+    }
+  }
+  B.CreateCall(CommitF, {Record, NumWords});
+
+  // Like the OpenCL printf lowering, return the number of format
+  // specifiers. It is not known for dynamic format strings, so the number
+  // of the arguments is returned instead.
+  OrigCall.replaceAllUsesWith(
+      B.getInt32(Fmt ? NumFormatSpecs(*Fmt) : NumArgs));
+  return true;
+}
+
+// Emit the format strings of the printf buffer records and a shadow kernel
+// for the runtime to query them. See ChipPrintfFormatsKernelName.
+void HipPrintfToOpenCLPrintfPass::emitFormatsKernel() {
+  LLVMContext &Ctx = M_->getContext();
+  auto *Formats = new GlobalVariable(
+      *M_, ArrayType::get(Type::getInt8Ty(Ctx), Formats_.size()), true,
+      GlobalValue::PrivateLinkage,
+      ConstantDataArray::getString(Ctx, Formats_, false), "__chip_printf_fmts",
+      nullptr, GlobalValue::NotThreadLocal, SPIRV_OPENCL_GLOBAL_AS);
+  Formats->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+  Formats->setAlignment(Align(1));
+
+  auto *Int64Ty = Type::getInt64Ty(Ctx);
+  auto *OutTy = PointerType::get(Int64Ty, SPIRV_OPENCL_GLOBAL_AS);
+  auto *F = cast<Function>(
+      M_->getOrInsertFunction(
+            ChipPrintfFormatsKernelName,
+            FunctionType::get(Type::getVoidTy(Ctx), {OutTy, Int64Ty}, false))
+          .getCallee());
+  assert(F->empty() && "Function name clash?");
+  F->setCallingConv(CallingConv::SPIR_KERNEL);
+  // HIP-CLang marks kernels hidden. Do the same here for consistency.
+  F->setVisibility(GlobalValue::HiddenVisibility);
+
+  Value *Out = F->getArg(0), *Capacity = F->getArg(1);
+  auto *Entry = BasicBlock::Create(Ctx, "entry", F);
+  auto *Copy = BasicBlock::Create(Ctx, "copy", F);
+  auto *Exit = BasicBlock::Create(Ctx, "exit", F);
+  IRBuilder<> B(Entry);
+  Value *Size = B.getInt64(Formats_.size());
+  B.CreateStore(Size, Out);
+  B.CreateCondBr(B.CreateICmpULE(Size, Capacity), Copy, Exit);
+  B.SetInsertPoint(Copy);
+  B.CreateMemCpy(B.CreateConstGEP1_32(Int64Ty, Out, 1), MaybeAlign(8),
+                 Formats, MaybeAlign(1), Size);
+  B.CreateBr(Exit);
+  B.SetInsertPoint(Exit);
+  B.CreateRetVoid();
+}
+
+// Erase the printf buffer variable unless printf() calls were lowered to
+// use it. Returns true if it was erased.
+static bool erasePrintfBuffer(Module &M) {
+  GlobalVariable *BufferVar = M.getGlobalVariable(ChipPrintfBufferVarName);
+  if (!BufferVar ||
+      any_of(BufferVar->users(), [](User *U) { return isa<Instruction>(U); }))
+    return false;
+  BufferVar->replaceAllUsesWith(Constant::getNullValue(BufferVar->getType()));
+  BufferVar->eraseFromParent();
+  return true;
+}
+
 PreservedAnalyses HipPrintfToOpenCLPrintfPass::run(Module &Mod,
                                                    ModuleAnalysisManager &AM) {
 
   M_ = &Mod;
   LiteralArgs_.clear();
+  Formats_.clear();
+  FormatOffsets_.clear();
 
   GlobalValue *Printf = Mod.getNamedValue("printf");
   GlobalValue *HipPrintf = Mod.getNamedValue(ORIG_PRINTF_FUNC_NAME);
@@ -301,7 +666,8 @@ PreservedAnalyses HipPrintfToOpenCLPrintfPass::run(Module &Mod,
   // No printf decl in the module, no printf calls to handle.
   // 1 use if the "printf" is only used by "_cl_printf"
   if (Printf == nullptr || Printf->getNumUses() == 1)
-    return PreservedAnalyses::all();
+    return erasePrintfBuffer(Mod) ? PreservedAnalyses::none()
+                                  : PreservedAnalyses::all();
   LLVM_DEBUG(dbgs() << "Found printf decl: "; Printf->dump());
 
   Function *PrintfF = cast<Function>(Printf);
@@ -334,11 +700,10 @@ PreservedAnalyses HipPrintfToOpenCLPrintfPass::run(Module &Mod,
     OpenCLPrintfF = FunctionCallee(OpenCLPrintfTy, PrintfF);
   }
 
-  bool Modified = false;
-
-  for (auto &F : Mod) {
-    SmallPtrSet<Instruction *, 8> EraseList;
-    for (auto &BB : F) {
+  // Collect the calls first since the printf buffer lowering splits blocks.
+  std::vector<CallInst *> PrintfCalls;
+  for (auto &F : Mod)
+    for (auto &BB : F)
       for (auto &I : BB) {
         CallInst *CI = dyn_cast<CallInst>(&I);
         if (!CI)
@@ -349,105 +714,20 @@ PreservedAnalyses HipPrintfToOpenCLPrintfPass::run(Module &Mod,
           continue;
         if (!Callee->hasName() || Callee->getName() != ORIG_PRINTF_FUNC_NAME)
           continue;
-
-        LLVM_DEBUG(dbgs() << "Original printf call: "; CI->dump());
-
-        CallInst &OrigCall = cast<CallInst>(I);
-        unsigned TotalFmtSpecCount;
-        auto FmtSpecPieces =
-            getFormatStringPieces(*OrigCall.args().begin(), TotalFmtSpecCount);
-
-        IRBuilder<> B(&I);
-
-        if (TotalFmtSpecCount > OrigCall.arg_size() - 1) {
-          // More specifiers than format arguments. Either the user forgot
-          // arguments or the format string has invalid specifiers - in either
-          // case this triggers UB.
-          LLVM_DEBUG(dbgs()
-                     << "  Invalid format string or missing arguments?\n");
-          Value *ErrorFmt = getOrCreateStrLiteralArg(
-              "Error: Invalid printf format string\n", B);
-          CallInst::Create(OpenCLPrintfF, ArrayRef(ErrorFmt), "", &OrigCall);
-          auto *PoisonInt = PoisonValue::get(Type::getInt32Ty(Ctx));
-          OrigCall.replaceAllUsesWith(PoisonInt);
-          EraseList.insert(&OrigCall);
-          continue;
-        }
-
-        auto OrigCallArgs = OrigCall.args();
-        auto OrigCallArgI = OrigCallArgs.begin();
-        // Skip the original format string arg and recreate it.
-        OrigCallArgI++;
-
-        for (auto FmtStr : FmtSpecPieces) {
-          unsigned FormatSpecCount = NumFormatSpecs(FmtStr);
-          std::vector<Value *> Args;
-
-          // TODO: handle a (compile time known) null ptr format string arg and
-          // return -1 like CUDA does.
-          if (FmtStr == "") {
-            // No output, the return value suffices.
-            continue;
-          } else if (FmtStr == "%s" || FmtStr == "%*s") {
-            // This is a string printout, we do not pass the format string
-            // in that case, but just call a string printer.
-            // We can use the normal printf if the %s arg can be resolved to
-            // a literal C string. However, it must be moved to constant AS
-            // for OpenCL compatibility.
-            Value *OrigArg = *OrigCallArgI++;
-            bool IsEmpty = false;
-            if (Value *ConstantSpaceCStr =
-                    cloneStrArgToConstantAS(OrigArg, B, &IsEmpty)) {
-              if (IsEmpty)
-                continue; // empty str arg to a %s, no output needed
-              // We could copy the arg to constant space, printf it
-              // directly. No format string needed.
-              Args.push_back(ConstantSpaceCStr);
-              CallInst::Create(OpenCLPrintfF, Args, "", &OrigCall);
-            } else if (ASSUME_PRINTF_SUPPORTS_GLOBAL_STRING_ARGS) {
-              if (IsEmpty)
-                continue;
-              // Create a constant space format string for %s.
-              Args.push_back(getOrCreateStrLiteralArg("%s", B));
-              // ...and then assume the data arg can point to a generic
-              // address space string (eventually residing in global AS).
-              Args.push_back(OrigArg);
-              CallInst::Create(OpenCLPrintfF, Args, "", &OrigCall);
-            } else {
-              Args.push_back(OrigArg);
-              CallInst::Create(getOrCreatePrintStringF(), Args, "", &OrigCall);
-            }
-            continue;
-          }
-
-          // Handle as a normal printf() call.
-          Args.push_back(getOrCreateStrLiteralArg(FmtStr, B));
-          while (FormatSpecCount--) {
-            assert(OrigCallArgI != OrigCallArgs.end());
-            Value *OrigArg = *OrigCallArgI++;
-            Args.push_back(OrigArg);
-          }
-          CallInst::Create(OpenCLPrintfF, Args, "", &OrigCall);
-        }
-
-        // Instead of returning the success/failure from the OpenCL printf(),
-        // assume that the parsing succeeds and return the number of format
-        // strings. A slight improvement would be to return 0 in case of a
-        // failure, but it still would not necessarily match CUDA nor HIP
-        // since it should return the number of _valid_ format replacements.
-        IntegerType *Int32Ty = Type::getInt32Ty(Ctx);
-        ConstantInt *RV = ConstantInt::get(Int32Ty, TotalFmtSpecCount);
-        OrigCall.replaceAllUsesWith(RV);
-
-        EraseList.insert(&I);
+        PrintfCalls.push_back(CI);
       }
-    }
-    for (auto I : EraseList)
-      I->eraseFromParent();
-    Modified |= EraseList.size() > 0;
+
+  for (auto *CI : PrintfCalls) {
+    LLVM_DEBUG(dbgs() << "Original printf call: "; CI->dump());
+    if (!UseBuffer_ || !lowerToPrintfBuffer(*CI))
+      lowerToOpenCLPrintf(*CI, OpenCLPrintfF);
+    CI->eraseFromParent();
   }
 
-  SmallPtrSet<GlobalVariable *, 8> UnusedGlobals;
+  if (!Formats_.empty())
+    emitFormatsKernel();
+  bool Modified = erasePrintfBuffer(Mod) || !PrintfCalls.empty();
+
   return Modified ? PreservedAnalyses::none() : PreservedAnalyses::all();
 }
 
@@ -464,6 +744,10 @@ llvmGetPassPluginInfo() {
                     FPM.addPass(HipPrintfToOpenCLPrintfPass());
                     return true;
                   }
+                  if (Name == "hip-printf-buffer") {
+                    FPM.addPass(HipPrintfToOpenCLPrintfPass(true));
+                    return true;
+                  }
                   return false;
                 });
           }};
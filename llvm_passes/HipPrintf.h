@@ -25,10 +25,19 @@ using namespace llvm;
 class HipPrintfToOpenCLPrintfPass
     : public PassInfoMixin<HipPrintfToOpenCLPrintfPass> {
 public:
+  /// If 'UseBuffer' is set, the printf() calls are lowered to records in the
+  /// printf buffer (see src/CHIPPrintf.hh) instead of OpenCL printf() calls.
+  HipPrintfToOpenCLPrintfPass(bool UseBuffer = false)
+      : UseBuffer_(UseBuffer) {}
+
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
   static bool isRequired() { return true; }
 
 private:
+  void lowerToOpenCLPrintf(CallInst &OrigCall, FunctionCallee OpenCLPrintfF);
+  bool lowerToPrintfBuffer(CallInst &OrigCall);
+  uint32_t getOrCreateFormatOffset(const std::string &Fmt);
+  void emitFormatsKernel();
   Constant *getOrCreateStrLiteralArg(
       const std::string& Str, llvm::IRBuilder<>& B);
   Function *getOrCreatePrintStringF();
@@ -37,6 +46,11 @@ private:
 
   std::map<std::string, Constant*> LiteralArgs_;
   Module *M_;
+
+  bool UseBuffer_;
+  /// The nul-separated format strings of the printf buffer records.
+  std::string Formats_;
+  std::map<std::string, uint32_t> FormatOffsets_;
 };
 
 #endif
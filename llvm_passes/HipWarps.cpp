@@ -24,11 +24,65 @@
 
 #include "HipWarps.h"
 
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Analysis/CallGraph.h>
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Constants.h>
 
 #include "chipStarConfig.hh"
 
+// Return true if the kernel may call any of the 'SensitiveFuncs', directly
+// or through other functions. Indirect calls are assumed to call them.
+static bool
+mayCallAny(const CallGraph &CG, const Function &Kernel,
+           const SmallPtrSetImpl<const Function *> &SensitiveFuncs) {
+  SmallPtrSet<const CallGraphNode *, 16> Visited;
+  SmallVector<const CallGraphNode *, 16> Worklist{CG[&Kernel]};
+  while (!Worklist.empty()) {
+    const auto *Node = Worklist.pop_back_val();
+    if (!Visited.insert(Node).second)
+      continue;
+    for (const auto &[Call, Callee] : *Node) {
+      const auto *F = Callee->getFunction();
+      if (!F)
+        return true; // An indirect call.
+      if (SensitiveFuncs.count(F))
+        return true;
+      // The declarations are builtins which don't call back to the module.
+      if (!F->isDeclaration())
+        Worklist.push_back(Callee);
+    }
+  }
+  return false;
+}
+
+// Return the identifier of a function name mangled as _Z<length><identifier>
+// followed by the parameter types, or the name as is if it isn't.
+static StringRef getIdentifier(StringRef Name) {
+  StringRef Rest = Name;
+  unsigned Length;
+  if (!Rest.consume_front("_Z") || Rest.consumeInteger(10, Length) ||
+      Length > Rest.size())
+    return Name;
+  return Rest.take_front(Length);
+}
+
+// Return true if F is a warp primitive or a subgroup builtin whose result
+// depends on the warp width. All overloads of them are matched.
+static bool isWarpSizeSensitive(const Function &F) {
+  StringRef Id = getIdentifier(F.getName());
+  // The shuffles, ballots and reductions of the OpenCL subgroup extensions
+  // which the warp primitives are implemented with.
+  if (Id.startswith("sub_group_") || Id.startswith("intel_sub_group_"))
+    return true;
+  // The __ballot(), __all() and __any() of the device library call the
+  // __chip_* variants.
+  return Id == "get_sub_group_local_id" || Id == "__shfl" ||
+         Id == "__shfl_xor" || Id == "__shfl_up" || Id == "__shfl_down" ||
+         Id == "__ballot" || Id == "__chip_ballot" || Id == "__chip_all" ||
+         Id == "__chip_any" || Id == "__chip_lane_id";
+}
+
 PreservedAnalyses HipWarpsPass::run(Module &Mod, ModuleAnalysisManager &AM) {
 
   // We emulate warps with subgroups of which size is implementation and
@@ -39,50 +93,23 @@ PreservedAnalyses HipWarpsPass::run(Module &Mod, ModuleAnalysisManager &AM) {
   // size to be fixed to the warp size used by the chipStar build in case there
   // is a possibility the kernel's semantically sensitive to the warp width.
   //
-  // For now check if the CUDA warp-size sensitive intrinsic declarations appear
-  // in the module and assume all the kernels call them. TO OPTIMIZE: Use
-  // CallGraph to analyze if the kernels really call them to allow subgroup
-  // freedom for those that don't.
-
-  std::vector<const char *> WarpSizeSensitiveFuncNames = {
-      "_Z6__shfliii",
-      "_Z6__shflfii",
-      "_Z10__shfl_xoriii",
-      "_Z10__shfl_xorfii",
-      "_Z9__shfl_upiji",
-      "_Z9__shfl_upfji",
-      "_Z11__shfl_downiji",
-      "_Z11__shfl_downfji",
-      "_Z8__balloti",
-      "_Z16sub_group_balloti",
-      "_Z17sub_group_shufflefj",
-      "_Z17sub_group_shuffleij",
-      "_Z21sub_group_shuffle_xorij",
-      "_Z21sub_group_shuffle_xorfj",
-      "_Z22sub_group_shuffle_downiij",
-      "_Z22sub_group_shuffle_downffj",
-      "_Z20sub_group_shuffle_upiij",
-      "_Z20sub_group_shuffle_upffj",
-      "_Z23intel_sub_group_shuffleij",
-      "_Z23intel_sub_group_shufflefj",
-      "_Z27intel_sub_group_shuffle_xorij",
-      "_Z27intel_sub_group_shuffle_xorfj",
-      "_Z22get_sub_group_local_idv"};
+  // Only the kernels which may call the CUDA warp-size sensitive intrinsics
+  // get the metadata. The others are left the subgroup freedom.
 
-  bool SensitiveFuncFound = false;
-  for (auto &FuncName : WarpSizeSensitiveFuncNames) {
-    if (Mod.getNamedValue(FuncName)) {
-      SensitiveFuncFound = true;
-      break;
-    }
-  }
+  SmallPtrSet<const Function *, 8> SensitiveFuncs;
+  for (auto &F : Mod)
+    if (isWarpSizeSensitive(F))
+      SensitiveFuncs.insert(&F);
 
-  if (!SensitiveFuncFound)
+  if (SensitiveFuncs.empty())
     return PreservedAnalyses::all();
 
+  CallGraph CG(Mod);
   auto &Ctx = Mod.getContext();
   for (auto &F : Mod) {
-    if (F.getCallingConv() != CallingConv::SPIR_KERNEL)
+    if (F.getCallingConv() != CallingConv::SPIR_KERNEL || F.isDeclaration())
+      continue;
+    if (!mayCallAny(CG, F, SensitiveFuncs))
       continue;
 
     IntegerType *I32Type = IntegerType::get(Ctx, 32);
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+// Measures hipGraphInstantiate time for synthetic graphs of increasing size.
+// The graphs are stacks of wide layers in which every node depends on all
+// the nodes of the previous layer and on a node a few layers further back.
+// The latter edges are redundant, and the number of paths through such a
+// graph grows exponentially with its depth.
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+constexpr int LayerWidth = 8;
+constexpr int SkipDistance = 3;
+
+__global__ void increment(int *Counter) { atomicAdd(Counter, 1); }
+
+// Build a graph of NumLayers * LayerWidth empty nodes followed by a single
+// kernel node which depends on the last layer.
+static hipGraph_t buildGraph(int NumLayers, int *Counter, size_t &NumNodes,
+                             size_t &NumEdges) {
+  NumNodes = NumEdges = 0;
+  hipGraph_t Graph;
+  CHECK(hipGraphCreate(&Graph, 0));
+  std::vector<std::vector<hipGraphNode_t>> Layers(NumLayers);
+  for (int L = 0; L < NumLayers; L++) {
+    for (int i = 0; i < LayerWidth; i++) {
+      std::vector<hipGraphNode_t> Deps;
+      if (L > 0)
+        Deps = Layers[L - 1];
+      if (L >= SkipDistance)
+        Deps.push_back(Layers[L - SkipDistance][i]);
+      hipGraphNode_t Node;
+      CHECK(hipGraphAddEmptyNode(&Node, Graph, Deps.data(), Deps.size()));
+      Layers[L].push_back(Node);
+      NumNodes++;
+      NumEdges += Deps.size();
+    }
+  }
+
+  void *Args[] = {&Counter};
+  hipKernelNodeParams Params = {};
+  Params.func = reinterpret_cast<void *>(increment);
+  Params.gridDim = dim3(1);
+  Params.blockDim = dim3(1);
+  Params.kernelParams = Args;
+  hipGraphNode_t Node;
+  CHECK(hipGraphAddKernelNode(&Node, Graph, Layers.back().data(),
+                              Layers.back().size(), &Params));
+  NumNodes++;
+  NumEdges += Layers.back().size();
+  return Graph;
+}
+
+int main() {
+  int *Counter;
+  CHECK(hipMalloc(&Counter, sizeof(int)));
+  CHECK(hipMemset(Counter, 0, sizeof(int)));
+
+  hipStream_t Stream;
+  CHECK(hipStreamCreate(&Stream));
+
+  using Clock = std::chrono::steady_clock;
+  int NumLaunches = 0;
+  printf("%8s %8s %20s\n", "nodes", "edges", "instantiate [ms]");
+  for (int NumLayers = 4; NumLayers <= 256; NumLayers *= 2) {
+    size_t NumNodes, NumEdges;
+    hipGraph_t Graph = buildGraph(NumLayers, Counter, NumNodes, NumEdges);
+
+    auto Start = Clock::now();
+    hipGraphExec_t GraphExec;
+    CHECK(hipGraphInstantiate(&GraphExec, Graph, nullptr, nullptr, 0));
+    double Millis =
+        std::chrono::duration<double, std::milli>(Clock::now() - Start)
+            .count();
+    printf("%8zu %8zu %20.2f\n", NumNodes, NumEdges, Millis);
+
+    CHECK(hipGraphLaunch(GraphExec, Stream));
+    NumLaunches++;
+    CHECK(hipGraphExecDestroy(GraphExec));
+    CHECK(hipGraphDestroy(Graph));
+  }
+  CHECK(hipStreamSynchronize(Stream));
+
+  int Result;
+  CHECK(hipMemcpy(&Result, Counter, sizeof(int), hipMemcpyDeviceToHost));
+  CHECK(hipStreamDestroy(Stream));
+  CHECK(hipFree(Counter));
+
+  bool Ok = Result == NumLaunches;
+  std::cout << (Ok ? "PASSED" : "FAILED") << "\n";
+  return Ok ? 0 : 1;
+}
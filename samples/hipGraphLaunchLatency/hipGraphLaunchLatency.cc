@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+// Compares the host-side cost of submitting a chain of small kernels as one
+// instantiated graph against launching the same kernels one by one.
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+constexpr int ChainLength = 100;
+constexpr int NumReps = 50;
+constexpr unsigned NumElements = 256;
+
+__global__ void addOne(int *Data) {
+  unsigned I = blockIdx.x * blockDim.x + threadIdx.x;
+  if (I < NumElements)
+    Data[I] += 1;
+}
+
+int main() {
+  int *Data;
+  CHECK(hipMalloc(&Data, NumElements * sizeof(int)));
+  CHECK(hipMemset(Data, 0, NumElements * sizeof(int)));
+
+  hipStream_t Stream;
+  CHECK(hipStreamCreate(&Stream));
+
+  hipGraph_t Graph;
+  CHECK(hipGraphCreate(&Graph, 0));
+  void *Args[] = {&Data};
+  hipKernelNodeParams Params = {};
+  Params.func = reinterpret_cast<void *>(addOne);
+  Params.gridDim = dim3(1);
+  Params.blockDim = dim3(NumElements);
+  Params.kernelParams = Args;
+  hipGraphNode_t Prev = nullptr;
+  for (int i = 0; i < ChainLength; i++) {
+    hipGraphNode_t Node;
+    CHECK(hipGraphAddKernelNode(&Node, Graph, Prev ? &Prev : nullptr,
+                                Prev ? 1 : 0, &Params));
+    Prev = Node;
+  }
+  hipGraphExec_t GraphExec;
+  CHECK(hipGraphInstantiate(&GraphExec, Graph, nullptr, nullptr, 0));
+
+  // Warm up both paths so that the kernel is compiled before timing.
+  hipLaunchKernelGGL(addOne, dim3(1), dim3(NumElements), 0, Stream, Data);
+  CHECK(hipGraphLaunch(GraphExec, Stream));
+  CHECK(hipStreamSynchronize(Stream));
+
+  using Clock = std::chrono::steady_clock;
+  auto Micros = [](Clock::duration D) {
+    return std::chrono::duration<double, std::micro>(D).count() / NumReps;
+  };
+
+  Clock::duration EagerSubmit{}, EagerTotal{};
+  for (int Rep = 0; Rep < NumReps; Rep++) {
+    auto Start = Clock::now();
+    for (int i = 0; i < ChainLength; i++)
+      hipLaunchKernelGGL(addOne, dim3(1), dim3(NumElements), 0, Stream, Data);
+    EagerSubmit += Clock::now() - Start;
+    CHECK(hipStreamSynchronize(Stream));
+    EagerTotal += Clock::now() - Start;
+  }
+
+  Clock::duration GraphSubmit{}, GraphTotal{};
+  for (int Rep = 0; Rep < NumReps; Rep++) {
+    auto Start = Clock::now();
+    CHECK(hipGraphLaunch(GraphExec, Stream));
+    GraphSubmit += Clock::now() - Start;
+    CHECK(hipStreamSynchronize(Stream));
+    GraphTotal += Clock::now() - Start;
+  }
+
+  printf("%d-kernel chain, averaged over %d runs\n", ChainLength, NumReps);
+  printf("%8s %14s %14s\n", "", "submit [us]", "total [us]");
+  printf("%8s %14.2f %14.2f\n", "eager", Micros(EagerSubmit),
+         Micros(EagerTotal));
+  printf("%8s %14.2f %14.2f\n", "graph", Micros(GraphSubmit),
+         Micros(GraphTotal));
+
+  int Host[NumElements];
+  CHECK(hipMemcpy(Host, Data, sizeof(Host), hipMemcpyDeviceToHost));
+  const int Expected = 1 + ChainLength + 2 * NumReps * ChainLength;
+  bool Ok = true;
+  for (unsigned i = 0; i < NumElements; i++)
+    Ok &= Host[i] == Expected;
+
+  CHECK(hipGraphExecDestroy(GraphExec));
+  CHECK(hipGraphDestroy(Graph));
+  CHECK(hipStreamDestroy(Stream));
+  CHECK(hipFree(Data));
+
+  std::cout << (Ok ? "PASSED" : "FAILED") << "\n";
+  return Ok ? 0 : 1;
+}
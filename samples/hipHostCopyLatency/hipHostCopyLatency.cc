@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Measures the latency of small copies between host-accessible buffers
+// (pinned host and managed memory). Run with CHIP_HOST_COPY_MAX_SIZE=0 to
+// disable the host-side copy path for comparison.
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+constexpr size_t MinSize = 8;
+constexpr size_t MaxSize = 64 * 1024;
+constexpr int NumReps = 1000;
+
+int main() {
+  unsigned char *HostBuf, *ManagedBuf;
+  CHECK(hipHostMalloc(&HostBuf, MaxSize));
+  CHECK(hipMallocManaged(&ManagedBuf, MaxSize));
+  for (size_t i = 0; i < MaxSize; i++)
+    HostBuf[i] = (unsigned char)(i * 13 + 1);
+
+  hipStream_t Stream;
+  CHECK(hipStreamCreate(&Stream));
+
+  using Clock = std::chrono::steady_clock;
+  auto Elapsed = [](Clock::time_point Start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - Start)
+               .count() /
+           NumReps;
+  };
+
+  bool Ok = true;
+  printf("%10s %16s %22s\n", "size [B]", "hipMemcpy [us]",
+         "hipMemcpyAsync [us]");
+  for (size_t Size = MinSize; Size <= MaxSize; Size *= 2) {
+    auto Start = Clock::now();
+    for (int Rep = 0; Rep < NumReps; Rep++)
+      CHECK(hipMemcpy(ManagedBuf, HostBuf, Size, hipMemcpyDefault));
+    double SyncTime = Elapsed(Start);
+    Ok &= std::memcmp(ManagedBuf, HostBuf, Size) == 0;
+
+    std::memset(ManagedBuf, 0, Size);
+    Start = Clock::now();
+    for (int Rep = 0; Rep < NumReps; Rep++) {
+      CHECK(hipMemcpyAsync(ManagedBuf, HostBuf, Size, hipMemcpyDefault,
+                           Stream));
+      CHECK(hipStreamSynchronize(Stream));
+    }
+    double AsyncTime = Elapsed(Start);
+    Ok &= std::memcmp(ManagedBuf, HostBuf, Size) == 0;
+
+    printf("%10zu %16.2f %22.2f\n", Size, SyncTime, AsyncTime);
+  }
+
+  CHECK(hipStreamDestroy(Stream));
+  CHECK(hipHostFree(HostBuf));
+  CHECK(hipFree(ManagedBuf));
+
+  std::cout << (Ok ? "PASSED" : "FAILED") << "\n";
+  return Ok ? 0 : 1;
+}
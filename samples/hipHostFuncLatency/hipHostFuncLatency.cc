@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+// Measures the round-trip latency of host functions enqueued into a stream
+// with hipLaunchHostFunc() and hipStreamAddCallback(): the time from the
+// submission until the function runs and until a kernel enqueued after the
+// function has completed.
+
+#include "hip/hip_runtime.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+constexpr int NumReps = 200;
+
+using Clock = std::chrono::steady_clock;
+
+struct Probe {
+  std::atomic<int> Calls{0};
+  Clock::time_point Called;
+};
+
+__global__ void addOne(int *Data) { *Data += 1; }
+
+static void hostFunc(void *UserData) {
+  auto *P = static_cast<Probe *>(UserData);
+  P->Called = Clock::now();
+  P->Calls++;
+}
+
+static void streamCallback(hipStream_t, hipError_t, void *UserData) {
+  hostFunc(UserData);
+}
+
+template <class EnqueueFn>
+static void measure(const char *Name, hipStream_t Stream, int *Data,
+                    EnqueueFn Enqueue) {
+  Probe P;
+  Clock::duration ToCall{}, Total{};
+  for (int Rep = 0; Rep < NumReps; Rep++) {
+    auto Start = Clock::now();
+    Enqueue(&P);
+    hipLaunchKernelGGL(addOne, dim3(1), dim3(1), 0, Stream, Data);
+    CHECK(hipStreamSynchronize(Stream));
+    Total += Clock::now() - Start;
+    ToCall += P.Called - Start;
+  }
+  auto Micros = [](Clock::duration D) {
+    return std::chrono::duration<double, std::micro>(D).count() / NumReps;
+  };
+  printf("%22s %14.2f %14.2f\n", Name, Micros(ToCall), Micros(Total));
+  if (P.Calls != NumReps) {
+    printf("%s: %d calls, expected %d\n", Name, P.Calls.load(), NumReps);
+    exit(1);
+  }
+}
+
+int main() {
+  int *Data;
+  CHECK(hipMalloc(&Data, sizeof(int)));
+  CHECK(hipMemset(Data, 0, sizeof(int)));
+
+  hipStream_t Stream;
+  CHECK(hipStreamCreate(&Stream));
+
+  // Warm up so that the kernel is compiled and the helper threads are
+  // running before timing.
+  Probe Warmup;
+  hipLaunchKernelGGL(addOne, dim3(1), dim3(1), 0, Stream, Data);
+  CHECK(hipLaunchHostFunc(Stream, hostFunc, &Warmup));
+  CHECK(hipStreamAddCallback(Stream, streamCallback, &Warmup, 0));
+  CHECK(hipStreamSynchronize(Stream));
+
+  printf("Host function round trip, averaged over %d runs\n", NumReps);
+  printf("%22s %14s %14s\n", "", "to call [us]", "total [us]");
+  measure("hipLaunchHostFunc", Stream, Data, [&](Probe *P) {
+    CHECK(hipLaunchHostFunc(Stream, hostFunc, P));
+  });
+  measure("hipStreamAddCallback", Stream, Data, [&](Probe *P) {
+    CHECK(hipStreamAddCallback(Stream, streamCallback, P, 0));
+  });
+
+  int Host;
+  CHECK(hipMemcpy(&Host, Data, sizeof(Host), hipMemcpyDeviceToHost));
+  const bool Ok = Host == 1 + 2 * NumReps && Warmup.Calls == 2;
+
+  CHECK(hipStreamDestroy(Stream));
+  CHECK(hipFree(Data));
+
+  std::cout << (Ok ? "PASSED" : "FAILED") << "\n";
+  return Ok ? 0 : 1;
+}
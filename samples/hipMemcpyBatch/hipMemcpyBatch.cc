@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Compares gathering many small chunks with one hipMemcpyAsync() per chunk
+// against a single hipExtMemcpyBatchAsync() call.
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+constexpr size_t NumChunks = 4096;
+constexpr size_t ChunkSize = 256;
+constexpr int NumReps = 10;
+
+int main() {
+  const size_t TotalSize = NumChunks * ChunkSize;
+  std::vector<unsigned char> SrcH(TotalSize), DstH(TotalSize);
+  for (size_t i = 0; i < TotalSize; i++)
+    SrcH[i] = (unsigned char)(i * 7 + 3);
+
+  unsigned char *SrcD, *DstD;
+  CHECK(hipMalloc(&SrcD, TotalSize));
+  CHECK(hipMalloc(&DstD, TotalSize));
+  CHECK(hipMemcpy(SrcD, SrcH.data(), TotalSize, hipMemcpyHostToDevice));
+
+  hipStream_t Stream;
+  CHECK(hipStreamCreate(&Stream));
+
+  // Gather the chunks in reverse order.
+  std::vector<void *> Dsts(NumChunks);
+  std::vector<const void *> Srcs(NumChunks);
+  std::vector<size_t> Sizes(NumChunks, ChunkSize);
+  for (size_t i = 0; i < NumChunks; i++) {
+    Dsts[i] = DstD + i * ChunkSize;
+    Srcs[i] = SrcD + (NumChunks - 1 - i) * ChunkSize;
+  }
+
+  auto Verify = [&]() -> bool {
+    CHECK(hipMemcpy(DstH.data(), DstD, TotalSize, hipMemcpyDeviceToHost));
+    for (size_t i = 0; i < NumChunks; i++)
+      for (size_t j = 0; j < ChunkSize; j++)
+        if (DstH[i * ChunkSize + j] !=
+            SrcH[(NumChunks - 1 - i) * ChunkSize + j])
+          return false;
+    return true;
+  };
+
+  using Clock = std::chrono::steady_clock;
+  auto Elapsed = [](Clock::time_point Start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - Start)
+        .count();
+  };
+
+  // Warm up.
+  CHECK(hipExtMemcpyBatchAsync(Dsts.data(), Srcs.data(), Sizes.data(),
+                               NumChunks, hipMemcpyDeviceToDevice, Stream));
+  CHECK(hipStreamSynchronize(Stream));
+
+  CHECK(hipMemset(DstD, 0, TotalSize));
+  auto Start = Clock::now();
+  for (int Rep = 0; Rep < NumReps; Rep++) {
+    for (size_t i = 0; i < NumChunks; i++)
+      CHECK(hipMemcpyAsync(Dsts[i], Srcs[i], Sizes[i],
+                           hipMemcpyDeviceToDevice, Stream));
+    CHECK(hipStreamSynchronize(Stream));
+  }
+  double LoopTime = Elapsed(Start) / NumReps;
+  bool LoopOk = Verify();
+
+  CHECK(hipMemset(DstD, 0, TotalSize));
+  Start = Clock::now();
+  for (int Rep = 0; Rep < NumReps; Rep++) {
+    CHECK(hipExtMemcpyBatchAsync(Dsts.data(), Srcs.data(), Sizes.data(),
+                                 NumChunks, hipMemcpyDeviceToDevice, Stream));
+    CHECK(hipStreamSynchronize(Stream));
+  }
+  double BatchTime = Elapsed(Start) / NumReps;
+  bool BatchOk = Verify();
+
+  std::cout << NumChunks << " copies of " << ChunkSize << " B\n";
+  std::cout << "hipMemcpyAsync loop:    " << LoopTime << " us\n";
+  std::cout << "hipExtMemcpyBatchAsync: " << BatchTime << " us\n";
+  std::cout << "speedup: " << LoopTime / BatchTime << "x\n";
+
+  CHECK(hipStreamDestroy(Stream));
+  CHECK(hipFree(SrcD));
+  CHECK(hipFree(DstD));
+
+  if (LoopOk && BatchOk) {
+    std::cout << "PASSED\n";
+    return 0;
+  }
+  std::cout << "FAILED\n";
+  return 1;
+}
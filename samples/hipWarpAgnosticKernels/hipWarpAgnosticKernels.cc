@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+// Measures the effect of the subgroup size requirement on kernels which
+// don't use warp primitives. Both kernels below do the same work and live
+// in the same module, but only the second one calls a warp primitive and
+// thus gets its subgroup size fixed to the warp size. The first one is free
+// to run with the subgroup size the driver considers the best.
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+constexpr unsigned N = 1 << 22;
+constexpr unsigned BlockSize = 256;
+constexpr int NumIters = 64;
+constexpr int NumReps = 50;
+
+__device__ float compute(float X, float Y) {
+  for (int I = 0; I < NumIters; I++)
+    X = X * 0.999f + Y;
+  return X;
+}
+
+__global__ void warpAgnostic(const float *In, float *Out) {
+  unsigned I = blockIdx.x * blockDim.x + threadIdx.x;
+  Out[I] = compute(In[I], 0.5f);
+}
+
+__global__ void warpSensitive(const float *In, float *Out) {
+  unsigned I = blockIdx.x * blockDim.x + threadIdx.x;
+  // Reads the own value of the thread, so the result is the same.
+  float X = __shfl(In[I], threadIdx.x % warpSize);
+  Out[I] = compute(X, 0.5f);
+}
+
+template <class KernelT>
+static double measure(KernelT Kernel, const float *In, float *Out) {
+  hipLaunchKernelGGL(Kernel, dim3(N / BlockSize), dim3(BlockSize), 0, 0, In,
+                     Out);
+  CHECK(hipDeviceSynchronize());
+
+  auto Start = std::chrono::steady_clock::now();
+  for (int Rep = 0; Rep < NumReps; Rep++)
+    hipLaunchKernelGGL(Kernel, dim3(N / BlockSize), dim3(BlockSize), 0, 0, In,
+                       Out);
+  CHECK(hipDeviceSynchronize());
+  auto Elapsed = std::chrono::steady_clock::now() - Start;
+  return std::chrono::duration<double, std::micro>(Elapsed).count() / NumReps;
+}
+
+int main() {
+  std::vector<float> Host(N);
+  for (unsigned I = 0; I < N; I++)
+    Host[I] = static_cast<float>(I % 1000);
+
+  float *In, *Out1, *Out2;
+  CHECK(hipMalloc(&In, N * sizeof(float)));
+  CHECK(hipMalloc(&Out1, N * sizeof(float)));
+  CHECK(hipMalloc(&Out2, N * sizeof(float)));
+  CHECK(hipMemcpy(In, Host.data(), N * sizeof(float), hipMemcpyHostToDevice));
+
+  double Agnostic = measure(warpAgnostic, In, Out1);
+  double Sensitive = measure(warpSensitive, In, Out2);
+  printf("Kernel time, averaged over %d runs\n", NumReps);
+  printf("%22s %14.2f us\n", "warp-agnostic", Agnostic);
+  printf("%22s %14.2f us\n", "warp-sensitive", Sensitive);
+  printf("%22s %14.2f\n", "speedup", Sensitive / Agnostic);
+
+  std::vector<float> Res1(N), Res2(N);
+  CHECK(hipMemcpy(Res1.data(), Out1, N * sizeof(float), hipMemcpyDeviceToHost));
+  CHECK(hipMemcpy(Res2.data(), Out2, N * sizeof(float), hipMemcpyDeviceToHost));
+  bool Ok = Res1 == Res2;
+
+  CHECK(hipFree(In));
+  CHECK(hipFree(Out1));
+  CHECK(hipFree(Out2));
+
+  std::cout << (Ok ? "PASSED" : "FAILED") << "\n";
+  return Ok ? 0 : 1;
+}
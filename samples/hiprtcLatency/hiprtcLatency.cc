@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Measures the latency of compiling small programs with hiprtc, with the
+// in-process compiler (CHIP_RTC_IN_PROCESS=1, effective when chipStar is
+// built with CHIP_HIPRTC_IN_PROCESS) and with hipcc (CHIP_RTC_IN_PROCESS=0),
+// and of compiling them again from the compilation cache, and checks the
+// compiled kernels.
+
+#include "hip/hip_runtime.h"
+#include "hip/hiprtc.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+#define CHECK_RTC(cmd)                                                         \
+  {                                                                            \
+    hiprtcResult error = cmd;                                                  \
+    if (error != HIPRTC_SUCCESS) {                                             \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n",                            \
+              hiprtcGetErrorString(error), error, __FILE__, __LINE__);         \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+constexpr int NumPrograms = 20;
+
+using Clock = std::chrono::steady_clock;
+
+static const char *Header = R"---(
+template <typename T> __device__ T scale(T X, T Factor) { return X * Factor; }
+)---";
+
+/// Return a program with a kernel template and a distinct constant, so that
+/// every program is different.
+static std::string makeSource(int Index) {
+  return "#include \"scale.h\"\n"
+         "template <typename T>\n"
+         "__global__ void addScaled(T *Data) {\n"
+         "  Data[threadIdx.x] += scale<T>(threadIdx.x, " +
+         std::to_string(Index) + ");\n}\n";
+}
+
+/// Compile a program, load it and check that its kernel adds 'Index' times
+/// the thread index to the data. Return the compilation time.
+static Clock::duration compileAndRun(int Index, int *Data) {
+  auto Source = makeSource(Index);
+  const char *HeaderName = "scale.h";
+  const char *NameExpr = "addScaled<int>";
+  const char *Options[] = {"-O2"};
+
+  auto Start = Clock::now();
+  hiprtcProgram Prog;
+  CHECK_RTC(hiprtcCreateProgram(&Prog, Source.c_str(), "latency", 1, &Header,
+                                &HeaderName));
+  CHECK_RTC(hiprtcAddNameExpression(Prog, NameExpr));
+  hiprtcResult Result = hiprtcCompileProgram(Prog, 1, Options);
+  if (Result != HIPRTC_SUCCESS) {
+    size_t LogSize;
+    CHECK_RTC(hiprtcGetProgramLogSize(Prog, &LogSize));
+    std::string Log(LogSize, '\0');
+    CHECK_RTC(hiprtcGetProgramLog(Prog, &Log[0]));
+    std::cerr << Log << "\n";
+    CHECK_RTC(Result);
+  }
+  size_t CodeSize;
+  CHECK_RTC(hiprtcGetCodeSize(Prog, &CodeSize));
+  std::string Code(CodeSize, '\0');
+  CHECK_RTC(hiprtcGetCode(Prog, &Code[0]));
+  const char *LoweredName;
+  CHECK_RTC(hiprtcGetLoweredName(Prog, NameExpr, &LoweredName));
+  std::string KernelName(LoweredName);
+  CHECK_RTC(hiprtcDestroyProgram(&Prog));
+  auto Elapsed = Clock::now() - Start;
+
+  constexpr int N = 64;
+  int Host[N] = {};
+  CHECK(hipMemcpy(Data, Host, sizeof(Host), hipMemcpyHostToDevice));
+  hipModule_t Module;
+  hipFunction_t Kernel;
+  CHECK(hipModuleLoadData(&Module, Code.data()));
+  CHECK(hipModuleGetFunction(&Kernel, Module, KernelName.c_str()));
+  void *Args[] = {&Data};
+  CHECK(hipModuleLaunchKernel(Kernel, 1, 1, 1, N, 1, 1, 0, nullptr, Args,
+                              nullptr));
+  CHECK(hipMemcpy(Host, Data, sizeof(Host), hipMemcpyDeviceToHost));
+  CHECK(hipModuleUnload(Module));
+  for (int I = 0; I < N; I++)
+    if (Host[I] != I * Index) {
+      printf("Program %d: Data[%d] = %d, expected %d\n", Index, I, Host[I],
+             I * Index);
+      exit(1);
+    }
+
+  return Elapsed;
+}
+
+/// Measure compiling the programs from 'FirstIndex' onwards.
+static void measure(const char *Label, const char *InProcess, int FirstIndex,
+                    int *Data) {
+  setenv("CHIP_RTC_IN_PROCESS", InProcess, 1);
+  // The first compilation includes one-time setup costs.
+  auto First = compileAndRun(FirstIndex, Data);
+  Clock::duration Total{};
+  for (int I = 1; I <= NumPrograms; I++)
+    Total += compileAndRun(FirstIndex + I, Data);
+
+  auto Millis = [](Clock::duration D) {
+    return std::chrono::duration<double, std::milli>(D).count();
+  };
+  printf("%22s %12.2f %12.2f\n", Label, Millis(First),
+         Millis(Total) / NumPrograms);
+}
+
+int main() {
+  // Keep the compilation cache in memory so that earlier runs do not affect
+  // the measurements.
+  setenv("CHIP_RTC_CACHE_DIR", "", 1);
+
+  int *Data;
+  CHECK(hipMalloc(&Data, 64 * sizeof(int)));
+
+  printf("hiprtc compilation latency, averaged over %d programs\n",
+         NumPrograms);
+  printf("%22s %12s %12s\n", "CHIP_RTC_IN_PROCESS", "first [ms]",
+         "next [ms]");
+  // Distinct programs for each compiler so that they are not cached.
+  measure("1", "1", 1, Data);
+  measure("0", "0", 101, Data);
+  measure("0, cached", "0", 101, Data);
+
+  CHECK(hipFree(Data));
+  std::cout << "PASSED\n";
+  return 0;
+}
@@ -0,0 +1,88 @@
+#!/bin/bash
+# Copyright (c) 2024 chipStar developers
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+# USAGE: $0 BUILD_A BUILD_B [SOURCE...]
+#
+# Compares the device code compilation of two chipStar builds, for example
+# ones configured with -DCHIP_PRUNE_DEVICELIB=OFF and =ON: compiles each
+# source (the samples/ sources defining kernels by default) for the device
+# only with the hipcc of both builds and prints the best of three compile
+# times and the size of the device binary. Sources a build fails to compile are
+# reported and left out of the totals.
+set -eu
+
+BUILD_A=$(realpath "${1:?Misses first build directory argument!}")
+BUILD_B=$(realpath "${2:?Misses second build directory argument!}")
+shift 2
+
+SRC_DIR=$(realpath "$(dirname "$0")/..")
+if [ $# -eq 0 ]; then
+    mapfile -t SOURCES < <(grep -rl --include='*.hip' --include='*.cc' \
+                                --include='*.cpp' __global__ \
+                                "${SRC_DIR}/samples" | sort)
+else
+    SOURCES=("$@")
+fi
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+
+nowMs() { echo $(($(date +%s%N) / 1000000)); }
+
+# Prints "<milliseconds> <bytes>" of compiling $2 with the hipcc of build $1.
+measure() {
+    local HIPCC="$1/bin/hipcc" SOURCE="$2" OUT="${WORK_DIR}/device.out"
+    local BEST="" START TIME
+    for RUN in 1 2 3; do
+        START=$(nowMs)
+        "${HIPCC}" -x hip --offload-device-only -c \
+                   -I"$(dirname "${SOURCE}")" "${SOURCE}" -o "${OUT}" \
+                   > /dev/null 2>&1 || return 1
+        TIME=$(($(nowMs) - START))
+        if [ -z "${BEST}" ] || [ "${TIME}" -lt "${BEST}" ]; then
+            BEST=${TIME}
+        fi
+    done
+    echo "${BEST} $(wc -c < "${OUT}")"
+}
+
+printf "%-48s %10s %10s %12s %12s\n" \
+       SOURCE "A time(ms)" "B time(ms)" "A size(B)" "B size(B)"
+TIME_A=0 TIME_B=0 SIZE_A=0 SIZE_B=0
+for SOURCE in "${SOURCES[@]}"; do
+    NAME=${SOURCE#"${SRC_DIR}/"}
+    if ! A=$(measure "${BUILD_A}" "${SOURCE}") ||
+            ! B=$(measure "${BUILD_B}" "${SOURCE}"); then
+        echo "${NAME}: compilation failed, skipped"
+        continue
+    fi
+    read -r TA SA <<< "${A}"
+    read -r TB SB <<< "${B}"
+    printf "%-48s %10d %10d %12d %12d\n" "${NAME}" "${TA}" "${TB}" \
+           "${SA}" "${SB}"
+    TIME_A=$((TIME_A + TA))
+    TIME_B=$((TIME_B + TB))
+    SIZE_A=$((SIZE_A + SA))
+    SIZE_B=$((SIZE_B + SB))
+done
+
+printf "%-48s %10d %10d %12d %12d\n" TOTAL "${TIME_A}" "${TIME_B}" \
+       "${SIZE_A}" "${SIZE_B}"
@@ -19,15 +19,22 @@
 # FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 # DEALINGS IN THE SOFTWARE.
 
-# USAGE: $0 NAME INPUT OUTPUT_SOURCE OUTPUT_HEADER
+# USAGE: $0 NAME INPUT OUTPUT_SOURCE OUTPUT_HEADER [SYMBOLS]
+#
+# SYMBOLS is an optional file listing symbol names, one per line, which are
+# embedded as std::array<const char *, N> <NAME>_symbols.
 set -eu
 
 NAME=${1:-"Misses name argument!"}
 INPUT=${2:-"Misses input file argument!"}
 OUTPUT_SOURCE=${3:-"Misses output source file argument!"}
 OUTPUT_HEADER=${4:-"Misses output header file argument!"}
+SYMBOLS=${5:-}
 
 SIZE=$(wc -c < "${INPUT}")
+if [ -n "${SYMBOLS}" ]; then
+    NUM_SYMBOLS=$(grep -c . "${SYMBOLS}" || true)
+fi
 
 {
     cat <<CPPSOURCE
@@ -42,10 +49,18 @@ CPPSOURCE
 
     xxd --include - < "$INPUT"
 
-    cat <<CPPSOURCE
-};
-} // namespace chipstar
+    echo "};"
+
+    if [ -n "${SYMBOLS}" ]; then
+        cat <<CPPSOURCE
+
+extern const std::array<const char *, ${NUM_SYMBOLS}> ${NAME}_symbols = {
 CPPSOURCE
+        grep . "${SYMBOLS}" | sed 's/.*/  "&",/' || true
+        echo "};"
+    fi
+
+    echo "} // namespace chipstar"
 } > "$OUTPUT_SOURCE"
 
 
@@ -60,6 +75,15 @@ CPPSOURCE
 namespace chipstar {
 
 extern const std::array<unsigned char, ${SIZE}> ${NAME};
+CPPSOURCE
+
+    if [ -n "${SYMBOLS}" ]; then
+        cat <<CPPSOURCE
+extern const std::array<const char *, ${NUM_SYMBOLS}> ${NAME}_symbols;
+CPPSOURCE
+    fi
+
+    cat <<CPPSOURCE
 
 } // namespace chipstar
 #endif // CHIP_EMBEDDED_BINARY_${NAME}_H
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Copyright (c) 2024 chipStar developers
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+# USAGE: $0 LLVM_NM OUTPUT CHIP_BITCODE... -- ROCM_BITCODE...
+#
+# Writes the symbols of the device library which device code may refer to,
+# one per line: the external definitions of chipStar's own bitcode and the
+# public __ocml_*, __ockl_* and __llvm_* functions of the ROCm device
+# libraries. The rest of the device library is internal to it.
+set -eu
+
+LLVM_NM=${1:-"Misses llvm-nm argument!"}
+OUTPUT=${2:-"Misses output file argument!"}
+shift 2
+
+CHIP_BITCODES=()
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    CHIP_BITCODES+=("$1")
+    shift
+done
+[ $# -gt 0 ] && shift # --
+
+# One file at a time for output without file name headers.
+listDefinitions() {
+    for BITCODE in "$@"; do
+        "${LLVM_NM}" --defined-only --extern-only --just-symbol-name \
+                     "${BITCODE}"
+    done
+}
+
+{
+    listDefinitions "${CHIP_BITCODES[@]}"
+    listDefinitions "$@" | { grep -E '^__(ocml|ockl|llvm)_' || true; }
+} | sort -u > "${OUTPUT}"
@@ -94,6 +94,58 @@ void chipstar::CallbackData::execute(hipError_t ResultFromDependency) {
   CallbackF(ChipQueue, ResultFromDependency, CallbackArgs);
 }
 
+// HostFuncExecutor
+// ************************************************************************
+void chipstar::HostFuncExecutor::submit(hipHostFn_t Fn, void *UserData,
+                                        std::shared_ptr<chipstar::Event> Ready,
+                                        std::shared_ptr<chipstar::Event> Done) {
+  {
+    std::lock_guard<std::mutex> Lock(Mtx_);
+    if (!Thread_.joinable()) {
+      Stop_ = false;
+      Thread_ = std::thread(&HostFuncExecutor::run, this);
+    }
+    Tasks_.push({Fn, UserData, std::move(Ready), std::move(Done)});
+  }
+  Cv_.notify_one();
+}
+
+void chipstar::HostFuncExecutor::stop() {
+  {
+    std::lock_guard<std::mutex> Lock(Mtx_);
+    if (!Thread_.joinable())
+      return;
+    Stop_ = true;
+  }
+  Cv_.notify_one();
+  Thread_.join();
+}
+
+void chipstar::HostFuncExecutor::run() {
+  while (true) {
+    Task Next;
+    {
+      std::unique_lock<std::mutex> Lock(Mtx_);
+      Cv_.wait(Lock, [this] { return Stop_ || !Tasks_.empty(); });
+      // Tasks left at stop() are still run, their device waits would hang
+      if (Tasks_.empty())
+        return;
+      Next = std::move(Tasks_.front());
+      Tasks_.pop();
+    }
+
+    try {
+      Next.Ready->wait();
+      Next.Fn(Next.UserData);
+      Next.Done->hostSignal();
+    } catch (CHIPError &Err) {
+      // The work waiting for Done can not be released anymore.
+      logCritical("Host function failed: {}", Err.getMsgStr());
+      std::abort();
+    }
+  }
+}
+
 // DeviceVar
 // ************************************************************************
 chipstar::DeviceVar::~DeviceVar() { assert(!DevAddr_ && "Memory leak?"); }
@@ -229,6 +281,54 @@ void chipstar::Event::releaseDependencies() {
   DependsOnList.clear();
 }
 
+std::shared_ptr<chipstar::CaptureSequence>
+chipstar::Event::getCapture() const {
+  if (!Capture_)
+    return nullptr;
+  LOCK(Capture_->Mtx); // CaptureSequence::Ended
+  return Capture_->Ended ? nullptr : Capture_;
+}
+
+// chipstar::CaptureSequence
+// ************************************************************************
+
+static std::atomic<unsigned long long> NextCaptureId{1};
+/// Capture sequences begun in the global mode by any thread
+static std::atomic<int> NumGlobalCaptures{0};
+/// Capture sequences begun in the global or thread-local mode by this thread
+static thread_local int NumThreadCaptures = 0;
+static thread_local hipStreamCaptureMode ThreadCaptureMode =
+    hipStreamCaptureModeGlobal;
+
+chipstar::CaptureSequence::CaptureSequence(chipstar::Queue *Origin,
+                                           hipStreamCaptureMode Mode)
+    : Id(NextCaptureId++), Mode(Mode), Origin(Origin),
+      Thread(std::this_thread::get_id()), Graph(new CHIPGraph()),
+      Queues({Origin}) {}
+
+chipstar::CaptureSequence::~CaptureSequence() {
+  // Ending the capture hands the graph over to the caller
+  if (!Ended)
+    delete Graph;
+}
+
+bool chipstar::CaptureSequence::prohibitsUnsafeCalls() {
+  switch (ThreadCaptureMode) {
+  case hipStreamCaptureModeRelaxed:
+    return false;
+  case hipStreamCaptureModeThreadLocal:
+    return NumThreadCaptures > 0;
+  default:
+    return NumThreadCaptures > 0 || NumGlobalCaptures > 0;
+  }
+}
+
+hipStreamCaptureMode
+chipstar::CaptureSequence::exchangeThreadMode(hipStreamCaptureMode Mode) {
+  std::swap(Mode, ThreadCaptureMode);
+  return Mode;
+}
+
 // CHIPModuleflags_
 //*************************************************************************************
 void chipstar::Module::consumeSPIRV() {
@@ -236,20 +336,14 @@ void chipstar::Module::consumeSPIRV() {
   IlSize_ = Src_->getBinary().size();
 
   // dump the SPIR-V source into current directory if CHIP_DUMP_SPIRV is set
-  // dump here prior to parsing in case parsing crashes
   if (ChipEnvVars.getDumpSpirv())
     dumpSpirv(Src_->getBinary());
 
-  // Parse the SPIR-V fat binary to retrieve kernel function
-  size_t NumWords = IlSize_ / 4;
-  BinaryData_ = new uint32_t[NumWords + 1];
-  std::memcpy(BinaryData_, FuncIL_, IlSize_);
-  // Extract kernel function information
-  bool Res = parseSPIR(BinaryData_, NumWords, FuncInfos_);
-  delete[] BinaryData_;
-  if (!Res) {
+  // The kernel info was extracted when the source was finalized.
+  if (!Src_->isValid()) {
     CHIPERR_LOG_AND_THROW("SPIR-V parsing failed", hipErrorUnknown);
   }
+  FuncInfos_ = Src_->getFuncInfos();
 }
 
 chipstar::Module::~Module() {
@@ -323,6 +417,122 @@ chipstar::DeviceVar *chipstar::Module::getGlobalVar(const char *VarName) {
   return *VarFound;
 }
 
+bool chipstar::Module::queryVariableTableNoLock(chipstar::Queue *Q) {
+  if (VarTableQueried_)
+    return !VarTable_.empty();
+  VarTableQueried_ = true;
+  auto *K = findKernel(ChipVarInfoTableKernelName);
+  if (!K)
+    return false;
+
+  // The kernel writes the number of variables and the size of the table
+  // followed by the table if it fits. Retry with the right size if it doesn't.
+  auto *Ctx = Q->getContext();
+  int64_t Capacity = 4096;
+  std::unique_ptr<char[]> BufH;
+  int64_t Header[2];
+  while (true) {
+    auto *BufD = Ctx->allocate(Capacity, hipMemoryType::hipMemoryTypeUnified);
+    assert(BufD && "Could not allocate space for a shadow kernel.");
+    BufH = std::make_unique<char[]>(Capacity);
+    void *Args[] = {&BufD, &Capacity};
+    queueKernel(Q, K, Args);
+    Q->memCopyAsync(BufH.get(), BufD, Capacity);
+    Q->finish();
+    (void)Ctx->free(BufD);
+
+    std::memcpy(Header, BufH.get(), sizeof(Header));
+    if (Header[0] < 0 || Header[1] < int64_t(sizeof(Header)))
+      CHIPERR_LOG_AND_THROW("Malformed device variable table",
+                            hipErrorInvalidImage);
+    if (Header[1] <= Capacity)
+      break;
+    Capacity = Header[1];
+  }
+
+  // The entries are followed by the names, each terminated by a null.
+  size_t NumVars = Header[0];
+  const char *Infos = BufH.get() + sizeof(Header);
+  const char *End = BufH.get() + Header[1];
+  if (NumVars > (End - Infos) / sizeof(CHIPVarInfo))
+    CHIPERR_LOG_AND_THROW("Malformed device variable table",
+                          hipErrorInvalidImage);
+  const char *Names = Infos + sizeof(CHIPVarInfo) * NumVars;
+  for (size_t I = 0; I < NumVars; I++) {
+    CHIPVarInfo Info;
+    std::memcpy(&Info, Infos + sizeof(CHIPVarInfo) * I, sizeof(CHIPVarInfo));
+    size_t NameLen = strnlen(Names, End - Names);
+    if (Names + NameLen == End)
+      CHIPERR_LOG_AND_THROW("Malformed device variable table",
+                            hipErrorInvalidImage);
+    VarTable_.push_back({std::string(Names, NameLen), size_t(Info[0]),
+                         size_t(Info[1]), Info[2] != 0});
+    Names += NameLen + 1;
+  }
+  return !VarTable_.empty();
+}
+
+size_t chipstar::Module::findTableVariable_(std::string_view Name) const {
+  auto Found = std::lower_bound(
+      VarTable_.begin(), VarTable_.end(), Name,
+      [](const VarTableEntry &Entry, std::string_view Name) {
+        return std::string_view(Entry.Name) < Name;
+      });
+  if (Found == VarTable_.end() || Found->Name != Name)
+    return VarTable_.size();
+  return Found - VarTable_.begin();
+}
+
+/// Bind all the device variables of the module to their storage with one
+/// shadow kernel launch. 'Addrs' lists the storage in the order of the
+/// variable table.
+static void
+queueVariableBindTableShadowKernel(chipstar::Queue *Q, chipstar::Module *M,
+                                   chipstar::Context *Ctx,
+                                   const std::vector<void *> &Addrs) {
+  auto *K = M->getKernelByName(ChipVarBindTableKernelName);
+  size_t BufSize = sizeof(void *) * Addrs.size();
+  auto *AddrsD = Ctx->allocate(BufSize, hipMemoryType::hipMemoryTypeUnified);
+  assert(AddrsD && "Could not allocate space for a shadow kernel.");
+  Q->memCopyAsync(AddrsD, Addrs.data(), BufSize);
+  void *Args[] = {&AddrsD};
+  queueKernel(Q, K, Args);
+  Q->finish();
+  (void)Ctx->free(AddrsD);
+}
+
+/// Query the format strings of the printf buffer records of the module
+/// with the shadow kernel for it. Returns an empty string if the module does
+/// not have the kernel.
+static std::string queryPrintfFormats(chipstar::Queue *Q, chipstar::Module *M,
+                                      chipstar::Context *Ctx) {
+  auto *K = M->findKernel(ChipPrintfFormatsKernelName);
+  if (!K)
+    return std::string(); // Only dynamic format strings.
+
+  // The kernel writes the size of the formats followed by the formats if they
+  // fit. Retry with the right size if they don't.
+  int64_t Capacity = 4096;
+  while (true) {
+    size_t BufSize = sizeof(int64_t) + Capacity;
+    auto *BufD = static_cast<int64_t *>(
+        Ctx->allocate(BufSize, hipMemoryType::hipMemoryTypeUnified));
+    assert(BufD && "Could not allocate space for a shadow kernel.");
+    auto BufH = std::make_unique<char[]>(BufSize);
+    void *Args[] = {&BufD, &Capacity};
+    queueKernel(Q, K, Args);
+    Q->memCopyAsync(BufH.get(), BufD, BufSize);
+    Q->finish();
+    (void)Ctx->free(BufD);
+
+    int64_t Size;
+    std::memcpy(&Size, BufH.get(), sizeof(int64_t));
+    if (Size <= Capacity)
+      return std::string(BufH.get() + sizeof(int64_t), Size);
+    Capacity = Size;
+  }
+}
+
 hipError_t
 chipstar::Module::allocateDeviceVariablesNoLock(chipstar::Device *Device,
                                                 chipstar::Queue *Queue) {
@@ -337,41 +547,76 @@ chipstar::Module::allocateDeviceVariablesNoLock(chipstar::Device *Device,
   // TODO: catch any exception and abort as it's probably an unrecoverable
   //       condition?
 
-  size_t VarInfoBufSize = sizeof(CHIPVarInfo) * ChipVars_.size();
+  // Gather information for storage allocation. Modules with the variable
+  // table list all their variables in it. Modules built without it have a
+  // shadow kernel per variable instead, which is launched for every variable.
   auto *Ctx = Device->getContext();
-  CHIPVarInfo *VarInfoBufD = (CHIPVarInfo *)Ctx->allocate(
-      VarInfoBufSize, hipMemoryType::hipMemoryTypeUnified);
-  assert(VarInfoBufD && "Could not allocate space for a shadow kernel.");
-  auto VarInfoBufH = std::make_unique<CHIPVarInfo[]>(ChipVars_.size());
-
-  // Gather information for storage allocation.
-  std::vector<std::pair<chipstar::DeviceVar *, CHIPVarInfo *>> VarInfos;
-  for (auto *Var : ChipVars_) {
-    auto I = VarInfos.size();
-    queueVariableInfoShadowKernel(Queue, this, Var, &VarInfoBufD[I]);
-    VarInfos.push_back(std::make_pair(Var, &VarInfoBufH[I]));
-  }
-  Queue->memCopyAsync(VarInfoBufH.get(), VarInfoBufD, VarInfoBufSize);
-  Queue->finish();
-
-  // Allocate storage for the device variables.
-  for (auto &VarInfo : VarInfos) {
-    size_t Size = (*VarInfo.second)[0];
-    size_t Alignment = (*VarInfo.second)[1];
-    size_t HasInitializer = (*VarInfo.second)[2];
+  bool UseTable = queryVariableTableNoLock(Queue);
+  size_t NumEntries = UseTable ? VarTable_.size() : ChipVars_.size();
+  auto VarInfoBufH = std::make_unique<CHIPVarInfo[]>(NumEntries);
+  if (UseTable) {
+    for (size_t I = 0; I < NumEntries; I++) {
+      VarInfoBufH[I][0] = VarTable_[I].Size;
+      VarInfoBufH[I][1] = VarTable_[I].Alignment;
+      VarInfoBufH[I][2] = VarTable_[I].HasInitializer;
+    }
+  } else {
+    size_t VarInfoBufSize = sizeof(CHIPVarInfo) * NumEntries;
+    CHIPVarInfo *VarInfoBufD = (CHIPVarInfo *)Ctx->allocate(
+        VarInfoBufSize, hipMemoryType::hipMemoryTypeUnified);
+    assert(VarInfoBufD && "Could not allocate space for a shadow kernel.");
+    for (size_t I = 0; I < NumEntries; I++)
+      queueVariableInfoShadowKernel(Queue, this, ChipVars_[I],
+                                    &VarInfoBufD[I]);
+    Queue->memCopyAsync(VarInfoBufH.get(), VarInfoBufD, VarInfoBufSize);
+    Queue->finish();
+    (void)Ctx->free(VarInfoBufD);
+  }
+
+  // Lay the variables out in one allocation.
+  std::vector<size_t> Offsets;
+  size_t StorageSize = 0;
+  size_t StorageAlignment = 1;
+  for (size_t I = 0; I < NumEntries; I++) {
+    size_t Size = VarInfoBufH[I][0];
+    size_t Alignment = VarInfoBufH[I][1];
     assert(Size && "Unexpected zero sized device variable.");
     assert(Alignment && "Unexpected alignment requirement.");
+    StorageSize = roundUp(StorageSize, Alignment);
+    Offsets.push_back(StorageSize);
+    StorageSize += Size;
+    StorageAlignment = std::max(StorageAlignment, Alignment);
+  }
 
-    auto *Var = VarInfo.first;
-    Var->setDevAddr(
-        Ctx->allocate(Size, Alignment, hipMemoryType::hipMemoryTypeUnified));
-    Var->markHasInitializer(HasInitializer);
+  DeviceVarStorage_ = Ctx->allocate(StorageSize, StorageAlignment,
+                                    hipMemoryType::hipMemoryTypeUnified);
+  if (!DeviceVarStorage_)
+    CHIPERR_LOG_AND_THROW("Could not allocate storage for device variables",
+                          hipErrorOutOfMemory);
+  for (size_t I = 0; I < ChipVars_.size(); I++) {
+    auto *Var = ChipVars_[I];
+    // Only the variables listed in the table were added to the module.
+    size_t Entry = UseTable ? findTableVariable_(Var->getName()) : I;
+    assert(Entry < NumEntries && "Variable missing from the table.");
+    Var->markHasInitializer(VarInfoBufH[Entry][2]);
     // Sanity check for object sizes reported by the shadow kernels vs
     // __hipRegisterVar.
-    assert(Var->getSize() == Size && "Object size discrepancy!");
-    queueVariableBindShadowKernel(Queue, this, Var);
+    assert(Var->getSize() == size_t(VarInfoBufH[Entry][0]) &&
+           "Object size discrepancy!");
+    Var->setDevAddr(static_cast<char *>(DeviceVarStorage_) + Offsets[Entry]);
+  }
+
+  if (UseTable) {
+    // Variables the host didn't register are bound to storage as well.
+    std::vector<void *> Addrs;
+    for (size_t Offset : Offsets)
+      Addrs.push_back(static_cast<char *>(DeviceVarStorage_) + Offset);
+    queueVariableBindTableShadowKernel(Queue, this, Ctx, Addrs);
+  } else {
+    for (auto *Var : ChipVars_)
+      queueVariableBindShadowKernel(Queue, this, Var);
+    Queue->finish();
   }
-  Queue->finish();
   DeviceVariablesAllocated_ = true;
 
   return hipSuccess;
@@ -395,11 +640,19 @@ void chipstar::Module::prepareDeviceVariablesNoLock(chipstar::Device *Device,
   logTrace("Initialize device variables in module: {}", (void *)this);
 
   bool QueuedKernels = false;
-  for (auto *Var : ChipVars_) {
-    if (!Var->hasInitializer())
-      continue;
-    queueVariableInitShadowKernel(Queue, this, Var);
-    QueuedKernels = true;
+  if (DeviceVarStorage_ && !VarTable_.empty()) {
+    // The kernel is emitted only if any of the variables has an initializer.
+    if (auto *InitTableKernel = findKernel(ChipVarInitTableKernelName)) {
+      queueKernel(Queue, InitTableKernel);
+      QueuedKernels = true;
+    }
+  } else {
+    for (auto *Var : ChipVars_) {
+      if (!Var->hasInitializer())
+        continue;
+      queueVariableInitShadowKernel(Queue, this, Var);
+      QueuedKernels = true;
+    }
   }
 
   // Launch kernel for resetting host-inaccessible global device variables.
@@ -408,6 +661,28 @@ void chipstar::Module::prepareDeviceVariablesNoLock(chipstar::Device *Device,
     QueuedKernels = true;
   }
 
+  // Point the kernels to the printf buffer, after the initialization of the
+  // variable to null above.
+  if (auto *PrintfBufferVar = getGlobalVar(ChipPrintfBufferVarName)) {
+    if (!PrintfBuffer_) {
+      auto *Ctx = Device->getContext();
+      std::string Formats = queryPrintfFormats(Queue, this, Ctx);
+      size_t Size = chipstar::PrintfBuffer::getStorageSize(
+          ChipEnvVars.getPrintfBufferSize());
+      void *Storage =
+          Ctx->allocate(Size, 0x1000, hipMemoryType::hipMemoryTypeHost);
+      if (!Storage)
+        CHIPERR_LOG_AND_THROW("Could not allocate the printf buffer",
+                              hipErrorOutOfMemory);
+      std::memset(Storage, 0, Size);
+      PrintfBuffer_ = std::make_unique<chipstar::PrintfBuffer>(
+          Storage, Size, std::move(Formats));
+      Device->addPrintfBuffer(PrintfBuffer_.get());
+    }
+    void *Storage = PrintfBuffer_->getStorage();
+    Queue->memCopy(PrintfBufferVar->getDevAddr(), &Storage, sizeof(void *));
+  }
+
   if (QueuedKernels)
     Queue->finish();
 
@@ -421,14 +696,26 @@ void chipstar::Module::invalidateDeviceVariablesNoLock() {
 void chipstar::Module::deallocateDeviceVariablesNoLock(
     chipstar::Device *Device) {
   invalidateDeviceVariablesNoLock();
-  for (auto *Var : ChipVars_) {
-    auto Err = Device->getContext()->free(Var->getDevAddr());
-    (void)Err;
+  releasePrintfBufferNoLock(Device);
+  for (auto *Var : ChipVars_)
     Var->setDevAddr(nullptr);
+  if (DeviceVarStorage_) {
+    auto Err = Device->getContext()->free(DeviceVarStorage_);
+    (void)Err;
+    DeviceVarStorage_ = nullptr;
   }
   DeviceVariablesAllocated_ = false;
 }
 
+void chipstar::Module::releasePrintfBufferNoLock(chipstar::Device *Device) {
+  if (!PrintfBuffer_)
+    return;
+  Device->removePrintfBuffer(PrintfBuffer_.get());
+  auto Err = Device->getContext()->free(PrintfBuffer_->getStorage());
+  (void)Err;
+  PrintfBuffer_.reset();
+}
+
 SPVFuncInfo *chipstar::Module::findFunctionInfo(const std::string &FName) {
   return FuncInfos_.count(FName) ? FuncInfos_.at(FName).get() : nullptr;
 }
@@ -452,15 +739,76 @@ void chipstar::Kernel::setHostPtr(const void *HostFPtr) {
 }
 void chipstar::Kernel::setDevPtr(const void *DevFPtr) { DevFPtr_ = DevFPtr; }
 
+// chipstar::ArgSpillPool
+//*****************************************************************************
+
+chipstar::ArgSpillPool::Block chipstar::ArgSpillPool::acquire(size_t Size) {
+  size_t Capacity = MinCapacity;
+  while (Capacity < Size)
+    Capacity *= 2;
+
+  {
+    LOCK(PoolMtx_); // chipstar::ArgSpillPool::FreeBlocks_
+    auto &Blocks = FreeBlocks_[Capacity];
+    if (Blocks.size()) {
+      Block Reused = std::move(Blocks.back());
+      Blocks.pop_back();
+      return Reused;
+    }
+  }
+
+  Block NewBlock;
+  NewBlock.Capacity = Capacity;
+  NewBlock.Host = std::make_unique<char[]>(Capacity);
+  NewBlock.Device = static_cast<char *>(
+      Ctx_->allocate(Capacity, Alignment, hipMemoryTypeDevice));
+  if (!NewBlock.Device)
+    CHIPERR_LOG_AND_THROW("Could not allocate an argument spill buffer",
+                          hipErrorOutOfMemory);
+  return NewBlock;
+}
+
+void chipstar::ArgSpillPool::release(Block &&TheBlock) {
+  {
+    LOCK(PoolMtx_); // chipstar::ArgSpillPool::FreeBlocks_
+    auto &Blocks = FreeBlocks_[TheBlock.Capacity];
+    if (Blocks.size() < MaxCachedBlocks) {
+      Blocks.push_back(std::move(TheBlock));
+      return;
+    }
+  }
+  (void)Ctx_->free(TheBlock.Device);
+}
+
+void chipstar::ArgSpillPool::clear() {
+  LOCK(PoolMtx_); // chipstar::ArgSpillPool::FreeBlocks_
+  // Not through Context::free() which looks up the active device. It may
+  // not be the device of the context being destroyed.
+  auto *Tracker = Ctx_->getDevice()->AllocTracker;
+  for (auto &[Capacity, Blocks] : FreeBlocks_)
+    for (auto &TheBlock : Blocks) {
+      if (auto *AllocInfo = Tracker->getAllocInfo(TheBlock.Device)) {
+        Tracker->releaseMemReservation(AllocInfo->Size);
+        Tracker->eraseRecord(AllocInfo);
+      }
+      Ctx_->freeImpl(TheBlock.Device);
+    }
+  FreeBlocks_.clear();
+}
+
 // chipstar::ArgSpillBuffer
 //*****************************************************************************
 
-chipstar::ArgSpillBuffer::~ArgSpillBuffer() { (void)Ctx_->free(DeviceBuffer_); }
+chipstar::ArgSpillBuffer::~ArgSpillBuffer() {
+  // The buffer is destroyed once the launch using it has completed so its
+  // storage can be handed to the next launch.
+  if (Storage_.Device)
+    Ctx_->getArgSpillPool().release(std::move(Storage_));
+}
 
 void chipstar::ArgSpillBuffer::computeAndReserveSpace(
     const SPVFuncInfo &KernelInfo) {
   size_t Offset = 0;
-  size_t MaxAlignment = 1;
   auto Visitor = [&](const SPVFuncInfo::KernelArg &Arg) -> void {
     if (Arg.Kind != SPVTypeKind::PODByRef)
       return;
@@ -468,27 +816,26 @@ void chipstar::ArgSpillBuffer::computeAndReserveSpace(
     //        from SPIR-V, store it in FuncInfo and read it
     //        here. Using now an arbitrarily chosen value.
     size_t Alignment = 32; // Chose sizeof(double4) as the alignment.
+    static_assert(ArgSpillPool::Alignment >= 32,
+                  "Spill storage is underaligned.");
     Offset = roundUp(Offset, Alignment);
     ArgIndexToOffset_.insert(std::make_pair(Arg.Index, Offset));
-    MaxAlignment = std::max<size_t>(MaxAlignment, Alignment);
     Offset += Arg.Size;
   };
   KernelInfo.visitKernelArgs(Visitor);
 
   Size_ = Offset;
-  HostBuffer_ = std::make_unique<char[]>(Size_);
-  DeviceBuffer_ = static_cast<char *>(
-      Ctx_->allocate(Size_, MaxAlignment, hipMemoryTypeDevice));
+  Storage_ = Ctx_->getArgSpillPool().acquire(Size_);
 }
 
 void *chipstar::ArgSpillBuffer ::allocate(const SPVFuncInfo::Arg &Arg) {
-  assert(HostBuffer_ && DeviceBuffer_ &&
+  assert(Storage_.Host && Storage_.Device &&
          "Forgot to call computeAndReserveSpace()?");
   auto Offset = ArgIndexToOffset_[Arg.Index];
-  auto *HostPtr = HostBuffer_.get() + Offset;
+  auto *HostPtr = Storage_.Host.get() + Offset;
   assert(Arg.Data);
   std::memcpy(HostPtr, Arg.Data, Arg.Size);
-  return DeviceBuffer_ + Offset;
+  return Storage_.Device + Offset;
 }
 
 // ExecItem
@@ -535,6 +882,9 @@ chipstar::Device::~Device() {
   delete LegacyDefaultQueue;
   LegacyDefaultQueue = nullptr;
 
+  // The queues have completed the kernels which could print.
+  stopPrintfDrainer();
+
   // delete all entires in SrcModToCompiledMod_
   for (auto &Kv : SrcModToCompiledMod_)
     delete Kv.second;
@@ -833,6 +1183,7 @@ void chipstar::Device::eraseModule(chipstar::Module *Module) {
   LOCK(DeviceMtx); // SrcModToCompiledMod_
   for (auto &Kv : SrcModToCompiledMod_)
     if (Kv.second == Module) {
+      Module->releasePrintfBufferNoLock(this);
       delete Module;
       SrcModToCompiledMod_.erase(Kv.first);
       break;
@@ -877,6 +1228,50 @@ chipstar::Device::createQueueAndRegister(const uintptr_t *NativeHandles,
   return ChipQueue;
 }
 
+chipstar::Queue *chipstar::Device::getGraphQueue(chipstar::Queue *LaunchQueue,
+                                                 size_t Idx) {
+  if (Idx >= (size_t)ChipEnvVars.getGraphQueues())
+    return nullptr;
+
+  LOCK(GraphQueuesMtx_); // chipstar::Device::GraphQueues_
+  auto &Queues = GraphQueues_[LaunchQueue];
+  while (Queues.size() <= Idx) {
+    if (!FreeGraphQueues_.empty()) {
+      Queues.push_back(FreeGraphQueues_.back());
+      FreeGraphQueues_.pop_back();
+      continue;
+    }
+    // The graph launch orders these queues explicitly with respect to the
+    // launch queue, so they must not synchronize with the default queue.
+    auto ChipQueue = createQueueAndRegister(
+        chipstar::QueueFlags(hipStreamNonBlocking), DEFAULT_QUEUE_PRIORITY);
+    logDebug("{} Device::getGraphQueue() created queue {} for queue {}",
+             (void *)this, (void *)ChipQueue, (void *)LaunchQueue);
+    Queues.push_back(ChipQueue);
+  }
+  return Queues[Idx];
+}
+
+void chipstar::Device::releaseGraphQueues(chipstar::Queue *ChipQueue) {
+  LOCK(GraphQueuesMtx_); // chipstar::Device::GraphQueues_
+  // A graph launch into the queue joins its graph queues back into it, so
+  // they are idle once the queue is.
+  auto Found = GraphQueues_.find(ChipQueue);
+  if (Found != GraphQueues_.end()) {
+    FreeGraphQueues_.insert(FreeGraphQueues_.end(), Found->second.begin(),
+                            Found->second.end());
+    GraphQueues_.erase(Found);
+  }
+  // The queue itself may be a graph queue when the device is torn down
+  auto Erase = [=](std::vector<chipstar::Queue *> &Queues) {
+    Queues.erase(std::remove(Queues.begin(), Queues.end(), ChipQueue),
+                 Queues.end());
+  };
+  Erase(FreeGraphQueues_);
+  for (auto &Entry : GraphQueues_)
+    Erase(Entry.second);
+}
+
 std::vector<chipstar::Queue *> &chipstar::Device::getQueues() {
   LOCK(DeviceMtx); // reading chipstar::Device::ChipQueues_
   return ChipQueues_;
@@ -917,6 +1312,10 @@ bool chipstar::Device::removeQueue(chipstar::Queue *ChipQueue) {
    *
    * Choosing not to call Queue->finish()
    */
+  releaseGraphQueues(ChipQueue);
+  // The pending host functions still signal events of the queue's context
+  ChipQueue->stopHostFuncs();
+
   LOCK(DeviceMtx) // reading chipstar::Device::ChipQueues_
   ChipQueue->updateLastEvent(nullptr);
 
@@ -971,6 +1370,88 @@ void chipstar::Device::invalidateDeviceVariables() {
     Kv.second->invalidateDeviceVariablesNoLock();
 }
 
+/// Write the formatted output of printf buffers to stdout.
+static void printPrintfOutput(const std::string &Out) {
+  if (Out.empty())
+    return;
+  std::fwrite(Out.data(), 1, Out.size(), stdout);
+  std::fflush(stdout);
+}
+
+void chipstar::Device::addPrintfBuffer(chipstar::PrintfBuffer *Buffer) {
+  LOCK(PrintfBuffersMtx_); // chipstar::Device::PrintfBuffers_
+  PrintfBuffers_.push_back(Buffer);
+  if (!PrintfDrainer_.joinable()) {
+    StopPrintfDrainer_ = false;
+    PrintfDrainer_ = std::thread(&chipstar::Device::runPrintfDrainer, this);
+  }
+}
+
+void chipstar::Device::addPrintfLaunch(std::shared_ptr<chipstar::Event> Event) {
+  {
+    LOCK(PrintfBuffersMtx_); // chipstar::Device::PrintfLaunches_
+    PrintfLaunches_.push_back(std::move(Event));
+  }
+  PrintfDrainerCv_.notify_one();
+}
+
+void chipstar::Device::runPrintfDrainer() {
+  // The records are committed by the device without any host involvement, so
+  // the buffers are polled while the kernels printing to them may run. The
+  // interval bounds the output latency of a running kernel and how fast it
+  // may print without dropping records.
+  constexpr auto PollInterval = std::chrono::milliseconds(10);
+  std::unique_lock<std::mutex> Lock(PrintfBuffersMtx_);
+  while (!StopPrintfDrainer_) {
+    // Forget the completed launches before draining so their last records
+    // are printed below.
+    PrintfLaunches_.erase(
+        std::remove_if(PrintfLaunches_.begin(), PrintfLaunches_.end(),
+                       [](const std::shared_ptr<chipstar::Event> &Event) {
+                         Event->updateFinishStatus(false);
+                         return Event->isFinished();
+                       }),
+        PrintfLaunches_.end());
+    for (auto *Buffer : PrintfBuffers_)
+      printPrintfOutput(Buffer->drain());
+    if (PrintfLaunches_.empty())
+      PrintfDrainerCv_.wait(Lock, [this] {
+        return StopPrintfDrainer_ || !PrintfLaunches_.empty();
+      });
+    else
+      PrintfDrainerCv_.wait_for(Lock, PollInterval,
+                                [this] { return StopPrintfDrainer_; });
+  }
+  PrintfLaunches_.clear();
+}
+
+void chipstar::Device::stopPrintfDrainer() {
+  {
+    LOCK(PrintfBuffersMtx_); // chipstar::Device::StopPrintfDrainer_
+    if (!PrintfDrainer_.joinable())
+      return;
+    StopPrintfDrainer_ = true;
+  }
+  PrintfDrainerCv_.notify_one();
+  PrintfDrainer_.join();
+  drainPrintfBuffers();
+}
+
+void chipstar::Device::removePrintfBuffer(chipstar::PrintfBuffer *Buffer) {
+  LOCK(PrintfBuffersMtx_); // chipstar::Device::PrintfBuffers_
+  auto It = std::find(PrintfBuffers_.begin(), PrintfBuffers_.end(), Buffer);
+  if (It == PrintfBuffers_.end())
+    return;
+  printPrintfOutput(Buffer->drain());
+  PrintfBuffers_.erase(It);
+}
+
+void chipstar::Device::drainPrintfBuffers() {
+  LOCK(PrintfBuffersMtx_); // chipstar::Device::PrintfBuffers_
+  for (auto *Buffer : PrintfBuffers_)
+    printPrintfOutput(Buffer->drain());
+}
+
 void chipstar::Device::deallocateDeviceVariables() {
   // chipstar::Device::SrcModToCompiledMod_
   // chipstar::Module::deallocateDeviceVariablesNoLock()
@@ -978,6 +1459,9 @@ void chipstar::Device::deallocateDeviceVariables() {
   logTrace("Deallocate storage for device variables.");
   for (auto &Kv : SrcModToCompiledMod_)
     Kv.second->deallocateDeviceVariablesNoLock(this);
+  // The printf buffers went with the variables. Not all backends delete
+  // their devices at uninitialization.
+  stopPrintfDrainer();
 }
 
 /// Get compiled module associated with the host pointer 'Ptr'. Return
@@ -1006,15 +1490,21 @@ chipstar::Module *chipstar::Device::getOrCreateModule(HostPtr Ptr) {
     HostPtrToCompiledMod_[Info.Ptr] = Mod;
   }
 
+  // Global device variables in the original HIP sources have been
+  // converted by a global variable pass (HipGlobalVariables.cpp) and they
+  // are listed in the variable table of the module. Modules built without
+  // the table have specially named shadow kernels for each variable.
+  bool HasVarTable = false;
+  if (!SrcMod->Variables.empty()) {
+    LOCK(DeviceVarMtx); // chipstar::Module::queryVariableTableNoLock()
+    HasVarTable = Mod->queryVariableTableNoLock(getDefaultQueue());
+  }
   for (const auto &Info : SrcMod->Variables) {
-    // Global device variables in the original HIP sources have been
-    // converted by a global variable pass (HipGlobalVariables.cpp)
-    // and they are accessible through specially named shadow
-    // kernels.
     std::string NameTmp(Info.Name.begin(), Info.Name.end());
     std::string VarInfoKernelName = std::string(ChipVarInfoPrefix) + NameTmp;
 
-    if (!Mod->hasKernel(VarInfoKernelName)) {
+    if (HasVarTable ? !Mod->hasTableVariable(Info.Name)
+                    : !Mod->hasKernel(VarInfoKernelName)) {
       // The kernel compilation pipe is allowed to remove device-side unused
       // global variables from the device modules. This is utilized in the
       // abort implementation to signal that abort is not called in the
@@ -1232,6 +1722,7 @@ void chipstar::Backend::waitForThreadExit() {
     LOCK(::Backend->BackendMtx); // prevent devices from being destrpyed
     for (auto Dev : ::Backend->getDevices()) {
       Dev->getLegacyDefaultQueue()->updateLastEvent(nullptr);
+      Dev->getLegacyDefaultQueue()->stopHostFuncs();
       LOCK(::Backend->EventsMtx); // CHIPBackend::Events
       int NumQueues = Dev->getQueuesNoLock().size();
       if (NumQueues) {
@@ -1528,6 +2019,29 @@ chipstar::Queue::getSyncQueuesLastEvents() {
   return EventsToWaitOn;
 }
 
+bool chipstar::Queue::canCopyOnHost(const chipstar::AllocationInfo *DstInfo,
+                                    const chipstar::AllocationInfo *SrcInfo,
+                                    size_t Size) {
+  if (Size > ChipEnvVars.getHostCopyMaxSize())
+    return false;
+
+  // Untracked pointers may be device memory from interop or imported
+  // memory, so both sides must be known host-accessible allocations.
+  if (!DstInfo || !ChipContext_->isHostAccessible(*DstInfo))
+    return false;
+  if (!SrcInfo || !ChipContext_->isHostAccessible(*SrcInfo))
+    return false;
+
+  // The copy must not overtake any pending work the device copy would be
+  // ordered after.
+  for (auto &Ev : getSyncQueuesLastEvents()) {
+    Ev->updateFinishStatus(false);
+    if (!Ev->isFinished())
+      return false;
+  }
+  return true;
+}
+
 ///////// Enqueue Operations //////////
 hipError_t chipstar::Queue::memCopy(void *Dst, const void *Src, size_t Size) {
 
@@ -1538,6 +2052,12 @@ hipError_t chipstar::Queue::memCopy(void *Dst, const void *Src, size_t Size) {
         ::Backend->getActiveDevice()->AllocTracker->getAllocInfo(Dst);
     auto AllocInfoSrc =
         ::Backend->getActiveDevice()->AllocTracker->getAllocInfo(Src);
+    if (canCopyOnHost(AllocInfoDst, AllocInfoSrc, Size)) {
+      logTrace("memCopy on host {} -> {} / {} B", Src, Dst, Size);
+      std::memcpy(Dst, Src, Size);
+      return hipSuccess;
+    }
+
     if (AllocInfoDst && AllocInfoDst->MemoryType == hipMemoryTypeHost)
       ::Backend->getActiveDevice()->getDefaultQueue()->MemUnmap(AllocInfoDst);
     if (AllocInfoSrc && AllocInfoSrc->MemoryType == hipMemoryTypeHost)
@@ -1566,6 +2086,14 @@ void chipstar::Queue::memCopyAsync(void *Dst, const void *Src, size_t Size) {
       ::Backend->getActiveDevice()->AllocTracker->getAllocInfo(Dst);
   auto AllocInfoSrc =
       ::Backend->getActiveDevice()->AllocTracker->getAllocInfo(Src);
+  if (canCopyOnHost(AllocInfoDst, AllocInfoSrc, Size)) {
+    // The queue is idle so its last event stays valid for ordering the
+    // subsequent commands; no event is needed for the copy.
+    logTrace("memCopyAsync on host {} -> {} / {} B", Src, Dst, Size);
+    std::memcpy(Dst, Src, Size);
+    return;
+  }
+
   if (AllocInfoDst && AllocInfoDst->MemoryType == hipMemoryTypeHost)
     this->MemUnmap(AllocInfoDst);
   if (AllocInfoSrc && AllocInfoSrc->MemoryType == hipMemoryTypeHost)
@@ -1582,6 +2110,56 @@ void chipstar::Queue::memCopyAsync(void *Dst, const void *Src, size_t Size) {
   ::Backend->trackEvent(ChipEvent);
 }
 
+std::shared_ptr<chipstar::Event>
+chipstar::Queue::memCopyBatchAsyncImpl(void *const *Dsts,
+                                       const void *const *Srcs,
+                                       const size_t *Sizes, size_t Count) {
+  std::shared_ptr<chipstar::Event> ChipEvent;
+  for (size_t i = 0; i < Count; i++) {
+    if (!Sizes[i])
+      continue;
+    if (ChipEvent)
+      ::Backend->trackEvent(ChipEvent);
+    ChipEvent = memCopyAsyncImpl(Dsts[i], Srcs[i], Sizes[i]);
+  }
+  return ChipEvent ? ChipEvent : enqueueMarkerImpl();
+}
+
+void chipstar::Queue::memCopyBatchAsync(void *const *Dsts,
+                                        const void *const *Srcs,
+                                        const size_t *Sizes, size_t Count) {
+  if (!Count)
+    return;
+
+  // Collect the host allocations touched by the batch once so each of them
+  // is unmapped/mapped only once regardless of the number of copies.
+  std::vector<chipstar::AllocationInfo *> HostAllocs;
+  auto &AllocTracker = ::Backend->getActiveDevice()->AllocTracker;
+  auto AddHostAlloc = [&](const void *Ptr) -> void {
+    auto *AllocInfo = AllocTracker->getAllocInfo(Ptr);
+    if (AllocInfo && AllocInfo->MemoryType == hipMemoryTypeHost &&
+        std::find(HostAllocs.begin(), HostAllocs.end(), AllocInfo) ==
+            HostAllocs.end())
+      HostAllocs.push_back(AllocInfo);
+  };
+  for (size_t i = 0; i < Count; i++) {
+    AddHostAlloc(Dsts[i]);
+    AddHostAlloc(Srcs[i]);
+  }
+
+  for (auto *AllocInfo : HostAllocs)
+    this->MemUnmap(AllocInfo);
+
+  std::shared_ptr<chipstar::Event> ChipEvent =
+      memCopyBatchAsyncImpl(Dsts, Srcs, Sizes, Count);
+
+  for (auto *AllocInfo : HostAllocs)
+    this->MemMap(AllocInfo, chipstar::Queue::MEM_MAP_TYPE::HOST_READ_WRITE);
+
+  ChipEvent->Msg = "memCopyBatchAsync";
+  ::Backend->trackEvent(ChipEvent);
+}
+
 void chipstar::Queue::memCopyAsync2D(void *Dst, size_t DPitch, const void *Src,
                                      size_t SPitch, size_t Width, size_t Height,
                                      hipMemcpyKind Kind) {
@@ -1717,14 +2295,119 @@ void chipstar::Queue::memCopy3DAsync(void *Dst, size_t DPitch, size_t DSPitch,
   ::Backend->trackEvent(ChipEvent);
 }
 
-void chipstar::Queue::updateLastNode(CHIPGraphNode *NewNode) {
-  if (LastNode_ != nullptr) {
-    NewNode->addDependency(LastNode_);
+void chipstar::Queue::addCapturedNode(CHIPGraphNode *Node) {
+  LOCK(Capture_->Mtx); // CaptureSequence::Graph
+  Node->addDependencies(CaptureDeps_);
+  Capture_->Graph->addNode(Node);
+  CaptureDeps_.assign(1, Node);
+}
+
+void chipstar::Queue::beginCapture(hipStreamCaptureMode Mode) {
+  logDebug("{} Queue::beginCapture()", (void *)this);
+  Capture_ = std::make_shared<chipstar::CaptureSequence>(this, Mode);
+  CaptureDeps_.clear();
+  if (Mode == hipStreamCaptureModeGlobal)
+    NumGlobalCaptures++;
+  if (Mode != hipStreamCaptureModeRelaxed)
+    NumThreadCaptures++;
+}
+
+hipError_t chipstar::Queue::joinCapture(chipstar::Event *Event) {
+  auto Capture = Event->getCapture();
+  assert(Capture && "The event was not recorded in an active capture");
+  if (Capture_ && Capture_ != Capture)
+    return hipErrorStreamCaptureMerge;
+
+  LOCK(Capture->Mtx); // CaptureSequence::Queues
+  if (!Capture_) {
+    logDebug("{} Queue::joinCapture() joins the capture {}", (void *)this,
+             Capture->Id);
+    Capture_ = Capture;
+    CaptureDeps_.clear();
+    Capture->Queues.push_back(this);
   }
-  LastNode_ = NewNode;
+  for (auto Node : Event->getCaptureDependencies())
+    if (std::find(CaptureDeps_.begin(), CaptureDeps_.end(), Node) ==
+        CaptureDeps_.end())
+      CaptureDeps_.push_back(Node);
+  return hipSuccess;
+}
+
+hipError_t chipstar::Queue::endCapture(CHIPGraph **Graph) {
+  logDebug("{} Queue::endCapture()", (void *)this);
+  *Graph = nullptr;
+  auto Capture = Capture_;
+  assert(Capture && "The queue is not capturing");
+  if (Capture->Origin != this)
+    return hipErrorStreamCaptureUnmatched;
+  if (Capture->Mode != hipStreamCaptureModeRelaxed &&
+      Capture->Thread != std::this_thread::get_id())
+    return hipErrorStreamCaptureWrongThread;
+
+  LOCK(Capture->Mtx); // CaptureSequence::Queues
+  hipError_t Status = hipSuccess;
+  if (Capture->Invalidated) {
+    Status = hipErrorStreamCaptureInvalidated;
+  } else {
+    // The work captured from the other queues must precede the last nodes
+    // captured from the origin queue.
+    std::set<CHIPGraphNode *> Joined;
+    std::vector<CHIPGraphNode *> Stack = CaptureDeps_;
+    while (!Stack.empty()) {
+      auto Node = Stack.back();
+      Stack.pop_back();
+      if (!Joined.insert(Node).second)
+        continue;
+      for (auto Dep : Node->getDependencies())
+        Stack.push_back(Dep);
+    }
+    for (auto Queue : Capture->Queues)
+      for (auto Node : Queue->CaptureDeps_)
+        if (!Joined.count(Node))
+          Status = hipErrorStreamCaptureUnjoined;
+  }
+
+  for (auto Queue : Capture->Queues) {
+    Queue->Capture_.reset();
+    Queue->CaptureDeps_.clear();
+  }
+  Capture->Queues.clear();
+  Capture->Ended = true;
+  if (Capture->Mode == hipStreamCaptureModeGlobal)
+    NumGlobalCaptures--;
+  if (Capture->Mode != hipStreamCaptureModeRelaxed)
+    NumThreadCaptures--;
+
+  if (Status == hipSuccess)
+    *Graph = Capture->Graph;
+  else
+    delete Capture->Graph;
+  return Status;
+}
+
+void chipstar::Queue::invalidateCapture() {
+  if (!Capture_)
+    return;
+  LOCK(Capture_->Mtx); // CaptureSequence::Invalidated
+  Capture_->Invalidated = true;
+}
+
+void chipstar::Queue::updateCaptureDependencies(CHIPGraphNode **Nodes,
+                                                size_t NumNodes, bool Set) {
+  if (Set)
+    CaptureDeps_.clear();
+  for (size_t i = 0; i < NumNodes; i++)
+    if (std::find(CaptureDeps_.begin(), CaptureDeps_.end(), Nodes[i]) ==
+        CaptureDeps_.end())
+      CaptureDeps_.push_back(Nodes[i]);
 }
 
-void chipstar::Queue::initCaptureGraph() { CaptureGraph_ = new CHIPGraph(); }
+hipStreamCaptureStatus chipstar::Queue::getCaptureStatus() const {
+  if (!Capture_)
+    return hipStreamCaptureStatusNone;
+  return Capture_->Invalidated ? hipStreamCaptureStatusInvalidated
+                               : hipStreamCaptureStatusActive;
+}
 
 std::shared_ptr<chipstar::Event>
 chipstar::Queue::RegisteredVarCopy(chipstar::ExecItem *ExecItem,
@@ -1825,6 +2508,11 @@ void chipstar::Queue::launch(chipstar::ExecItem *ExItem) {
   std::shared_ptr<chipstar::Event> RegisteredVarOutEvent =
       RegisteredVarCopy(ExItem, MANAGED_MEM_STATE::POST_KERNEL);
 
+  // Print the output of the kernel while it runs.
+  auto *Module = ExItem->getKernel()->getModule();
+  if (LaunchEvent && Module && Module->getPrintfBuffer())
+    getDevice()->addPrintfLaunch(LaunchEvent);
+
   ::Backend->trackEvent(LaunchEvent);
 }
 
@@ -1844,14 +2532,43 @@ std::shared_ptr<chipstar::Event> chipstar::Queue::enqueueMarker() {
   return ChipEvent;
 }
 
-void chipstar::Queue::memPrefetch(const void *Ptr, size_t Count) {
+void chipstar::Queue::enqueueNativeGraph(chipstar::NativeGraph *Graph) {
+  // Synchronize host and managed memory once for the whole graph instead of
+  // once per kernel.
+  std::shared_ptr<chipstar::Event> RegisteredVarInEvent =
+      RegisteredVarCopy(nullptr, MANAGED_MEM_STATE::PRE_KERNEL);
+  std::shared_ptr<chipstar::Event> GraphEvent = enqueueNativeGraphImpl(Graph);
+  std::shared_ptr<chipstar::Event> RegisteredVarOutEvent =
+      RegisteredVarCopy(nullptr, MANAGED_MEM_STATE::POST_KERNEL);
+
+  GraphEvent->Msg = "enqueueNativeGraph";
+  ::Backend->trackEvent(GraphEvent);
+}
+
+void chipstar::Queue::memPrefetch(const void *Ptr, size_t Count,
+                                  bool ToHost) {
+  if (!Count)
+    return;
 
   std::shared_ptr<chipstar::Event> ChipEvent =
-      std::shared_ptr<chipstar::Event>(memPrefetchImpl(Ptr, Count));
+      std::shared_ptr<chipstar::Event>(memPrefetchImpl(Ptr, Count, ToHost));
   ChipEvent->Msg = "memPrefetch";
   ::Backend->trackEvent(ChipEvent);
 }
 
+void chipstar::Queue::memAdvise(const void *Ptr, size_t Count,
+                                hipMemoryAdvise Advice, bool ToHost) {
+  if (!Count)
+    return;
+
+  std::shared_ptr<chipstar::Event> ChipEvent =
+      memAdviseImpl(Ptr, Count, Advice, ToHost);
+  if (!ChipEvent) // The hint was not meaningful for the backend.
+    return;
+  ChipEvent->Msg = "memAdvise";
+  ::Backend->trackEvent(ChipEvent);
+}
+
 void chipstar::Queue::launchKernel(chipstar::Kernel *ChipKernel, dim3 NumBlocks,
                                    dim3 DimBlocks, void **Args,
                                    size_t SharedMemBytes) {
@@ -1892,6 +2609,24 @@ void chipstar::Queue::addCallback(hipStreamCallback_t Callback,
   return;
 }
 
+void chipstar::Queue::launchHostFunc(hipHostFn_t Fn, void *UserData) {
+  // The marker completes with the work the function has to wait for,
+  // including the work of the queues this queue synchronizes with.
+  std::shared_ptr<chipstar::Event> Ready = enqueueMarker();
+  Ready->Msg = "hostFuncReady";
+  Ready->setRecording();
+
+  std::shared_ptr<chipstar::Event> Done = createHostSignalEvent();
+  Done->Msg = "hostFuncDone";
+  enqueueBarrier({Done});
+
+  HostFuncs_.submit(Fn, UserData, std::move(Ready), std::move(Done));
+}
+
+std::shared_ptr<chipstar::Event> chipstar::Queue::createHostSignalEvent() {
+  return ::Backend->createEventShared(ChipContext_);
+}
+
 //   template <class GraphNodeType, class... ArgTypes>
 //   bool chipstar::Queue::captureIntoGraph(ArgTypes... ArgsPack) {
 //     if (getCaptureStatus() == hipStreamCaptureStatusActive) {
@@ -1905,5 +2640,5 @@ void chipstar::Queue::addCallback(hipStreamCallback_t Callback,
 //   }
 
 CHIPGraph *chipstar::Queue::getCaptureGraph() const {
-  return static_cast<CHIPGraph *>(CaptureGraph_);
+  return Capture_ ? Capture_->Graph : nullptr;
 }
@@ -46,6 +46,10 @@
 #include "CHIPException.hh"
 
 #include "SPVRegister.hh"
+#include "CHIPPrintf.hh"
+
+#include <condition_variable>
+#include <thread>
 
 #define DEFAULT_QUEUE_PRIORITY 1
 
@@ -88,6 +92,7 @@ class Device;
 class EventMonitor;
 class Texture;
 class Context;
+class CaptureSequence;
 
 class RegionDesc {
 public:
@@ -335,6 +340,48 @@ public:
   void execute(hipError_t ResultFromDependency);
 };
 
+/**
+ * @brief Runs the host functions enqueued into one queue with
+ * hipLaunchHostFunc() and by graph host nodes on a dedicated thread.
+ *
+ * Each task waits on the host for one event marking the completion of the
+ * preceding work, calls the host function and then signals one event the
+ * device is waiting on. Tasks run in submission order which is the order of
+ * the work they depend on. Every queue has its own executor, so the host
+ * functions of independent queues don't wait for each other.
+ */
+class HostFuncExecutor {
+  struct Task {
+    hipHostFn_t Fn;
+    void *UserData;
+    std::shared_ptr<chipstar::Event> Ready;
+    std::shared_ptr<chipstar::Event> Done;
+  };
+
+  std::mutex Mtx_;
+  std::condition_variable Cv_;
+  std::queue<Task> Tasks_;
+  std::thread Thread_;
+  bool Stop_ = false;
+
+  void run();
+
+public:
+  HostFuncExecutor() = default;
+  ~HostFuncExecutor() { stop(); }
+
+  /**
+   * @brief Call Fn(UserData) once Ready has completed and signal Done from
+   * the host after it has returned. The thread is started on first use.
+   */
+  void submit(hipHostFn_t Fn, void *UserData,
+              std::shared_ptr<chipstar::Event> Ready,
+              std::shared_ptr<chipstar::Event> Done);
+
+  /// @brief Run the remaining tasks and join the thread
+  void stop();
+};
+
 class EventMonitor {
   typedef void *(*THREADFUNCPTR)(void *);
 
@@ -641,6 +688,11 @@ protected:
 
   bool Deleted_ = false;
 
+  /// The stream capture this event was last recorded in, if any, and the
+  /// captured nodes which a stream waiting for this event depends on.
+  std::shared_ptr<chipstar::CaptureSequence> Capture_;
+  std::vector<CHIPGraphNode *> CaptureDeps_;
+
   /**
    * @brief Events are always created with a context
    *
@@ -672,6 +724,25 @@ public:
   /// @brief Release dependencies, allowing them to be recycled
   void releaseDependencies();
   chipstar::EventFlags getFlags() { return Flags_; }
+
+  /**
+   * @brief Record this event into a capturing stream.
+   *
+   * Nothing is enqueued. A stream waiting for this event joins the capture
+   * and its next captured node depends on Deps.
+   */
+  void setCapture(std::shared_ptr<chipstar::CaptureSequence> Capture,
+                  const std::vector<CHIPGraphNode *> &Deps) {
+    Capture_ = std::move(Capture);
+    CaptureDeps_ = Deps;
+  }
+
+  /// @brief Get the capture this event was recorded in, null if that capture
+  /// has ended or the event was recorded outside of a capture since.
+  std::shared_ptr<chipstar::CaptureSequence> getCapture() const;
+  const std::vector<CHIPGraphNode *> &getCaptureDependencies() const {
+    return CaptureDeps_;
+  }
   std::mutex EventMtx;
   std::string Msg;
   // Optionally provide a field for origin of this event
@@ -867,6 +938,27 @@ protected:
   std::mutex Mtx_;
   // Global variables
   std::vector<chipstar::DeviceVar *> ChipVars_;
+  /// A single allocation holding the storage of all the device variables.
+  void *DeviceVarStorage_ = nullptr;
+  /// A device variable listed by the ChipVarInfoTableKernelName shadow
+  /// kernel.
+  struct VarTableEntry {
+    std::string Name;
+    size_t Size;
+    size_t Alignment;
+    bool HasInitializer;
+  };
+  /// The variables of the device module in the order of the shadow kernels
+  /// processing all the variables at once (ChipVar*TableKernelName), which
+  /// is the order of their names. Empty for modules built without them.
+  std::vector<VarTableEntry> VarTable_;
+  bool VarTableQueried_ = false;
+
+  /// Return the index of the variable named Name in VarTable_, or the size of
+  /// VarTable_ if it doesn't list one.
+  size_t findTableVariable_(std::string_view Name) const;
+  /// The buffer for the printf() output of the kernels, if they have any.
+  std::unique_ptr<chipstar::PrintfBuffer> PrintfBuffer_;
   // Kernels
   std::vector<chipstar::Kernel *> ChipKernels_;
   /// Binary representation extracted from FatBinary.
@@ -874,8 +966,6 @@ protected:
   // Kernel JIT compilation can be lazy
   std::once_flag Compiled_;
 
-  uint32_t *BinaryData_;
-
   /**
    * @brief hidden default constuctor. Only derived type constructor should be
    * called.
@@ -993,6 +1083,20 @@ public:
 
   std::vector<chipstar::DeviceVar *> &getDeviceVariables() { return ChipVars_; }
 
+  /**
+   * @brief Read the variable table of the device module with the
+   * ChipVarInfoTableKernelName shadow kernel on the first call.
+   *
+   * @return true if the module has the table. Modules built without it have a
+   * set of shadow kernels per variable instead.
+   */
+  bool queryVariableTableNoLock(chipstar::Queue *Queue);
+
+  /// Return true if the variable table lists a variable named Name.
+  bool hasTableVariable(std::string_view Name) const {
+    return findTableVariable_(Name) < VarTable_.size();
+  }
+
   hipError_t allocateDeviceVariablesNoLock(chipstar::Device *Device,
                                            chipstar::Queue *Queue);
   void prepareDeviceVariablesNoLock(chipstar::Device *Device,
@@ -1000,9 +1104,30 @@ public:
   void invalidateDeviceVariablesNoLock();
   void deallocateDeviceVariablesNoLock(chipstar::Device *Device);
 
+  /// Return the printf buffer of the kernels or nullptr if they don't have
+  /// one or it has not been set up yet.
+  chipstar::PrintfBuffer *getPrintfBuffer() const {
+    return PrintfBuffer_.get();
+  }
+  /// Print the remaining output of the printf buffer and free it.
+  void releasePrintfBufferNoLock(chipstar::Device *Device);
+
   SPVFuncInfo *findFunctionInfo(const std::string &FName);
 
   const SPVModule &getSourceModule() const { return *Src_; }
+
+  /// Return true if the module imports any of 'Symbols'. Used with the
+  /// symbol index of a runtime device library (rtdevlib) module, built at
+  /// build time, for leaving the modules it doesn't need out of the device
+  /// link.
+  template <size_t N>
+  bool importsAnyOf(const std::array<const char *, N> &Symbols) const {
+    const auto &Imports = Src_->getImports();
+    for (const char *Symbol : Symbols)
+      if (std::find(Imports.begin(), Imports.end(), Symbol) != Imports.end())
+        return true;
+    return false;
+  }
 };
 
 /**
@@ -1088,10 +1213,51 @@ public:
   virtual const chipstar::Module *getModule() const = 0;
 };
 
+/**
+ * @brief A per-context cache for the storage of argument spill buffers.
+ *
+ * Kernels with spilled arguments need a fresh spill buffer on every launch.
+ * The storage of a buffer is returned here once the launch using it has
+ * completed and is handed out again to later launches, so launches do not
+ * allocate and free device memory.
+ */
+class ArgSpillPool {
+public:
+  /// Host staging and device storage of a spill buffer.
+  struct Block {
+    std::unique_ptr<char[]> Host;
+    char *Device = nullptr;
+    size_t Capacity = 0;
+  };
+
+  /// Alignment of the device storage.
+  static constexpr size_t Alignment = 32;
+
+private:
+  /// Maximum number of cached blocks per capacity.
+  static constexpr size_t MaxCachedBlocks = 16;
+  /// Smallest capacity handed out.
+  static constexpr size_t MinCapacity = 256;
+
+  chipstar::Context *Ctx_; ///< A context to allocate device space from.
+  std::mutex PoolMtx_;
+  std::map<size_t, std::vector<Block>> FreeBlocks_; ///< Keyed by capacity.
+
+public:
+  ArgSpillPool(chipstar::Context *Ctx) : Ctx_(Ctx) {}
+
+  /// Get a block with room for at least 'Size' bytes.
+  Block acquire(size_t Size);
+  /// Return a block for reuse. The device must not access it anymore.
+  void release(Block &&TheBlock);
+  /// Free the cached blocks. Called by the context before it releases its
+  /// device resources.
+  void clear();
+};
+
 class ArgSpillBuffer {
   chipstar::Context *Ctx_; ///< A context to allocate device space from.
-  std::unique_ptr<char[]> HostBuffer_;
-  char *DeviceBuffer_ = nullptr;
+  chipstar::ArgSpillPool::Block Storage_;
   std::map<size_t, size_t> ArgIndexToOffset_;
   size_t Size_ = 0;
 
@@ -1103,12 +1269,12 @@ public:
   void *allocate(const SPVFuncInfo::Arg &Arg);
   size_t getSize() const { return Size_; }
   const void *getHostBuffer() const {
-    assert(HostBuffer_.get());
-    return HostBuffer_.get();
+    assert(Storage_.Host.get());
+    return Storage_.Host.get();
   }
   void *getDeviceBuffer() {
-    assert(DeviceBuffer_);
-    return DeviceBuffer_;
+    assert(Storage_.Device);
+    return Storage_.Device;
   }
 };
 
@@ -1266,6 +1432,15 @@ protected:
   std::vector<chipstar::Queue *> ChipQueues_;
   std::once_flag PropsPopulated_;
 
+  /// Internal queues for executing independent graph branches, per queue
+  /// graphs are launched into. Created on demand, they are also registered
+  /// in ChipQueues_. The queues of a removed launch queue are idle and are
+  /// kept in FreeGraphQueues_ for reuse.
+  std::unordered_map<chipstar::Queue *, std::vector<chipstar::Queue *>>
+      GraphQueues_;
+  std::vector<chipstar::Queue *> FreeGraphQueues_;
+  std::mutex GraphQueuesMtx_;
+
   hipDeviceAttribute_t Attrs_;
   hipDeviceProp_t HipDeviceProps_;
 
@@ -1276,6 +1451,22 @@ protected:
   /// Maps host-side shadow variables to the corresponding device variables.
   std::unordered_map<const void *, chipstar::DeviceVar *> DeviceVarLookup_;
 
+  /// The printf buffers of the modules. PrintfBuffersMtx_ is never held while
+  /// waiting for device work so the buffers can be drained while it runs.
+  std::vector<chipstar::PrintfBuffer *> PrintfBuffers_;
+  std::mutex PrintfBuffersMtx_;
+  /// The launches of the kernels with a printf buffer that may be running.
+  /// The buffers are polled only while there are any.
+  std::vector<std::shared_ptr<chipstar::Event>> PrintfLaunches_;
+  /// The thread polling the printf buffers, started with the first buffer.
+  std::thread PrintfDrainer_;
+  std::condition_variable PrintfDrainerCv_;
+  bool StopPrintfDrainer_ = false;
+
+  void runPrintfDrainer();
+  /// Join the printf buffer polling thread and print the remaining output.
+  void stopPrintfDrainer();
+
   int Idx_ = -1; // Initialized with a value indicating unset ID.
 
   // only callable from derived classes, because we need to call also init()
@@ -1341,6 +1532,25 @@ public:
   chipstar::Queue *createQueueAndRegister(const uintptr_t *NativeHandles,
                                           const size_t NumHandles);
 
+  /**
+   * @brief Get an internal queue for executing graph nodes concurrently with
+   * the queue the graph was launched on. Created on first use.
+   *
+   * Every launch queue has its own internal queues, so graphs launched into
+   * different streams don't serialize on them.
+   *
+   * @param LaunchQueue the queue the graph is launched into
+   * @param Idx index of the queue, less than CHIP_GRAPH_QUEUES
+   * @return Queue* the queue or nullptr if Idx is out of range
+   */
+  chipstar::Queue *getGraphQueue(chipstar::Queue *LaunchQueue, size_t Idx);
+
+  /**
+   * @brief Return the internal graph queues of a queue which is being
+   * removed for reuse by other launch queues.
+   */
+  void releaseGraphQueues(chipstar::Queue *ChipQueue);
+
   void removeContext(chipstar::Context *Ctx);
   virtual chipstar::Context *createContext() = 0;
   chipstar::Context *createContextAndRegister() {
@@ -1600,6 +1810,15 @@ public:
   void invalidateDeviceVariables();
   void deallocateDeviceVariables();
 
+  /// Register a printf buffer of a module for drainPrintfBuffers().
+  void addPrintfBuffer(chipstar::PrintfBuffer *Buffer);
+  /// Print the remaining output of a printf buffer and unregister it.
+  void removePrintfBuffer(chipstar::PrintfBuffer *Buffer);
+  /// Poll the printf buffers until the kernel launch of Event completes.
+  void addPrintfLaunch(std::shared_ptr<chipstar::Event> Event);
+  /// Print the output of the completed printf() calls of the kernels.
+  void drainPrintfBuffers();
+
 protected:
   /**
    * @brief The backend hook for reset().
@@ -1621,6 +1840,7 @@ protected:
   int RefCount_;
   chipstar::Device *ChipDevice_;
   std::vector<void *> AllocatedPtrs_;
+  chipstar::ArgSpillPool ArgSpillPool_{this};
 
   unsigned int Flags_;
 
@@ -1641,6 +1861,8 @@ public:
 
   void setDevice(chipstar::Device *Device) { ChipDevice_ = Device; }
 
+  chipstar::ArgSpillPool &getArgSpillPool() { return ArgSpillPool_; }
+
   /**
    * @brief Get this context's CHIPDevices
    *
@@ -1712,6 +1934,17 @@ public:
 
   virtual bool isAllocatedPtrMappedToVM(void *Ptr) = 0;
 
+  /**
+   * @brief Returns true if the host may access the allocation directly
+   * without mapping it or synchronizing it explicitly.
+   *
+   * @param AllocInfo allocation made by allocate().
+   * @return true/false
+   */
+  virtual bool isHostAccessible(const chipstar::AllocationInfo &AllocInfo) {
+    return false;
+  }
+
   /**
    * @brief Free memory
    *
@@ -2035,18 +2268,95 @@ public:
   virtual void *getNativeEvent(hipEvent_t HipEvent) = 0;
 };
 
+/**
+ * @brief A graph recorded into a backend-native command container, which is
+ * submitted into a queue as a whole.
+ *
+ * Created by chipstar::Queue::createNativeGraph() and submitted with
+ * chipstar::Queue::enqueueNativeGraph() into the queue which created it.
+ */
+class NativeGraph {
+public:
+  virtual ~NativeGraph() {}
+
+  /**
+   * @brief Record a node of the graph.
+   *
+   * Nodes are added in a topological order.
+   *
+   * @param Node the node to record
+   * @param Deps positions of the dependencies of the node in the sequence of
+   * previously added nodes
+   * @param NumDeps number of dependencies
+   * @return false if the node can't be recorded. The graph is then executed
+   * eagerly.
+   */
+  virtual bool addNode(CHIPGraphNode *Node, const size_t *Deps,
+                       size_t NumDeps) = 0;
+
+  /**
+   * @brief Finish the recording after all the nodes have been added.
+   *
+   * @return false if the recording can't be submitted
+   */
+  virtual bool finalize() = 0;
+
+  /// True if the state captured by the recording has changed since and the
+  /// graph must be recorded again.
+  virtual bool isStale() { return false; }
+
+  /// True if the recording can be submitted now. Otherwise the graph is
+  /// executed eagerly for this launch.
+  virtual bool isReady() { return true; }
+};
+
+/**
+ * @brief A stream capture sequence.
+ *
+ * Started by hipStreamBeginCapture() on the origin queue. Other queues join
+ * the sequence by waiting for an event recorded in a queue taking part in
+ * it and all of them capture into the same graph. The sequence is ended on
+ * the origin queue once the other queues have been joined back into it.
+ */
+class CaptureSequence {
+public:
+  CaptureSequence(chipstar::Queue *Origin, hipStreamCaptureMode Mode);
+  ~CaptureSequence();
+
+  /**
+   * @brief Check whether the capture modes in effect prohibit potentially
+   * unsafe API calls, such as allocations and synchronizations, on the
+   * calling thread.
+   */
+  static bool prohibitsUnsafeCalls();
+
+  /// @brief Set the capture mode of the calling thread, returning the
+  /// previous one
+  static hipStreamCaptureMode exchangeThreadMode(hipStreamCaptureMode Mode);
+
+  const unsigned long long Id;
+  const hipStreamCaptureMode Mode;
+  chipstar::Queue *const Origin;
+  /// The thread which began the capture
+  const std::thread::id Thread;
+  CHIPGraph *Graph;
+  /// The queues taking part in the capture, the origin queue first
+  std::vector<chipstar::Queue *> Queues;
+  bool Invalidated = false;
+  bool Ended = false;
+  std::mutex Mtx;
+};
+
 /**
  * @brief Queue class for submitting kernels to for execution
  */
 class Queue : public ihipStream_t {
 protected:
-  hipStreamCaptureStatus CaptureStatus_ = hipStreamCaptureStatusNone;
-  hipStreamCaptureMode CaptureMode_ = hipStreamCaptureModeGlobal;
-  hipGraph_t CaptureGraph_;
+  /// The capture sequence this queue takes part in, if any
+  std::shared_ptr<chipstar::CaptureSequence> Capture_;
+  /// The captured nodes the next node captured from this queue depends on
+  std::vector<CHIPGraphNode *> CaptureDeps_;
   std::mutex LastEventMtx;
-  /// @brief  node for creating a dependency chain between subsequent record
-  /// events when in graph capture mode
-  CHIPGraphNode *LastNode_ = nullptr;
   int Priority_;
   /**
    * @brief Maximum priority that can be had by a queue is 0; Priority range is
@@ -2068,9 +2378,14 @@ protected:
 
   std::shared_ptr<chipstar::Event>
   RegisteredVarCopy(chipstar::ExecItem *ExecItem, MANAGED_MEM_STATE ExecState);
+  bool canCopyOnHost(const chipstar::AllocationInfo *DstInfo,
+                     const chipstar::AllocationInfo *SrcInfo, size_t Size);
   bool isDefaultLegacyQueue_ = false;
   bool isPerThreadDefaultQueue_ = false;
 
+  /// Runs the host functions launched into this queue
+  chipstar::HostFuncExecutor HostFuncs_;
+
 public:
   /// @brief Get the host/device timestamps and copy them to the event.
   /// @param Event The event to update.
@@ -2101,26 +2416,65 @@ public:
    */
   template <class GraphNodeType, class... ArgTypes>
   bool captureIntoGraph(ArgTypes... ArgsPack) {
-    if (getCaptureStatus() == hipStreamCaptureStatusActive) {
-      auto Graph = getCaptureGraph();
-      auto Node = new GraphNodeType(ArgsPack...);
-      updateLastNode(Node);
-      Graph->addNode(Node);
-      return true;
-    }
-    return false;
+    if (!Capture_)
+      return false;
+    // Work submitted after the capture got invalidated is dropped, the error
+    // is reported by hipStreamEndCapture().
+    if (getCaptureStatus() == hipStreamCaptureStatusActive)
+      addCapturedNode(new GraphNodeType(ArgsPack...));
+    return true;
   }
 
-  void updateLastNode(CHIPGraphNode *NewNode);
-  void initCaptureGraph();
+  /**
+   * @brief Add a node to the capture graph. The node depends on the current
+   * capture dependencies of this queue and replaces them.
+   */
+  void addCapturedNode(CHIPGraphNode *Node);
+
+  /// @brief Start a new capture sequence with this queue as its origin
+  void beginCapture(hipStreamCaptureMode Mode);
+
+  /**
+   * @brief Join the capture sequence of an event recorded in it, or extend
+   * the capture dependencies if this queue already takes part in it.
+   *
+   * @return hipErrorStreamCaptureMerge if this queue takes part in
+   * another capture sequence
+   */
+  hipError_t joinCapture(chipstar::Event *Event);
+
+  /**
+   * @brief End the capture sequence originating from this queue.
+   *
+   * All the queues leave the sequence, also if it fails.
+   *
+   * @param Graph set to the captured graph on success, null otherwise
+   * @return hipErrorStreamCaptureUnmatched if this queue is not the origin,
+   * hipErrorStreamCaptureWrongThread if the capture must be ended on the
+   * thread which began it, hipErrorStreamCaptureInvalidated if the capture
+   * got invalidated or hipErrorStreamCaptureUnjoined if the work of another
+   * queue has not been joined into this queue
+   */
+  hipError_t endCapture(CHIPGraph **Graph);
 
-  hipStreamCaptureStatus getCaptureStatus() const { return CaptureStatus_; }
-  void setCaptureStatus(hipStreamCaptureStatus CaptureMode) {
-    CaptureStatus_ = CaptureMode;
+  /// @brief Invalidate the capture sequence this queue takes part in after
+  /// an operation which can't be captured
+  void invalidateCapture();
+
+  /**
+   * @brief Replace or extend the capture dependencies of this queue
+   *
+   * @param Set replace the dependencies instead of adding to them
+   */
+  void updateCaptureDependencies(CHIPGraphNode **Nodes, size_t NumNodes,
+                                 bool Set);
+
+  hipStreamCaptureStatus getCaptureStatus() const;
+  std::shared_ptr<chipstar::CaptureSequence> getCapture() const {
+    return Capture_;
   }
-  hipStreamCaptureMode getCaptureMode() const { return CaptureMode_; }
-  void setCaptureMode(hipStreamCaptureMode CaptureMode) {
-    CaptureMode_ = CaptureMode;
+  const std::vector<CHIPGraphNode *> &getCaptureDependencies() const {
+    return CaptureDeps_;
   }
   CHIPGraph *getCaptureGraph() const;
 
@@ -2182,6 +2536,26 @@ public:
   virtual std::shared_ptr<chipstar::Event>
   memCopyAsyncImpl(void *Dst, const void *Src, size_t Size) = 0;
   void memCopyAsync(void *Dst, const void *Src, size_t Size);
+
+  /**
+   * @brief Non-blocking batch of memory copies submitted as one unit
+   *
+   * Copies Sizes[i] bytes from Srcs[i] to Dsts[i] for each i < Count. The
+   * copies of a batch must not overlap each other. A single event is
+   * produced for the whole batch. The default implementation issues the
+   * copies one by one; backends may override it to submit the batch at once.
+   *
+   * @param Dsts Destinations
+   * @param Srcs Sources
+   * @param Sizes Transfer sizes
+   * @param Count Number of copies in the batch
+   */
+  virtual std::shared_ptr<chipstar::Event>
+  memCopyBatchAsyncImpl(void *const *Dsts, const void *const *Srcs,
+                        const size_t *Sizes, size_t Count);
+  void memCopyBatchAsync(void *const *Dsts, const void *const *Srcs,
+                         const size_t *Sizes, size_t Count);
+
   void memCopyAsync2D(void *Dst, size_t DPitch, const void *Src, size_t SPitch,
                       size_t Width, size_t Height, hipMemcpyKind Kind);
 
@@ -2295,6 +2669,24 @@ public:
   virtual std::shared_ptr<chipstar::Event> enqueueMarkerImpl() = 0;
   std::shared_ptr<chipstar::Event> enqueueMarker();
 
+  /**
+   * @brief Create an empty native graph for recording graph nodes which are
+   * later submitted into this queue.
+   *
+   * @return chipstar::NativeGraph* or nullptr if the backend can't record
+   * graphs for this queue
+   */
+  virtual chipstar::NativeGraph *createNativeGraph() { return nullptr; }
+
+  virtual std::shared_ptr<chipstar::Event>
+  enqueueNativeGraphImpl(chipstar::NativeGraph *Graph) {
+    UNIMPLEMENTED(nullptr);
+  }
+  /**
+   * @brief Submit a finalized native graph created by this queue.
+   */
+  void enqueueNativeGraph(chipstar::NativeGraph *Graph);
+
   /**
    * @brief Get the Flags object with which this queue was created.
    *
@@ -2320,18 +2712,51 @@ public:
    */
 
   virtual void addCallback(hipStreamCallback_t Callback, void *UserData);
+
+  /**
+   * @brief Call a host function after the preceding work of this queue.
+   *
+   * The work enqueued after it waits for a single host-signalled event which
+   * is signalled by the queue's host function executor once the function
+   * has returned.
+   */
+  void launchHostFunc(hipHostFn_t Fn, void *UserData);
+
+  /// @brief Run the pending host functions and stop their thread
+  void stopHostFuncs() { HostFuncs_.stop(); }
+
+  /// @brief Create an event which is signalled with Event::hostSignal()
+  virtual std::shared_ptr<chipstar::Event> createHostSignalEvent();
   /**
    * @brief Insert a memory prefetch
    *
-   * @param ptr
-   * @param count
-   * @return true
-   * @return false
+   * @param Ptr start of the memory range to migrate
+   * @param Count size of the memory range in bytes
+   * @param ToHost migrate the range to the host instead of to the device of
+   * this queue
+   * @return event signaled once the migration has completed
    */
 
-  virtual std::shared_ptr<chipstar::Event> memPrefetchImpl(const void *Ptr,
-                                                           size_t Count) = 0;
-  void memPrefetch(const void *Ptr, size_t Count);
+  virtual std::shared_ptr<chipstar::Event>
+  memPrefetchImpl(const void *Ptr, size_t Count, bool ToHost) = 0;
+  void memPrefetch(const void *Ptr, size_t Count, bool ToHost = false);
+
+  /**
+   * @brief Insert a memory usage hint for a range of managed memory
+   *
+   * @param Ptr start of the memory range
+   * @param Count size of the memory range in bytes
+   * @param Advice the hint to apply
+   * @param ToHost the hint refers to the host instead of to the device of
+   * this queue (hipCpuDeviceId)
+   * @return event signaled once the hint has been applied or nullptr if the
+   * backend has no use for the hint
+   */
+  virtual std::shared_ptr<chipstar::Event>
+  memAdviseImpl(const void *Ptr, size_t Count, hipMemoryAdvise Advice,
+                bool ToHost) = 0;
+  void memAdvise(const void *Ptr, size_t Count, hipMemoryAdvise Advice,
+                 bool ToHost = false);
 
   /**
    * @brief Launch a kernel on this queue given a host pointer and arguments
@@ -47,6 +47,7 @@
 #include "common.hh"
 #include "hip/hip_interop.h"
 #include "hip/hip_runtime_api.h"
+#include "hip/spirv_hip_ext.h"
 #include "hip/spirv_spt.h"
 #include "hip_conversions.hh"
 #include "macros.hh"
@@ -188,16 +189,48 @@ hipError_t hipMemPoolDestroy(hipMemPool_t mem_pool) {
 
 hipError_t hipLaunchHostFunc(hipStream_t stream, hipHostFn_t fn,
                              void *userData) {
-  UNIMPLEMENTED(hipErrorNotSupported);
+  CHIP_TRY
+  CHIPInitialize();
+  if (!fn)
+    RETURN(hipErrorInvalidValue);
+
+  auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(stream));
+  LOCK(ChipQueue->QueueMtx);
+
+  hipHostNodeParams Params;
+  Params.fn = fn;
+  Params.userData = userData;
+  if (ChipQueue->captureIntoGraph<CHIPGraphNodeHost>(&Params))
+    RETURN(hipSuccess);
+
+  ChipQueue->launchHostFunc(fn, userData);
+  RETURN(hipSuccess);
+  CHIP_CATCH
 }
 hipError_t hipStreamIsCapturing(hipStream_t stream,
                                 hipStreamCaptureStatus *pCaptureStatus) {
-  UNIMPLEMENTED(hipErrorNotSupported);
+  CHIP_TRY
+  CHIPInitialize();
+  if (!pCaptureStatus)
+    RETURN(hipErrorInvalidValue);
+  auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(stream));
+  *pCaptureStatus = ChipQueue->getCaptureStatus();
+  RETURN(hipSuccess);
+  CHIP_CATCH
 }
 hipError_t hipStreamGetCaptureInfo(hipStream_t stream,
                                    hipStreamCaptureStatus *pCaptureStatus,
                                    unsigned long long *pId) {
-  UNIMPLEMENTED(hipErrorNotSupported);
+  CHIP_TRY
+  CHIPInitialize();
+  if (!pCaptureStatus)
+    RETURN(hipErrorInvalidValue);
+  auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(stream));
+  *pCaptureStatus = ChipQueue->getCaptureStatus();
+  if (pId && *pCaptureStatus != hipStreamCaptureStatusNone)
+    *pId = ChipQueue->getCapture()->Id;
+  RETURN(hipSuccess);
+  CHIP_CATCH
 }
 hipError_t hipStreamGetCaptureInfo_v2(hipStream_t stream,
                                       hipStreamCaptureStatus *captureStatus_out,
@@ -205,7 +238,60 @@ hipError_t hipStreamGetCaptureInfo_v2(hipStream_t stream,
                                       hipGraph_t *graph_out,
                                       const hipGraphNode_t **dependencies_out,
                                       size_t *numDependencies_out) {
-  UNIMPLEMENTED(hipErrorNotSupported);
+  CHIP_TRY
+  CHIPInitialize();
+  if (!captureStatus_out)
+    RETURN(hipErrorInvalidValue);
+  auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(stream));
+  *captureStatus_out = ChipQueue->getCaptureStatus();
+  if (*captureStatus_out != hipStreamCaptureStatusActive)
+    RETURN(hipSuccess);
+
+  if (id_out)
+    *id_out = ChipQueue->getCapture()->Id;
+  if (graph_out)
+    *graph_out = ChipQueue->getCaptureGraph();
+  // Valid until the next operation on the stream, as in CUDA
+  auto &Deps = ChipQueue->getCaptureDependencies();
+  if (dependencies_out)
+    *dependencies_out = reinterpret_cast<const hipGraphNode_t *>(Deps.data());
+  if (numDependencies_out)
+    *numDependencies_out = Deps.size();
+  RETURN(hipSuccess);
+  CHIP_CATCH
+}
+hipError_t hipStreamUpdateCaptureDependencies(hipStream_t stream,
+                                              hipGraphNode_t *dependencies,
+                                              size_t numDependencies,
+                                              unsigned int flags) {
+  CHIP_TRY
+  CHIPInitialize();
+  if (flags != hipStreamAddCaptureDependencies &&
+      flags != hipStreamSetCaptureDependencies)
+    RETURN(hipErrorInvalidValue);
+  if (!dependencies && numDependencies)
+    RETURN(hipErrorInvalidValue);
+  auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(stream));
+  if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusActive)
+    RETURN(hipErrorIllegalState);
+  auto Graph = ChipQueue->getCaptureGraph();
+  for (size_t i = 0; i < numDependencies; i++)
+    if (!Graph->findNode(NODE(dependencies[i])))
+      RETURN(hipErrorInvalidValue);
+  ChipQueue->updateCaptureDependencies(
+      NODES(dependencies), numDependencies,
+      flags == hipStreamSetCaptureDependencies);
+  RETURN(hipSuccess);
+  CHIP_CATCH
+}
+hipError_t hipThreadExchangeStreamCaptureMode(hipStreamCaptureMode *mode) {
+  CHIP_TRY
+  CHIPInitialize();
+  if (!mode)
+    RETURN(hipErrorInvalidValue);
+  *mode = chipstar::CaptureSequence::exchangeThreadMode(*mode);
+  RETURN(hipSuccess);
+  CHIP_CATCH
 }
 hipError_t hipUserObjectCreate(hipUserObject_t *object_out, void *ptr,
                                hipHostFn_t destroy,
@@ -501,6 +587,10 @@ hipError_t hipGraphLaunch(hipGraphExec_t graphExec, hipStream_t stream) {
 
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(stream));
 
+  // A graph launched into a capturing stream becomes a child graph
+  if (ChipQueue->captureIntoGraph<CHIPGraphNodeGraph>(
+          EXEC(graphExec)->getOriginalGraphPtr()))
+    RETURN(hipSuccess);
   EXEC(graphExec)->launch(ChipQueue);
   RETURN(hipSuccess);
   CHIP_CATCH
@@ -519,109 +609,23 @@ hipError_t hipGraphExecUpdate(hipGraphExec_t hGraphExec, hipGraph_t hGraph,
                               hipGraphExecUpdateResult *updateResult_out) {
   CHIP_TRY
   CHIPInitialize();
-  // TODO Graphs - hipGraphExecUpdate
+  if (!hGraphExec || !hGraph || !hErrorNode_out || !updateResult_out)
+    RETURN(hipErrorInvalidValue);
   /**
-   * cudaGraphExecUpdate sets updateResult_out to
-   cudaGraphExecUpdateErrorTopologyChanged under the following conditions:
-    1. The count of nodes directly in hGraphExec and hGraph differ, in which
-   case hErrorNode_out is NULL.
-    2. A node is deleted in hGraph but not not its pair from hGraphExec, in
-   which case hErrorNode_out is NULL.
-    3. A node is deleted in hGraphExec but not its pair from hGraph, in which
-   case hErrorNode_out is the pairless node from hGraph.
-    4. The dependent nodes of a pair differ, in which case hErrorNode_out is the
-   node from hGraph.
+   * The nodes of hGraph are paired with the nodes of hGraphExec by their
+   * creation order. The update fails and leaves hGraphExec untouched if
+   * 1. the count of the nodes differs, in which case hErrorNode_out is NULL,
+   * 2. the dependencies of a pair differ,
+   * 3. the type of a node changed,
+   * 4. the function of a kernel node changed or
+   * 5. a child graph node is to be updated.
+   * Otherwise hErrorNode_out is set to the offending node of hGraph.
    */
-  auto ExecGraph = EXEC(hGraphExec)->getOriginalGraphPtr();
-  // 1.
-  if (ExecGraph->getNodes().size() != GRAPH(hGraph)->getNodes().size()) {
-    *updateResult_out = hipGraphExecUpdateErrorTopologyChanged;
-    *hErrorNode_out = nullptr;
+  CHIPGraphNode *ErrorNode;
+  *updateResult_out = EXEC(hGraphExec)->update(GRAPH(hGraph), ErrorNode);
+  *hErrorNode_out = ErrorNode;
+  if (*updateResult_out != hipGraphExecUpdateSuccess)
     RETURN(hipErrorGraphExecUpdateFailure);
-  }
-  // 2.
-  if (ExecGraph->getNodes().size() > GRAPH(hGraph)->getNodes().size()) {
-    *updateResult_out = hipGraphExecUpdateErrorTopologyChanged;
-    *hErrorNode_out = nullptr;
-    RETURN(hipErrorGraphExecUpdateFailure);
-  }
-  // 3.
-  for (auto Node : GRAPH(hGraph)->getNodes()) {
-    auto NodeFound = ExecGraph->nodeLookup(Node);
-    if (!NodeFound) {
-      *updateResult_out = hipGraphExecUpdateErrorTopologyChanged;
-      *hErrorNode_out = Node;
-      RETURN(hipErrorGraphExecUpdateFailure);
-    }
-  }
-
-  /**
-   Update Limitations:
-    a) chipstar::Kernel nodes:
-        1. The owning context of the function cannot change.
-        2. A node whose function originally did not use CUDA dynamic parallelism
-   cannot be updated to a function which uses CDP.
-        3. A cooperative node cannot be updated to a non-cooperative node, and
-   vice-versa.
-        4. If the graph was instantiated with
-   cudaGraphInstantiateFlagUseNodePriority, the priority attribute cannot
-   change. Equality is checked on the originally requested priority values,
-   before they are clamped to the device's supported range.
-
-    b) Memset and memcpy nodes:
-        1. The CUDA device(s) to which the operand(s) was allocated/mapped
-   cannot change.
-        2. The source/destination memory must be allocated from the same
-   contexts as the original source/destination memory.
-        3. Only 1D memsets can be changed.
-
-    c) Additional memcpy node restrictions:
-        1. Changing either the source or destination memory type(i.e.
-   CU_MEMORYTYPE_DEVICE, CU_MEMORYTYPE_ARRAY, etc.) is not supported.
-   **/
-
-  /**
-   * cudaGraphExecUpdate sets updateResult_out to:
-      1. cudaGraphExecUpdateError if passed an invalid value.
-      2. cudaGraphExecUpdateErrorTopologyChanged if the graph topology changed
-      3. cudaGraphExecUpdateErrorNodeTypeChanged if the type of a node changed,
-   in which case hErrorNode_out is set to the node from hGraph.
-      4. cudaGraphExecUpdateErrorFunctionChanged if the function of a kernel
-   node changed (CUDA driver < 11.2)
-      5. cudaGraphExecUpdateErrorUnsupportedFunctionChange if the func field of
-   a kernel changed in an unsupported way(see note above), in which case
-   hErrorNode_out is set to the node from hGraph
-      cudaGraphExecUpdateErrorParametersChanged if any parameters to a node
-   changed in a way that is not supported, in which case hErrorNode_out is set
-   to the node from hGraph cudaGraphExecUpdateErrorAttributesChanged if any
-   attributes of a node changed in a way that is not supported, in which case
-   hErrorNode_out is set to the node from hGraph
-      cudaGraphExecUpdateErrorNotSupported if something about a node is
-   unsupported, like the node's type or configuration, in which case
-   hErrorNode_out is set to the node from hGraph
-   **/
-  for (auto Node : GRAPH(hGraph)->getNodes()) {
-    auto NodeFound = ExecGraph->nodeLookup(Node);
-    // 3.
-    if (Node->getType() != NodeFound->getType()) {
-      *updateResult_out = hipGraphExecUpdateErrorNodeTypeChanged;
-      *hErrorNode_out = Node;
-      RETURN(hipErrorGraphExecUpdateFailure);
-    }
-
-    // 4.
-    if (Node->getType() == hipGraphNodeType::hipGraphNodeTypeKernel &&
-        NodeFound->getType() == hipGraphNodeType::hipGraphNodeTypeKernel) {
-      auto NodeCast = static_cast<CHIPGraphNodeKernel *>(Node);
-      auto NodeFoundCast = static_cast<CHIPGraphNodeKernel *>(NodeFound);
-      if (NodeCast->getParams().func != NodeFoundCast->getParams().func) {
-        *updateResult_out = hipGraphExecUpdateErrorFunctionChanged;
-        *hErrorNode_out = Node;
-        RETURN(hipErrorGraphExecUpdateFailure);
-      }
-    }
-  }
-
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -665,14 +669,15 @@ hipGraphExecKernelNodeSetParams(hipGraphExec_t hGraphExec, hipGraphNode_t node,
   CHIP_TRY
   CHIPInitialize();
   // Graph obtained from hipGraphExec_t is a clone of the original
-  CHIPGraph *Graph = EXEC(hGraphExec)->getOriginalGraphPtr();
+  CHIPGraph *Graph = EXEC(hGraphExec)->getCompiledGraphPtr();
   // KernelNode here is a handle to the original
 
   CHIPGraphNodeKernel *ExecKernelNode = static_cast<CHIPGraphNodeKernel *>(
       GRAPH(Graph)->getClonedNodeFromOriginal(NODE(node)));
   assert(ExecKernelNode);
 
-  ExecKernelNode->setParams(*pNodeParams);
+  EXEC(hGraphExec)->updateNode(
+      ExecKernelNode, [&]() { ExecKernelNode->setParams(*pNodeParams); });
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -742,17 +747,19 @@ hipError_t hipGraphExecMemcpyNodeSetParams(hipGraphExec_t hGraphExec,
   CHIP_TRY
   CHIPInitialize();
   auto ExecNode =
-      EXEC(hGraphExec)->getOriginalGraphPtr()->nodeLookup(NODE(node));
+      EXEC(hGraphExec)->getCompiledGraphPtr()->nodeLookup(NODE(node));
   if (!ExecNode)
     CHIPERR_LOG_AND_THROW("Failed to find the node in hipGraphExec_t",
                           hipErrorInvalidValue);
 
-  auto CastNode = static_cast<CHIPGraphNodeMemcpy *>(node);
+  auto CastNode = static_cast<CHIPGraphNodeMemcpy *>(ExecNode);
   if (!CastNode)
     CHIPERR_LOG_AND_THROW("Node provided failed to cast to CHIPGraphNodeMemcpy",
                           hipErrorInvalidValue);
 
-  CastNode->setParams(const_cast<hipMemcpy3DParms *>(pNodeParams));
+  EXEC(hGraphExec)->updateNode(CastNode, [&]() {
+    CastNode->setParams(const_cast<hipMemcpy3DParms *>(pNodeParams));
+  });
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -795,17 +802,18 @@ hipError_t hipGraphExecMemcpyNodeSetParams1D(hipGraphExec_t hGraphExec,
   CHIP_TRY
   CHIPInitialize();
   auto ExecNode =
-      EXEC(hGraphExec)->getOriginalGraphPtr()->nodeLookup(NODE(node));
+      EXEC(hGraphExec)->getCompiledGraphPtr()->nodeLookup(NODE(node));
   if (!ExecNode)
     CHIPERR_LOG_AND_THROW("Failed to find the node in hipGraphExec_t",
                           hipErrorInvalidValue);
 
-  auto CastNode = static_cast<CHIPGraphNodeMemcpy *>(node);
+  auto CastNode = static_cast<CHIPGraphNodeMemcpy *>(ExecNode);
   if (!CastNode)
     CHIPERR_LOG_AND_THROW("Node provided failed to cast to CHIPGraphNodeMemcpy",
                           hipErrorInvalidValue);
 
-  CastNode->setParams(dst, src, count, kind);
+  EXEC(hGraphExec)->updateNode(
+      CastNode, [&]() { CastNode->setParams(dst, src, count, kind); });
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -846,7 +854,7 @@ hipError_t hipGraphExecMemcpyNodeSetParamsFromSymbol(
   CHIP_TRY
   CHIPInitialize();
   // Graph obtained from hipGraphExec_t is a clone of the original
-  CHIPGraph *Graph = EXEC(hGraphExec)->getOriginalGraphPtr();
+  CHIPGraph *Graph = EXEC(hGraphExec)->getCompiledGraphPtr();
   // KernelNode here is a handle to the original
   CHIPGraphNodeMemcpyFromSymbol *KernelNode =
       ((CHIPGraphNodeMemcpyFromSymbol *)node);
@@ -854,7 +862,9 @@ hipError_t hipGraphExecMemcpyNodeSetParamsFromSymbol(
       ((CHIPGraphNodeMemcpyFromSymbol *)GRAPH(Graph)->getClonedNodeFromOriginal(
           KernelNode));
 
-  ExecKernelNode->setParams(dst, symbol, count, offset, kind);
+  EXEC(hGraphExec)->updateNode(ExecKernelNode, [&]() {
+    ExecKernelNode->setParams(dst, symbol, count, offset, kind);
+  });
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -897,18 +907,20 @@ hipError_t hipGraphExecMemcpyNodeSetParamsToSymbol(
   CHIP_TRY
   CHIPInitialize();
   auto ExecNode =
-      EXEC(hGraphExec)->getOriginalGraphPtr()->nodeLookup(NODE(node));
+      EXEC(hGraphExec)->getCompiledGraphPtr()->nodeLookup(NODE(node));
   if (!ExecNode)
     CHIPERR_LOG_AND_THROW("Failed to find the node in hipGraphExec_t",
                           hipErrorInvalidValue);
 
-  auto CastNode = static_cast<CHIPGraphNodeMemcpyToSymbol *>(node);
+  auto CastNode = static_cast<CHIPGraphNodeMemcpyToSymbol *>(ExecNode);
   if (!CastNode)
     CHIPERR_LOG_AND_THROW(
         "Node provided failed to cast to CHIPGraphNodeMemcpyToSymbol",
         hipErrorInvalidValue);
 
-  CastNode->setParams(const_cast<void *>(src), symbol, count, offset, kind);
+  EXEC(hGraphExec)->updateNode(CastNode, [&]() {
+    CastNode->setParams(const_cast<void *>(src), symbol, count, offset, kind);
+  });
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -954,17 +966,18 @@ hipError_t hipGraphExecMemsetNodeSetParams(hipGraphExec_t hGraphExec,
   CHIP_TRY
   CHIPInitialize();
   auto ExecNode =
-      EXEC(hGraphExec)->getOriginalGraphPtr()->nodeLookup(NODE(node));
+      EXEC(hGraphExec)->getCompiledGraphPtr()->nodeLookup(NODE(node));
   if (!ExecNode)
     CHIPERR_LOG_AND_THROW("Failed to find the node in hipGraphExec_t",
                           hipErrorInvalidValue);
 
-  auto CastNode = static_cast<CHIPGraphNodeMemset *>(node);
+  auto CastNode = static_cast<CHIPGraphNodeMemset *>(ExecNode);
   if (!CastNode)
     CHIPERR_LOG_AND_THROW("Node provided failed to cast to CHIPGraphNodeMemset",
                           hipErrorInvalidValue);
 
-  CastNode->setParams(pNodeParams);
+  EXEC(hGraphExec)->updateNode(CastNode,
+                               [&]() { CastNode->setParams(pNodeParams); });
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -1010,7 +1023,7 @@ hipError_t hipGraphExecHostNodeSetParams(hipGraphExec_t hGraphExec,
   CHIP_TRY
   CHIPInitialize();
   auto ExecNode =
-      EXEC(hGraphExec)->getOriginalGraphPtr()->nodeLookup(NODE(node));
+      EXEC(hGraphExec)->getCompiledGraphPtr()->nodeLookup(NODE(node));
   if (!ExecNode)
     CHIPERR_LOG_AND_THROW("Failed to find the node in hipGraphExec_t",
                           hipErrorInvalidValue);
@@ -1020,7 +1033,8 @@ hipError_t hipGraphExecHostNodeSetParams(hipGraphExec_t hGraphExec,
     CHIPERR_LOG_AND_THROW("Node provided failed to cast to CHIPGraphNodeMemset",
                           hipErrorInvalidValue);
 
-  CastNode->setParams(pNodeParams);
+  EXEC(hGraphExec)->updateNode(CastNode,
+                               [&]() { CastNode->setParams(pNodeParams); });
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -1121,12 +1135,12 @@ hipError_t hipGraphExecEventRecordNodeSetEvent(hipGraphExec_t hGraphExec,
   CHIP_TRY
   CHIPInitialize();
   auto ExecNode =
-      EXEC(hGraphExec)->getOriginalGraphPtr()->nodeLookup(NODE(hNode));
+      EXEC(hGraphExec)->getCompiledGraphPtr()->nodeLookup(NODE(hNode));
   if (!ExecNode)
     CHIPERR_LOG_AND_THROW("Failed to find the node in hipGraphExec_t",
                           hipErrorInvalidValue);
 
-  auto CastNode = static_cast<CHIPGraphNodeEventRecord *>(hNode);
+  auto CastNode = static_cast<CHIPGraphNodeEventRecord *>(ExecNode);
   if (!CastNode)
     CHIPERR_LOG_AND_THROW(
         "Node provided failed to cast to CHIPGraphNodeEventRecord",
@@ -1189,7 +1203,7 @@ hipError_t hipGraphExecEventWaitNodeSetEvent(hipGraphExec_t hGraphExec,
   CHIP_TRY
   CHIPInitialize();
   auto ExecNode =
-      EXEC(hGraphExec)->getOriginalGraphPtr()->nodeLookup(NODE(hNode));
+      EXEC(hGraphExec)->getCompiledGraphPtr()->nodeLookup(NODE(hNode));
   if (!ExecNode)
     CHIPERR_LOG_AND_THROW("Failed to find the node in hipGraphExec_t",
                           hipErrorInvalidValue);
@@ -1214,10 +1228,9 @@ hipError_t hipStreamBeginCapture(hipStream_t stream,
   if (ChipQueue == Backend->getActiveDevice()->getLegacyDefaultQueue()) {
     RETURN(hipErrorInvalidValue);
   }
-  ChipQueue->initCaptureGraph();
-  ChipQueue->setCaptureMode(mode);
-  ChipQueue->setCaptureStatus(
-      hipStreamCaptureStatus::hipStreamCaptureStatusActive);
+  if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone)
+    RETURN(hipErrorIllegalState);
+  ChipQueue->beginCapture(mode);
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -1230,14 +1243,13 @@ hipError_t hipStreamEndCapture(hipStream_t stream, hipGraph_t *pGraph) {
   if (ChipQueue == Backend->getActiveDevice()->getLegacyDefaultQueue()) {
     RETURN(hipErrorInvalidValue);
   }
-  if (ChipQueue->getCaptureStatus() !=
-      hipStreamCaptureStatus::hipStreamCaptureStatusActive) {
+  if (ChipQueue->getCaptureStatus() == hipStreamCaptureStatusNone) {
     RETURN(hipErrorInvalidValue);
   }
-  ChipQueue->setCaptureStatus(
-      hipStreamCaptureStatus::hipStreamCaptureStatusNone);
-  *pGraph = ChipQueue->getCaptureGraph();
-  RETURN(hipSuccess);
+  CHIPGraph *Graph;
+  auto Status = ChipQueue->endCapture(&Graph);
+  *pGraph = Graph;
+  RETURN(Status);
   CHIP_CATCH
 }
 
@@ -1298,7 +1310,7 @@ hipError_t hipMemcpyWithStream(void *Dst, const void *Src, size_t SizeBytes,
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
 
   if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
-    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    ChipQueue->invalidateCapture();
     RETURN(hipErrorStreamCaptureInvalidated);
   }
 
@@ -1365,6 +1377,40 @@ hipError_t hipMemcpyAsync(void *Dst, const void *Src, size_t SizeBytes,
   CHIP_CATCH
 }
 
+hipError_t hipExtMemcpyBatchAsync(void **Dsts, const void **Srcs,
+                                  const size_t *Sizes, size_t Count,
+                                  hipMemcpyKind Kind, hipStream_t Stream) {
+  CHIP_TRY
+  CHIPInitialize();
+  if (Count == 0)
+    RETURN(hipSuccess);
+  NULLCHECK(Dsts, Srcs, Sizes);
+  for (size_t i = 0; i < Count; i++)
+    if (Sizes[i])
+      NULLCHECK(Dsts[i], Srcs[i]);
+
+  auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
+  LOCK(ChipQueue->QueueMtx);
+
+  if (ChipQueue->getCaptureStatus() == hipStreamCaptureStatusActive) {
+    for (size_t i = 0; i < Count; i++)
+      if (Sizes[i])
+        ChipQueue->captureIntoGraph<CHIPGraphNodeMemcpy>(Dsts[i], Srcs[i],
+                                                         Sizes[i], Kind);
+    RETURN(hipSuccess);
+  }
+
+  if (Kind == hipMemcpyHostToHost) {
+    for (size_t i = 0; i < Count; i++)
+      memcpy(Dsts[i], Srcs[i], Sizes[i]);
+    RETURN(hipSuccess);
+  }
+
+  ChipQueue->memCopyBatchAsync(Dsts, Srcs, Sizes, Count);
+  RETURN(hipSuccess);
+  CHIP_CATCH
+}
+
 static inline hipError_t
 hipMemcpy2DAsyncInternal(void *Dst, size_t DPitch, const void *Src,
                          size_t SPitch, size_t Width, size_t Height,
@@ -1544,6 +1590,7 @@ static inline hipError_t hipDeviceSynchronizeInternal(void) {
   if (Backend->getActiveDevice()->isPerThreadStreamUsed()) {
     Backend->getActiveDevice()->getPerThreadDefaultQueue()->finish();
   }
+  Dev->drainPrintfBuffers();
 
   return hipSuccess;
 }
@@ -1551,6 +1598,8 @@ static inline hipError_t hipDeviceSynchronizeInternal(void) {
 hipError_t hipDeviceSynchronize(void) {
   CHIP_TRY
   CHIPInitialize();
+  if (chipstar::CaptureSequence::prohibitsUnsafeCalls())
+    RETURN(hipErrorStreamCaptureUnsupported);
   RETURN(hipDeviceSynchronizeInternal());
   CHIP_CATCH
 }
@@ -2088,7 +2137,7 @@ hipError_t hipStreamDestroy(hipStream_t Stream) {
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
 
   if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
-    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    ChipQueue->invalidateCapture();
     RETURN(hipErrorStreamCaptureInvalidated);
   }
 
@@ -2109,7 +2158,7 @@ static inline hipError_t hipStreamQueryInternal(hipStream_t Stream) {
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
 
   if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
-    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    ChipQueue->invalidateCapture();
     return hipErrorStreamCaptureInvalidated;
   }
 
@@ -2130,11 +2179,12 @@ static inline hipError_t hipStreamSynchronizeInternal(hipStream_t Stream) {
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
 
   if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
-    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    ChipQueue->invalidateCapture();
     return hipErrorStreamCaptureInvalidated;
   }
 
   ChipQueue->finish();
+  ChipQueue->getDevice()->drainPrintfBuffers();
   return hipSuccess;
 }
 
@@ -2151,6 +2201,10 @@ hipError_t hipStreamWaitEventInternal(hipStream_t Stream, hipEvent_t Event,
 
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
 
+  // Waiting for an event recorded in a capture forks the capture into this
+  // stream or joins the branches.
+  if (ChipEvent && ChipEvent->getCapture())
+    return ChipQueue->joinCapture(ChipEvent);
   if (ChipQueue->captureIntoGraph<CHIPGraphNodeWaitEvent>(ChipEvent)) {
     return hipSuccess;
   }
@@ -2193,7 +2247,7 @@ static inline hipError_t hipStreamGetFlagsInternal(hipStream_t Stream,
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
 
   if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
-    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    ChipQueue->invalidateCapture();
     return hipErrorStreamCaptureInvalidated;
   }
 
@@ -2219,7 +2273,7 @@ static inline hipError_t hipStreamGetPriorityInternal(hipStream_t Stream,
   }
 
   if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
-    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    ChipQueue->invalidateCapture();
     return hipErrorStreamCaptureInvalidated;
   }
 
@@ -2252,7 +2306,7 @@ hipError_t hipStreamAddCallback(hipStream_t Stream,
   LOCK(ChipQueue->QueueMtx);
 
   if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
-    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    ChipQueue->invalidateCapture();
     RETURN(hipErrorStreamCaptureInvalidated);
   }
 
@@ -2309,10 +2363,15 @@ hipError_t hipEventRecordInternal(hipEvent_t Event, hipStream_t Stream) {
 
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
 
-  if (ChipQueue->captureIntoGraph<CHIPGraphNodeEventRecord>(ChipEvent)) {
+  // Recording into a capturing stream only marks the position in the capture,
+  // see hipStreamWaitEventInternal().
+  if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
+    ChipEvent->setCapture(ChipQueue->getCapture(),
+                          ChipQueue->getCaptureDependencies());
     return hipSuccess;
   }
 
+  ChipEvent->setCapture(nullptr, {});
   ChipQueue->recordEvent(ChipEvent);
   return hipSuccess;
 }
@@ -2344,6 +2403,7 @@ hipError_t hipEventSynchronize(hipEvent_t Event) {
   chipstar::Event *ChipEvent = static_cast<chipstar::Event *>(Event);
 
   ChipEvent->wait();
+  ChipEvent->getContext()->getDevice()->drainPrintfBuffers();
   RETURN(hipSuccess);
 
   CHIP_CATCH
@@ -2409,6 +2469,8 @@ static inline hipError_t hipMallocInternal(void **Ptr, size_t Size) {
 hipError_t hipMalloc(void **Ptr, size_t Size) {
   CHIP_TRY
   CHIPInitialize();
+  if (chipstar::CaptureSequence::prohibitsUnsafeCalls())
+    RETURN(hipErrorStreamCaptureUnsupported);
   NULLCHECK(Ptr);
   RETURN(hipMallocInternal(Ptr, Size));
   CHIP_CATCH
@@ -2417,6 +2479,8 @@ hipError_t hipMalloc(void **Ptr, size_t Size) {
 hipError_t hipMallocManaged(void **DevPtr, size_t Size, unsigned int Flags) {
   CHIP_TRY
   CHIPInitialize();
+  if (chipstar::CaptureSequence::prohibitsUnsafeCalls())
+    RETURN(hipErrorStreamCaptureUnsupported);
   NULLCHECK(DevPtr);
 
   // TODO: Create a class for parsing this, default to attach global
@@ -2478,6 +2542,8 @@ static inline hipError_t hipHostMallocInternal(void **Ptr, size_t Size,
 hipError_t hipHostMalloc(void **Ptr, size_t Size, unsigned int Flags) {
   CHIP_TRY
   CHIPInitialize();
+  if (chipstar::CaptureSequence::prohibitsUnsafeCalls())
+    RETURN(hipErrorStreamCaptureUnsupported);
   RETURN(hipHostMallocInternal(Ptr, Size, Flags));
   CHIP_CATCH
 }
@@ -2510,6 +2576,8 @@ static inline hipError_t hipFreeInternal(void *Ptr) {
 hipError_t hipFree(void *Ptr) {
   CHIP_TRY
   CHIPInitialize();
+  if (chipstar::CaptureSequence::prohibitsUnsafeCalls())
+    RETURN(hipErrorStreamCaptureUnsupported);
   RETURN(hipFreeInternal(Ptr));
   CHIP_CATCH
 }
@@ -2540,23 +2608,43 @@ hipError_t hipFreeHost(void *Ptr) {
   CHIP_CATCH
 }
 
+/// Return true if [Ptr, Ptr + Count) lies within the allocation 'AllocInfo'.
+static bool isRangeInAllocation(const chipstar::AllocationInfo *AllocInfo,
+                                const void *Ptr, size_t Count) {
+  if (!AllocInfo)
+    return false;
+  auto Offset = static_cast<const char *>(Ptr) -
+                static_cast<const char *>(AllocInfo->DevPtr);
+  return Offset >= 0 && static_cast<size_t>(Offset) <= AllocInfo->Size &&
+         Count <= AllocInfo->Size - Offset;
+}
+
 hipError_t hipMemPrefetchAsync(const void *Ptr, size_t Count, int DstDevId,
                                hipStream_t Stream) {
   CHIP_TRY
-  UNIMPLEMENTED(hipErrorTbd);
   CHIPInitialize();
   NULLCHECK(Ptr);
 
   auto ChipQueue = Backend->findQueue(static_cast<chipstar::Queue *>(Stream));
+  LOCK(ChipQueue->QueueMtx);
+
+  // Prefetching does not affect the results of the captured work.
+  // TODO Graphs - no prefetch node is defined
+  if (ChipQueue->getCaptureStatus() == hipStreamCaptureStatusActive)
+    RETURN(hipSuccess);
+
+  bool ToHost = DstDevId == hipCpuDeviceId;
+  if (!ToHost) {
+    ERROR_CHECK_DEVNUM(DstDevId);
+    chipstar::Device *Dev = Backend->getDevices()[DstDevId];
 
-  // TODO Graphs - async operation should be supported by graphs but no prefetch
-  // node is defined
-  ERROR_CHECK_DEVNUM(DstDevId);
-  chipstar::Device *Dev = Backend->getDevices()[DstDevId];
+    // Check if given Stream belongs to the requested device
+    ERROR_IF(ChipQueue->getDevice() != Dev, hipErrorInvalidDevice);
+  }
 
-  // Check if given Stream belongs to the requested device
-  ERROR_IF(ChipQueue->getDevice() != Dev, hipErrorInvalidDevice);
-  ChipQueue->memPrefetch(Ptr, Count);
+  auto *AllocInfo = ChipQueue->getDevice()->AllocTracker->getAllocInfo(Ptr);
+  ERROR_IF(!isRangeInAllocation(AllocInfo, Ptr, Count), hipErrorInvalidValue);
+  ChipQueue->memPrefetch(Ptr, Count, ToHost);
 
   RETURN(hipSuccess);
   CHIP_CATCH
@@ -2572,7 +2660,37 @@ hipError_t hipMemAdvise(const void *Ptr, size_t Count, hipMemoryAdvise Advice,
     RETURN(hipSuccess);
   }
 
-  UNIMPLEMENTED(hipErrorNotSupported);
+  switch (Advice) {
+  case hipMemAdviseSetReadMostly:
+  case hipMemAdviseUnsetReadMostly:
+  case hipMemAdviseSetPreferredLocation:
+  case hipMemAdviseUnsetPreferredLocation:
+  case hipMemAdviseSetAccessedBy:
+  case hipMemAdviseUnsetAccessedBy:
+    break;
+  default:
+    // E.g. the coarse grain hints which have no meaning on the SPIR-V
+    // backends.
+    RETURN(hipSuccess);
+  }
+
+  bool ToHost = DstDevId == hipCpuDeviceId;
+  chipstar::Device *Dev = Backend->getActiveDevice();
+  if (!ToHost) {
+    ERROR_CHECK_DEVNUM(DstDevId);
+    Dev = Backend->getDevices()[DstDevId];
+  }
+
+  auto *AllocInfo = Dev->AllocTracker->getAllocInfo(Ptr);
+  ERROR_IF(!isRangeInAllocation(AllocInfo, Ptr, Count) ||
+               AllocInfo->MemoryType != hipMemoryTypeUnified,
+           hipErrorInvalidValue);
+
+  // The hints are applied in the order of the device's default queue so they
+  // do not race with the previous work on the range.
+  auto *ChipQueue = Dev->getDefaultQueue();
+  LOCK(ChipQueue->QueueMtx);
+  ChipQueue->memAdvise(Ptr, Count, Advice, ToHost);
 
   RETURN(hipSuccess);
   CHIP_CATCH
@@ -231,6 +231,11 @@ private:
   bool L0ImmCmdLists_ = true;
   unsigned long L0EventTimeout_ = 0;
   int L0CollectEventsTimeout_ = 0;
+  size_t HostCopyMaxSize_ = 64 * 1024;
+  int GraphQueues_ = 3;
+  bool GraphNative_ = true;
+  bool GraphFusion_ = true;
+  size_t PrintfBufferSize_ = 1024 * 1024;
 
 public:
   EnvVars() {
@@ -248,6 +253,11 @@ public:
   bool getLazyJit() const { return LazyJit_; }
   bool getL0ImmCmdLists() const { return L0ImmCmdLists_; }
   int getL0CollectEventsTimeout() const { return L0CollectEventsTimeout_; }
+  size_t getHostCopyMaxSize() const { return HostCopyMaxSize_; }
+  int getGraphQueues() const { return GraphQueues_; }
+  bool getGraphNative() const { return GraphNative_; }
+  bool getGraphFusion() const { return GraphFusion_; }
+  size_t getPrintfBufferSize() const { return PrintfBufferSize_; }
   unsigned long getL0EventTimeout() const {
     if (L0EventTimeout_ == 0)
       return UINT64_MAX;
@@ -287,6 +297,23 @@ private:
 
     if (!readEnvVar("CHIP_L0_EVENT_TIMEOUT").empty())
       L0EventTimeout_ = parseInt("CHIP_L0_EVENT_TIMEOUT");
+
+    if (!readEnvVar("CHIP_HOST_COPY_MAX_SIZE").empty())
+      HostCopyMaxSize_ = parseInt("CHIP_HOST_COPY_MAX_SIZE");
+
+    if (!readEnvVar("CHIP_GRAPH_QUEUES").empty())
+      GraphQueues_ = parseInt("CHIP_GRAPH_QUEUES");
+    if (GraphQueues_ < 0)
+      GraphQueues_ = 0;
+
+    if (!readEnvVar("CHIP_GRAPH_NATIVE").empty())
+      GraphNative_ = parseBoolean("CHIP_GRAPH_NATIVE");
+
+    if (!readEnvVar("CHIP_GRAPH_FUSION").empty())
+      GraphFusion_ = parseBoolean("CHIP_GRAPH_FUSION");
+
+    if (!readEnvVar("CHIP_PRINTF_BUFFER_SIZE").empty())
+      PrintfBufferSize_ = parseInt("CHIP_PRINTF_BUFFER_SIZE");
   }
 
   std::string_view parseJitFlags(const std::string &StrIn) {
@@ -328,6 +355,11 @@ private:
     logDebug("CHIP_L0_COLLECT_EVENTS_TIMEOUT={}", L0CollectEventsTimeout_);
     logDebug("CHIP_L0_EVENT_TIMEOUT={}", L0EventTimeout_);
     logDebug("CHIP_SKIP_UNINIT={}", SkipUninit_ ? "on" : "off");
+    logDebug("CHIP_HOST_COPY_MAX_SIZE={}", HostCopyMaxSize_);
+    logDebug("CHIP_GRAPH_QUEUES={}", GraphQueues_);
+    logDebug("CHIP_GRAPH_NATIVE={}", GraphNative_ ? "on" : "off");
+    logDebug("CHIP_GRAPH_FUSION={}", GraphFusion_ ? "on" : "off");
+    logDebug("CHIP_PRINTF_BUFFER_SIZE={}", PrintfBufferSize_);
   }
 };
 
@@ -32,28 +32,6 @@
 
 #include "CHIPBackend.hh"
 #include "CHIPBindingsInternal.hh"
-// CHIPGraphNode
-//*************************************************************************************
-void CHIPGraphNode::DFS(std::vector<CHIPGraphNode *> CurrPath,
-                        std::vector<std::vector<CHIPGraphNode *>> &Paths) {
-  CurrPath.push_back(this);
-  for (auto &Dep : Dependencies_) {
-    Dep->DFS(CurrPath, Paths);
-  }
-
-  if (Dependencies_.size() == 0) {
-    Paths.push_back(CurrPath);
-    // std::string PathStr = "";
-    // for(auto & Node : CurrPath) {
-    //     PathStr += Node->Msg + ", ";
-    // }
-    // logDebug("PATH: {}", PathStr);
-  }
-
-  CurrPath.pop_back();
-  return;
-}
-
 CHIPGraph::CHIPGraph(const CHIPGraph &OriginalGraph) {
   /**
    * Create another Graph using the copy constructor.
@@ -86,7 +64,7 @@ CHIPGraph::CHIPGraph(const CHIPGraph &OriginalGraph) {
 CHIPGraphNodeKernel::CHIPGraphNodeKernel(const CHIPGraphNodeKernel &Other)
     : CHIPGraphNode(Other) {
   Params_ = Other.Params_;
-  ExecItem_ = Other.ExecItem_->clone();
+  ExecItem_.reset(Other.ExecItem_->clone());
 }
 
 CHIPGraphNode *CHIPGraphNodeKernel::clone() const {
@@ -94,20 +72,55 @@ CHIPGraphNode *CHIPGraphNodeKernel::clone() const {
   return NewNode;
 }
 
+void CHIPGraphNodeMemset::getExtent(size_t &RowSize, size_t &Pitch,
+                                    size_t &NumRows) const {
+  RowSize = std::max<size_t>(1, Params_.width);
+  NumRows = std::max<size_t>(1, Params_.height);
+  Pitch = Params_.pitch;
+  // 1D memsets are recorded with a pitch of 1. Rows are only contiguous if
+  // the pitch equals the width.
+  if (NumRows == 1 || Pitch == RowSize) {
+    RowSize *= NumRows;
+    Pitch = RowSize;
+    NumRows = 1;
+  }
+}
+
 void CHIPGraphNodeMemset::execute(chipstar::Queue *Queue) const {
   const unsigned int Val = Params_.value;
-  size_t Height = std::max<size_t>(1, Params_.height);
-  size_t Width = std::max<size_t>(1, Params_.width);
-  size_t Size = Height * Width; //  TODO Graphs Pitch?
-  Queue->memFillAsync(Params_.dst, Size, (void *)&Val, Params_.elementSize);
+  size_t RowSize, Pitch, NumRows;
+  getExtent(RowSize, Pitch, NumRows);
+  for (size_t Row = 0; Row < NumRows; Row++)
+    Queue->memFillAsync(static_cast<char *>(Params_.dst) + Row * Pitch,
+                        RowSize, (void *)&Val, Params_.elementSize);
+}
+
+namespace {
+/// A host-to-host copy of a memcpy node. The parameters are taken when the
+/// node executes so updating the node doesn't affect launches in flight.
+struct HostCopy {
+  void *Dst;
+  const void *Src;
+  size_t Count;
+};
+} // namespace
+
+static void hostCopy(void *UserData) {
+  auto *Copy = static_cast<HostCopy *>(UserData);
+  memcpy(Copy->Dst, Copy->Src, Copy->Count);
+  delete Copy;
 }
 
 void CHIPGraphNodeMemcpy::execute(chipstar::Queue *Queue) const {
   if (Dst_ && Src_) {
-    auto Status = hipMemcpyInternal(Dst_, Src_, Count_, Kind_);
-    if (Status != hipSuccess)
-      CHIPERR_LOG_AND_THROW("Error enountered while executing a graph node",
-                            hipErrorTbd);
+    if (!Count_ || Dst_ == Src_)
+      return;
+    // Host-to-host copies are done on the host like in hipMemcpyAsync(), but
+    // from a host function so they still run after the nodes they depend on.
+    if (Kind_ == hipMemcpyHostToHost)
+      Queue->launchHostFunc(hostCopy, new HostCopy{Dst_, Src_, Count_});
+    else
+      Queue->memCopyAsync(Dst_, Src_, Count_);
   } else {
     auto Status = hipMemcpy3DAsyncInternal(&Params_, Queue);
     if (Status != hipSuccess)
@@ -116,7 +129,7 @@ void CHIPGraphNodeMemcpy::execute(chipstar::Queue *Queue) const {
   }
 }
 void CHIPGraphNodeKernel::execute(chipstar::Queue *Queue) const {
-  Queue->launch(ExecItem_);
+  Queue->launch(ExecItem_.get());
 }
 
 CHIPGraphNodeKernel::CHIPGraphNodeKernel(const hipKernelNodeParams *TheParams)
@@ -127,17 +140,7 @@ CHIPGraphNodeKernel::CHIPGraphNodeKernel(const hipKernelNodeParams *TheParams)
   Params_.gridDim = TheParams->gridDim;
   Params_.kernelParams = TheParams->kernelParams;
   Params_.sharedMemBytes = TheParams->sharedMemBytes;
-  auto Dev = Backend->getActiveDevice();
-  chipstar::Kernel *ChipKernel = Dev->findKernel(HostPtr(Params_.func));
-  if (!ChipKernel)
-    CHIPERR_LOG_AND_THROW("Could not find requested kernel",
-                          hipErrorInvalidDeviceFunction);
-  ExecItem_ = Backend->createExecItem(Params_.gridDim, Params_.blockDim,
-                                      Params_.sharedMemBytes, nullptr);
-  ExecItem_->setKernel(ChipKernel);
-
-  ExecItem_->copyArgs(TheParams->kernelParams);
-  ExecItem_->setupAllArgs();
+  setupExecItem_(TheParams->kernelParams);
 }
 
 CHIPGraphNodeKernel::CHIPGraphNodeKernel(const void *HostFunction, dim3 GridDim,
@@ -151,19 +154,39 @@ CHIPGraphNodeKernel::CHIPGraphNodeKernel(const void *HostFunction, dim3 GridDim,
   Params_.gridDim = GridDim;
   Params_.kernelParams = Args;
   Params_.sharedMemBytes = SharedMem;
+  setupExecItem_(Args);
+}
 
+void CHIPGraphNodeKernel::setupExecItem_(void **Args) {
   auto Dev = Backend->getActiveDevice();
-  chipstar::Kernel *ChipKernel = Dev->findKernel(HostPtr(HostFunction));
+  chipstar::Kernel *ChipKernel = Dev->findKernel(HostPtr(Params_.func));
   if (!ChipKernel)
     CHIPERR_LOG_AND_THROW("Could not find requested kernel",
                           hipErrorInvalidDeviceFunction);
-  ExecItem_ = Backend->createExecItem(GridDim, BlockDim, SharedMem, nullptr);
+  // Launches of the previous exec item keep what they need alive until they
+  // complete, native recordings of it hold on to it.
+  ExecItem_.reset(Backend->createExecItem(Params_.gridDim, Params_.blockDim,
+                                          Params_.sharedMemBytes, nullptr));
   ExecItem_->setKernel(ChipKernel);
 
   ExecItem_->copyArgs(Args);
   ExecItem_->setupAllArgs();
 }
 
+void CHIPGraphNodeKernel::setParams(const hipKernelNodeParams Params) {
+  Params_ = Params;
+  setupExecItem_(Params.kernelParams);
+}
+
+void CHIPGraphNodeKernel::updateParams(const CHIPGraphNode &Other) {
+  auto &Node = static_cast<const CHIPGraphNodeKernel &>(Other);
+  Params_ = Node.Params_;
+  // The kernelParams array of the other node may be gone by now, take the
+  // arguments from its exec item instead.
+  std::vector<void *> Args = Node.ExecItem_->getArgs();
+  setupExecItem_(Args.data());
+}
+
 int NodeCounter = 1;
 void CHIPGraph::addNode(CHIPGraphNode *Node) {
   logDebug("{} CHIPGraph::addNode({})", (void *)this, (void *)Node);
@@ -186,44 +209,100 @@ void CHIPGraph::removeNode(CHIPGraphNode *Node) {
 
 void CHIPGraphExec::launch(chipstar::Queue *Queue) {
   logDebug("{} CHIPGraphExec::launch({})", (void *)this, (void *)Queue);
-  compile();
-  auto ExecQueueCopy = ExecQueues_;
-  while (ExecQueueCopy.size()) {
-    auto Nodes = ExecQueueCopy.front();
-    std::string NodesInThisLevel = "";
-    for (auto Node : Nodes) {
-      NodesInThisLevel += Node->Msg + " ";
+  LOCK(LaunchMtx_); // CHIPGraphExec::ExecEvents_
+  if (FusionStale_) {
+    fuseNodes_();
+    scheduleQueues_();
+    FusionStale_ = false;
+  }
+  if (ChipEnvVars.getGraphNative()) {
+    if (Queue != NativeQueue_ || (NativeGraph_ && NativeGraph_->isStale()))
+      recordNative_(Queue);
+    if (NativeGraph_ && NativeGraph_->isReady()) {
+      logDebug("Replaying the native recording of the graph");
+      Queue->enqueueNativeGraph(NativeGraph_.get());
+      return;
     }
-    logDebug("Executing nodes: {}", NodesInThisLevel);
-    for (auto Node : Nodes) {
+  }
+
+  if (NumSlots_ == 1) {
+    // The queue is in-order and the plan is in topological order, so every
+    // node is enqueued after all of its dependencies. The last node of the
+    // graph becomes the last event of the queue.
+    for (auto Node : ExecNodes_) {
       logDebug("Executing {}", Node->Msg);
       Node->execute(Queue);
-      Queue->finish();
     }
-
-    ExecQueueCopy.pop();
+    return;
   }
-}
 
-void unchainUnnecessaryDeps(std::vector<CHIPGraphNode *> Path,
-                            std::vector<CHIPGraphNode *> SubPath) {
-  assert(Path.size() > SubPath.size());
-  std::string PathStr = "";
-  for (auto Node : SubPath) {
-    PathStr += Node->Msg + " ";
+  SlotQueues_[0] = Queue;
+  for (unsigned Slot = 1; Slot < NumSlots_; Slot++) {
+    auto SlotQueue = Queue->getDevice()->getGraphQueue(Queue, Slot - 1);
+    SlotQueues_[Slot] = SlotQueue ? SlotQueue : Queue;
   }
-  std::string LongerPathStr = "";
-  for (auto Node : Path) {
-    LongerPathStr += Node->Msg + " ";
+
+  // Fork: the graph queues start after the work already in the launch queue
+  WaitEvents_.assign(1, Queue->enqueueMarker());
+  for (unsigned Slot = 1; Slot < NumSlots_; Slot++)
+    if (SlotQueues_[Slot] != Queue)
+      SlotQueues_[Slot]->enqueueBarrier(WaitEvents_);
+
+  for (size_t i = 0; i < ExecNodes_.size(); i++) {
+    chipstar::Queue *NodeQueue = SlotQueues_[ExecSlots_[i]];
+    // Dependencies on the same queue are satisfied by the queue order
+    WaitEvents_.clear();
+    for (size_t j = ExecDepOffsets_[i]; j < ExecDepOffsets_[i + 1]; j++) {
+      size_t Dep = ExecDeps_[j];
+      if (SlotQueues_[ExecSlots_[Dep]] != NodeQueue)
+        WaitEvents_.push_back(ExecEvents_[Dep]);
+    }
+    if (!WaitEvents_.empty())
+      NodeQueue->enqueueBarrier(WaitEvents_);
+
+    logDebug("Executing {} on queue {}", ExecNodes_[i]->Msg,
+             (void *)NodeQueue);
+    ExecNodes_[i]->execute(NodeQueue);
+    if (ExecSignals_[i])
+      ExecEvents_[i] = NodeQueue->enqueueMarker();
   }
-  logDebug("unchainUnnecessaryDeps({}, {})", PathStr, LongerPathStr);
 
-  for (int i = 0; i < SubPath.size(); i++) {
-    if (SubPath[i] != Path[i]) {
-      SubPath[i - 1]->removeDependency(SubPath[i]);
-      break;
+  // Join: the launch queue waits for all the graph queues
+  WaitEvents_.clear();
+  for (unsigned Slot = 1; Slot < NumSlots_; Slot++)
+    if (SlotQueues_[Slot] != Queue)
+      WaitEvents_.push_back(SlotQueues_[Slot]->enqueueMarker());
+  if (!WaitEvents_.empty())
+    Queue->enqueueBarrier(WaitEvents_);
+
+  for (auto &Event : ExecEvents_)
+    Event.reset();
+}
+
+void CHIPGraphExec::recordNative_(chipstar::Queue *Queue) {
+  logDebug("{} CHIPGraphExec::recordNative_({})", (void *)this, (void *)Queue);
+  resetNativeGraph_();
+  NativeQueue_ = Queue;
+  NativeGraph_.reset(Queue->createNativeGraph());
+  if (!NativeGraph_)
+    return;
+
+  for (size_t i = 0; i < ExecNodes_.size(); i++) {
+    const size_t *Deps = ExecDeps_.data() + ExecDepOffsets_[i];
+    size_t NumDeps = ExecDepOffsets_[i + 1] - ExecDepOffsets_[i];
+    if (!NativeGraph_->addNode(ExecNodes_[i], Deps, NumDeps)) {
+      logDebug("Can't record {}, the graph is executed node by node",
+               ExecNodes_[i]->Msg);
+      resetNativeGraph_();
+      return;
     }
+    if (ExecNodes_[i]->getType() == hipGraphNodeTypeKernel)
+      NativeExecItems_.push_back(
+          static_cast<CHIPGraphNodeKernel *>(ExecNodes_[i])->shareExecItem());
   }
+
+  if (!NativeGraph_->finalize())
+    resetNativeGraph_();
 }
 
 std::vector<CHIPGraphNode *> CHIPGraph::getLeafNodes() {
@@ -237,57 +316,459 @@ std::vector<CHIPGraphNode *> CHIPGraph::getLeafNodes() {
   return LeafNodes;
 }
 
+void CHIPGraphExec::sortTopologically_() {
+  auto &Nodes = CompiledGraph_.getNodes();
+  size_t NumNodes = Nodes.size();
+  std::unordered_map<CHIPGraphNode *, size_t> NodeIndex;
+  NodeIndex.reserve(NumNodes);
+  for (size_t i = 0; i < NumNodes; i++)
+    NodeIndex[Nodes[i]] = i;
+
+  // Dependencies and dependants by index into Nodes. Duplicate edges are
+  // dropped here so the in-degrees below count distinct dependencies.
+  std::vector<std::vector<size_t>> Deps(NumNodes);
+  std::vector<std::vector<size_t>> Dependants(NumNodes);
+  for (size_t i = 0; i < NumNodes; i++) {
+    for (auto Dep : Nodes[i]->getDependencies()) {
+      auto DepIter = NodeIndex.find(Dep);
+      if (DepIter == NodeIndex.end())
+        CHIPERR_LOG_AND_THROW("Graph node depends on a node outside the graph",
+                              hipErrorInvalidValue);
+      Deps[i].push_back(DepIter->second);
+    }
+    std::sort(Deps[i].begin(), Deps[i].end());
+    Deps[i].erase(std::unique(Deps[i].begin(), Deps[i].end()), Deps[i].end());
+    for (auto Dep : Deps[i])
+      Dependants[Dep].push_back(i);
+  }
+
+  // Kahn's algorithm, one level at a time: a level consists of the nodes
+  // whose last dependency was resolved by the previous level.
+  std::vector<size_t> InDegree(NumNodes);
+  std::vector<size_t> Order;
+  Order.reserve(NumNodes);
+  for (size_t i = 0; i < NumNodes; i++) {
+    InDegree[i] = Deps[i].size();
+    if (!InDegree[i])
+      Order.push_back(i);
+  }
+  ExecLevelOffsets_.push_back(0);
+  for (size_t LevelBegin = 0; LevelBegin < Order.size();) {
+    size_t LevelEnd = Order.size();
+    for (size_t i = LevelBegin; i < LevelEnd; i++)
+      for (auto Dependant : Dependants[Order[i]])
+        if (--InDegree[Dependant] == 0)
+          Order.push_back(Dependant);
+    ExecLevelOffsets_.push_back(LevelEnd);
+    LevelBegin = LevelEnd;
+  }
+  if (Order.size() != NumNodes)
+    CHIPERR_LOG_AND_THROW("Graph contains a cycle", hipErrorInvalidValue);
+
+  // Renumber the nodes by their position in the topological order
+  std::vector<size_t> Position(NumNodes);
+  ExecNodes_.reserve(NumNodes);
+  for (size_t i = 0; i < NumNodes; i++) {
+    Position[Order[i]] = i;
+    ExecNodes_.push_back(Nodes[Order[i]]);
+  }
+  ExecDepOffsets_.reserve(NumNodes + 1);
+  for (size_t i = 0; i < NumNodes; i++) {
+    ExecDepOffsets_.push_back(ExecDeps_.size());
+    for (auto Dep : Deps[Order[i]])
+      ExecDeps_.push_back(Position[Dep]);
+    std::sort(ExecDeps_.begin() + ExecDepOffsets_.back(), ExecDeps_.end());
+  }
+  ExecDepOffsets_.push_back(ExecDeps_.size());
+}
+
 void CHIPGraphExec::pruneGraph_() {
-  std::vector<CHIPGraphNode *> LeafNodes_ = OriginalGraph_->getLeafNodes();
+  size_t NumNodes = ExecNodes_.size();
+  size_t NumWords = (NumNodes + 63) / 64;
+  // Reachable[i] is the set of nodes node i transitively depends on, as a
+  // bitset over the positions in ExecNodes_.
+  std::vector<uint64_t> Reachable(NumNodes * NumWords, 0);
+  auto bitsOf = [&](size_t Node) { return &Reachable[Node * NumWords]; };
+
+  std::vector<size_t> PrunedDeps;
+  PrunedDeps.reserve(ExecDeps_.size());
+  std::vector<size_t> PrunedDepOffsets;
+  PrunedDepOffsets.reserve(NumNodes + 1);
+  for (size_t i = 0; i < NumNodes; i++) {
+    PrunedDepOffsets.push_back(PrunedDeps.size());
+    uint64_t *Bits = bitsOf(i);
+    // Visit the dependencies from the latest to the earliest in topological
+    // order. A dependency which is reachable through a later dependency
+    // is implied by it, and the edge to it is redundant.
+    for (size_t j = ExecDepOffsets_[i + 1]; j-- > ExecDepOffsets_[i];) {
+      size_t Dep = ExecDeps_[j];
+      if (Bits[Dep / 64] & (uint64_t(1) << (Dep % 64))) {
+        logDebug("Removing redundant dependency <{} depends on {}>",
+                 ExecNodes_[i]->Msg, ExecNodes_[Dep]->Msg);
+        ExecNodes_[i]->removeDependency(ExecNodes_[Dep]);
+        ExecNodes_[Dep]->removeDependant(ExecNodes_[i]);
+        continue;
+      }
+      PrunedDeps.push_back(Dep);
+      const uint64_t *DepBits = bitsOf(Dep);
+      for (size_t Word = 0; Word < NumWords; Word++)
+        Bits[Word] |= DepBits[Word];
+      Bits[Dep / 64] |= uint64_t(1) << (Dep % 64);
+    }
+    // Keep the dependencies in ascending order
+    std::reverse(PrunedDeps.begin() + PrunedDepOffsets.back(),
+                 PrunedDeps.end());
+  }
+  PrunedDepOffsets.push_back(PrunedDeps.size());
 
-  for (auto LeafNode : LeafNodes_) {
-    // Generate all paths from leaf to root
-    std::vector<CHIPGraphNode *> CurrPath;
-    std::vector<std::vector<CHIPGraphNode *>> Paths;
-    LeafNode->DFS(CurrPath, Paths);
+  ExecDeps_.swap(PrunedDeps);
+  ExecDepOffsets_.swap(PrunedDepOffsets);
+}
 
-    if (Paths.size() < 2) {
-      continue;
+namespace {
+/// Copies up to this size are collected into CHIPGraphNodeMemcpyBatch nodes.
+constexpr size_t MaxBatchedCopySize = 64 * 1024;
+
+/// Nodes of the unfused plan which are executed as one node of the plan.
+struct FusionGroup {
+  enum { Single, Memset, Memcpy, Batch } Kind = Single;
+  std::vector<size_t> Members;
+  /// The region written by a Memset group, in the format of getExtent().
+  hipMemsetParams Fill;
+  /// The copy performed by a Memcpy group.
+  char *Dst;
+  const char *Src;
+  size_t Count;
+  hipMemcpyKind CopyKind;
+};
+} // namespace
+
+static bool isNoOpCopy(CHIPGraphNodeMemcpy *Node) {
+  return !Node->getCount() || Node->getDst() == Node->getSrc();
+}
+
+/// Small 1D copies which can be submitted as a part of a batch.
+static bool isBatchable(CHIPGraphNode *Node) {
+  if (Node->getType() == hipGraphNodeTypeMemcpyToSymbol) {
+    auto ToSymbol = static_cast<CHIPGraphNodeMemcpyToSymbol *>(Node);
+    return ToSymbol->getSrc() && ToSymbol->getSizeBytes() &&
+           ToSymbol->getSizeBytes() <= MaxBatchedCopySize &&
+           (ToSymbol->getKind() == hipMemcpyHostToDevice ||
+            ToSymbol->getKind() == hipMemcpyDeviceToDevice);
+  }
+  if (Node->getType() != hipGraphNodeTypeMemcpy)
+    return false;
+  auto Memcpy = static_cast<CHIPGraphNodeMemcpy *>(Node);
+  // Host-to-host copies stay on the host
+  return Memcpy->getDst() && Memcpy->getSrc() && !isNoOpCopy(Memcpy) &&
+         Memcpy->getKind() != hipMemcpyHostToHost &&
+         Memcpy->getCount() <= MaxBatchedCopySize;
+}
+
+/// True if Node takes part in the node fusion.
+static bool isFusable(const CHIPGraphNode *Node) {
+  return Node->getType() == hipGraphNodeTypeMemset ||
+         Node->getType() == hipGraphNodeTypeMemcpy ||
+         Node->getType() == hipGraphNodeTypeMemcpyToSymbol;
+}
+
+/// True if the parameters the node fusion looks at differ between A and B,
+/// two nodes of the same type.
+static bool fusionParamsDiffer(CHIPGraphNode *A, CHIPGraphNode *B) {
+  if (A->getType() == hipGraphNodeTypeMemset) {
+    auto ParamsA = static_cast<CHIPGraphNodeMemset *>(A)->getParams();
+    auto ParamsB = static_cast<CHIPGraphNodeMemset *>(B)->getParams();
+    return ParamsA.dst != ParamsB.dst ||
+           ParamsA.elementSize != ParamsB.elementSize ||
+           ParamsA.width != ParamsB.width ||
+           ParamsA.height != ParamsB.height ||
+           ParamsA.pitch != ParamsB.pitch || ParamsA.value != ParamsB.value;
+  }
+  if (A->getType() == hipGraphNodeTypeMemcpy) {
+    auto CopyA = static_cast<CHIPGraphNodeMemcpy *>(A);
+    auto CopyB = static_cast<CHIPGraphNodeMemcpy *>(B);
+    return CopyA->getDst() != CopyB->getDst() ||
+           CopyA->getSrc() != CopyB->getSrc() ||
+           CopyA->getCount() != CopyB->getCount() ||
+           CopyA->getKind() != CopyB->getKind();
+  }
+  if (A->getType() == hipGraphNodeTypeMemcpyToSymbol) {
+    // The symbol address is resolved when the batch executes
+    auto CopyA = static_cast<CHIPGraphNodeMemcpyToSymbol *>(A);
+    auto CopyB = static_cast<CHIPGraphNodeMemcpyToSymbol *>(B);
+    return CopyA->getSrc() != CopyB->getSrc() ||
+           CopyA->getSizeBytes() != CopyB->getSizeBytes() ||
+           CopyA->getKind() != CopyB->getKind();
+  }
+  return false;
+}
+
+/// Start a group which other nodes can be merged into.
+static void initGroup(FusionGroup &Group, CHIPGraphNode *Node) {
+  if (Node->getType() == hipGraphNodeTypeMemset) {
+    auto Memset = static_cast<CHIPGraphNodeMemset *>(Node);
+    Group.Kind = FusionGroup::Memset;
+    Group.Fill = Memset->getParams();
+    Memset->getExtent(Group.Fill.width, Group.Fill.pitch, Group.Fill.height);
+  } else if (Node->getType() == hipGraphNodeTypeMemcpy) {
+    auto Memcpy = static_cast<CHIPGraphNodeMemcpy *>(Node);
+    if (!Memcpy->getDst() || !Memcpy->getSrc() || isNoOpCopy(Memcpy))
+      return;
+    Group.Kind = FusionGroup::Memcpy;
+    Group.Dst = static_cast<char *>(Memcpy->getDst());
+    Group.Src = static_cast<const char *>(Memcpy->getSrc());
+    Group.Count = Memcpy->getCount();
+    Group.CopyKind = Memcpy->getKind();
+  }
+}
+
+/// True if A and B, which may point into an allocation, point into the same
+/// allocation. Adjacent allocations can't be accessed as one region.
+static bool inSameAllocation(chipstar::AllocationTracker *Tracker,
+                             const void *A, const void *B) {
+  auto AllocInfo = Tracker->getAllocInfo(A);
+  return AllocInfo && AllocInfo == Tracker->getAllocInfo(B);
+}
+
+/// Extend the region of a Memset group with the region of Node: either the
+/// bytes right after the region or the next rows of the same pitch.
+static bool mergeMemset(FusionGroup &Group, CHIPGraphNode *Node,
+                        chipstar::AllocationTracker *Tracker) {
+  if (Node->getType() != hipGraphNodeTypeMemset)
+    return false;
+  auto Memset = static_cast<CHIPGraphNodeMemset *>(Node);
+  hipMemsetParams Params = Memset->getParams();
+  hipMemsetParams &Fill = Group.Fill;
+  if (Params.value != Fill.value || Params.elementSize != Fill.elementSize)
+    return false;
+  size_t RowSize, Pitch, NumRows;
+  Memset->getExtent(RowSize, Pitch, NumRows);
+  uintptr_t Begin = reinterpret_cast<uintptr_t>(Fill.dst);
+  uintptr_t Dst = reinterpret_cast<uintptr_t>(Params.dst);
+  if (Dst <= Begin)
+    return false;
+
+  if (Fill.height == 1 && NumRows == 1 && Dst == Begin + Fill.width) {
+    // The pattern must continue where the region ends
+    if (Fill.elementSize && Fill.width % Fill.elementSize)
+      return false;
+    if (!inSameAllocation(Tracker, Fill.dst, Params.dst))
+      return false;
+    Fill.width += RowSize;
+    Fill.pitch = Fill.width;
+    return true;
+  }
+
+  // The pitch of a single row region is defined by the next row
+  size_t FillPitch = Fill.height > 1 ? Fill.pitch
+                     : NumRows > 1   ? Pitch
+                                     : Dst - Begin;
+  if (RowSize != Fill.width || FillPitch <= RowSize ||
+      (NumRows > 1 && Pitch != FillPitch) ||
+      Dst != Begin + Fill.height * FillPitch)
+    return false;
+  if (!inSameAllocation(Tracker, Fill.dst, Params.dst))
+    return false;
+  Fill.pitch = FillPitch;
+  Fill.height += NumRows;
+  return true;
+}
+
+/// Extend the copy of a Memcpy group with the copy of Node if both the
+/// sources and the destinations are adjacent parts of the same allocations.
+static bool mergeMemcpy(FusionGroup &Group, CHIPGraphNode *Node,
+                        chipstar::AllocationTracker *Tracker) {
+  if (Node->getType() != hipGraphNodeTypeMemcpy)
+    return false;
+  auto Memcpy = static_cast<CHIPGraphNodeMemcpy *>(Node);
+  if (!Memcpy->getDst() || !Memcpy->getSrc() || isNoOpCopy(Memcpy) ||
+      Memcpy->getKind() != Group.CopyKind ||
+      Memcpy->getDst() != Group.Dst + Group.Count ||
+      Memcpy->getSrc() != Group.Src + Group.Count)
+    return false;
+  // The merged copy must not read what it writes
+  size_t Count = Group.Count + Memcpy->getCount();
+  if (Group.Dst < Group.Src + Count && Group.Src < Group.Dst + Count)
+    return false;
+  if (!inSameAllocation(Tracker, Group.Dst, Memcpy->getDst()) ||
+      !inSameAllocation(Tracker, Group.Src, Memcpy->getSrc()))
+    return false;
+  Group.Count = Count;
+  return true;
+}
+
+void CHIPGraphExec::fuseNodes_() {
+  NumFusions_++;
+  size_t NumNodes = UnfusedNodes_.size();
+  FusedMemsets_.clear();
+  FusedMemcpys_.clear();
+  FusedBatches_.clear();
+
+  std::vector<FusionGroup> Groups;
+  std::vector<size_t> GroupOf(NumNodes);
+  std::vector<size_t> NumDependants(NumNodes, 0);
+  for (auto Dep : UnfusedDeps_)
+    NumDependants[Dep]++;
+  // Single copy or batch group for the dependency set of its nodes. Nodes
+  // with the same dependencies are at the same level and don't depend on
+  // each other.
+  std::map<std::vector<size_t>, size_t> Batches;
+
+  bool Enabled = ChipEnvVars.getGraphFusion();
+  auto Tracker = Backend->getActiveDevice()->AllocTracker;
+  for (size_t i = 0; i < NumNodes; i++) {
+    CHIPGraphNode *Node = UnfusedNodes_[i];
+    auto DepsBegin = UnfusedDeps_.begin() + UnfusedDepOffsets_[i];
+    auto DepsEnd = UnfusedDeps_.begin() + UnfusedDepOffsets_[i + 1];
+
+    // Merge the node into the group of its only dependency if that has no
+    // other dependants. Contracting such an edge can't create a cycle.
+    if (Enabled && DepsEnd - DepsBegin == 1 && NumDependants[*DepsBegin] == 1) {
+      FusionGroup &Group = Groups[GroupOf[*DepsBegin]];
+      if ((Group.Kind == FusionGroup::Memset &&
+           mergeMemset(Group, Node, Tracker)) ||
+          (Group.Kind == FusionGroup::Memcpy &&
+           mergeMemcpy(Group, Node, Tracker))) {
+        Group.Members.push_back(i);
+        GroupOf[i] = GroupOf[*DepsBegin];
+        continue;
+      }
     }
 
-    std::sort(Paths.begin(), Paths.end(),
-              [](std::vector<CHIPGraphNode *> PathA,
-                 std::vector<CHIPGraphNode *> PathB) {
-                return PathA.size() > PathB.size();
-              });
-
-    for (auto Path : Paths) {
-      // convert the current path to a set
-      std::set<CHIPGraphNode *> PathSet(Path.begin(), Path.end());
-
-      // Check other paths to see if they are a subset of this (longer) path
-      for (auto SubPathIter = Paths.begin(); SubPathIter != Paths.end();
-           SubPathIter++) {
-        auto SubPath = *SubPathIter;
-        // skip if subpath is longer than path
-        if (Path.size() <= SubPath.size() || Path == SubPath) {
+    if (Enabled && isBatchable(Node)) {
+      std::vector<size_t> Deps(DepsBegin, DepsEnd);
+      auto Found = Batches.find(Deps);
+      if (Found != Batches.end()) {
+        FusionGroup &Group = Groups[Found->second];
+        if (Group.Kind == FusionGroup::Batch || Group.Members.size() == 1) {
+          Group.Kind = FusionGroup::Batch;
+          Group.Members.push_back(i);
+          GroupOf[i] = Found->second;
           continue;
         }
+      }
+      // Another copy with these dependencies can form a batch with this one
+      Batches[Deps] = Groups.size();
+    }
 
-        // convert the other path to a set
-        std::set<CHIPGraphNode *> SubPathSet(SubPath.begin(), SubPath.end());
-        // std::string PathStr = "";
-        // for(auto Node : Path) {
-        //   PathStr += Node->Msg + " ";
-        // }
-        // std::string SubPathStr = "";
-        // for(auto Node : SubPath) {
-        //   SubPathStr += Node->Msg + " ";
-        // }
-        // logDebug("Path: {}", PathStr);
-        // logDebug("OtherPath: {}", SubPathStr);
-        if (std::includes(PathSet.begin(), PathSet.end(), SubPathSet.begin(),
-                          SubPathSet.end())) {
-          unchainUnnecessaryDeps(Path, SubPath);
-        }
+    GroupOf[i] = Groups.size();
+    Groups.emplace_back();
+    Groups.back().Members.push_back(i);
+    initGroup(Groups.back(), Node);
+  }
+
+  // The groups are in a topological order: the dependencies outside of a
+  // group precede its first node. Sort them into levels again.
+  size_t NumGroups = Groups.size();
+  std::vector<size_t> GroupDepOffsets(1, 0);
+  std::vector<size_t> GroupDeps;
+  std::vector<size_t> Level(NumGroups, 0);
+  for (size_t g = 0; g < NumGroups; g++) {
+    for (auto Member : Groups[g].Members)
+      for (size_t j = UnfusedDepOffsets_[Member];
+           j < UnfusedDepOffsets_[Member + 1]; j++)
+        if (GroupOf[UnfusedDeps_[j]] != g)
+          GroupDeps.push_back(GroupOf[UnfusedDeps_[j]]);
+    auto Begin = GroupDeps.begin() + GroupDepOffsets.back();
+    std::sort(Begin, GroupDeps.end());
+    GroupDeps.erase(std::unique(Begin, GroupDeps.end()), GroupDeps.end());
+    for (auto It = Begin; It != GroupDeps.end(); ++It)
+      Level[g] = std::max(Level[g], Level[*It] + 1);
+    GroupDepOffsets.push_back(GroupDeps.size());
+  }
+
+  std::vector<size_t> Order(NumGroups);
+  for (size_t g = 0; g < NumGroups; g++)
+    Order[g] = g;
+  std::stable_sort(Order.begin(), Order.end(),
+                   [&](size_t A, size_t B) { return Level[A] < Level[B]; });
+  std::vector<size_t> Position(NumGroups);
+  for (size_t i = 0; i < NumGroups; i++)
+    Position[Order[i]] = i;
+
+  ExecNodes_.clear();
+  ExecDepOffsets_.clear();
+  ExecDeps_.clear();
+  ExecLevelOffsets_.assign(1, 0);
+  for (size_t i = 0; i < NumGroups; i++) {
+    FusionGroup &Group = Groups[Order[i]];
+    CHIPGraphNode *First = UnfusedNodes_[Group.Members[0]];
+    if (Group.Members.size() == 1) {
+      ExecNodes_.push_back(First);
+    } else if (Group.Kind == FusionGroup::Memset) {
+      FusedMemsets_.emplace_back(new CHIPGraphNodeMemset(Group.Fill));
+      FusedMemsets_.back()->Msg = "Fused" + First->Msg;
+      ExecNodes_.push_back(FusedMemsets_.back().get());
+    } else if (Group.Kind == FusionGroup::Memcpy) {
+      FusedMemcpys_.emplace_back(new CHIPGraphNodeMemcpy(
+          Group.Dst, Group.Src, Group.Count, Group.CopyKind));
+      FusedMemcpys_.back()->Msg = "Fused" + First->Msg;
+      ExecNodes_.push_back(FusedMemcpys_.back().get());
+    } else {
+      FusedBatches_.emplace_back(new CHIPGraphNodeMemcpyBatch());
+      for (auto Member : Group.Members)
+        FusedBatches_.back()->addCopy(UnfusedNodes_[Member]);
+      FusedBatches_.back()->Msg = "MemcpyBatch";
+      ExecNodes_.push_back(FusedBatches_.back().get());
+    }
+
+    ExecDepOffsets_.push_back(ExecDeps_.size());
+    for (size_t j = GroupDepOffsets[Order[i]];
+         j < GroupDepOffsets[Order[i] + 1]; j++)
+      ExecDeps_.push_back(Position[GroupDeps[j]]);
+    std::sort(ExecDeps_.begin() + ExecDepOffsets_.back(), ExecDeps_.end());
+
+    if (i + 1 == NumGroups || Level[Order[i + 1]] != Level[Order[i]])
+      ExecLevelOffsets_.push_back(i + 1);
+  }
+  ExecDepOffsets_.push_back(ExecDeps_.size());
+
+  logDebug("{} CHIPGraphExec: node fusion removed {} of {} nodes",
+           (void *)this, NumNodes - NumGroups, NumNodes);
+}
+
+void CHIPGraphExec::scheduleQueues_() {
+  size_t NumNodes = ExecNodes_.size();
+  size_t MaxWidth = 1;
+  for (size_t Level = 0; Level + 1 < ExecLevelOffsets_.size(); Level++)
+    MaxWidth = std::max(MaxWidth, ExecLevelOffsets_[Level + 1] -
+                                      ExecLevelOffsets_[Level]);
+  NumSlots_ = std::min<size_t>(MaxWidth, ChipEnvVars.getGraphQueues() + 1);
+  ExecSlots_.assign(NumNodes, 0);
+  ExecSignals_.assign(NumNodes, false);
+  if (NumSlots_ == 1)
+    return;
+
+  // A node continues on the slot of a dependency which is the last node on
+  // its slot so far. Otherwise it starts a new chain on the next slot.
+  constexpr size_t NoNode = SIZE_MAX;
+  std::vector<size_t> SlotTail(NumSlots_, NoNode);
+  unsigned NextSlot = 0;
+  for (size_t i = 0; i < NumNodes; i++) {
+    unsigned Slot = NumSlots_;
+    for (size_t j = ExecDepOffsets_[i]; j < ExecDepOffsets_[i + 1]; j++) {
+      size_t Dep = ExecDeps_[j];
+      if (SlotTail[ExecSlots_[Dep]] == Dep) {
+        Slot = ExecSlots_[Dep];
+        break;
       }
     }
+    if (Slot == NumSlots_) {
+      Slot = NextSlot;
+      NextSlot = (NextSlot + 1) % NumSlots_;
+    }
+    ExecSlots_[i] = Slot;
+    SlotTail[Slot] = i;
+
+    for (size_t j = ExecDepOffsets_[i]; j < ExecDepOffsets_[i + 1]; j++)
+      if (ExecSlots_[ExecDeps_[j]] != Slot)
+        ExecSignals_[ExecDeps_[j]] = true;
   }
+
+  ExecEvents_.resize(NumNodes);
+  SlotQueues_.resize(NumSlots_);
+  logDebug("{} CHIPGraphExec: {} nodes scheduled on {} queues", (void *)this,
+           NumNodes, NumSlots_);
 }
 
 std::vector<CHIPGraphNode *> CHIPGraph::getRootNodes() {
@@ -300,99 +781,156 @@ std::vector<CHIPGraphNode *> CHIPGraph::getRootNodes() {
   return RootNodes;
 }
 
+/// Index the dependencies of Nodes by their positions in Nodes, sorted and
+/// without duplicates. Returns false if a dependency is not in Nodes.
+static bool indexDependencies(const std::vector<CHIPGraphNode *> &Nodes,
+                              std::vector<size_t> &DepOffsets,
+                              std::vector<size_t> &Deps) {
+  std::unordered_map<CHIPGraphNode *, size_t> Index;
+  for (size_t i = 0; i < Nodes.size(); i++)
+    Index[Nodes[i]] = i;
+
+  DepOffsets.assign(1, 0);
+  Deps.clear();
+  for (auto Node : Nodes) {
+    for (auto Dep : Node->getDependencies()) {
+      auto Found = Index.find(Dep);
+      if (Found == Index.end())
+        return false;
+      Deps.push_back(Found->second);
+    }
+    auto Begin = Deps.begin() + DepOffsets.back();
+    std::sort(Begin, Deps.end());
+    Deps.erase(std::unique(Begin, Deps.end()), Deps.end());
+    DepOffsets.push_back(Deps.size());
+  }
+  return true;
+}
+
 void CHIPGraphExec::compile() {
+  logDebug("{} CHIPGraphExec::compile()", (void *)this);
+  InstNodes_ = CompiledGraph_.getNodes();
+  indexDependencies(InstNodes_, InstDepOffsets_, InstDeps_);
   ExtractSubGraphs_();
+  sortTopologically_();
   pruneGraph_();
-  logDebug("{} CHIPGraphExec::compile()", (void *)this);
-  std::vector<CHIPGraphNode *> Nodes = OriginalGraph_->getNodes();
-  auto RootNodesVec = OriginalGraph_->getRootNodes();
-  std::set<CHIPGraphNode *> RootNodes(RootNodesVec.begin(), RootNodesVec.end());
-  ExecQueues_.push(RootNodes);
-  //  Remove root nodes from the set of nodes
-  for (auto Node : RootNodes) {
-    Nodes.erase(std::find(Nodes.begin(), Nodes.end(), Node));
-  }
+  UnfusedNodes_.swap(ExecNodes_);
+  UnfusedDepOffsets_.swap(ExecDepOffsets_);
+  UnfusedDeps_.swap(ExecDeps_);
+  fuseNodes_();
+  scheduleQueues_();
+
+  std::string PlanStr = "";
+  for (auto Node : ExecNodes_)
+    PlanStr += Node->Msg + " ";
+  logDebug("Execution plan: {}", PlanStr);
+}
 
-  /**
-   * This piece of code will generate sets of nodes that can be executed in
-   * parallel. These sets are accumulated into the execution queue. The
-   * execution queue starts with the root nodes. To fill the execution queue, we
-   * find all the nodes that depend only the nodes in the back of the exec
-   * queue.
-   */
-  std::set<CHIPGraphNode *> NextSet;
-  std::set<CHIPGraphNode *> PrevLevelNodes = RootNodes;
-  auto NodeIter = Nodes.begin();
-  while (Nodes.size()) { // while more unnasigned nodes available
-    auto CurrentNodeDeps = (*NodeIter)->getDependencies();
-    std::string CurrentNodeDepsStr = "";
-    for (auto Node : CurrentNodeDeps) {
-      CurrentNodeDepsStr += Node->Msg + " ";
-    }
-    logDebug("CurrentNode {} Deps: {}", (*NodeIter)->Msg, CurrentNodeDepsStr);
-    std::string PrevLevelNodesStr = "";
-    for (auto Node : PrevLevelNodes) {
-      PrevLevelNodesStr += Node->Msg + " ";
-    }
-    logDebug("PrevLevelNodes: {}", PrevLevelNodesStr);
-
-    // std::includes requires sorted ranges. Since PrevLevelNodes is a sorted
-    // set, we only need to sort the CurrentNodeDeps
-    std::sort(CurrentNodeDeps.begin(), CurrentNodeDeps.end());
-    if (std::includes(PrevLevelNodes.begin(), PrevLevelNodes.end(),
-                      CurrentNodeDeps.begin(), CurrentNodeDeps.end())) {
-      NextSet.insert(*NodeIter);
-      Nodes.erase(NodeIter);
-      NodeIter = Nodes.begin();
-    } else {
-      NodeIter++;
-    }
+hipGraphExecUpdateResult CHIPGraphExec::update(CHIPGraph *Graph,
+                                               CHIPGraphNode *&ErrorNode) {
+  logDebug("{} CHIPGraphExec::update({})", (void *)this, (void *)Graph);
+  ErrorNode = nullptr;
+  auto &Nodes = Graph->getNodes();
+  if (Nodes.size() != InstNodes_.size())
+    return hipGraphExecUpdateErrorTopologyChanged;
 
-    if (NodeIter == Nodes.end()) {
-      PrevLevelNodes.insert(NextSet.begin(), NextSet.end());
-      ExecQueues_.push(NextSet);
-      NextSet.clear();
-      NodeIter = Nodes.begin();
-    }
+  std::vector<size_t> DepOffsets, Deps;
+  if (!indexDependencies(Nodes, DepOffsets, Deps))
+    return hipGraphExecUpdateErrorTopologyChanged;
+
+  // Check all the pairs before touching any of the instantiated nodes
+  for (size_t i = 0; i < Nodes.size(); i++) {
+    auto Node = Nodes[i];
+    auto InstNode = InstNodes_[i];
+    ErrorNode = Node;
+    if (!std::equal(Deps.begin() + DepOffsets[i],
+                    Deps.begin() + DepOffsets[i + 1],
+                    InstDeps_.begin() + InstDepOffsets_[i],
+                    InstDeps_.begin() + InstDepOffsets_[i + 1]))
+      return hipGraphExecUpdateErrorTopologyChanged;
+    if (Node->getType() != InstNode->getType())
+      return hipGraphExecUpdateErrorNodeTypeChanged;
+    // The nodes of child graphs were merged into the execution plan
+    if (Node->getType() == hipGraphNodeTypeGraph)
+      return hipGraphExecUpdateErrorNotSupported;
+    if (Node->getType() == hipGraphNodeTypeKernel &&
+        static_cast<CHIPGraphNodeKernel *>(Node)->getParams().func !=
+            static_cast<CHIPGraphNodeKernel *>(InstNode)->getParams().func)
+      return hipGraphExecUpdateErrorFunctionChanged;
+  }
+  ErrorNode = nullptr;
+
+  LOCK(LaunchMtx_); // CHIPGraphExec::NativeGraph_
+  for (size_t i = 0; i < Nodes.size(); i++) {
+    if (fusionParamsDiffer(InstNodes_[i], Nodes[i]))
+      FusionStale_ = true;
+    InstNodes_[i]->updateParams(*Nodes[i]);
   }
+  resetNativeGraph_();
+  NativeQueue_ = nullptr;
+  return hipGraphExecUpdateSuccess;
+}
+
+void CHIPGraphExec::updateNode(CHIPGraphNode *Node,
+                               const std::function<void()> &SetParams) {
+  LOCK(LaunchMtx_); // CHIPGraphExec::NativeGraph_
+  SetParams();
+  resetNativeGraph_();
+  NativeQueue_ = nullptr;
+  // Kernel nodes are executed as they are, only fused nodes copy parameters
+  if (isFusable(Node))
+    FusionStale_ = true;
+}
+
+void CHIPGraphExec::resetNativeGraph_() {
+  // The backends wait for the launches of the recording in its destructor,
+  // only then the recorded exec items can go.
+  NativeGraph_.reset();
+  NativeExecItems_.clear();
 }
 
 void CHIPGraphNodeHost::execute(chipstar::Queue *Queue) const {
-  Queue->finish();
-  Params_.fn(Params_.userData);
+  // The nodes enqueued after this one are held back until the function has
+  // returned on the host function executor.
+  Queue->launchHostFunc(Params_.fn, Params_.userData);
 }
 
 void CHIPGraphExec::ExtractSubGraphs_() {
-  auto Nodes = CompiledGraph_.getNodes();
-  for (int i = 0; i < Nodes.size(); i++) {
+  auto &Nodes = CompiledGraph_.getNodes();
+  // Nodes of the child graphs get appended to Nodes so nested child graphs
+  // are extracted by later iterations.
+  for (size_t i = 0; i < Nodes.size(); i++) {
     auto Node = Nodes[i];
-    if (Node->getType() == hipGraphNodeTypeGraph) {
-      auto SubGraphNode = static_cast<CHIPGraphNodeGraph *>(Node);
-      auto SubGraph = SubGraphNode->getGraph();
-
-      // 1. get all the root nodes
-      auto RootNodes = SubGraph->getRootNodes();
-      if (i > 0) {
-        // 2. make them dependants of prev nodes
-        auto PrevNode = Nodes[i - 1];
-        PrevNode->addDependencies(RootNodes);
-      }
-
-      // 3. get all the leaf nodes
-      auto LeafNodes = SubGraph->getLeafNodes();
-      if (i < Nodes.size()) {
-        // 4. add dependency on next node
-        auto NextNode = Nodes[i + 1];
-        NextNode->addDependants(LeafNodes);
-      }
+    if (Node->getType() != hipGraphNodeTypeGraph)
+      continue;
 
-      // 5. Erase the original subgraph node
-      Nodes.erase(Nodes.begin() + i);
-      // 6. replace it with nodes from the subgraph
-      for (auto SubGraphNode : SubGraph->getNodes()) {
-        Nodes.push_back(SubGraphNode);
-      }
+    auto SubGraphNode = static_cast<CHIPGraphNodeGraph *>(Node);
+    // Clone the child graph so that the user's child graph remains untouched
+    CHIPGraph SubGraph(*SubGraphNode->getGraph());
+    auto Dependencies = SubGraphNode->getDependencies();
+    auto Dependants = SubGraphNode->getDependants();
+
+    // 1. the root nodes take over the dependencies of the subgraph node
+    // 2. the dependants of the subgraph node depend on the leaf nodes instead.
+    // An empty child graph passes its dependencies through.
+    auto RootNodes = SubGraph.getRootNodes();
+    auto LeafNodes = SubGraph.getLeafNodes();
+    if (SubGraph.getNodes().empty())
+      LeafNodes = Dependencies;
+    for (auto Root : RootNodes)
+      Root->addDependencies(Dependencies);
+    for (auto Dep : Dependencies)
+      Dep->removeDependant(SubGraphNode);
+    for (auto Dependant : Dependants) {
+      Dependant->removeDependency(SubGraphNode);
+      Dependant->addDependencies(LeafNodes);
     }
+
+    // 3. replace the subgraph node with the nodes from the subgraph
+    Nodes.erase(Nodes.begin() + i);
+    i--;
+    for (auto SubGraphNode : SubGraph.getNodes())
+      Nodes.push_back(SubGraphNode);
   }
 }
 
@@ -406,11 +944,8 @@ void CHIPGraphNodeEventRecord::execute(chipstar::Queue *Queue) const {
 
 void CHIPGraphNodeMemcpyFromSymbol::execute(chipstar::Queue *Queue) const {
   NULLCHECK(Dst_, Symbol_);
-  auto ChipQueue = Backend->getActiveDevice()->getDefaultQueue();
   auto Status = hipMemcpyFromSymbolAsyncInternal(Dst_, Symbol_, SizeBytes_,
-                                                 Offset_, Kind_, ChipQueue);
-  if (Status == hipSuccess)
-    ChipQueue->finish();
+                                                 Offset_, Kind_, Queue);
   if (Status != hipSuccess)
     CHIPERR_LOG_AND_THROW("Error enountered while executing a graph node",
                           hipErrorTbd);
@@ -418,16 +953,54 @@ void CHIPGraphNodeMemcpyFromSymbol::execute(chipstar::Queue *Queue) const {
 
 void CHIPGraphNodeMemcpyToSymbol::execute(chipstar::Queue *Queue) const {
   NULLCHECK(Symbol_, Src_);
-  auto ChipQueue = Backend->getActiveDevice()->getDefaultQueue();
   auto Status = hipMemcpyToSymbolAsyncInternal(Symbol_, Src_, SizeBytes_,
-                                               Offset_, Kind_, ChipQueue);
-  if (Status == hipSuccess)
-    ChipQueue->finish();
+                                               Offset_, Kind_, Queue);
   if (Status != hipSuccess)
     CHIPERR_LOG_AND_THROW("Error enountered while executing a graph node",
                           hipErrorTbd);
 }
 
+void *CHIPGraphNodeMemcpyToSymbol::getDstPtr(chipstar::Device *Dev) const {
+  Dev->prepareDeviceVariables(HostPtr(Symbol_));
+  chipstar::DeviceVar *Var = Dev->getGlobalVar(Symbol_);
+  ERROR_IF(!Var, hipErrorInvalidSymbol);
+  if (Offset_ + SizeBytes_ > Var->getSize())
+    CHIPERR_LOG_AND_THROW("Copy has out-of-bounds accesses!",
+                          hipErrorInvalidValue);
+  return static_cast<char *>(Var->getDevAddr()) + Offset_;
+}
+
+void CHIPGraphNodeMemcpyBatch::getCopies(chipstar::Device *Dev,
+                                         std::vector<void *> &Dsts,
+                                         std::vector<const void *> &Srcs,
+                                         std::vector<size_t> &Sizes) const {
+  Dsts.clear();
+  Srcs.clear();
+  Sizes.clear();
+  for (auto Copy : Copies_) {
+    if (Copy->getType() == hipGraphNodeTypeMemcpyToSymbol) {
+      auto ToSymbol = static_cast<CHIPGraphNodeMemcpyToSymbol *>(Copy);
+      Dsts.push_back(ToSymbol->getDstPtr(Dev));
+      Srcs.push_back(ToSymbol->getSrc());
+      Sizes.push_back(ToSymbol->getSizeBytes());
+    } else {
+      auto Memcpy = static_cast<CHIPGraphNodeMemcpy *>(Copy);
+      Dsts.push_back(Memcpy->getDst());
+      Srcs.push_back(Memcpy->getSrc());
+      Sizes.push_back(Memcpy->getCount());
+    }
+  }
+}
+
+void CHIPGraphNodeMemcpyBatch::execute(chipstar::Queue *Queue) const {
+  std::vector<void *> Dsts;
+  std::vector<const void *> Srcs;
+  std::vector<size_t> Sizes;
+  getCopies(Queue->getDevice(), Dsts, Srcs, Sizes);
+  Queue->memCopyBatchAsync(Dsts.data(), Srcs.data(), Sizes.data(),
+                           Dsts.size());
+}
+
 void CHIPGraphNodeWaitEvent::execute(chipstar::Queue *Queue) const {
   // current HIP API requires Flags
   unsigned int Flags = 0;
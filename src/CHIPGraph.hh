@@ -40,6 +40,7 @@
 #include "macros.hh"
 
 namespace chipstar {
+class Device;
 class Queue;
 class Event;
 class ExecItem;
@@ -74,17 +75,6 @@ public:
   hipGraphNodeType getType() { return Type_; }
   virtual CHIPGraphNode *clone() const = 0;
 
-  /**
-   * @brief Depth-first search of the graph.
-   * For each node, the function is called recursively on all of its
-   * dependencies. Returns all possible paths from this node to root node.
-   *
-   * @param CurrPath space for the current path
-   * @param Paths space for the paths
-   */
-  void DFS(std::vector<CHIPGraphNode *> CurrPath,
-           std::vector<std::vector<CHIPGraphNode *>> &Paths);
-
   /**
    * @brief Pure virtual method to be overriden by derived classes. This method
    * gets called during graph execution.
@@ -93,6 +83,14 @@ public:
    */
   virtual void execute(chipstar::Queue *Queue) const = 0;
 
+  /**
+   * @brief Take over the parameters of another node of the same type. The
+   * dependencies of this node are kept. Used by hipGraphExecUpdate().
+   *
+   * @param Other node to copy the parameters from
+   */
+  virtual void updateParams(const CHIPGraphNode &Other) {}
+
   /**
    * @brief Add a dependant to a node.
    *
@@ -242,6 +240,20 @@ public:
     return;
   }
 
+  /**
+   * @brief Remove a dependant from a node.
+   *
+   * Visualizing the graph, remove an edge going up.
+   *
+   * @param TheNode
+   */
+  void removeDependant(CHIPGraphNode *TheNode) {
+    auto FoundNode =
+        std::find(Dependendants_.begin(), Dependendants_.end(), TheNode);
+    if (FoundNode != Dependendants_.end())
+      Dependendants_.erase(FoundNode);
+  }
+
   /**
    * @brief Get the Dependencies object
    *  nodes which depend on this node
@@ -262,7 +274,13 @@ public:
 class CHIPGraphNodeKernel : public CHIPGraphNode {
 private:
   hipKernelNodeParams Params_;
-  chipstar::ExecItem *ExecItem_;
+  std::shared_ptr<chipstar::ExecItem> ExecItem_;
+
+  /**
+   * @brief Replace ExecItem_ with a new one for the kernel, configuration
+   * and the given arguments of Params_.
+   */
+  void setupExecItem_(void **Args);
 
 public:
   CHIPGraphNodeKernel(const CHIPGraphNodeKernel &Other);
@@ -278,7 +296,16 @@ public:
 
   hipKernelNodeParams getParams() const { return Params_; }
 
-  void setParams(const hipKernelNodeParams Params) { Params_ = Params; }
+  void setParams(const hipKernelNodeParams Params);
+
+  virtual void updateParams(const CHIPGraphNode &Other) override;
+
+  /// The kernel, configuration and arguments launched by this node
+  chipstar::ExecItem *getExecItem() const { return ExecItem_.get(); }
+  /// The exec item for holding on to it after it's replaced
+  std::shared_ptr<chipstar::ExecItem> shareExecItem() const {
+    return ExecItem_;
+  }
   /**
    * @brief Createa a copy of this node
    * Must copy over all the arguments
@@ -295,10 +322,10 @@ class CHIPGraphNodeMemcpy : public CHIPGraphNode {
 private:
   hipMemcpy3DParms Params_;
 
-  void *Dst_;
-  const void *Src_;
-  size_t Count_;
-  hipMemcpyKind Kind_;
+  void *Dst_ = nullptr;
+  const void *Src_ = nullptr;
+  size_t Count_ = 0;
+  hipMemcpyKind Kind_ = hipMemcpyDefault;
 
 public:
   CHIPGraphNodeMemcpy(const CHIPGraphNodeMemcpy &Other)
@@ -322,6 +349,12 @@ public:
 
   hipMemcpy3DParms getParams() { return Params_; }
 
+  // 1D MemCpy, null pointers if this is a 3D copy
+  void *getDst() const { return Dst_; }
+  const void *getSrc() const { return Src_; }
+  size_t getCount() const { return Count_; }
+  hipMemcpyKind getKind() const { return Kind_; }
+
   // 1D MemCpy
   void setParams(void *Dst, const void *Src, size_t Count, hipMemcpyKind Kind) {
     Dst_ = Dst;
@@ -331,6 +364,9 @@ public:
   }
 
   void setParams(const hipMemcpy3DParms *Params) {
+    Dst_ = nullptr;
+    Src_ = nullptr;
+    Count_ = 0;
     Params_.srcArray = Params->srcArray;
     // if(Params->srcArray)
     // memcpy(Params_.srcArray, Params->srcArray, sizeof(hipArray_t));
@@ -345,6 +381,12 @@ public:
     memcpy(&Params_.kind, &(Params->kind), sizeof(hipMemcpyKind));
   }
 
+  virtual void updateParams(const CHIPGraphNode &Other) override {
+    auto &Node = static_cast<const CHIPGraphNodeMemcpy &>(Other);
+    Params_ = Node.Params_;
+    setParams(Node.Dst_, Node.Src_, Node.Count_, Node.Kind_);
+  }
+
   virtual void execute(chipstar::Queue *Queue) const override;
 
   virtual CHIPGraphNode *clone() const override {
@@ -372,6 +414,17 @@ public:
   hipMemsetParams getParams() { return Params_; }
   void setParams(const hipMemsetParams *Params) { Params_ = *Params; }
 
+  /**
+   * @brief Get the memory written by the node: NumRows rows of RowSize bytes
+   * starting at the destination, Pitch bytes apart. Rows without a gap
+   * between them are reported as one row.
+   */
+  void getExtent(size_t &RowSize, size_t &Pitch, size_t &NumRows) const;
+
+  virtual void updateParams(const CHIPGraphNode &Other) override {
+    Params_ = static_cast<const CHIPGraphNodeMemset &>(Other).Params_;
+  }
+
   virtual void execute(chipstar::Queue *Queue) const override;
   virtual CHIPGraphNode *clone() const override {
     auto NewNode = new CHIPGraphNodeMemset(*this);
@@ -401,6 +454,10 @@ public:
 
   void setParams(const hipHostNodeParams *Params) { Params_ = *Params; }
 
+  virtual void updateParams(const CHIPGraphNode &Other) override {
+    Params_ = static_cast<const CHIPGraphNodeHost &>(Other).Params_;
+  }
+
   hipHostNodeParams getParams() { return Params_; }
 };
 
@@ -470,6 +527,10 @@ public:
 
   chipstar::Event *getEvent() { return Event_; }
   void setEvent(chipstar::Event *Event) { Event_ = Event; }
+
+  virtual void updateParams(const CHIPGraphNode &Other) override {
+    Event_ = static_cast<const CHIPGraphNodeWaitEvent &>(Other).Event_;
+  }
 };
 
 class CHIPGraphNodeEventRecord : public CHIPGraphNode {
@@ -495,6 +556,10 @@ public:
   void setEvent(chipstar::Event *NewEvent) { Event_ = NewEvent; }
 
   chipstar::Event *getEvent() { return Event_; }
+
+  virtual void updateParams(const CHIPGraphNode &Other) override {
+    Event_ = static_cast<const CHIPGraphNodeEventRecord &>(Other).Event_;
+  }
 };
 
 class CHIPGraphNodeMemcpyFromSymbol : public CHIPGraphNode {
@@ -527,13 +592,19 @@ public:
     Symbol_ = const_cast<void *>(Symbol);
     SizeBytes_ = SizeBytes;
     Offset_ = Offset;
-    Kind = Kind_;
+    Kind_ = Kind;
   }
 
   virtual CHIPGraphNode *clone() const override {
     auto NewNode = new CHIPGraphNodeMemcpyFromSymbol(*this);
     return NewNode;
   }
+
+  virtual void updateParams(const CHIPGraphNode &Other) override {
+    auto &Node = static_cast<const CHIPGraphNodeMemcpyFromSymbol &>(Other);
+    setParams(Node.Dst_, Node.Symbol_, Node.SizeBytes_, Node.Offset_,
+              Node.Kind_);
+  }
 };
 
 class CHIPGraphNodeMemcpyToSymbol : public CHIPGraphNode {
@@ -560,18 +631,70 @@ public:
 
   virtual void execute(chipstar::Queue *Queue) const override;
 
+  const void *getSrc() const { return Src_; }
+  size_t getSizeBytes() const { return SizeBytes_; }
+  hipMemcpyKind getKind() const { return Kind_; }
+
+  /**
+   * @brief Get the device address the node copies to on the given device.
+   */
+  void *getDstPtr(chipstar::Device *Dev) const;
+
   virtual CHIPGraphNode *clone() const override {
     auto NewNode = new CHIPGraphNodeMemcpyToSymbol(*this);
     return NewNode;
   }
 
+  virtual void updateParams(const CHIPGraphNode &Other) override {
+    auto &Node = static_cast<const CHIPGraphNodeMemcpyToSymbol &>(Other);
+    setParams(Node.Src_, Node.Symbol_, Node.SizeBytes_, Node.Offset_,
+              Node.Kind_);
+  }
+
   void setParams(void *Src, const void *Symbol, size_t SizeBytes, size_t Offset,
                  hipMemcpyKind Kind) {
     Src_ = Src;
     Symbol_ = const_cast<void *>(Symbol);
     SizeBytes_ = SizeBytes;
     Offset_ = Offset;
-    Kind = Kind_;
+    Kind_ = Kind;
+  }
+};
+
+/**
+ * @brief Independent 1D copies submitted as one batch.
+ *
+ * Created by CHIPGraphExec when it fuses the nodes of an execution plan and
+ * never part of a user graph. The copies are taken from the fused
+ * CHIPGraphNodeMemcpy and CHIPGraphNodeMemcpyToSymbol nodes when the batch is
+ * executed.
+ */
+class CHIPGraphNodeMemcpyBatch : public CHIPGraphNode {
+private:
+  std::vector<CHIPGraphNode *> Copies_;
+
+public:
+  CHIPGraphNodeMemcpyBatch(const CHIPGraphNodeMemcpyBatch &Other)
+      : CHIPGraphNode(Other), Copies_(Other.Copies_) {}
+
+  CHIPGraphNodeMemcpyBatch() : CHIPGraphNode(hipGraphNodeTypeMemcpy) {}
+
+  virtual ~CHIPGraphNodeMemcpyBatch() override {}
+
+  void addCopy(CHIPGraphNode *Node) { Copies_.push_back(Node); }
+
+  /**
+   * @brief Resolve the copies of the batch for execution on the given device.
+   */
+  void getCopies(chipstar::Device *Dev, std::vector<void *> &Dsts,
+                 std::vector<const void *> &Srcs,
+                 std::vector<size_t> &Sizes) const;
+
+  virtual void execute(chipstar::Queue *Queue) const override;
+
+  virtual CHIPGraphNode *clone() const override {
+    auto NewNode = new CHIPGraphNodeMemcpyBatch(*this);
+    return NewNode;
   }
 };
 
@@ -651,54 +774,213 @@ protected:
   CHIPGraph CompiledGraph_;
 
   /**
-   * @brief each element in this queue represents represents a sequence of nodes
-   * that can be submitted to one or more queues
+   * @brief Topology of the graph at instantiation, used by update().
+   *
+   * InstNodes_ holds the top-level nodes of CompiledGraph_ in creation order.
+   * The dependencies of InstNodes_[i] are InstNodes_[InstDeps_[j]] for
+   * InstDepOffsets_[i] <= j < InstDepOffsets_[i + 1], sorted.
+   */
+  std::vector<CHIPGraphNode *> InstNodes_;
+  std::vector<size_t> InstDepOffsets_;
+  std::vector<size_t> InstDeps_;
+
+  /**
+   * @brief Execution plan generated by compile().
+   *
+   * ExecNodes_ holds the nodes of CompiledGraph_ and the nodes created by
+   * fuseNodes_() in a topological order. The dependencies of ExecNodes_[i]
+   * are ExecNodes_[ExecDeps_[j]] for ExecDepOffsets_[i] <= j <
+   * ExecDepOffsets_[i + 1]. ExecLevelOffsets_ splits ExecNodes_ into levels:
+   * the nodes of a level only depend on nodes of previous levels and can be
+   * executed simultaneously in any order.
+   */
+  std::vector<CHIPGraphNode *> ExecNodes_;
+  std::vector<size_t> ExecDepOffsets_;
+  std::vector<size_t> ExecDeps_;
+  std::vector<size_t> ExecLevelOffsets_;
+
+  /**
+   * @brief The pruned execution plan before node fusion, in the format of
+   * ExecNodes_ and its dependencies.
+   *
+   * Kept for fusing the nodes again after their parameters change.
+   */
+  std::vector<CHIPGraphNode *> UnfusedNodes_;
+  std::vector<size_t> UnfusedDepOffsets_;
+  std::vector<size_t> UnfusedDeps_;
+
+  /// Nodes created by fuseNodes_() for the current execution plan.
+  std::vector<std::unique_ptr<CHIPGraphNodeMemset>> FusedMemsets_;
+  std::vector<std::unique_ptr<CHIPGraphNodeMemcpy>> FusedMemcpys_;
+  std::vector<std::unique_ptr<CHIPGraphNodeMemcpyBatch>> FusedBatches_;
+  /// Set when the fused nodes no longer match the parameters of their parts.
+  bool FusionStale_ = false;
+  /// Number of times fuseNodes_() generated the execution plan.
+  size_t NumFusions_ = 0;
+
+  /**
+   * @brief Queue assignment of the execution plan.
+   *
+   * ExecNodes_[i] is executed on the queue slot ExecSlots_[i]: slot 0 is the
+   * launch queue and slot s > 0 is the graph queue s - 1 of the device.
+   * ExecSignals_[i] is set if a node in another slot depends on
+   * ExecNodes_[i]. The completion of such nodes is recorded into
+   * ExecEvents_[i] during a launch.
+   */
+  std::vector<unsigned> ExecSlots_;
+  std::vector<bool> ExecSignals_;
+  unsigned NumSlots_ = 1;
+
+  /// Scratch space of launch(), reused by every launch.
+  std::vector<std::shared_ptr<chipstar::Event>> ExecEvents_;
+  std::vector<std::shared_ptr<chipstar::Event>> WaitEvents_;
+  std::vector<chipstar::Queue *> SlotQueues_;
+  std::mutex LaunchMtx_;
+
+  /**
+   * @brief Backend-native recording of the execution plan.
    *
+   * Recorded on a launch into NativeQueue_ and replayed by subsequent
+   * launches into the same queue. Null if the backend couldn't record the
+   * plan for NativeQueue_.
+   */
+  std::unique_ptr<chipstar::NativeGraph> NativeGraph_;
+  chipstar::Queue *NativeQueue_ = nullptr;
+  /// The exec items of the kernel nodes recorded into NativeGraph_. Node
+  /// updates replace the exec items of the nodes, these are kept until the
+  /// recording is dropped.
+  std::vector<std::shared_ptr<chipstar::ExecItem>> NativeExecItems_;
+
+  /// Drop the native recording after its launches have completed.
+  void resetNativeGraph_();
+
+  /**
+   * @brief Record the execution plan into NativeGraph_ for launches into
+   * Queue.
    */
-  std::queue<std::set<CHIPGraphNode *>> ExecQueues_;
+  void recordNative_(chipstar::Queue *Queue);
 
   /**
    * @brief For every CHIPGraphNodeGraph in CompiledGraph_, replace this node
-   * with its contents.
+   * with a clone of its contents.
    *
    */
   void ExtractSubGraphs_();
 
   /**
-   * @brief remove unnecessary dependencies
-   * for leaf node in graph:
-   *   for each dependency in node:
-   *     1. traverse from node to root, constructing a vector of nodes visited
-   *   for each traversal vector:
-   *     1. traverse from node to root, constructing a vector of nodes visited
+   * @brief Order the nodes of CompiledGraph_ using Kahn's algorithm
    *
+   * Fills ExecNodes_, ExecLevelOffsets_ and the dependencies of the plan,
+   * with duplicate edges removed. O(nodes + edges).
+   */
+  void sortTopologically_();
+
+  /**
+   * @brief remove unnecessary dependencies
    *
+   * Computes the transitive reduction of the plan: an edge to a dependency is
+   * dropped if the dependency is also reachable through another dependency.
+   * The reachable nodes of every node are kept as a bitset, built in
+   * topological order. O(edges * nodes / 64).
    */
   void pruneGraph_();
 
+  /**
+   * @brief Generate the execution plan from the unfused plan by fusing nodes
+   *
+   * A memset or 1D memcpy node which is the only dependant of its only
+   * dependency is merged into it if they write one contiguous (or evenly
+   * pitched) region and, for copies, read one contiguous region. Small
+   * independent 1D copies with the same dependencies are collected into a
+   * CHIPGraphNodeMemcpyBatch. The nodes of the plan are sorted into levels
+   * again. Disabled by CHIP_GRAPH_FUSION=off. O(nodes + edges).
+   */
+  void fuseNodes_();
+
+  /**
+   * @brief Assign the nodes of the plan to queue slots.
+   *
+   * Chains of dependent nodes stay on one slot and independent chains are
+   * spread over up to CHIP_GRAPH_QUEUES + 1 slots. Dependencies between
+   * slots are turned into event waits at launch.
+   */
+  void scheduleQueues_();
+
+  /**
+   * @brief Optimize CompiledGraph_ and generate the execution plan
+   *
+   * This method will first record the instantiated topology, flatten the
+   * child graphs, sort the nodes into levels, call pruneGraph_ and
+   * fuseNodes_ and then assign the nodes to queues. Called once, when the
+   * graph is instantiated.
+   * @see pruneGraph_
+   * @see fuseNodes_
+   *
+   */
+  void compile();
+
 public:
   CHIPGraphExec(CHIPGraph *Graph)
       : OriginalGraph_(Graph), /* Copy the pointer to the original graph */
         CompiledGraph_(CHIPGraph(*Graph)) /* invoke the copy constructor to make
                                              a clone of the graph */
-  {}
+  {
+    compile();
+  }
 
-  ~CHIPGraphExec() {}
+  ~CHIPGraphExec() { resetNativeGraph_(); }
 
+  /**
+   * @brief Enqueue the nodes of the execution plan into the given queue.
+   *
+   * Independent branches may be enqueued into the graph queues of the
+   * device. These start after the work already submitted to the given queue
+   * and are joined back into it, so the last event of the given queue marks
+   * the completion of the graph. If the backend supports it, the plan is
+   * instead recorded on the first launch into the queue and the recording is
+   * submitted as a whole. Does not wait for the nodes to complete.
+   */
   void launch(chipstar::Queue *Queue);
 
-  CHIPGraph *getOriginalGraphPtr() const { return OriginalGraph_; }
-
   /**
-   * @brief Optimize and generate ExecQueues_
+   * @brief Update the instantiated nodes in place with the parameters of the
+   * nodes of Graph.
    *
-   * This method will first call PruneGraph and then generate an executable
-   * queue. Executable queue is made up of sets of nodes. All members of the
-   * aforementioned set can be executed simultanously in no particular order.
-   * @see PruneGraph
+   * The nodes are paired by their creation order and Graph must have the
+   * topology of the instantiated graph. The native recording is dropped and
+   * recorded again on the next launch. The nodes are fused again only if the
+   * parameters of a memset or copy node changed. Nothing is updated on
+   * failure.
    *
+   * @param Graph graph to take the parameters from
+   * @param ErrorNode set to the node of Graph which prevents the update, if
+   * any
+   * @return hipGraphExecUpdateSuccess or the reason of the failure
    */
-  void compile();
+  hipGraphExecUpdateResult update(CHIPGraph *Graph, CHIPGraphNode *&ErrorNode);
+
+  /**
+   * @brief Change the parameters of the instantiated node Node.
+   *
+   * SetParams is called under the launch lock. The native recording can't be
+   * patched in place: it is dropped and the next launch records the plan
+   * again. The nodes are fused again as well if Node is a memset or copy.
+   */
+  void updateNode(CHIPGraphNode *Node, const std::function<void()> &SetParams);
+
+  CHIPGraph *getOriginalGraphPtr() const { return OriginalGraph_; }
+
+  /// Number of nodes in the execution plan after the node fusion
+  size_t getNumExecNodes() const { return ExecNodes_.size(); }
+
+  /// Number of times the execution plan was generated by the node fusion
+  size_t getNumFusions() const { return NumFusions_; }
+
+  /**
+   * @brief Get the instantiated clone of the original graph. Its nodes are
+   * the ones executed by launch().
+   */
+  CHIPGraph *getCompiledGraphPtr() { return &CompiledGraph_; }
 };
 
 #endif // include guard
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2023 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Host side of the printf ring buffer (see CHIPPrintf.hh).
+
+#include "CHIPPrintf.hh"
+
+#include "Utils.hh"
+#include "logging.hh"
+#include "macros.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+namespace chipstar {
+
+/// The conversion characters ending a conversion specification. The device
+/// side (_chip_printf_str_args()) must scan the specifications the same way.
+static constexpr char Conversions[] = "diouxXcsfFeEgGaApn";
+
+namespace {
+/// Reads the items of a printf record.
+class RecordReader {
+  const uint32_t *Pos_;
+  const uint32_t *End_;
+
+public:
+  RecordReader(const uint32_t *Words, size_t NumWords)
+      : Pos_(Words), End_(Words + NumWords) {}
+
+  bool read(uint32_t &Value) {
+    if (Pos_ == End_)
+      return false;
+    Value = *Pos_++;
+    return true;
+  }
+
+  bool read(uint64_t &Value) {
+    uint32_t Lo, Hi;
+    if (!read(Lo) || !read(Hi))
+      return false;
+    Value = static_cast<uint64_t>(Hi) << 32 | Lo;
+    return true;
+  }
+
+  /// Read a string item. 'IsNull' is set for null pointers.
+  bool read(std::string &Str, bool &IsNull) {
+    uint32_t Len;
+    if (!read(Len))
+      return false;
+    IsNull = Len == PrintfBuffer::NullString;
+    if (IsNull)
+      return true;
+    size_t NumWords = roundUp(Len, sizeof(uint32_t)) / sizeof(uint32_t);
+    if (NumWords > static_cast<size_t>(End_ - Pos_))
+      return false;
+    Str.assign(reinterpret_cast<const char *>(Pos_), Len);
+    Pos_ += NumWords;
+    return true;
+  }
+};
+} // namespace
+
+/// Append 'Value' formatted by the single conversion specification 'Spec'.
+template <typename T>
+static void appendFormatted(std::string &Out, const std::string &Spec,
+                            T Value) {
+  int Len = std::snprintf(nullptr, 0, Spec.c_str(), Value);
+  if (Len <= 0)
+    return;
+  size_t Start = Out.size();
+  Out.resize(Start + Len + 1);
+  std::snprintf(&Out[Start], Len + 1, Spec.c_str(), Value);
+  Out.resize(Start + Len);
+}
+
+size_t PrintfBuffer::getStorageSize(size_t MinBytes) {
+  size_t Capacity =
+      roundUpToPowerOfTwo(std::max<size_t>(MinBytes / sizeof(uint32_t), 1024));
+  return (NumHeaderWords + Capacity) * sizeof(uint32_t);
+}
+
+PrintfBuffer::PrintfBuffer(void *Storage, size_t StorageSize,
+                           std::string Formats)
+    : Words_(static_cast<uint32_t *>(Storage)),
+      Capacity_(StorageSize / sizeof(uint32_t) - NumHeaderWords),
+      Formats_(std::move(Formats)) {
+  assert(Capacity_ && (Capacity_ & (Capacity_ - 1)) == 0 &&
+         "The capacity must be a power of two.");
+  Words_[CapacityWord] = Capacity_;
+}
+
+std::string PrintfBuffer::drain() {
+  LOCK(Mtx_); // PrintfBuffer::ReadPos_
+  std::string Out;
+  uint32_t *Data = Words_ + NumHeaderWords;
+  uint32_t Mask = Capacity_ - 1;
+  while (true) {
+    uint32_t Off = ReadPos_ & Mask;
+    // The header is written last by the device, after the rest of the
+    // record.
+    uint32_t Header = __atomic_load_n(&Data[Off], __ATOMIC_ACQUIRE);
+    if (!Header)
+      break;
+    uint32_t NumWords = Header & 0xffffff;
+    if (!NumWords || Off + NumWords > Capacity_) {
+      logError("Corrupted printf buffer record at {}", Off);
+      break;
+    }
+    if (Header >> 24 == Printf)
+      formatRecord(&Data[Off + 1], NumWords - 1, Out);
+    std::memset(&Data[Off], 0, NumWords * sizeof(uint32_t));
+    ReadPos_ += NumWords;
+    __atomic_store_n(&Words_[ReadPosWord], ReadPos_, __ATOMIC_RELEASE);
+  }
+
+  if (auto Dropped = __atomic_exchange_n(&Words_[DroppedWord], 0u,
+                                         __ATOMIC_RELAXED))
+    logWarn("{} printf() calls dropped due to a full printf buffer. "
+            "Increase CHIP_PRINTF_BUFFER_SIZE.",
+            Dropped);
+  return Out;
+}
+
+void PrintfBuffer::formatRecord(const uint32_t *Words, size_t NumWords,
+                                std::string &Out) const {
+  RecordReader Args(Words, NumWords);
+  uint32_t FmtOffset;
+  if (!Args.read(FmtOffset))
+    return;
+  std::string InlineFmt;
+  std::string_view Fmt;
+  if (FmtOffset == InlineFormat) {
+    bool IsNull;
+    if (!Args.read(InlineFmt, IsNull) || IsNull)
+      return;
+    Fmt = InlineFmt;
+  } else if (FmtOffset < Formats_.size()) {
+    Fmt = Formats_.c_str() + FmtOffset;
+  } else {
+    logError("Invalid printf format offset {}", FmtOffset);
+    return;
+  }
+
+  for (size_t I = 0; I < Fmt.size(); I++) {
+    if (Fmt[I] != '%') {
+      Out += Fmt[I];
+      continue;
+    }
+    if (I + 1 < Fmt.size() && Fmt[I + 1] == '%') {
+      Out += '%';
+      I++;
+      continue;
+    }
+    size_t End = Fmt.find_first_of(Conversions, I + 1);
+    if (End == std::string_view::npos) {
+      Out.append(Fmt.substr(I));
+      return;
+    }
+
+    // Rebuild the specification for the host with the '*' widths and
+    // precisions substituted and the length modifiers normalized.
+    std::string Spec = "%";
+    bool Is64Bit = false;
+    for (size_t J = I + 1; J < End; J++) {
+      char C = Fmt[J];
+      if (C == '*') {
+        uint32_t Value;
+        if (!Args.read(Value))
+          return;
+        // A negative precision is taken as if it was omitted.
+        if (Spec.back() == '.' && static_cast<int32_t>(Value) < 0)
+          Spec.pop_back();
+        else
+          Spec += std::to_string(static_cast<int32_t>(Value));
+      } else if (C == 'l' || C == 'z' || C == 'j' || C == 't') {
+        Is64Bit = true;
+      } else if (C != 'L') {
+        Spec += C;
+      }
+    }
+    char Conv = Fmt[End];
+    I = End;
+
+    switch (Conv) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'c': {
+      bool IsSigned = Conv == 'd' || Conv == 'i';
+      if (Is64Bit && Conv != 'c') {
+        uint64_t Value;
+        if (!Args.read(Value))
+          return;
+        Spec += "ll";
+        Spec += Conv;
+        if (IsSigned)
+          appendFormatted(Out, Spec, static_cast<long long>(Value));
+        else
+          appendFormatted(Out, Spec, static_cast<unsigned long long>(Value));
+      } else {
+        uint32_t Value;
+        if (!Args.read(Value))
+          return;
+        Spec += Conv;
+        if (IsSigned || Conv == 'c')
+          appendFormatted(Out, Spec, static_cast<int>(Value));
+        else
+          appendFormatted(Out, Spec, static_cast<unsigned>(Value));
+      }
+      break;
+    }
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': {
+      uint64_t Bits;
+      if (!Args.read(Bits))
+        return;
+      double Value;
+      std::memcpy(&Value, &Bits, sizeof(Value));
+      Spec += Conv;
+      appendFormatted(Out, Spec, Value);
+      break;
+    }
+    case 'p': {
+      uint64_t Value;
+      if (!Args.read(Value))
+        return;
+      Spec += Conv;
+      appendFormatted(Out, Spec,
+                      reinterpret_cast<void *>(static_cast<uintptr_t>(Value)));
+      break;
+    }
+    case 's': {
+      std::string Str;
+      bool IsNull;
+      if (!Args.read(Str, IsNull))
+        return;
+      Spec += Conv;
+      appendFormatted(Out, Spec, IsNull ? "(null)" : Str.c_str());
+      break;
+    }
+    case 'n': {
+      // Nothing is written back to the device.
+      uint64_t Ignored;
+      if (!Args.read(Ignored))
+        return;
+      break;
+    }
+    }
+  }
+}
+
+} // namespace chipstar
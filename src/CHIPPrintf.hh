@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2023 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SRC_CHIP_PRINTF_H
+#define SRC_CHIP_PRINTF_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace chipstar {
+
+/// A ring buffer through which kernels pass their printf() calls to the host
+/// as binary records for formatting them on the host.
+///
+/// The storage consists of a header followed by the data words. The
+/// kernels reserve space for records by advancing the free-running write
+/// position and the host consumes them by advancing the free-running read
+/// position. The host formats the records whose header word has been
+/// written and clears them for reuse. The device side of this is in
+/// bitcode/_chip_printf_buffer.cl and the records are emitted by
+/// HipPrintf.cpp.
+///
+/// A record starts with a header word carrying the record size in words
+/// (bits 0-23) and a RecordKind (bits 24-31). A printf record continues with
+/// the offset of its format string in the format table of the module, or
+/// InlineFormat followed by the format string, and the arguments:
+///
+///   * 32-bit integers as one word,
+///   * 64-bit integers, doubles and pointers as two words (low word first)
+///   * strings of %s conversions as their length in bytes (or NullString)
+///     followed by the bytes padded to the word boundary.
+class PrintfBuffer {
+public:
+  /// Words of the storage header.
+  enum HeaderWord : unsigned {
+    WritePosWord,
+    ReadPosWord,
+    CapacityWord,
+    DroppedWord,
+    NumHeaderWords
+  };
+  enum RecordKind : uint32_t { Padding = 1, Printf = 2 };
+  static constexpr uint32_t InlineFormat = ~0u;
+  static constexpr uint32_t NullString = ~0u;
+
+  /// Return the storage size in bytes for a buffer holding at least MinBytes
+  /// of records.
+  static size_t getStorageSize(size_t MinBytes);
+
+  /// Construct a buffer on zero-initialized, host and device accessible
+  /// 'Storage' of 'StorageSize' bytes given by getStorageSize(). 'Formats'
+  /// are the nul-separated format strings of the module.
+  PrintfBuffer(void *Storage, size_t StorageSize, std::string Formats);
+
+  void *getStorage() const { return Words_; }
+
+  /// Format the completed records and return the output. The records of
+  /// running kernels are left for later calls.
+  std::string drain();
+
+private:
+  std::mutex Mtx_;
+  uint32_t *Words_;
+  uint32_t Capacity_;
+  uint32_t ReadPos_ = 0;
+  std::string Formats_;
+
+  void formatRecord(const uint32_t *Words, size_t NumWords,
+                    std::string &Out) const;
+};
+
+} // namespace chipstar
+
+#endif
@@ -79,6 +79,10 @@ class SPVFuncInfo {
   /// index (key) and argument size (value).
   std::map<uint16_t, uint16_t> SpilledArgs_;
 
+  /// False if the kernel is known to access memory only through its
+  /// pointer arguments (see HipIndirectAccess.cpp).
+  bool MayHaveIndirectAccess_ = true;
+
 public:
   /// A structure for argument info passed by the visitor methods.
   struct Arg : SPVArgTypeInfo {
@@ -121,6 +125,10 @@ public:
   /// Return true is any argument is passed via intermediate buffer.
   bool hasByRefArgs() const { return SpilledArgs_.size(); }
 
+  /// Return true if the kernel may access allocations through pointers
+  /// not passed as kernel arguments (e.g. pointers loaded from memory).
+  bool mayHaveIndirectAccess() const { return MayHaveIndirectAccess_; }
+
 private:
   void visitClientArgsImpl(const std::vector<void *> &ArgList,
                            ClientArgVisitor Fn) const;
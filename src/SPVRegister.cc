@@ -88,9 +88,10 @@ void SPVRegister::bindVariable(SPVRegister::Handle Handle, HostPtr Ptr,
       // Host pointer should be associated with one source module and variable
       // at most.
       (!HostPtrLookup_.count(Ptr)) ||
-      // A variable made for abort() implementation is an exception to this due
-      // to the way it's modeled.
-      (Name == ChipDeviceAbortFlagName && HostPtrLookup_[Ptr]->Name == Name) &&
+      // The variables made for abort() and printf() implementation are an
+      // exception to this due to the way they are modeled.
+      ((Name == ChipDeviceAbortFlagName || Name == ChipPrintfBufferVarName) &&
+       HostPtrLookup_[Ptr]->Name == Name) &&
           "Host-pointer is already mapped.");
 
   if (Name == ChipDeviceAbortFlagName) {
@@ -98,6 +99,11 @@ void SPVRegister::bindVariable(SPVRegister::Handle Handle, HostPtr Ptr,
       return; // Ignore duplicate abort flag variable.
     SrcMod->HasAbortFlag = true;
   }
+  if (Name == ChipPrintfBufferVarName) {
+    if (SrcMod->HasPrintfBuffer)
+      return; // Ignore duplicate printf buffer variable.
+    SrcMod->HasPrintfBuffer = true;
+  }
 
   SrcMod->Variables.emplace_back(SPVVariable{{SrcMod, Ptr, Name}, Size});
   HostPtrLookup_.emplace(std::make_pair(Ptr, &SrcMod->Variables.back()));
@@ -152,10 +158,10 @@ SPVModule *SPVRegister::getFinalizedSource(SPVModule *SrcMod) {
   //       into smaller independent ones (is possible) for reducing
   //       compilation time in the backend.
 
-  bool Success =
-      filterSPIRV(SrcMod->OriginalBinary_.data(),
-                  SrcMod->OriginalBinary_.size(), SrcMod->FinalizedBinary_);
-  assert(Success && "SPIRV post processing failed!");
+  SrcMod->Valid_ = filterSPIRV(
+      SrcMod->OriginalBinary_.data(), SrcMod->OriginalBinary_.size(),
+      SrcMod->FinalizedBinary_, SrcMod->FuncInfos_, &SrcMod->Imports_);
+  assert(SrcMod->Valid_ && "SPIRV post processing failed!");
   // Can't be empty. There should be at least a SPIR-V header.
   assert(SrcMod->FinalizedBinary_.size() && "Empty finalized source");
   return SrcMod;
@@ -26,7 +26,9 @@ THE SOFTWARE.
 #define SRC_SPVREGISTER_HH
 
 #include "Utils.hh"
+#include "SPIRVFuncInfo.hh"
 
+#include <string>
 #include <string_view>
 #include <memory>
 #include <set>
@@ -35,6 +37,7 @@ THE SOFTWARE.
 #include <optional>
 #include <cassert>
 #include <list>
+#include <vector>
 #include <mutex>
 
 class SPVModule;
@@ -76,17 +79,39 @@ class SPVModule {
   /// post-processing step has not been performed (yet).
   std::string FinalizedBinary_;
 
+  /// Kernel info collected while finalizing the source.
+  OpenCLFunctionInfoMap FuncInfos_;
+  /// Symbols the finalized source expects other modules to define.
+  std::vector<std::string> Imports_;
+  /// True if the finalized source was parsed successfully.
+  bool Valid_ = false;
+
 public:
   // Using lists for iterator stability.
   std::list<SPVFunction> Kernels;
   std::list<SPVVariable> Variables;
   /// True if the module has flag variable for signaling device side abort.
   bool HasAbortFlag = false;
+  /// True if the module has a variable for the printf buffer.
+  bool HasPrintfBuffer = false;
 
   std::string_view getBinary() const {
     assert(FinalizedBinary_.size() && "Has not finalized yet!");
     return FinalizedBinary_;
   }
+
+  /// Kernel info of the finalized source.
+  const OpenCLFunctionInfoMap &getFuncInfos() const {
+    assert(FinalizedBinary_.size() && "Has not finalized yet!");
+    return FuncInfos_;
+  }
+
+  /// Names of the symbols imported by the finalized source.
+  const std::vector<std::string> &getImports() const {
+    assert(FinalizedBinary_.size() && "Has not finalized yet!");
+    return Imports_;
+  }
+  bool isValid() const { return Valid_; }
 };
 
 class SPVRegister {
@@ -217,6 +217,25 @@ std::string_view extractSPIRVModule(const void *Bundle, std::string &ErrorMsg) {
   return std::string_view();
 }
 
+std::string createSPIRVBundle(std::string_view SPIRV) {
+  std::string_view EntryID = "hip-spirv64-unknown-unknown-";
+  std::string Bundle(CLANG_OFFLOAD_BUNDLER_MAGIC);
+  auto Append = [&](uint64_t Value) {
+    Bundle.append(reinterpret_cast<const char *>(&Value), sizeof(Value));
+  };
+
+  size_t HeaderSize = Bundle.size() + 4 * sizeof(uint64_t) + EntryID.size();
+  size_t Offset = roundUp(HeaderSize, sizeof(uint64_t));
+  Append(1); // numBundles.
+  Append(Offset);
+  Append(SPIRV.size());
+  Append(EntryID.size());
+  Bundle.append(EntryID);
+  Bundle.resize(Offset, '\0');
+  Bundle.append(SPIRV);
+  return Bundle;
+}
+
 std::vector<void *>
 convertExtraArgsToPointerArray(void *ExtraArgBuf, const SPVFuncInfo &FuncInfo) {
   auto *BaseAddr = (uint8_t *)ExtraArgBuf;
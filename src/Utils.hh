@@ -86,6 +86,10 @@ std::optional<fs::path> getHIPCCPath();
 std::string_view extractSPIRVModule(const void *ClangOffloadBundle,
                                     std::string &ErrorMsg);
 
+/// Return a clang offload bundle holding the 'SPIRV' module as its only
+/// entry. This is the inverse of extractSPIRVModule().
+std::string createSPIRVBundle(std::string_view SPIRV);
+
 /// Convert "extra" kernel argument passing style to pointer array
 /// style (an array of pointers to the arguments).
 std::vector<void *> convertExtraArgsToPointerArray(void *ExtraArgBuf,
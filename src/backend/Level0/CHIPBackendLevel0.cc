@@ -1151,8 +1151,9 @@ CHIPQueueLevel0::launchImpl(chipstar::ExecItem *ExecItem) {
 
   // Do we need to annotate indirect buffer accesses?
   auto *LzDev = static_cast<CHIPDeviceLevel0 *>(getDevice());
-  if (!LzDev->hasOnDemandPaging()) {
-    // The baseline answer is yes (unless we would know that the
+  if (!LzDev->hasOnDemandPaging() &&
+      ChipKernel->getFuncInfo()->mayHaveIndirectAccess()) {
+    // The baseline answer is yes (unless the compiler has proven that the
     // kernel won't access buffers indirectly).
     auto Status = zeKernelSetIndirectAccess(
         KernelZe, ZE_KERNEL_INDIRECT_ACCESS_FLAG_DEVICE |
@@ -1358,6 +1359,96 @@ hipError_t CHIPQueueLevel0::getBackendHandles(uintptr_t *NativeInfo,
   return hipSuccess;
 }
 
+std::shared_ptr<chipstar::Event>
+CHIPQueueLevel0::memPrefetchImpl(const void *Ptr, size_t Count, bool ToHost) {
+  // Level Zero only prefetches toward the device of the command list.
+  if (ToHost)
+    return enqueueMarkerImpl();
+
+  std::shared_ptr<chipstar::Event> PrefetchEvent =
+      static_cast<CHIPBackendLevel0 *>(Backend)->createEventShared(
+          ChipContext_);
+
+  LOCK(CommandListMtx);
+  ze_command_list_handle_t CommandList = this->getCmdList();
+  // The application must not call this function from
+  // simultaneous threads with the same command list handle.
+  // Done via LOCK(CommandListMtx)
+  auto EventHandles = addDependenciesQueueSync(PrefetchEvent);
+  ze_result_t Status;
+  if (EventHandles.size()) {
+    Status = zeCommandListAppendWaitOnEvents(CommandList, EventHandles.size(),
+                                             EventHandles.data());
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  }
+  // The prefetch takes no events. The barrier orders the signal after it.
+  Status = zeCommandListAppendMemoryPrefetch(CommandList, Ptr, Count);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListAppendBarrier(
+      CommandList,
+      std::static_pointer_cast<CHIPEventLevel0>(PrefetchEvent)->peek(), 0,
+      nullptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  executeCommandList(CommandList, PrefetchEvent);
+
+  return PrefetchEvent;
+}
+
+std::shared_ptr<chipstar::Event>
+CHIPQueueLevel0::memAdviseImpl(const void *Ptr, size_t Count,
+                               hipMemoryAdvise Advice, bool ToHost) {
+  ze_memory_advice_t ZeAdvice;
+  switch (Advice) {
+  case hipMemAdviseSetReadMostly:
+    ZeAdvice = ZE_MEMORY_ADVICE_SET_READ_MOSTLY;
+    break;
+  case hipMemAdviseUnsetReadMostly:
+    ZeAdvice = ZE_MEMORY_ADVICE_CLEAR_READ_MOSTLY;
+    break;
+  case hipMemAdviseSetPreferredLocation:
+    // Level Zero has no hint for preferring the host.
+    if (ToHost)
+      return nullptr;
+    ZeAdvice = ZE_MEMORY_ADVICE_SET_PREFERRED_LOCATION;
+    break;
+  case hipMemAdviseUnsetPreferredLocation:
+    ZeAdvice = ZE_MEMORY_ADVICE_CLEAR_PREFERRED_LOCATION;
+    break;
+  default:
+    // Accessed-by has no Level Zero equivalent: shared allocations are
+    // always accessible from the host and the device of the context.
+    return nullptr;
+  }
+
+  std::shared_ptr<chipstar::Event> AdviseEvent =
+      static_cast<CHIPBackendLevel0 *>(Backend)->createEventShared(
+          ChipContext_);
+
+  LOCK(CommandListMtx);
+  ze_command_list_handle_t CommandList = this->getCmdList();
+  // The application must not call this function from
+  // simultaneous threads with the same command list handle.
+  // Done via LOCK(CommandListMtx)
+  auto EventHandles = addDependenciesQueueSync(AdviseEvent);
+  ze_result_t Status;
+  if (EventHandles.size()) {
+    Status = zeCommandListAppendWaitOnEvents(CommandList, EventHandles.size(),
+                                             EventHandles.data());
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  }
+  Status = zeCommandListAppendMemAdvise(CommandList, ZeDev_, Ptr, Count,
+                                        ZeAdvice);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListAppendBarrier(
+      CommandList,
+      std::static_pointer_cast<CHIPEventLevel0>(AdviseEvent)->peek(), 0,
+      nullptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  executeCommandList(CommandList, AdviseEvent);
+
+  return AdviseEvent;
+}
+
 std::shared_ptr<chipstar::Event> CHIPQueueLevel0::enqueueMarkerImpl() {
 
   std::shared_ptr<chipstar::Event> MarkerEvent =
@@ -1522,6 +1613,44 @@ CHIPQueueLevel0::memCopyAsyncImpl(void *Dst, const void *Src, size_t Size) {
   return MemCopyEvent;
 }
 
+std::shared_ptr<chipstar::Event>
+CHIPQueueLevel0::memCopyBatchAsyncImpl(void *const *Dsts,
+                                       const void *const *Srcs,
+                                       const size_t *Sizes, size_t Count) {
+  logTrace("CHIPQueueLevel0::memCopyBatchAsync {} copies", Count);
+  CHIPContextLevel0 *ChipCtxZe = (CHIPContextLevel0 *)ChipContext_;
+  std::shared_ptr<chipstar::Event> MemCopyEvent =
+      static_cast<CHIPBackendLevel0 *>(Backend)->createEventShared(ChipCtxZe);
+  ze_result_t Status;
+  LOCK(CommandListMtx);
+  ze_command_list_handle_t CommandList = this->getCmdList();
+  // The application must not call this function from simultaneous threads with
+  // the same command list handle
+  // Done via LOCK(CommandListMtx)
+  auto EventHandles = addDependenciesQueueSync(MemCopyEvent);
+  // The copies of a batch are independent of each other so they are
+  // appended without signal events and may execute concurrently. The
+  // trailing barrier signals the completion of the whole batch.
+  for (size_t i = 0; i < Count; i++) {
+    if (!Sizes[i])
+      continue;
+    Status = zeCommandListAppendMemoryCopy(CommandList, Dsts[i], Srcs[i],
+                                           Sizes[i], nullptr,
+                                           EventHandles.size(),
+                                           EventHandles.data());
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS,
+                                hipErrorInitializationError);
+  }
+  Status = zeCommandListAppendBarrier(
+      CommandList,
+      std::static_pointer_cast<CHIPEventLevel0>(MemCopyEvent)->peek(),
+      EventHandles.size(), EventHandles.data());
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  executeCommandList(CommandList, MemCopyEvent);
+
+  return MemCopyEvent;
+}
+
 void CHIPQueueLevel0::finish() {
 #ifdef CHIP_DUBIOUS_LOCKS
   LOCK(Backend->DubiousLockLevel0)
@@ -1608,8 +1737,281 @@ void CHIPQueueLevel0::executeCommandListImm(
   updateLastEvent(Event);
 };
 
+chipstar::NativeGraph *CHIPQueueLevel0::createNativeGraph() {
+  return new CHIPNativeGraphLevel0(this);
+}
+
+std::shared_ptr<chipstar::Event>
+CHIPQueueLevel0::enqueueNativeGraphImpl(chipstar::NativeGraph *Graph) {
+  auto *GraphLz = static_cast<CHIPNativeGraphLevel0 *>(Graph);
+  std::shared_ptr<chipstar::Event> GraphEvent =
+      static_cast<CHIPBackendLevel0 *>(Backend)->createEventShared(
+          ChipContext_);
+  GraphEvent->Msg = "graph";
+  auto GraphEventLz = std::static_pointer_cast<CHIPEventLevel0>(GraphEvent);
+
+  LOCK(CommandListMtx); // CHIPQueueLevel0::ZeCmdListImm_
+  // The recording executes on the command queue which is not ordered with
+  // the immediate command list, so it waits for the last event explicitly.
+  auto EventHandles = addDependenciesQueueSync(GraphEvent);
+  if (auto LastEvent = getLastEvent()) {
+    EventHandles.push_back(
+        std::static_pointer_cast<CHIPEventLevel0>(LastEvent)->peek());
+    GraphEvent->addDependency(LastEvent);
+  }
+
+  // Start the recording after the dependencies and signal the launch event
+  // once it is done.
+  ze_command_list_handle_t CmdLists[3] = {ChipCtxLz_->getCmdListReg(),
+                                          GraphLz->getCmdList(),
+                                          ChipCtxLz_->getCmdListReg()};
+  auto Status =
+      zeCommandListAppendBarrier(CmdLists[0], GraphLz->getStartEvent(),
+                                 EventHandles.size(), EventHandles.data());
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListClose(CmdLists[0]);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  ze_event_handle_t DoneHandle = GraphLz->getDoneEvent();
+  Status = zeCommandListAppendBarrier(CmdLists[2], GraphEventLz->peek(), 1,
+                                      &DoneHandle);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListClose(CmdLists[2]);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+
+  Status = zeFenceReset(ZeFence_);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandQueueExecuteCommandLists(ZeCmdQ_, 3, CmdLists, ZeFence_);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+
+  // Recycle the two pooled command lists once the launch has completed
+  GraphEventLz->assignCmdList(ChipCtxLz_, CmdLists[2]);
+  CHIPContextLevel0 *ChipCtxLz = ChipCtxLz_;
+  ze_command_list_handle_t StartCmdList = CmdLists[0];
+  GraphEventLz->addAction([=]() -> void {
+    zeCommandListReset(StartCmdList);
+    ChipCtxLz->returnCmdList(StartCmdList);
+  });
+
+  if (ChipEnvVars.getL0ImmCmdLists()) {
+    // Commands appended to the immediate command list later follow the graph
+    ze_event_handle_t GraphEventHandle = GraphEventLz->peek();
+    Status = zeCommandListAppendBarrier(ZeCmdListImm_, nullptr, 1,
+                                        &GraphEventHandle);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  }
+
+  GraphLz->setLastSubmission(GraphEvent);
+  updateLastEvent(GraphEvent);
+  return GraphEvent;
+}
+
 // End CHIPQueueLevelZero
 
+// CHIPNativeGraphLevel0
+// ***********************************************************************
+CHIPNativeGraphLevel0::CHIPNativeGraphLevel0(CHIPQueueLevel0 *ChipQueue)
+    : ChipQueue_(ChipQueue), ChipCtxLz_(ChipQueue->getContextLz()) {
+  auto *BackendLz = static_cast<CHIPBackendLevel0 *>(Backend);
+  Start_ = std::static_pointer_cast<CHIPEventLevel0>(
+      BackendLz->createEventShared(ChipCtxLz_));
+  Done_ = std::static_pointer_cast<CHIPEventLevel0>(
+      BackendLz->createEventShared(ChipCtxLz_));
+  CmdList_ = ChipCtxLz_->getCmdListReg();
+
+  // Wait for the launch and rearm the framing events for the next one.
+  ze_event_handle_t StartHandle = Start_->peek();
+  auto Status = zeCommandListAppendBarrier(CmdList_, nullptr, 1, &StartHandle);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListAppendEventReset(CmdList_, StartHandle);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListAppendEventReset(CmdList_, Done_->peek());
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListAppendBarrier(CmdList_, nullptr, 0, nullptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+}
+
+CHIPNativeGraphLevel0::~CHIPNativeGraphLevel0() {
+  // The command list and the events must not be recycled while a launch
+  // still uses them.
+  if (LastSubmission_)
+    LastSubmission_->wait();
+
+  zeCommandListReset(CmdList_);
+  ChipCtxLz_->returnCmdList(CmdList_);
+  for (auto &Event : NodeEvents_)
+    Event->EventPool->returnEvent(Event);
+  Start_->EventPool->returnEvent(Start_);
+  Done_->EventPool->returnEvent(Done_);
+}
+
+ze_event_handle_t CHIPNativeGraphLevel0::addNodeEvent_() {
+  NodeEvents_.push_back(std::static_pointer_cast<CHIPEventLevel0>(
+      static_cast<CHIPBackendLevel0 *>(Backend)->createEventShared(
+          ChipCtxLz_)));
+  return NodeEvents_.back()->peek();
+}
+
+bool CHIPNativeGraphLevel0::addNode(CHIPGraphNode *Node, const size_t *Deps,
+                                    size_t NumDeps) {
+  WaitList_.clear();
+  for (size_t i = 0; i < NumDeps; i++)
+    WaitList_.insert(WaitList_.end(),
+                     SignalEvents_.begin() + SignalOffsets_[Deps[i]],
+                     SignalEvents_.begin() + SignalOffsets_[Deps[i] + 1]);
+  std::sort(WaitList_.begin(), WaitList_.end());
+  WaitList_.erase(std::unique(WaitList_.begin(), WaitList_.end()),
+                  WaitList_.end());
+
+  ze_event_handle_t Signal = nullptr;
+  ze_result_t Status = ZE_RESULT_SUCCESS;
+  switch (Node->getType()) {
+  case hipGraphNodeTypeEmpty:
+    break;
+  case hipGraphNodeTypeKernel: {
+    auto *ExecItem = static_cast<CHIPExecItemLevel0 *>(
+        static_cast<CHIPGraphNodeKernel *>(Node)->getExecItem());
+    Signal = addNodeEvent_();
+    if (!addKernel_(ExecItem, Signal))
+      return false;
+    break;
+  }
+  case hipGraphNodeTypeMemcpy: {
+    if (auto *Batch = dynamic_cast<CHIPGraphNodeMemcpyBatch *>(Node)) {
+      Batch->getCopies(ChipQueue_->getDevice(), Dsts_, Srcs_, Sizes_);
+      // Every copy signals its own event, dependants wait for all of them
+      for (size_t i = 0; i < Dsts_.size() && Status == ZE_RESULT_SUCCESS;
+           i++) {
+        if (Signal)
+          SignalEvents_.push_back(Signal);
+        Signal = addNodeEvent_();
+        Status = zeCommandListAppendMemoryCopy(
+            CmdList_, Dsts_[i], Srcs_[i], Sizes_[i], Signal, WaitList_.size(),
+            WaitList_.data());
+      }
+      break;
+    }
+    auto *Memcpy = static_cast<CHIPGraphNodeMemcpy *>(Node);
+    if (!Memcpy->getDst() || !Memcpy->getSrc())
+      return false; // 3D copies
+    if (Memcpy->getKind() == hipMemcpyHostToHost)
+      return false; // Done on the host by CHIPGraphNodeMemcpy::execute()
+    if (!Memcpy->getCount() || Memcpy->getDst() == Memcpy->getSrc())
+      break;
+    Signal = addNodeEvent_();
+    Status = zeCommandListAppendMemoryCopy(
+        CmdList_, Memcpy->getDst(), Memcpy->getSrc(), Memcpy->getCount(),
+        Signal, WaitList_.size(), WaitList_.data());
+    break;
+  }
+  case hipGraphNodeTypeMemset: {
+    auto *Memset = static_cast<CHIPGraphNodeMemset *>(Node);
+    auto Params = Memset->getParams();
+    size_t PatternSize = Params.elementSize;
+    if (!PatternSize || (PatternSize & (PatternSize - 1)) ||
+        PatternSize > ChipQueue_->getMaxMemoryFillPatternSize())
+      return false;
+    // Same extent as CHIPGraphNodeMemset::execute(): a fill per row unless
+    // the rows are contiguous.
+    size_t RowSize, Pitch, NumRows;
+    Memset->getExtent(RowSize, Pitch, NumRows);
+    Patterns_.emplace_back(new unsigned int(Params.value));
+    for (size_t Row = 0; Row < NumRows && Status == ZE_RESULT_SUCCESS;
+         Row++) {
+      if (Signal)
+        SignalEvents_.push_back(Signal);
+      Signal = addNodeEvent_();
+      Status = zeCommandListAppendMemoryFill(
+          CmdList_, static_cast<char *>(Params.dst) + Row * Pitch,
+          Patterns_.back().get(), PatternSize, RowSize, Signal,
+          WaitList_.size(), WaitList_.data());
+    }
+    break;
+  }
+  default:
+    return false;
+  }
+
+  if (Status != ZE_RESULT_SUCCESS) {
+    logDebug("Recording {} failed with {}", Node->Msg, resultToString(Status));
+    return false;
+  }
+
+  // Nodes without a command forward the events of their dependencies
+  if (Signal)
+    SignalEvents_.push_back(Signal);
+  else
+    SignalEvents_.insert(SignalEvents_.end(), WaitList_.begin(),
+                         WaitList_.end());
+  SignalOffsets_.push_back(SignalEvents_.size());
+  return true;
+}
+
+bool CHIPNativeGraphLevel0::addKernel_(CHIPExecItemLevel0 *ExecItem,
+                                       ze_event_handle_t Signal) {
+  CHIPKernelLevel0 *ChipKernel = (CHIPKernelLevel0 *)ExecItem->getKernel();
+  ze_kernel_handle_t KernelZe = ChipKernel->get();
+
+  // The command captures the arguments and the group size set on the kernel
+  // handle at this point. The exec items of graph nodes have no queue, which
+  // the argument spill buffer is allocated from.
+  ExecItem->setQueue(ChipQueue_);
+  ExecItem->resetupAllArgs();
+
+  LOCK(ExecItem->ExecItemMtx); // required by zeKernelSetGroupSize
+  auto Status =
+      zeKernelSetGroupSize(KernelZe, ExecItem->getBlock().x,
+                           ExecItem->getBlock().y, ExecItem->getBlock().z);
+  if (Status != ZE_RESULT_SUCCESS)
+    return false;
+
+  if (!ChipQueue_->getDeviceLz()->hasOnDemandPaging() &&
+      ChipKernel->getFuncInfo()->mayHaveIndirectAccess()) {
+    Status = zeKernelSetIndirectAccess(KernelZe,
+                                       ZE_KERNEL_INDIRECT_ACCESS_FLAG_DEVICE |
+                                           ZE_KERNEL_INDIRECT_ACCESS_FLAG_HOST);
+    if (Status != ZE_RESULT_SUCCESS)
+      return false;
+  }
+
+  ze_group_count_t LaunchArgs = {ExecItem->getGrid().x, ExecItem->getGrid().y,
+                                 ExecItem->getGrid().z};
+  Status = zeCommandListAppendLaunchKernel(CmdList_, KernelZe, &LaunchArgs,
+                                           Signal, WaitList_.size(),
+                                           WaitList_.data());
+  if (Status != ZE_RESULT_SUCCESS) {
+    logDebug("zeCommandListAppendLaunchKernel failed with {}",
+             resultToString(Status));
+    return false;
+  }
+
+  if (std::shared_ptr<chipstar::ArgSpillBuffer> SpillBuf =
+          ExecItem->getArgSpillBuffer())
+    SpillBuffers_.push_back(SpillBuf);
+  return true;
+}
+
+bool CHIPNativeGraphLevel0::finalize() {
+  // Rearm the node events once all the nodes are done, then signal the end
+  // of the recording.
+  auto Status = zeCommandListAppendBarrier(CmdList_, nullptr, 0, nullptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  for (auto &Event : NodeEvents_) {
+    Status = zeCommandListAppendEventReset(CmdList_, Event->peek());
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  }
+  Status = zeCommandListAppendBarrier(CmdList_, Done_->peek(), 0, nullptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+
+  Status = zeCommandListClose(CmdList_);
+  if (Status != ZE_RESULT_SUCCESS) {
+    logDebug("zeCommandListClose failed with {}", resultToString(Status));
+    return false;
+  }
+  return true;
+}
+
+// End CHIPNativeGraphLevel0
+
 // EventPool
 // ***********************************************************************
 LZEventPool::LZEventPool(CHIPContextLevel0 *Ctx, unsigned int Size)
@@ -1914,6 +2316,7 @@ void CHIPContextLevel0::freeImpl(void *Ptr) {
 
 CHIPContextLevel0::~CHIPContextLevel0() {
   logTrace("~CHIPContextLevel0() {}", (void *)this);
+  ArgSpillPool_.clear();
 
   // print out reuse statistics
   if (CmdListsRequested_ != 0)
@@ -2499,11 +2902,15 @@ static ze_module_handle_t compileIL(ze_context_handle_t ZeCtx,
 }
 
 static void appendDeviceLibrarySources(
-    std::vector<size_t> &SrcSizes, std::vector<const uint8_t *> &Sources,
+    const chipstar::Module &ChipModule, std::vector<size_t> &SrcSizes,
+    std::vector<const uint8_t *> &Sources,
     std::vector<const char *> &BuildFlags,
     const ze_float_atomic_ext_properties_t &FpAtomicProps) {
 
-  auto AppendSource = [&](auto &Source) -> void {
+  // Link only the modules defining symbols the program uses.
+  auto AppendSource = [&](auto &Source, auto &Symbols) -> void {
+    if (!ChipModule.importsAnyOf(Symbols))
+      return;
     SrcSizes.push_back(Source.size());
     Sources.push_back(Source.data());
     BuildFlags.push_back("");
@@ -2511,19 +2918,23 @@ static void appendDeviceLibrarySources(
 
   if (FpAtomicProps.fp32Flags & ZE_DEVICE_FP_ATOMIC_EXT_FLAG_GLOBAL_ADD &&
       FpAtomicProps.fp32Flags & ZE_DEVICE_FP_ATOMIC_EXT_FLAG_LOCAL_ADD)
-    AppendSource(chipstar::atomicAddFloat_native);
+    AppendSource(chipstar::atomicAddFloat_native,
+                 chipstar::atomicAddFloat_native_symbols);
   else
-    AppendSource(chipstar::atomicAddFloat_emulation);
+    AppendSource(chipstar::atomicAddFloat_emulation,
+                 chipstar::atomicAddFloat_emulation_symbols);
 
   if (FpAtomicProps.fp64Flags & ZE_DEVICE_FP_ATOMIC_EXT_FLAG_GLOBAL_ADD &&
       FpAtomicProps.fp64Flags & ZE_DEVICE_FP_ATOMIC_EXT_FLAG_LOCAL_ADD)
-    AppendSource(chipstar::atomicAddDouble_native);
+    AppendSource(chipstar::atomicAddDouble_native,
+                 chipstar::atomicAddDouble_native_symbols);
   else
-    AppendSource(chipstar::atomicAddDouble_emulation);
+    AppendSource(chipstar::atomicAddDouble_emulation,
+                 chipstar::atomicAddDouble_emulation_symbols);
 
   // OpGroupNonUniformBallot instructions seems to compile and work
   // despite not having ZE_extension_subgroups.
-  AppendSource(chipstar::ballot_native);
+  AppendSource(chipstar::ballot_native, chipstar::ballot_native_symbols);
 
   assert(SrcSizes.size() == Sources.size() &&
          Sources.size() == BuildFlags.size());
@@ -2544,8 +2955,9 @@ void CHIPModuleLevel0::compile(chipstar::Device *ChipDev) {
   std::vector<const uint8_t *> ILInputs(1, FuncIL_);
   std::vector<const char *> BuildFlags(1, ChipEnvVars.getJitFlags().c_str());
 
-  appendDeviceLibrarySources(ILSizes, ILInputs, BuildFlags,
+  appendDeviceLibrarySources(*this, ILSizes, ILInputs, BuildFlags,
                              LzDev->getFpAtomicProps());
+  logDebug("Linking {} runtime device library module(s)", ILSizes.size() - 1);
 
   ze_module_program_exp_desc_t ProgramDesc = {
       ZE_STRUCTURE_TYPE_MODULE_PROGRAM_EXP_DESC,
@@ -2597,9 +3009,8 @@ void CHIPModuleLevel0::compile(chipstar::Device *ChipDev) {
                                    0, // flags
                                    HostFName.c_str()};
 
-    if (!LzDev->hasOnDemandPaging())
-      // TODO: This is not needed if the kernel does not access allocations
-      //       indirectly. This requires kernel code inspection.
+    if (!LzDev->hasOnDemandPaging() && FuncInfo->mayHaveIndirectAccess())
+      // Not needed if the kernel does not access allocations indirectly.
       KernelDesc.flags |= ZE_KERNEL_FLAG_FORCE_RESIDENCY;
 
     Status = zeKernelCreate(ZeModule_, &KernelDesc, &ZeKernel);
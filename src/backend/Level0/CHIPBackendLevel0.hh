@@ -63,6 +63,17 @@ public:
   virtual ~CHIPExecItemLevel0() override {}
 
   virtual void setupAllArgs() override;
+
+  /// Set the arguments on the kernel handle even if they have been set
+  /// before. The handle is shared by all exec items of the kernel.
+  void resetupAllArgs() {
+    {
+      LOCK(this->ExecItemMtx); // chipstar::ExecItem::ArgsSetup
+      ArgsSetup = false;
+    }
+    setupAllArgs();
+  }
+
   virtual chipstar::ExecItem *clone() const override {
     auto NewExecItem = new CHIPExecItemLevel0(*this);
     return NewExecItem;
@@ -293,6 +304,10 @@ public:
   virtual std::shared_ptr<chipstar::Event>
   memCopyAsyncImpl(void *Dst, const void *Src, size_t Size) override;
 
+  virtual std::shared_ptr<chipstar::Event>
+  memCopyBatchAsyncImpl(void *const *Dsts, const void *const *Srcs,
+                        const size_t *Sizes, size_t Count) override;
+
   /**
    * @brief Execute a given command list
    *
@@ -337,9 +352,14 @@ public:
       const std::vector<std::shared_ptr<chipstar::Event>> &EventsToWaitFor);
 
   virtual std::shared_ptr<chipstar::Event>
-  memPrefetchImpl(const void *Ptr, size_t Count) override {
-    UNIMPLEMENTED(nullptr);
-  }
+  memPrefetchImpl(const void *Ptr, size_t Count, bool ToHost) override;
+  virtual std::shared_ptr<chipstar::Event>
+  memAdviseImpl(const void *Ptr, size_t Count, hipMemoryAdvise Advice,
+                bool ToHost) override;
+
+  virtual chipstar::NativeGraph *createNativeGraph() override;
+  virtual std::shared_ptr<chipstar::Event>
+  enqueueNativeGraphImpl(chipstar::NativeGraph *Graph) override;
 
   void setCmdQueueOwnership(bool isOwnedByChip) {
     zeCmdQOwnership_ = isOwnedByChip;
@@ -414,11 +434,74 @@ public:
       chipstar::HostAllocFlags Flags = chipstar::HostAllocFlags()) override;
 
   bool isAllocatedPtrMappedToVM(void *Ptr) override { return false; } // TODO
+  bool isHostAccessible(const chipstar::AllocationInfo &AllocInfo) override {
+    // Host and shared USM allocations. Registered host memory is backed by
+    // a separate device allocation.
+    return AllocInfo.MemoryType != hipMemoryTypeDevice &&
+           !AllocInfo.IsHostRegistered;
+  }
   void freeImpl(void *Ptr) override;
   ze_context_handle_t &get() { return ZeCtx; }
 
 }; // CHIPContextLevel0
 
+/**
+ * @brief Graph recorded into a regular command list.
+ *
+ * The list is recorded once and executed on the command queue of the queue
+ * it was created for by every launch. Kernel, 1D copy, fill and empty nodes
+ * are recorded. Each recorded node signals an event owned by the graph which
+ * its dependants wait for. The list is framed by two more events owned by
+ * the graph: it starts once Start_ is signaled and signals Done_ at the end.
+ * A launch signals Start_ from a pooled list after the dependencies of the
+ * launch and signals the launch event from another pooled list after Done_.
+ */
+class CHIPNativeGraphLevel0 : public chipstar::NativeGraph {
+  CHIPQueueLevel0 *ChipQueue_;
+  CHIPContextLevel0 *ChipCtxLz_;
+  ze_command_list_handle_t CmdList_;
+  std::shared_ptr<CHIPEventLevel0> Start_;
+  std::shared_ptr<CHIPEventLevel0> Done_;
+  std::vector<std::shared_ptr<CHIPEventLevel0>> NodeEvents_;
+
+  /// The events marking the completion of the i-th added node are
+  /// SignalEvents_[SignalOffsets_[i]..SignalOffsets_[i + 1]).
+  std::vector<size_t> SignalOffsets_{0};
+  std::vector<ze_event_handle_t> SignalEvents_;
+  std::vector<ze_event_handle_t> WaitList_;
+
+  /// Scratch space for the copies of a CHIPGraphNodeMemcpyBatch
+  std::vector<void *> Dsts_;
+  std::vector<const void *> Srcs_;
+  std::vector<size_t> Sizes_;
+
+  /// Storage for the fill patterns and the argument spill buffers used by
+  /// the recorded commands.
+  std::vector<std::unique_ptr<unsigned int>> Patterns_;
+  std::vector<std::shared_ptr<chipstar::ArgSpillBuffer>> SpillBuffers_;
+
+  /// The launch event of the last submission
+  std::shared_ptr<chipstar::Event> LastSubmission_;
+
+  ze_event_handle_t addNodeEvent_();
+  bool addKernel_(CHIPExecItemLevel0 *ExecItem, ze_event_handle_t Signal);
+
+public:
+  CHIPNativeGraphLevel0(CHIPQueueLevel0 *ChipQueue);
+  virtual ~CHIPNativeGraphLevel0() override;
+
+  virtual bool addNode(CHIPGraphNode *Node, const size_t *Deps,
+                       size_t NumDeps) override;
+  virtual bool finalize() override;
+
+  ze_command_list_handle_t getCmdList() const { return CmdList_; }
+  ze_event_handle_t getStartEvent() const { return Start_->peek(); }
+  ze_event_handle_t getDoneEvent() const { return Done_->peek(); }
+  void setLastSubmission(std::shared_ptr<chipstar::Event> Event) {
+    LastSubmission_ = Event;
+  }
+};
+
 class CHIPModuleLevel0 : public chipstar::Module {
   ze_module_handle_t ZeModule_ = nullptr;
 
@@ -226,20 +226,27 @@ static void memCopyToImage(cl_command_queue CmdQ, cl_mem Image,
 /// within another allocation). Without the annotation the allocations
 /// may not be properly synchronized.
 ///
-/// Returns the list of annotated pointers.
-static std::unique_ptr<std::vector<std::shared_ptr<void>>>
-annotateIndirectPointers(const CHIPContextOpenCL &Ctx,
-                         cl_kernel KernelAPIHandle) {
-  // By default we pass every allocated SVM pointer at this point to
+/// The annotation is set again on the cl_kernel only if the allocations
+/// have changed since it was last annotated.
+///
+/// Returns the annotated SVM allocations which must be kept alive until the
+/// kernel has finished, or nullptr if no SVM allocations are annotated.
+static std::shared_ptr<const SvmAnnotation>
+annotateIndirectPointers(CHIPContextOpenCL &Ctx, CHIPKernelOpenCL &Kernel) {
+  // Nothing to annotate if the compiler has proven that the kernel
+  // accesses memory only through its pointer arguments.
+  if (!Kernel.getFuncInfo()->mayHaveIndirectAccess())
+    return nullptr;
+
+  // Otherwise we pass every allocated SVM pointer at this point to
   // the clSetKernelExecInfo() since any of them could be potentially
   // be accessed indirectly by the kernel.
-  //
-  // TODO: Optimization. Don't call clSetKernelExecInfo() if the
-  //       kernel is known not to access any buffer indirectly
-  //       discovered through kernel code inspection.
-
-  std::unique_ptr<std::vector<std::shared_ptr<void>>> SvmKeepAlives;
+  cl_kernel KernelAPIHandle = Kernel.get()->get();
   if (Ctx.usesUSM()) {
+    LOCK(Kernel.ExecInfoMtx); // CHIPKernelOpenCL::IndirectAccessEnabled_
+    if (Kernel.isIndirectAccessEnabled())
+      return nullptr;
+
     cl_bool Enable = CL_TRUE;
     for (auto Param : {CL_KERNEL_EXEC_INFO_INDIRECT_HOST_ACCESS_INTEL,
                        CL_KERNEL_EXEC_INFO_INDIRECT_DEVICE_ACCESS_INTEL,
@@ -248,39 +255,35 @@ annotateIndirectPointers(const CHIPContextOpenCL &Ctx,
           clSetKernelExecInfo(KernelAPIHandle, Param, sizeof(cl_bool), &Enable);
       CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
     }
-
-    return SvmKeepAlives;
+    Kernel.setIndirectAccessEnabled();
+    return nullptr;
   }
 
   // Annotate SVM pointers.
   assert(Ctx.usesSVM());
 
-  std::vector<void *> SvmAnnotationList;
-  LOCK(Ctx.ContextMtx); // CHIPContextOpenCL::MemManager_
-  auto NumSvmAllocations = Ctx.getNumAllocations();
-  if (NumSvmAllocations) {
-    SvmAnnotationList.reserve(NumSvmAllocations);
-    SvmKeepAlives.reset(new std::vector<std::shared_ptr<void>>());
-    SvmKeepAlives->reserve(NumSvmAllocations);
-    for (std::shared_ptr<void> Ptr : Ctx.getSvmPointers()) {
-      SvmAnnotationList.push_back(Ptr.get());
-      SvmKeepAlives->push_back(Ptr);
-    }
-
-    // TODO: Optimization. Don't call this function again if we know the
-    //       SvmAnnotationList hasn't changed since the last call.
+  std::shared_ptr<const SvmAnnotation> Annotation;
+  {
+    LOCK(Ctx.ContextMtx); // CHIPContextOpenCL::MemManager_
+    Annotation = Ctx.getSvmAnnotation();
+  }
+  LOCK(Kernel.ExecInfoMtx); // CHIPKernelOpenCL::SvmAnnotationGeneration_
+  if (!Annotation->Pointers.empty() &&
+      Kernel.getSvmAnnotationGeneration() != Annotation->Generation) {
     auto Status = clSetKernelExecInfo(
         KernelAPIHandle, CL_KERNEL_EXEC_INFO_SVM_PTRS,
-        SvmAnnotationList.size() * sizeof(void *), SvmAnnotationList.data());
+        Annotation->Pointers.size() * sizeof(void *),
+        Annotation->Pointers.data());
     CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+    Kernel.setSvmAnnotationGeneration(Annotation->Generation);
   }
 
-  return SvmKeepAlives;
+  return Annotation;
 }
 
 struct KernelEventCallbackData {
   std::shared_ptr<chipstar::ArgSpillBuffer> ArgSpillBuffer;
-  std::unique_ptr<std::vector<std::shared_ptr<void>>> SvmKeepAlives;
+  std::shared_ptr<const SvmAnnotation> SvmAnnotation;
 };
 static void CL_CALLBACK kernelEventCallback(cl_event Event,
                                             cl_int CommandExecStatus,
@@ -763,7 +766,16 @@ float CHIPEventOpenCL::getElapsedTime(chipstar::Event *OtherIn) {
   return (float)MS + FractInMS;
 }
 
-void CHIPEventOpenCL::hostSignal() { UNIMPLEMENTED(); }
+void CHIPEventOpenCL::hostSignal() {
+  logTrace("CHIPEventOpenCL::hostSignal()");
+  // Only events created with clCreateUserEvent() can be signalled from the
+  // host, see CHIPQueueOpenCL::createHostSignalEvent().
+  auto Status = clSetUserEventStatus(ClEvent, CL_COMPLETE);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+
+  LOCK(EventMtx); // chipstar::Event::EventStatus_
+  EventStatus_ = EVENT_STATUS_RECORDED;
+}
 
 // CHIPModuleOpenCL
 //*************************************************************************
@@ -800,38 +812,47 @@ static cl::Program compileIL(cl::Context Ctx, CHIPDeviceOpenCL &ChipDev,
   return Prog;
 }
 
-template <size_t N>
-static cl::Program compileIL(cl::Context Ctx, CHIPDeviceOpenCL &ChipDev,
-                             std::array<unsigned char, N> IL,
-                             const std::string &Options = "") {
-  return compileIL(Ctx, ChipDev, IL.data(), IL.size());
+cl::Program CHIPDeviceOpenCL::getRuntimeObject(std::string_view IL) {
+  LOCK(RuntimeObjectsMtx_); // CHIPDeviceOpenCL::RuntimeObjects_
+  auto It = RuntimeObjects_.find(IL.data());
+  if (It == RuntimeObjects_.end()) {
+    auto Object = compileIL(*ClContext, *this, IL.data(), IL.size());
+    It = RuntimeObjects_.emplace(IL.data(), Object).first;
+  }
+  return It->second;
 }
 
-static void appendRuntimeObjects(cl::Context Ctx, CHIPDeviceOpenCL &ChipDev,
+static void appendRuntimeObjects(CHIPModuleOpenCL &ChipModule,
+                                 CHIPDeviceOpenCL &ChipDev,
                                  std::vector<cl::Program> &Objects) {
-
-  // TODO: Minor optimization opportunity. Link modules based on
-  //       SPIR-V module inspection.
-
-  // TODO: Reuse already compiled modules.
-
-  auto AppendSource = [&](auto &Source) -> void {
-    Objects.push_back(compileIL(Ctx, ChipDev, Source));
+  // Link only the modules defining symbols the program uses.
+  auto AppendSource = [&](auto &Source, auto &Symbols) -> void {
+    if (!ChipModule.importsAnyOf(Symbols))
+      return;
+    std::string_view IL(reinterpret_cast<const char *>(Source.data()),
+                        Source.size());
+    Objects.push_back(ChipDev.getRuntimeObject(IL));
   };
 
   if (ChipDev.hasFP32AtomicAdd())
-    AppendSource(chipstar::atomicAddFloat_native);
+    AppendSource(chipstar::atomicAddFloat_native,
+                 chipstar::atomicAddFloat_native_symbols);
   else
-    AppendSource(chipstar::atomicAddFloat_emulation);
+    AppendSource(chipstar::atomicAddFloat_emulation,
+                 chipstar::atomicAddFloat_emulation_symbols);
 
   if (ChipDev.hasFP64AtomicAdd())
-    AppendSource(chipstar::atomicAddDouble_native);
+    AppendSource(chipstar::atomicAddDouble_native,
+                 chipstar::atomicAddDouble_native_symbols);
   else
-    AppendSource(chipstar::atomicAddDouble_emulation);
+    AppendSource(chipstar::atomicAddDouble_emulation,
+                 chipstar::atomicAddDouble_emulation_symbols);
 
   if (ChipDev.hasBallot())
-    AppendSource(chipstar::ballot_native);
-  // No fall-back implementation for ballot - let linker raise an error.
+    AppendSource(chipstar::ballot_native, chipstar::ballot_native_symbols);
+  else
+    AppendSource(chipstar::ballot_emulation,
+                 chipstar::ballot_emulation_symbols);
 }
 
 void CHIPModuleOpenCL::compile(chipstar::Device *ChipDev) {
@@ -852,7 +873,9 @@ void CHIPModuleOpenCL::compile(chipstar::Device *ChipDev) {
 
   std::vector<cl::Program> ClObjects;
   ClObjects.push_back(ClMainObj);
-  appendRuntimeObjects(*ChipCtxOcl->get(), *ChipDevOcl, ClObjects);
+  appendRuntimeObjects(*this, *ChipDevOcl, ClObjects);
+  logDebug("Linking {} runtime device library module(s)",
+           ClObjects.size() - 1);
   Program_ = cl::linkProgram(ClObjects, nullptr, nullptr, nullptr, &Err);
   if (Err != CL_SUCCESS) {
     dumpProgramLog(*ChipDevOcl, Program_);
@@ -978,6 +1001,17 @@ bool CHIPContextOpenCL::allDevicesSupportFineGrainSVMorUSM() {
   return SupportsFineGrainSVM || SupportsIntelUSM;
 }
 
+bool CHIPContextOpenCL::isHostAccessible(
+    const chipstar::AllocationInfo &AllocInfo) {
+  // Registered host memory is backed by a separate device allocation.
+  if (AllocInfo.IsHostRegistered)
+    return false;
+  // See MemoryManager::allocate() for the allocation kinds.
+  if (usesUSM())
+    return AllocInfo.MemoryType != hipMemoryTypeDevice;
+  return SupportsFineGrainSVM;
+}
+
 void CHIPContextOpenCL::freeImpl(void *Ptr) {
   LOCK(ContextMtx); // CHIPContextOpenCL::MemManager_
   MemManager_.free(Ptr);
@@ -1011,10 +1045,57 @@ CHIPContextOpenCL::CHIPContextOpenCL(cl::Context CtxIn, cl::Device Dev,
     USM.clMemFreeINTEL =
         (clMemFreeINTEL_fn)::clGetExtensionFunctionAddressForPlatform(
             Plat(), "clMemFreeINTEL");
+    USM.clEnqueueMigrateMemINTEL =
+        (clEnqueueMigrateMemINTEL_fn)::clGetExtensionFunctionAddressForPlatform(
+            Plat(), "clEnqueueMigrateMemINTEL");
   } else {
     logDebug("Device does not support Intel USM");
   }
 
+#ifdef cl_khr_command_buffer
+  SupportsCommandBuffers =
+      DevExts.find("cl_khr_command_buffer") != std::string::npos;
+  if (SupportsCommandBuffers) {
+    std::memset(&CommandBuffer, 0, sizeof(CommandBuffer));
+    CommandBuffer.clCreateCommandBufferKHR =
+        (clCreateCommandBufferKHR_fn)::clGetExtensionFunctionAddressForPlatform(
+            Plat(), "clCreateCommandBufferKHR");
+    CommandBuffer.clCommandNDRangeKernelKHR =
+        (clCommandNDRangeKernelKHR_fn)::
+            clGetExtensionFunctionAddressForPlatform(
+                Plat(), "clCommandNDRangeKernelKHR");
+    CommandBuffer.clFinalizeCommandBufferKHR =
+        (clFinalizeCommandBufferKHR_fn)::
+            clGetExtensionFunctionAddressForPlatform(
+                Plat(), "clFinalizeCommandBufferKHR");
+    CommandBuffer.clEnqueueCommandBufferKHR =
+        (clEnqueueCommandBufferKHR_fn)::
+            clGetExtensionFunctionAddressForPlatform(
+                Plat(), "clEnqueueCommandBufferKHR");
+    CommandBuffer.clReleaseCommandBufferKHR =
+        (clReleaseCommandBufferKHR_fn)::
+            clGetExtensionFunctionAddressForPlatform(
+                Plat(), "clReleaseCommandBufferKHR");
+    SupportsCommandBuffers = CommandBuffer.clCreateCommandBufferKHR &&
+                             CommandBuffer.clCommandNDRangeKernelKHR &&
+                             CommandBuffer.clFinalizeCommandBufferKHR &&
+                             CommandBuffer.clEnqueueCommandBufferKHR &&
+                             CommandBuffer.clReleaseCommandBufferKHR;
+  }
+  if (SupportsCommandBuffers) {
+    cl_device_command_buffer_capabilities_khr Caps = 0;
+    Dev.getInfo(CL_DEVICE_COMMAND_BUFFER_CAPABILITIES_KHR, &Caps);
+#ifdef CL_COMMAND_BUFFER_CAPABILITY_SIMULTANEOUS_USE_KHR
+    SupportsSimultaneousCommandBuffers =
+        Caps & CL_COMMAND_BUFFER_CAPABILITY_SIMULTANEOUS_USE_KHR;
+#endif
+    logDebug("Device supports command buffers (simultaneous use: {})",
+             SupportsSimultaneousCommandBuffers ? "yes" : "no");
+  } else {
+    logDebug("Device does not support command buffers");
+  }
+#endif
+
   cl_device_svm_capabilities DeviceSVMCapabilities;
   int Err = Dev.getInfo(CL_DEVICE_SVM_CAPABILITIES, &DeviceSVMCapabilities);
   CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd);
@@ -1209,6 +1290,19 @@ void CHIPQueueOpenCL::addCallback(hipStreamCallback_t Callback,
   return;
 };
 
+std::shared_ptr<chipstar::Event> CHIPQueueOpenCL::createHostSignalEvent() {
+  cl::Context *ClContext_ = ((CHIPContextOpenCL *)ChipContext_)->get();
+  cl_int Err;
+
+  std::shared_ptr<chipstar::Event> Event =
+      static_cast<CHIPBackendOpenCL *>(Backend)->createEventShared(
+          ChipContext_);
+  std::static_pointer_cast<CHIPEventOpenCL>(Event)->ClEvent =
+      clCreateUserEvent(ClContext_->get(), &Err);
+  CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd);
+  return Event;
+}
+
 std::shared_ptr<chipstar::Event> CHIPQueueOpenCL::enqueueMarkerImpl() {
   std::shared_ptr<chipstar::Event> MarkerEvent =
       static_cast<CHIPBackendOpenCL *>(Backend)->createEventShared(
@@ -1255,7 +1349,7 @@ CHIPQueueOpenCL::launchImpl(chipstar::ExecItem *ExecItem) {
 #endif
 
   auto AllocationsToKeepAlive =
-      annotateIndirectPointers(*OclContext, Kernel->get()->get());
+      annotateIndirectPointers(*OclContext, *Kernel);
 
   auto SyncQueuesEventHandles = addDependenciesQueueSync(LaunchEvent);
   auto Status = clEnqueueNDRangeKernel(
@@ -1281,7 +1375,7 @@ CHIPQueueOpenCL::launchImpl(chipstar::ExecItem *ExecItem) {
     //   live.
     auto *CBData = new KernelEventCallbackData;
     CBData->ArgSpillBuffer = SpillBuf;
-    CBData->SvmKeepAlives = std::move(AllocationsToKeepAlive);
+    CBData->SvmAnnotation = std::move(AllocationsToKeepAlive);
     Status = clSetEventCallback(
         std::static_pointer_cast<CHIPEventOpenCL>(LaunchEvent)->getNativeRef(),
         CL_COMPLETE, kernelEventCallback, CBData);
@@ -1296,6 +1390,197 @@ CHIPQueueOpenCL::launchImpl(chipstar::ExecItem *ExecItem) {
   return LaunchEvent;
 }
 
+chipstar::NativeGraph *CHIPQueueOpenCL::createNativeGraph() {
+#ifdef cl_khr_command_buffer
+  auto *OclContext = static_cast<CHIPContextOpenCL *>(ChipContext_);
+  if (!OclContext->supportsCommandBuffers())
+    return nullptr;
+
+  auto *Graph = new CHIPNativeGraphOpenCL(OclContext, ClQueue_->get());
+  if (!Graph->init()) {
+    delete Graph;
+    return nullptr;
+  }
+  return Graph;
+#else
+  return nullptr;
+#endif
+}
+
+std::shared_ptr<chipstar::Event>
+CHIPQueueOpenCL::enqueueNativeGraphImpl(chipstar::NativeGraph *Graph) {
+#ifdef cl_khr_command_buffer
+  logTrace("CHIPQueueOpenCL::enqueueNativeGraphImpl()");
+  auto *OclContext = static_cast<CHIPContextOpenCL *>(ChipContext_);
+  std::shared_ptr<chipstar::Event> GraphEvent =
+      static_cast<CHIPBackendOpenCL *>(Backend)->createEventShared(OclContext);
+
+  auto SyncQueuesEventHandles = addDependenciesQueueSync(GraphEvent);
+  auto Status = static_cast<CHIPNativeGraphOpenCL *>(Graph)->enqueue(
+      SyncQueuesEventHandles,
+      std::static_pointer_cast<CHIPEventOpenCL>(GraphEvent)->getNativePtr());
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+
+  GraphEvent->Msg = "CommandBuffer";
+  updateLastEvent(GraphEvent);
+  return GraphEvent;
+#else
+  UNIMPLEMENTED(nullptr);
+#endif
+}
+
+#ifdef cl_khr_command_buffer
+CHIPNativeGraphOpenCL::CHIPNativeGraphOpenCL(CHIPContextOpenCL *Ctx,
+                                             cl_command_queue ClQueue)
+    : Ctx_(Ctx), ClQueue_(ClQueue) {
+  // The graph may outlive the stream it was recorded for.
+  clRetainCommandQueue(ClQueue_);
+}
+
+CHIPNativeGraphOpenCL::~CHIPNativeGraphOpenCL() {
+  // The command buffer and the kernels recorded into it must not be released
+  // while a launch still uses them.
+  if (LastSubmission_) {
+    clWaitForEvents(1, &LastSubmission_);
+    clReleaseEvent(LastSubmission_);
+  }
+  if (CommandBuffer_)
+    Ctx_->getCommandBufferExts().clReleaseCommandBufferKHR(CommandBuffer_);
+  clReleaseCommandQueue(ClQueue_);
+}
+
+bool CHIPNativeGraphOpenCL::init() {
+  cl_command_buffer_properties_khr Props[3] = {0, 0, 0};
+#ifdef CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR
+  if (Ctx_->supportsSimultaneousCommandBuffers()) {
+    Props[0] = CL_COMMAND_BUFFER_FLAGS_KHR;
+    Props[1] = CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR;
+  }
+#endif
+  cl_int Status;
+  CommandBuffer_ = Ctx_->getCommandBufferExts().clCreateCommandBufferKHR(
+      1, &ClQueue_, Props, &Status);
+  if (Status != CL_SUCCESS) {
+    logDebug("clCreateCommandBufferKHR failed with {}", Status);
+    CommandBuffer_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool CHIPNativeGraphOpenCL::addNode(CHIPGraphNode *Node, const size_t *Deps,
+                                    size_t NumDeps) {
+  WaitList_.clear();
+  for (size_t i = 0; i < NumDeps; i++)
+    WaitList_.insert(WaitList_.end(),
+                     SyncPoints_.begin() + SyncPointOffsets_[Deps[i]],
+                     SyncPoints_.begin() + SyncPointOffsets_[Deps[i] + 1]);
+
+  switch (Node->getType()) {
+  case hipGraphNodeTypeEmpty:
+    // Dependants of the node wait for its dependencies directly.
+    std::sort(WaitList_.begin(), WaitList_.end());
+    WaitList_.erase(std::unique(WaitList_.begin(), WaitList_.end()),
+                    WaitList_.end());
+    SyncPoints_.insert(SyncPoints_.end(), WaitList_.begin(), WaitList_.end());
+    break;
+  case hipGraphNodeTypeKernel:
+    if (!addKernel_(static_cast<CHIPExecItemOpenCL *>(
+            static_cast<CHIPGraphNodeKernel *>(Node)->getExecItem())))
+      return false;
+    break;
+  default:
+    return false;
+  }
+
+  SyncPointOffsets_.push_back(SyncPoints_.size());
+  return true;
+}
+
+bool CHIPNativeGraphOpenCL::addKernel_(CHIPExecItemOpenCL *ExecItem) {
+  CHIPKernelOpenCL *Kernel = (CHIPKernelOpenCL *)ExecItem->getKernel();
+  assert(Kernel && "Kernel in chipstar::ExecItem is NULL!");
+
+  // The command captures the arguments and the execution info set on the
+  // kernel at this point.
+  ExecItem->setupAllArgs();
+
+  dim3 GridDim = ExecItem->getGrid();
+  dim3 BlockDim = ExecItem->getBlock();
+  const size_t NumDims = 3;
+  const size_t GlobalOffset[NumDims] = {0, 0, 0};
+  const size_t Global[NumDims] = {
+      GridDim.x * BlockDim.x, GridDim.y * BlockDim.y, GridDim.z * BlockDim.z};
+  const size_t Local[NumDims] = {BlockDim.x, BlockDim.y, BlockDim.z};
+
+  auto AllocationsToKeepAlive =
+      annotateIndirectPointers(*Ctx_, *Kernel);
+
+  cl_sync_point_khr SyncPoint;
+  auto Status = Ctx_->getCommandBufferExts().clCommandNDRangeKernelKHR(
+      CommandBuffer_, nullptr, nullptr, Kernel->get()->get(), NumDims,
+      GlobalOffset, Global, Local, WaitList_.size(),
+      WaitList_.empty() ? nullptr : WaitList_.data(), &SyncPoint, nullptr);
+  if (Status != CL_SUCCESS) {
+    logDebug("clCommandNDRangeKernelKHR failed with {}", Status);
+    return false;
+  }
+
+  // Every recorded kernel annotates the same allocations.
+  if (AllocationsToKeepAlive)
+    SvmAnnotation_ = std::move(AllocationsToKeepAlive);
+
+  SyncPoints_.push_back(SyncPoint);
+  return true;
+}
+
+bool CHIPNativeGraphOpenCL::finalize() {
+  auto Status =
+      Ctx_->getCommandBufferExts().clFinalizeCommandBufferKHR(CommandBuffer_);
+  if (Status != CL_SUCCESS) {
+    logDebug("clFinalizeCommandBufferKHR failed with {}", Status);
+    return false;
+  }
+  return true;
+}
+
+bool CHIPNativeGraphOpenCL::isStale() {
+  if (!SvmAnnotation_)
+    return false;
+
+  // The kernels may access any SVM allocation indirectly, so the recording
+  // must annotate exactly the currently live allocations.
+  LOCK(Ctx_->ContextMtx); // CHIPContextOpenCL::MemManager_
+  return SvmAnnotation_->Generation != Ctx_->getAllocationGeneration();
+}
+
+bool CHIPNativeGraphOpenCL::isReady() {
+  if (!LastSubmission_ || Ctx_->supportsSimultaneousCommandBuffers())
+    return true;
+
+  cl_int ExecStatus;
+  auto Status = clGetEventInfo(LastSubmission_,
+                               CL_EVENT_COMMAND_EXECUTION_STATUS,
+                               sizeof(cl_int), &ExecStatus, nullptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  return ExecStatus == CL_COMPLETE;
+}
+
+cl_int CHIPNativeGraphOpenCL::enqueue(const std::vector<cl_event> &WaitEvents,
+                                      cl_event *Event) {
+  auto Status = Ctx_->getCommandBufferExts().clEnqueueCommandBufferKHR(
+      0, nullptr, CommandBuffer_, WaitEvents.size(),
+      WaitEvents.empty() ? nullptr : WaitEvents.data(), Event);
+  if (Status != CL_SUCCESS)
+    return Status;
+
+  if (LastSubmission_)
+    clReleaseEvent(LastSubmission_);
+  LastSubmission_ = *Event;
+  return clRetainEvent(LastSubmission_);
+}
+#endif
+
 CHIPQueueOpenCL::CHIPQueueOpenCL(chipstar::Device *ChipDevice, int Priority,
                                  cl_command_queue Queue)
     : chipstar::Queue(ChipDevice, chipstar::QueueFlags{}, Priority) {
@@ -1382,6 +1667,57 @@ CHIPQueueOpenCL::memCopyAsyncImpl(void *Dst, const void *Src, size_t Size) {
   return Event;
 }
 
+std::shared_ptr<chipstar::Event>
+CHIPQueueOpenCL::memCopyBatchAsyncImpl(void *const *Dsts,
+                                       const void *const *Srcs,
+                                       const size_t *Sizes, size_t Count) {
+  std::shared_ptr<chipstar::Event> Event =
+      static_cast<CHIPBackendOpenCL *>(Backend)->createEventShared(
+          ChipContext_);
+  logTrace("clSVMmemcpy batch of {} copies\n", Count);
+
+  // Dst == Src copies are no-ops (see memCopyAsyncImpl()).
+  auto IsNoOp = [&](size_t i) { return !Sizes[i] || Dsts[i] == Srcs[i]; };
+  size_t Last = Count;
+  for (size_t i = Count; i-- > 0;)
+    if (!IsNoOp(i)) {
+      Last = i;
+      break;
+    }
+
+#ifdef CHIP_DUBIOUS_LOCKS
+  LOCK(Backend->DubiousLockOpenCL)
+#endif
+  auto SyncQueuesEventHandles = addDependenciesQueueSync(Event);
+  cl_event *EventPtr =
+      std::static_pointer_cast<CHIPEventOpenCL>(Event)->getNativePtr();
+  if (Last == Count) {
+    auto Status = clEnqueueMarkerWithWaitList(
+        ClQueue_->get(), SyncQueuesEventHandles.size(),
+        SyncQueuesEventHandles.data(), EventPtr);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+    updateLastEvent(Event);
+    return Event;
+  }
+
+  // The command queue is in-order: only the first copy needs to wait for
+  // the synchronized queues and only the last one needs to signal an event.
+  bool First = true;
+  for (size_t i = 0; i <= Last; i++) {
+    if (IsNoOp(i))
+      continue;
+    auto Status = ::clEnqueueSVMMemcpy(
+        ClQueue_->get(), CL_FALSE, Dsts[i], Srcs[i], Sizes[i],
+        First ? SyncQueuesEventHandles.size() : 0,
+        First ? SyncQueuesEventHandles.data() : nullptr,
+        i == Last ? EventPtr : nullptr);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorRuntimeMemory);
+    First = false;
+  }
+  updateLastEvent(Event);
+  return Event;
+}
+
 void CHIPQueueOpenCL::finish() {
 #ifdef CHIP_DUBIOUS_LOCKS
   LOCK(Backend->DubiousLockOpenCL)
@@ -1461,8 +1797,47 @@ hipError_t CHIPQueueOpenCL::getBackendHandles(uintptr_t *NativeInfo,
 }
 
 std::shared_ptr<chipstar::Event>
-CHIPQueueOpenCL::memPrefetchImpl(const void *Ptr, size_t Count) {
-  UNIMPLEMENTED(nullptr);
+CHIPQueueOpenCL::memPrefetchImpl(const void *Ptr, size_t Count, bool ToHost) {
+  auto *ChipCtxCl = static_cast<CHIPContextOpenCL *>(ChipContext_);
+  auto MigrateMemINTEL = ChipCtxCl->getUSMExts().clEnqueueMigrateMemINTEL;
+  if (ChipCtxCl->usesUSM() && !MigrateMemINTEL) {
+    logDebug("clEnqueueMigrateMemINTEL is not available. Ignoring prefetch.");
+    return enqueueMarkerImpl();
+  }
+
+  std::shared_ptr<chipstar::Event> Event =
+      static_cast<CHIPBackendOpenCL *>(Backend)->createEventShared(
+          ChipContext_);
+  logTrace("memPrefetch {} / {} B to {}\n", Ptr, Count,
+           ToHost ? "host" : "device");
+  cl_mem_migration_flags Flags = ToHost ? CL_MIGRATE_MEM_OBJECT_HOST : 0;
+  auto SyncQueuesEventHandles = addDependenciesQueueSync(Event);
+  cl_int Status;
+  if (ChipCtxCl->usesUSM())
+    Status = MigrateMemINTEL(
+        ClQueue_->get(), Ptr, Count, Flags, SyncQueuesEventHandles.size(),
+        SyncQueuesEventHandles.data(),
+        std::static_pointer_cast<CHIPEventOpenCL>(Event)->getNativePtr());
+  else
+    Status = ::clEnqueueSVMMigrateMem(
+        ClQueue_->get(), 1, &Ptr, &Count, Flags,
+        SyncQueuesEventHandles.size(), SyncQueuesEventHandles.data(),
+        std::static_pointer_cast<CHIPEventOpenCL>(Event)->getNativePtr());
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorRuntimeMemory);
+  updateLastEvent(Event);
+  return Event;
+}
+
+std::shared_ptr<chipstar::Event>
+CHIPQueueOpenCL::memAdviseImpl(const void *Ptr, size_t Count,
+                               hipMemoryAdvise Advice, bool ToHost) {
+  // cl_intel_unified_shared_memory does not define any advice values yet and
+  // SVM has none, so the only hint we can act on is the preferred location:
+  // migrate the range there now, which is where the driver would otherwise
+  // move it on the first access.
+  if (Advice == hipMemAdviseSetPreferredLocation)
+    return memPrefetchImpl(Ptr, Count, ToHost);
+  return nullptr;
 }
 
 std::shared_ptr<chipstar::Event> CHIPQueueOpenCL::enqueueBarrierImpl(
@@ -125,15 +125,39 @@ struct CHIPContextUSMExts {
   clDeviceMemAllocINTEL_fn clDeviceMemAllocINTEL;
   clHostMemAllocINTEL_fn clHostMemAllocINTEL;
   clMemFreeINTEL_fn clMemFreeINTEL;
+  clEnqueueMigrateMemINTEL_fn clEnqueueMigrateMemINTEL;
 };
 
-using const_svm_alloc_iterator = ConstMapKeyIterator<
-    std::map<std::shared_ptr<void>, size_t, PointerCmp<void>>>;
+#ifdef cl_khr_command_buffer
+struct CHIPContextCommandBufferExts {
+  clCreateCommandBufferKHR_fn clCreateCommandBufferKHR;
+  clCommandNDRangeKernelKHR_fn clCommandNDRangeKernelKHR;
+  clFinalizeCommandBufferKHR_fn clFinalizeCommandBufferKHR;
+  clEnqueueCommandBufferKHR_fn clEnqueueCommandBufferKHR;
+  clReleaseCommandBufferKHR_fn clReleaseCommandBufferKHR;
+};
+#endif
+
+/// A snapshot of the SVM allocations for annotating them to kernels which
+/// may access them indirectly. The allocations are released only after the
+/// last holder of a snapshot containing them lets go of it.
+struct SvmAnnotation {
+  /// MemoryManager::getGeneration() at the time of the snapshot.
+  uint64_t Generation;
+  std::vector<void *> Pointers;
+  std::vector<std::shared_ptr<void>> KeepAlives;
+};
 
 class MemoryManager {
   // ContextMutex should be enough
 
   std::map<std::shared_ptr<void>, size_t, PointerCmp<void>> Allocations_;
+  /// Incremented on every change to Allocations_. Starts from one so zero
+  /// can mean "never annotated".
+  uint64_t Generation_ = 1;
+  /// A snapshot of the current allocations. Dropped on changes to them and
+  /// rebuilt on demand.
+  std::shared_ptr<const SvmAnnotation> SvmAnnotation_;
   cl::Context Context_;
   cl::Device Device_;
 
@@ -156,11 +180,9 @@ public:
   void clear();
 
   size_t getNumAllocations() const { return Allocations_.size(); }
-  IteratorRange<const_svm_alloc_iterator> getSvmPointers() const {
-    return IteratorRange<const_svm_alloc_iterator>(
-        const_svm_alloc_iterator(Allocations_.begin()),
-        const_svm_alloc_iterator(Allocations_.end()));
-  }
+  uint64_t getGeneration() const { return Generation_; }
+  /// Return a snapshot of the current allocations.
+  std::shared_ptr<const SvmAnnotation> getSvmAnnotation();
 
   bool usesUSM() const noexcept { return UseIntelUSM; }
   bool usesSVM() const noexcept { return !usesUSM(); }
@@ -173,12 +195,18 @@ private:
   bool SupportsFineGrainSVM;
   CHIPContextUSMExts USM;
   MemoryManager MemManager_;
+  bool SupportsCommandBuffers = false;
+  bool SupportsSimultaneousCommandBuffers = false;
+#ifdef cl_khr_command_buffer
+  CHIPContextCommandBufferExts CommandBuffer;
+#endif
 
 public:
   bool allDevicesSupportFineGrainSVMorUSM();
   CHIPContextOpenCL(cl::Context CtxIn, cl::Device Dev, cl::Platform Plat);
   virtual ~CHIPContextOpenCL() {
     logTrace("CHIPContextOpenCL::~CHIPContextOpenCL");
+    ArgSpillPool_.clear();
     MemManager_.clear();
     delete ChipDevice_;
   }
@@ -187,17 +215,37 @@ public:
       chipstar::HostAllocFlags Flags = chipstar::HostAllocFlags()) override;
 
   bool isAllocatedPtrMappedToVM(void *Ptr) override { return false; } // TODO
+  bool isHostAccessible(const chipstar::AllocationInfo &AllocInfo) override;
   virtual void freeImpl(void *Ptr) override;
   cl::Context *get();
 
   size_t getNumAllocations() const { return MemManager_.getNumAllocations(); }
-  IteratorRange<const_svm_alloc_iterator> getSvmPointers() const {
+  uint64_t getAllocationGeneration() const {
+    return MemManager_.getGeneration();
+  }
+  std::shared_ptr<const SvmAnnotation> getSvmAnnotation() {
     assert(MemManager_.usesSVM());
-    return MemManager_.getSvmPointers();
+    return MemManager_.getSvmAnnotation();
   }
 
   bool usesUSM() const noexcept { return MemManager_.usesUSM(); }
   bool usesSVM() const noexcept { return MemManager_.usesSVM(); }
+  const CHIPContextUSMExts &getUSMExts() const noexcept { return USM; }
+
+  /// True if graphs can be recorded into cl_khr_command_buffer objects
+  bool supportsCommandBuffers() const noexcept {
+    return SupportsCommandBuffers;
+  }
+  /// True if a command buffer can be enqueued while a previous submission of
+  /// it is still pending.
+  bool supportsSimultaneousCommandBuffers() const noexcept {
+    return SupportsSimultaneousCommandBuffers;
+  }
+#ifdef cl_khr_command_buffer
+  const CHIPContextCommandBufferExts &getCommandBufferExts() const noexcept {
+    return CommandBuffer;
+  }
+#endif
 };
 
 class CHIPDeviceOpenCL : public chipstar::Device {
@@ -209,6 +257,10 @@ private:
   cl_device_fp_atomic_capabilities_ext Fp64AtomicAddCapabilities_;
   bool HasSubgroupBallot_ = false;
 
+  /// Compiled runtime device library modules, by their SPIR-V binary.
+  std::unordered_map<const void *, cl::Program> RuntimeObjects_;
+  std::mutex RuntimeObjectsMtx_;
+
 public:
   ~CHIPDeviceOpenCL() override {
     logTrace("CHIPDeviceOpenCL::~CHIPDeviceOpenCL");
@@ -254,6 +306,10 @@ public:
   }
 
   bool hasBallot() const noexcept { return HasSubgroupBallot_; }
+
+  /// Return the runtime device library module 'IL' compiled for the device.
+  /// Each module is compiled once and shared by the programs linking it.
+  cl::Program getRuntimeObject(std::string_view IL);
 };
 
 class CHIPQueueOpenCL : public chipstar::Queue {
@@ -295,9 +351,13 @@ public:
   launchImpl(chipstar::ExecItem *ExecItem) override;
   virtual void addCallback(hipStreamCallback_t Callback,
                            void *UserData) override;
+  virtual std::shared_ptr<chipstar::Event> createHostSignalEvent() override;
   virtual void finish() override;
   virtual std::shared_ptr<chipstar::Event>
   memCopyAsyncImpl(void *Dst, const void *Src, size_t Size) override;
+  virtual std::shared_ptr<chipstar::Event>
+  memCopyBatchAsyncImpl(void *const *Dsts, const void *const *Srcs,
+                        const size_t *Sizes, size_t Count) override;
   cl::CommandQueue *get();
   virtual std::shared_ptr<chipstar::Event>
   memFillAsyncImpl(void *Dst, size_t Size, const void *Pattern,
@@ -316,12 +376,63 @@ public:
       const std::vector<std::shared_ptr<chipstar::Event>> &EventsToWaitFor)
       override;
   virtual std::shared_ptr<chipstar::Event> enqueueMarkerImpl() override;
+  virtual chipstar::NativeGraph *createNativeGraph() override;
   virtual std::shared_ptr<chipstar::Event>
-  memPrefetchImpl(const void *Ptr, size_t Count) override;
+  enqueueNativeGraphImpl(chipstar::NativeGraph *Graph) override;
+  virtual std::shared_ptr<chipstar::Event>
+  memPrefetchImpl(const void *Ptr, size_t Count, bool ToHost) override;
+  virtual std::shared_ptr<chipstar::Event>
+  memAdviseImpl(const void *Ptr, size_t Count, hipMemoryAdvise Advice,
+                bool ToHost) override;
   std::vector<cl_event>
   addDependenciesQueueSync(std::shared_ptr<chipstar::Event> TargetEvent);
 };
 
+#ifdef cl_khr_command_buffer
+/**
+ * @brief Graph recorded into a cl_khr_command_buffer.
+ *
+ * Kernel nodes are recorded with their arguments and indirect access
+ * annotations as they are at the time of the recording. Empty nodes only
+ * forward the dependencies. Other node types are not recorded.
+ */
+class CHIPNativeGraphOpenCL : public chipstar::NativeGraph {
+  CHIPContextOpenCL *Ctx_;
+  cl_command_queue ClQueue_;
+  cl_command_buffer_khr CommandBuffer_ = nullptr;
+
+  /// The sync points marking the completion of the i-th added node are
+  /// SyncPoints_[SyncPointOffsets_[i]..SyncPointOffsets_[i + 1]).
+  std::vector<size_t> SyncPointOffsets_{0};
+  std::vector<cl_sync_point_khr> SyncPoints_;
+  std::vector<cl_sync_point_khr> WaitList_;
+
+  /// SVM allocations annotated to the recorded kernels. Nullptr if the
+  /// context uses USM or no recorded kernel needs the annotation.
+  std::shared_ptr<const SvmAnnotation> SvmAnnotation_;
+
+  /// Completion of the last submission
+  cl_event LastSubmission_ = nullptr;
+
+  bool addKernel_(CHIPExecItemOpenCL *ExecItem);
+
+public:
+  CHIPNativeGraphOpenCL(CHIPContextOpenCL *Ctx, cl_command_queue ClQueue);
+  virtual ~CHIPNativeGraphOpenCL() override;
+
+  /// Create the command buffer. Returns false on failure.
+  bool init();
+
+  virtual bool addNode(CHIPGraphNode *Node, const size_t *Deps,
+                       size_t NumDeps) override;
+  virtual bool finalize() override;
+  virtual bool isStale() override;
+  virtual bool isReady() override;
+
+  cl_int enqueue(const std::vector<cl_event> &WaitEvents, cl_event *Event);
+};
+#endif
+
 class CHIPKernelOpenCL : public chipstar::Kernel {
 private:
   std::string Name_;
@@ -331,6 +442,19 @@ private:
   size_t StaticLocalSize_;
   size_t PrivateSize_;
 
+  /// The generation of the SVM allocations annotated to the cl_kernel, or
+  /// zero if none. See annotateIndirectPointers().
+  uint64_t SvmAnnotationGeneration_ = 0;
+  /// True if the USM indirect access flags are set on the cl_kernel.
+  bool IndirectAccessEnabled_ = false;
+
+public:
+  /// Guards the indirect access execution info of the cl_kernel and
+  /// SvmAnnotationGeneration_ and IndirectAccessEnabled_, which track it.
+  std::mutex ExecInfoMtx;
+
+private:
+
   CHIPModuleOpenCL *Module;
   CHIPDeviceOpenCL *Device;
 
@@ -347,6 +471,15 @@ public:
   cl::Kernel *get();
   CHIPKernelOpenCL *clone();
 
+  uint64_t getSvmAnnotationGeneration() const {
+    return SvmAnnotationGeneration_;
+  }
+  void setSvmAnnotationGeneration(uint64_t Generation) {
+    SvmAnnotationGeneration_ = Generation;
+  }
+  bool isIndirectAccessEnabled() const { return IndirectAccessEnabled_; }
+  void setIndirectAccessEnabled() { IndirectAccessEnabled_ = true; }
+
   CHIPModuleOpenCL *getModule() override { return Module; }
   const CHIPModuleOpenCL *getModule() const override { return Module; }
   virtual hipError_t getAttributes(hipFuncAttributes *Attr) override;
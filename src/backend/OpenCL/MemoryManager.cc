@@ -35,6 +35,8 @@ void MemoryManager::init(cl::Context C, cl::Device D, CHIPContextUSMExts &U,
 
 MemoryManager &MemoryManager::operator=(MemoryManager &&Rhs) {
   Allocations_ = std::move(Rhs.Allocations_);
+  Generation_ = Rhs.Generation_;
+  SvmAnnotation_ = std::move(Rhs.SvmAnnotation_);
   Context_ = std::move(Rhs.Context_);
   Device_ = std::move(Rhs.Device_);
   USM = std::move(Rhs.USM);
@@ -86,6 +88,8 @@ void *MemoryManager::allocate(size_t Size, size_t Alignment,
     logTrace("Memory allocated: {} / {}\n", Ptr, Size);
     assert(Allocations_.find(SPtr) == Allocations_.end());
     Allocations_.emplace(SPtr, Size);
+    Generation_++;
+    SvmAnnotation_.reset();
   } else
     CHIPERR_LOG_AND_THROW("clSVMAlloc failed", hipErrorMemoryAllocation);
 
@@ -94,8 +98,13 @@ void *MemoryManager::allocate(size_t Size, size_t Alignment,
 
 bool MemoryManager::free(void *Ptr) {
   auto I = Allocations_.find(Ptr);
-  if (I != Allocations_.end())
+  if (I != Allocations_.end()) {
+    // The memory is released once the kernels annotated with the
+    // allocation drop their SVM annotation.
     Allocations_.erase(I);
+    Generation_++;
+    SvmAnnotation_.reset();
+  }
   return true;
 }
 
@@ -130,4 +139,26 @@ bool MemoryManager::pointerInfo(void *Ptr, void **Base, size_t *Size) {
   return false;
 }
 
-void MemoryManager::clear() { Allocations_.clear(); }
+void MemoryManager::clear() {
+  Allocations_.clear();
+  SvmAnnotation_.reset();
+  Generation_++;
+}
+
+std::shared_ptr<const SvmAnnotation> MemoryManager::getSvmAnnotation() {
+  if (SvmAnnotation_) {
+    assert(SvmAnnotation_->Generation == Generation_);
+    return SvmAnnotation_;
+  }
+
+  auto Annotation = std::make_shared<SvmAnnotation>();
+  Annotation->Generation = Generation_;
+  Annotation->Pointers.reserve(Allocations_.size());
+  Annotation->KeepAlives.reserve(Allocations_.size());
+  for (auto &[Ptr, Size] : Allocations_) {
+    Annotation->Pointers.push_back(Ptr.get());
+    Annotation->KeepAlives.push_back(Ptr);
+  }
+  SvmAnnotation_ = std::move(Annotation);
+  return SvmAnnotation_;
+}
@@ -31,6 +31,7 @@
 #include <vector>
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <unordered_set>
 #include <utility>
@@ -38,6 +39,7 @@
 #include <algorithm>
 #include <iostream>
 #include <mutex>
+#include <thread>
 #include <queue>
 #include <stack>
 
@@ -52,14 +54,24 @@ struct ihipGraph {};
 struct hipGraphNode {};
 struct hipGraphExec {};
 
-bool filterSPIRV(const char *Bytes, size_t NumBytes, std::string &Dst);
-bool parseSPIR(uint32_t *Stream, size_t NumWords,
-               OpenCLFunctionInfoMap &FuncInfoMap);
+/// Post-process a SPIR-V binary into Dst and collect the kernel info of
+/// it into FuncInfoMap in the same pass over the instructions. The names of
+/// the symbols the binary imports are stored in Imports if it's given. The
+/// kernel info is taken from the kernel info table of the binary, if it has
+/// one, unless UseKernelInfoTable is false.
+bool filterSPIRV(const char *Bytes, size_t NumBytes, std::string &Dst,
+                 OpenCLFunctionInfoMap &FuncInfoMap,
+                 std::vector<std::string> *Imports = nullptr,
+                 bool UseKernelInfoTable = true);
+
+/// Return the names of the symbols a SPIR-V binary exports to other modules.
+std::vector<std::string> getExportedSymbols(std::string_view Binary);
 
 /// A prefix given to lowered global scope device variables.
 constexpr char ChipVarPrefix[] = "__chip_var_";
 /// A prefix used for a shadow kernel used for querying device
-/// variable properties.
+/// variable properties. The per-variable shadow kernels are only found in
+/// modules built without the ChipVar*TableKernelName kernels.
 constexpr char ChipVarInfoPrefix[] = "__chip_var_info_";
 /// A prefix used for a shadow kernel used for binding storage to
 /// device variables.
@@ -67,6 +79,19 @@ constexpr char ChipVarBindPrefix[] = "__chip_var_bind_";
 /// A prefix used for a shadow kernel used for initializing device
 /// variables.
 constexpr char ChipVarInitPrefix[] = "__chip_var_init_";
+/// Name of a shadow kernel for querying the names and properties of all the
+/// device variables of a module in one launch. It writes the number of
+/// variables and the size of the table in bytes. If the size is at most the
+/// second argument, these are followed by a CHIPVarInfo for each variable in
+/// the order of their names and then the null-terminated names in the same
+/// order.
+constexpr char ChipVarInfoTableKernelName[] = "__chip_vars_info";
+/// Name of a shadow kernel for binding storage to all the device variables of
+/// a module. It takes an array of addresses in the order of variable names.
+constexpr char ChipVarBindTableKernelName[] = "__chip_vars_bind";
+/// Name of a shadow kernel for initializing all the device variables of a
+/// module which have an initializer.
+constexpr char ChipVarInitTableKernelName[] = "__chip_vars_init";
 /// A structure to where properties of a device variable are written.
 /// CHIPVarInfo[0]: Size in bytes.
 /// CHIPVarInfo[1]: Requested alignment.
@@ -84,8 +109,37 @@ constexpr char ChipNonSymbolResetKernelName[] = "__chip_reset_non_symbols";
 /// variables is '<ChipSpilledArgsVarPrefix><kernel-name>'
 constexpr char ChipSpilledArgsVarPrefix[] = "__chip_spilled_args_";
 
+/// The prefix for global-scope variables in SPIR-V modules marking kernels
+/// which access memory only through their pointer arguments.
+///
+/// see HipIndirectAccess.cpp for details. Full name of such variables is
+/// '<ChipNoIndirectAccessVarPrefix><kernel-name>'
+constexpr char ChipNoIndirectAccessVarPrefix[] = "__chip_no_indirect_access_";
+
+/// The name of a global-scope variable in SPIR-V modules carrying a table of
+/// the kernels and their parameters.
+///
+/// see HipKernelInfo.cpp for the format. When present and consistent with
+/// the entry points, the kernel parameters are not decoded from the SPIR-V
+/// types.
+constexpr char ChipKernelInfoVarName[] = "__chip_kernel_info";
+
 /// The name of a global variable which indicates, when non-zero, if
 /// the abort() function was called by a kernel.
 constexpr char ChipDeviceAbortFlagName[] = "__chipspv_abort_called";
 
+/// The name of a global variable holding the printf buffer of the module.
+///
+/// see CHIPPrintf.hh. It is present only in modules built with the
+/// CHIP_PRINTF_BUFFER option whose kernels call printf().
+constexpr char ChipPrintfBufferVarName[] = "__chip_printf_buffer";
+
+/// The name of a shadow kernel for querying the format strings of the printf
+/// calls lowered to printf buffer records.
+///
+/// The kernel has parameters (int64_t *Out, int64_t Capacity): it writes the
+/// size of the nul-separated format strings to Out[0] and, if the size is at
+/// most 'Capacity', the format strings after it.
+constexpr char ChipPrintfFormatsKernelName[] = "__chip_printf_formats";
+
 #endif
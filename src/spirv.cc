@@ -28,8 +28,8 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
-#include <regex>
 
 #include "common.hh"
 #include "spirv.hh"
@@ -81,7 +81,7 @@ public:
   virtual SPVStorageClass getSC() { return SPVStorageClass::Private; }
 };
 
-typedef std::map<InstWord, SPIRVtype *> SPIRTypeMap;
+typedef std::unordered_map<InstWord, SPIRVtype *> SPIRTypeMap;
 
 class SPIRVtypePOD : public SPIRVtype {
 public:
@@ -191,7 +191,7 @@ public:
   }
 };
 
-typedef std::map<InstWord, SPIRVConstant *> SPIRVConstMap;
+typedef std::unordered_map<InstWord, SPIRVConstant *> SPIRVConstMap;
 
 // Parses and checks SPIR-V header. Sets word buffer pointer to poin
 // past the header and updates NumWords count to exclude header words.
@@ -278,11 +278,11 @@ public:
             (getWord(1) == (InstWord)spv::SourceLanguageOpenCL_CPP));
   }
 
-  bool isEntryPoint() {
+  bool isEntryPoint() const {
     return (Opcode_ == spv::Op::OpEntryPoint) &&
            (getWord(1) == (InstWord)spv::ExecutionModelKernel);
   }
-  InstWord entryPointID() { return getWord(2); }
+  InstWord entryPointID() const { return getWord(2); }
   std::string_view entryPointName() const { return Extra_; }
 
   size_t size() const { return WordCount_; }
@@ -357,7 +357,7 @@ public:
   }
 
   SPIRVtype *decodeType(SPIRTypeMap &TypeMap, SPIRVConstMap &ConstMap,
-                        size_t PointerSize) {
+                        size_t PointerSize) const {
     if (Opcode_ == spv::Op::OpTypeVoid) {
       return new SPIRVtypePOD(getWord(1), 0);
     }
@@ -483,10 +483,6 @@ static std::string_view parseLinkageAttributeName(const SPIRVinst &Inst) {
   return parseLiteralString(&Inst.getWord(3), StrSize);
 }
 
-static std::string_view parseLinkageAttributeName(const SPIRVinst *Inst) {
-  return parseLinkageAttributeName(*Inst);
-}
-
 static spv::LinkageType parseLinkageAttributeType(const SPIRVinst &Inst) {
   assert(Inst.isDecoration(spv::DecorationLinkageAttributes));
   return static_cast<spv::LinkageType>(Inst.getWord(Inst.size() - 1));
@@ -504,25 +500,43 @@ static IteratorRange<const InstWord *> getWordRange(const InstWord *Begin,
 }
 
 class SPIRVmodule {
-  std::map<InstWord, std::string> EntryPoints_;
+  std::unordered_map<InstWord, std::string_view> EntryPoints_;
   SPIRTypeMap TypeMap_;
   SPIRVConstMap ConstMap_;
   SPVFuncInfoMap KernelInfoMap_;
-  // Records of result IDs decorated with ByVal function parameter attribute.
-  std::map<InstWord, bool> ByValParams_;
-  std::unordered_map<InstWord, std::unique_ptr<SPIRVinst>> IdToInstMap_;
+  // Result IDs decorated with ByVal function parameter attribute.
+  std::unordered_set<InstWord> ByValParams_;
+  /// Words of the constants, by result ID. Points into the parsed binary.
+  std::unordered_map<InstWord, const InstWord *> Constants_;
   /// Names of globals and functions.
-  std::map<InstWord, std::string_view> LinkNames_;
-  std::map<std::string_view, std::vector<std::pair<uint16_t, uint16_t>>>
+  std::unordered_map<InstWord, std::string_view> LinkNames_;
+  std::unordered_map<std::string_view,
+                     std::vector<std::pair<uint16_t, uint16_t>>>
       SpilledArgAnnotations_;
-
-  bool MemModelCL_;
-  bool KernelCapab_;
-  bool ExtIntOpenCL_;
-  bool HeaderOK_;
-  bool ParseOK_;
+  /// Names of the kernels without indirect memory accesses.
+  std::unordered_set<std::string_view> NoIndirectAccessKernels_;
+
+  /// Kernel infos decoded from the kernel info table, by kernel name.
+  std::unordered_map<std::string, std::shared_ptr<SPVFuncInfo>> TableInfos_;
+  /// Set if the kernel info table may be used instead of decoding the
+  /// kernel parameters.
+  bool TableEnabled_;
+  /// Set if a kernel info table has been decoded.
+  bool HasTable_ = false;
+  bool InFunctions_ = false;
+
+  size_t PointerSize_ = 0;
+  SPVFuncInfo *CurrentKernelInfo_ = nullptr;
+
+  bool MemModelCL_ = false;
+  bool KernelCapab_ = false;
+  bool ExtIntOpenCL_ = false;
+  bool HeaderOK_ = false;
 
 public:
+  SPIRVmodule(bool UseKernelInfoTable = true)
+      : TableEnabled_(UseKernelInfoTable) {}
+
   ~SPIRVmodule() {
     for (auto I : TypeMap_)
       delete I.second;
@@ -545,27 +559,45 @@ public:
     // Check(KernelCapab_, "Kernel capability missing.");
     // Check(ExtIntOpenCL_, "Missing extended OpenCL instructions.");
     Check(MemModelCL_, "Incorrect memory model.");
-    Check(ParseOK_, "An error encountered during parsing.");
     return AllOk;
   }
 
-  bool parseSPIRV(const InstWord *Stream, size_t NumWords) {
-    KernelCapab_ = false;
-    ExtIntOpenCL_ = false;
-    HeaderOK_ = false;
-    MemModelCL_ = false;
-    ParseOK_ = false;
-    HeaderOK_ = parseHeader(Stream, NumWords);
+  /// Parse the header and move 'Stream' past it. The instructions
+  /// are then given one by one to parseInstruction().
+  bool parseHeader(const InstWord *&Stream, size_t &NumWords) {
+    HeaderOK_ = ::parseHeader(Stream, NumWords);
+    return HeaderOK_;
+  }
 
-    // INSTRUCTION STREAM
-    ParseOK_ = parseInstructionStream(Stream, NumWords);
-    return valid();
+  /// Return true if the kernel info table was used and it does not
+  /// describe exactly the entry points of the module. The module must
+  /// then be parsed again with the table disabled.
+  bool hasStaleKernelInfoTable() const {
+    if (!HasTable_)
+      return false;
+    if (TableInfos_.size() != EntryPoints_.size())
+      return true;
+    for (auto &[ID, Name] : EntryPoints_)
+      if (!TableInfos_.count(std::string(Name)))
+        return true;
+    return false;
   }
 
   bool fillModuleInfo(OpenCLFunctionInfoMap &ModuleMap) {
     if (!valid())
       return false;
 
+    if (HasTable_) {
+      assert(!hasStaleKernelInfoTable());
+      for (auto &[Name, FnInfo] : TableInfos_) {
+        if (NoIndirectAccessKernels_.count(Name))
+          FnInfo->MayHaveIndirectAccess_ = false;
+        ModuleMap.emplace(Name, FnInfo);
+      }
+      TableInfos_.clear();
+      return true;
+    }
+
     for (auto i : EntryPoints_) {
       InstWord EntryPointID = i.first;
       std::string_view KernelName = i.second;
@@ -573,29 +605,227 @@ public:
       assert(Fi != KernelInfoMap_.end());
       auto FnInfo = Fi->second;
 
-      if (SpilledArgAnnotations_.count(KernelName))
-        for (auto &Kv : SpilledArgAnnotations_[KernelName])
+      auto Annotation = SpilledArgAnnotations_.find(KernelName);
+      if (Annotation != SpilledArgAnnotations_.end())
+        for (auto &Kv : Annotation->second)
           FnInfo->SpilledArgs_.insert(Kv);
 
-      ModuleMap.emplace(std::make_pair(i.second, FnInfo));
+      if (NoIndirectAccessKernels_.count(KernelName))
+        FnInfo->MayHaveIndirectAccess_ = false;
+
+      ModuleMap.emplace(std::string(KernelName), FnInfo);
     }
     KernelInfoMap_.clear();
 
     return true;
   }
 
+  /// Process an instruction. The instruction words must stay valid
+  /// until fillModuleInfo() has been called.
+  void parseInstruction(const SPIRVinst &Inst) {
+    if (Inst.isFunction())
+      InFunctions_ = true;
+    // The kernel info table precedes the functions. With it, nothing in
+    // the function definitions is needed.
+    if (HasTable_ && InFunctions_)
+      return;
+
+    if (Inst.isKernelCapab())
+      KernelCapab_ = true;
+
+    if (Inst.isExtIntOpenCL())
+      ExtIntOpenCL_ = true;
+
+    if (Inst.isMemModelOpenCL()) {
+      MemModelCL_ = true;
+      PointerSize_ = Inst.getPointerSize();
+      assert(PointerSize_ > 0);
+    }
+
+    if (Inst.isEntryPoint())
+      EntryPoints_.emplace(Inst.entryPointID(), Inst.entryPointName());
+
+    if (Inst.isType())
+      TypeMap_.emplace(Inst.getTypeID(),
+                       Inst.decodeType(TypeMap_, ConstMap_, PointerSize_));
+
+    if (Inst.isFunction() && EntryPoints_.count(Inst.getFunctionID())) {
+      auto KernelID = Inst.getFunctionID();
+      assert(!KernelInfoMap_.count(KernelID) &&
+             "Overwriting existing kernel function info!");
+      auto FnInfo = std::make_shared<SPVFuncInfo>();
+      KernelInfoMap_[KernelID] = FnInfo;
+      CurrentKernelInfo_ = FnInfo.get();
+
+      // ret type must be void
+      assert(TypeMap_.count(Inst.getFunctionRetType()));
+      assert(TypeMap_[Inst.getFunctionRetType()]->size() == 0);
+    }
+
+    if (Inst.isa<spv::OpFunctionParameter>() && CurrentKernelInfo_)
+      processKernelParameter(Inst, *CurrentKernelInfo_);
+
+    if (Inst.isa<spv::OpFunctionEnd>())
+      CurrentKernelInfo_ = nullptr;
+
+    if (Inst.isConstant()) {
+      auto *Const = Inst.decodeConstant(TypeMap_);
+      ConstMap_.emplace(Inst.getResultID(), Const);
+    }
+
+    // Only the constants are looked up by ID (for the spill annotations).
+    if (Inst.isConstant() || Inst.isa<spv::OpConstantComposite>())
+      Constants_[Inst.getResultID()] = &Inst.getWord(0);
+
+    if (Inst.isDecoration(spv::DecorationLinkageAttributes)) {
+      auto TargetID = Inst.getWord(1);
+      LinkNames_[TargetID] = parseLinkageAttributeName(Inst);
+    }
+
+    if (Inst.isDecoration(spv::DecorationFuncParamAttr)) {
+      auto Attr = parseFunctionParameterAttribute(Inst);
+      if (Attr == spv::FunctionParameterAttributeByVal)
+        ByValParams_.insert(Inst.getWord(1));
+    }
+
+    if (Inst.isGlobalVariable()) {
+      auto Name = getLinkNameOr(Inst, "");
+      if (TableEnabled_ && Name == ChipKernelInfoVarName) {
+        HasTable_ = decodeKernelInfoTable(Inst);
+        if (!HasTable_) {
+          logWarn("SPIR-V Parser: Invalid kernel info table. Decoding the "
+                  "kernel parameters instead.");
+          TableInfos_.clear();
+        }
+      }
+      auto NoIndirectAccess = std::string_view(ChipNoIndirectAccessVarPrefix);
+      if (startsWith(Name, NoIndirectAccess))
+        NoIndirectAccessKernels_.insert(Name.substr(NoIndirectAccess.size()));
+
+      auto SpillArgAnnotation = std::string_view(ChipSpilledArgsVarPrefix);
+      if (startsWith(Name, SpillArgAnnotation)) {
+        auto KernelName = Name.substr(SpillArgAnnotation.size());
+        auto &SpillAnnotation = SpilledArgAnnotations_[KernelName];
+        // Get initializer operand.
+        const auto *InitWords = getConstant(Inst.getWord(4));
+        assert(InitWords && "Annotation variable is missing an initializer.");
+        // Init is known to be OpConstantComposite of char array.
+        SPIRVinst Init(InitWords);
+        auto *Type = TypeMap_[Init.getResultTypeID()];
+        assert(Type && dynamic_cast<SPIRVtypeArray *>(Type) &&
+               "Could not type for result ID.");
+        auto *ArrayType = static_cast<SPIRVtypeArray *>(Type);
+        auto ArrLen = ArrayType->elementCount();
+        // Iterate constituents.
+        for (auto EltID : getWordRange(&Init.getWord(3), ArrLen)) {
+          SPIRVinst ConstInt(getConstant(EltID)); // OpConstant
+          uint32_t Annotation = ConstInt.getWord(3);
+          uint16_t ArgIndex = Annotation & 0xffff;
+          uint16_t ArgSize = Annotation >> 16u;
+          SpillAnnotation.push_back(std::make_pair(ArgIndex, ArgSize));
+        }
+      }
+    }
+  }
+
 private:
-  std::string_view getLinkNameOr(const SPIRVinst *Inst,
+  std::string_view getLinkNameOr(const SPIRVinst &Inst,
                                  std::string_view OrValue) const {
-    if (!Inst->hasResultID())
+    if (!Inst.hasResultID())
       return OrValue;
-    auto It = LinkNames_.find(Inst->getResultID());
+    auto It = LinkNames_.find(Inst.getResultID());
     return It != LinkNames_.end() ? It->second : OrValue;
   }
 
-  const SPIRVinst *getInstruction(InstWord ID) const {
-    auto It = IdToInstMap_.find(ID);
-    return It != IdToInstMap_.end() ? It->second.get() : nullptr;
+  const InstWord *getConstant(InstWord ID) const {
+    auto It = Constants_.find(ID);
+    return It != Constants_.end() ? It->second : nullptr;
+  }
+
+  /// Decode the kernel info table emitted by HipKernelInfo.cpp from the
+  /// initializer of the global variable 'Inst'.
+  bool decodeKernelInfoTable(const SPIRVinst &Inst) {
+    if (Inst.size() < 5)
+      return false;
+    const auto *InitWords = getConstant(Inst.getWord(4));
+    if (!InitWords)
+      return false;
+    SPIRVinst Init(InitWords);
+    if (!Init.isa<spv::OpConstantComposite>())
+      return false;
+
+    std::vector<InstWord> Table;
+    Table.reserve(Init.size() - 3);
+    for (auto EltID : getWordRange(&Init.getWord(3), Init.size() - 3)) {
+      const auto *EltWords = getConstant(EltID);
+      if (!EltWords)
+        return false;
+      SPIRVinst Elt(EltWords);
+      if (!Elt.isa<spv::OpConstant>() || Elt.size() != 4)
+        return false;
+      Table.push_back(Elt.getWord(3));
+    }
+
+    size_t Pos = 0;
+    auto Next = [&](InstWord &Word) -> bool {
+      if (Pos >= Table.size())
+        return false;
+      Word = Table[Pos++];
+      return true;
+    };
+
+    constexpr InstWord SupportedVersion = 1;
+    InstWord Version, NumKernels;
+    if (!Next(Version) || Version != SupportedVersion || !Next(NumKernels))
+      return false;
+
+    for (InstWord K = 0; K < NumKernels; K++) {
+      InstWord NameWords;
+      if (!Next(NameWords) || NameWords > Table.size() - Pos)
+        return false;
+      std::string Name((const char *)&Table[Pos],
+                       NameWords * sizeof(InstWord));
+      auto NameEnd = Name.find('\0');
+      if (NameEnd == std::string::npos)
+        return false; // Missing nul-termination.
+      Name.resize(NameEnd);
+      Pos += NameWords;
+
+      auto FnInfo = std::make_shared<SPVFuncInfo>();
+      InstWord NumArgs;
+      if (!Next(NumArgs))
+        return false;
+      for (InstWord A = 0; A < NumArgs; A++) {
+        InstWord Arg;
+        if (!Next(Arg))
+          return false;
+        auto Kind = static_cast<SPVTypeKind>((Arg >> 24u) & 0xf);
+        InstWord SCBits = Arg >> 28u;
+        if (Kind == SPVTypeKind::Unknown || Kind > SPVTypeKind::Sampler ||
+            (SCBits > 3 && SCBits != 0xf))
+          return false;
+        auto SC = SCBits == 0xf ? SPVStorageClass::Unknown
+                                : static_cast<SPVStorageClass>(SCBits);
+        FnInfo->ArgTypeInfo_.emplace_back(
+            SPVArgTypeInfo{Kind, SC, Arg & 0xffffffu});
+      }
+
+      InstWord NumSpilled;
+      if (!Next(NumSpilled))
+        return false;
+      for (InstWord A = 0; A < NumSpilled; A++) {
+        InstWord Annotation;
+        if (!Next(Annotation))
+          return false;
+        uint16_t ArgIndex = Annotation & 0xffff;
+        uint16_t ArgSize = Annotation >> 16u;
+        FnInfo->SpilledArgs_.insert(std::make_pair(ArgIndex, ArgSize));
+      }
+
+      if (!TableInfos_.emplace(std::move(Name), FnInfo).second)
+        return false; // Duplicate kernel.
+    }
+    return Pos == Table.size();
   }
 
   void processKernelParameter(const SPIRVinst &Inst, SPVFuncInfo &FuncInfo) {
@@ -623,114 +853,6 @@ private:
     FuncInfo.ArgTypeInfo_.emplace_back(
         SPVArgTypeInfo{TypeKind, ParamType->getSC(), ParamSize});
   }
-
-  bool parseInstructionStream(const InstWord *Stream, size_t NumWords) {
-    const InstWord *StreamIntPtr = Stream;
-    size_t PointerSize = 0;
-    InstWord CurrentKernelID = 0;
-    SPVFuncInfo *CurrentKernelInfo = nullptr;
-    while (NumWords > 0) {
-      SPIRVinst TempInst(StreamIntPtr);
-      auto *Inst = &TempInst;
-
-      if (Inst->hasResultID()) {
-        Inst = new SPIRVinst(StreamIntPtr);
-        IdToInstMap_[Inst->getResultID()].reset(Inst);
-      }
-
-      if (Inst->isKernelCapab())
-        KernelCapab_ = true;
-
-      if (Inst->isExtIntOpenCL())
-        ExtIntOpenCL_ = true;
-
-      if (Inst->isMemModelOpenCL()) {
-        MemModelCL_ = true;
-        PointerSize = Inst->getPointerSize();
-        assert(PointerSize > 0);
-      }
-
-      if (Inst->isEntryPoint()) {
-        EntryPoints_.emplace(
-            std::make_pair(Inst->entryPointID(), Inst->entryPointName()));
-      }
-
-      if (Inst->isType())
-        TypeMap_.emplace(
-            std::make_pair(Inst->getTypeID(),
-                           Inst->decodeType(TypeMap_, ConstMap_, PointerSize)));
-
-      if (Inst->isFunction() && EntryPoints_.count(Inst->getFunctionID())) {
-        CurrentKernelID = Inst->getFunctionID();
-        assert(!KernelInfoMap_.count(CurrentKernelID) &&
-               "Overwriting existing kernel function info!");
-        auto FnInfo = std::make_shared<SPVFuncInfo>();
-        KernelInfoMap_[CurrentKernelID] = FnInfo;
-        CurrentKernelInfo = FnInfo.get();
-
-        // ret type must be void
-        auto Retty = TypeMap_.find(Inst->getFunctionRetType());
-        assert(Retty != TypeMap_.end());
-        assert(TypeMap_[Inst->getFunctionRetType()]->size() == 0);
-      }
-
-      if (Inst->isa<spv::OpFunctionParameter>() && CurrentKernelInfo)
-        processKernelParameter(*Inst, *CurrentKernelInfo);
-
-      if (Inst->isa<spv::OpFunctionEnd>())
-        CurrentKernelInfo = nullptr;
-
-      if (Inst->isConstant()) {
-        auto *Const = Inst->decodeConstant(TypeMap_);
-        ConstMap_.emplace(std::make_pair(Inst->getResultID(), Const));
-      }
-
-      if (Inst->isDecoration(spv::DecorationLinkageAttributes)) {
-        auto TargetID = Inst->getWord(1);
-        auto LinkName = parseLinkageAttributeName(Inst);
-        LinkNames_[TargetID] = LinkName;
-      }
-
-      if (Inst->isDecoration(spv::DecorationFuncParamAttr)) {
-        auto Attr = parseFunctionParameterAttribute(*Inst);
-        if (Attr == spv::FunctionParameterAttributeByVal) {
-          auto TargetID = Inst->getWord(1);
-          ByValParams_[TargetID] = true;
-        }
-      }
-
-      if (Inst->isGlobalVariable()) {
-        auto Name = getLinkNameOr(Inst, "");
-        auto SpillArgAnnotation = std::string_view(ChipSpilledArgsVarPrefix);
-        if (startsWith(Name, SpillArgAnnotation)) {
-          auto KernelName = Name.substr(SpillArgAnnotation.size());
-          auto &SpillAnnotation = SpilledArgAnnotations_[KernelName];
-          // Get initializer operand.
-          auto *Init = getInstruction(Inst->getWord(4));
-          assert(Init && "Annotation variable is missing an initializer.");
-          // Init is known to be OpConstantComposite of char array.
-          auto *Type = TypeMap_[Init->getResultTypeID()];
-          assert(Type && dynamic_cast<SPIRVtypeArray *>(Type) &&
-                 "Could not type for result ID.");
-          auto *ArrayType = static_cast<SPIRVtypeArray *>(Type);
-          auto ArrLen = ArrayType->elementCount();
-          // Iterate constituents.
-          for (auto EltID : getWordRange(&Init->getWord(3), ArrLen)) {
-            auto *ConstInt = getInstruction(EltID); // OpConstant
-            uint32_t Annotation = ConstInt->getWord(3);
-            uint16_t ArgIndex = Annotation & 0xffff;
-            uint16_t ArgSize = Annotation >> 16u;
-            SpillAnnotation.push_back(std::make_pair(ArgIndex, ArgSize));
-          }
-        }
-      }
-
-      NumWords -= Inst->size();
-      StreamIntPtr += Inst->size();
-    }
-
-    return true;
-  }
 };
 
 using IdMapT = std::unordered_map<InstWord, InstWord>;
@@ -785,123 +907,184 @@ workaroundLlvmSpirvIssue2008(const SPIRVinst &Insn,
   return FilterAction::Keep;
 }
 
-bool filterSPIRV(const char *Bytes, size_t NumBytes, std::string &Dst) {
+// Return true for chipStar device library and SPIR-V translator
+// symbols: names starting with __spirv_, __chip_ or _Z<digits>__chip_.
+static bool isCompilerMagicSymbol(std::string_view Name) {
+  if (startsWith(Name, "__spirv_") || startsWith(Name, "__chip_"))
+    return true;
+  if (!startsWith(Name, "_Z"))
+    return false;
+  auto NameBegin = Name.find_first_not_of("0123456789", 2);
+  return NameBegin != std::string_view::npos &&
+         startsWith(Name.substr(NameBegin), "__chip_");
+}
+
+namespace {
+/// State of filterSPIRV() carried from an instruction to the next.
+struct FilterState {
+  std::unordered_set<std::string_view> EntryPoints;
+  std::unordered_set<InstWord> BuiltIns;
+  std::unordered_map<InstWord, std::string_view> MissingDefs;
+  std::vector<std::string_view> Imports;
+  IdMapT ResultIdMap;
+  IdSetT SampledImgs;
+};
+} // namespace
+
+static FilterAction filterInstruction(const SPIRVinst &Insn,
+                                      FilterState &State,
+                                      std::vector<InstWord> &ReplacementInsn) {
+  if (Insn.isEntryPoint())
+    State.EntryPoints.insert(Insn.entryPointName());
+
+  if (Insn.isExtension() && Insn.getExtension() == "SPV_KHR_linkonce_odr")
+    // Drop SPV_KHR_linkonce_odr and LinkOnceODR linkage attributes
+    // (below) for improving portability. They appear for inline and
+    // template functions. Dealing with fully linked device code the
+    // attribute is no longer needed.
+    return FilterAction::Drop;
+
+  // A workaround for https://github.com/CHIP-SPV/chipStar/issues/48.
+  //
+  // Some Intel Compute Runtime versions fails to compile valid SPIR-V
+  // modules correctly on OpenCL if there are OpEntryPoints and
+  // functions or export linkage attributes by the same name.
+  //
+  // This workaround drops OpName instructions, whose string matches one of
+  // the OpEntryPoint names, and all linkage attribute OpDecorations from the
+  // binary we don't need to preserve. OpNames do not have semantical meaning
+  // and we are not currently linking the SPIR-V modules with anything else.
+  if (Insn.isName() && State.EntryPoints.count(Insn.getName()))
+    return FilterAction::Drop;
+
+  if (Insn.isDecoration(spv::DecorationLinkageAttributes)) {
+    auto LinkName = parseLinkageAttributeName(Insn);
+    if (State.EntryPoints.count(LinkName))
+      return FilterAction::Drop;
+    if (parseLinkageAttributeType(Insn) == spv::LinkageTypeLinkOnceODR)
+      // Drop because the SPV_KHR_linkonce_odr is dropped in the above.
+      return FilterAction::Drop;
+    if (parseLinkageAttributeType(Insn) == spv::LinkageTypeImport) {
+      State.Imports.push_back(LinkName);
+      // We are currently supposed to receive only fully linked
+      // device code (from the user perspective). The user probably
+      // forgot a definition.
+      //
+      // Issue warning unless it's a builtin, magic chipStar or
+      // llvm-spirv symbol.
+      if (!isCompilerMagicSymbol(LinkName) &&
+          !State.BuiltIns.count(Insn.getWord(1)))
+        State.MissingDefs[Insn.getWord(1)] = LinkName;
+    }
+  }
+
+  if (Insn.isDecoration(spv::DecorationBuiltIn)) {
+    State.BuiltIns.insert(Insn.getWord(1));
+    State.MissingDefs.erase(Insn.getWord(1));
+  }
+
+#ifdef CHIP_MALI_GPU_WORKAROUNDS
+  // (Old) Mali GPU drivers have issues consuming valid SPIR-V
+  // modules with NoWrite and NoReadWrite parameter attributes so
+  // drop them. Dropping these should not affect the module's
+  // behavior.
+  if (Insn.isDecoration(spv::DecorationFuncParamAttr)) {
+    auto FnAttr = parseFunctionParameterAttribute(Insn);
+    if (FnAttr == spv::FunctionParameterAttributeNoWrite ||
+        FnAttr == spv::FunctionParameterAttributeNoReadWrite)
+      return FilterAction::Drop;
+  }
+#endif
+
+  return workaroundLlvmSpirvIssue2008(Insn, ReplacementInsn, State.ResultIdMap,
+                                      State.SampledImgs);
+}
+
+bool filterSPIRV(const char *Bytes, size_t NumBytes, std::string &Dst,
+                 OpenCLFunctionInfoMap &FuncInfoMap,
+                 std::vector<std::string> *Imports, bool UseKernelInfoTable) {
   logTrace("filterSPIRV");
 
   auto *WordsPtr = (const InstWord *)Bytes;
   size_t NumWords = NumBytes / sizeof(InstWord);
 
-  if (!parseHeader(WordsPtr, NumWords))
+  SPIRVmodule Mod(UseKernelInfoTable);
+  if (!Mod.parseHeader(WordsPtr, NumWords))
     return false; // Invalid SPIR-V binary.
 
   Dst.reserve(NumBytes);
-  Dst.append(Bytes, (const char *)WordsPtr); // Copy the header.
 
-  // Matches chipStar device library and SPIR-V translator symbols.
-  auto CompilerMagicSymbol =
-      std::regex(R"RE((__spirv_|__chip_|_Z\d*__chip_).*)RE");
-  std::set<std::string_view> EntryPoints;
-  std::unordered_set<InstWord> BuiltIns;
-  std::unordered_map<InstWord, std::string_view> MissingDefs;
-  IdMapT ResultIdMap;
-  IdSetT SampledImgs;
+  // The kept instructions are copied in runs between the dropped and
+  // replaced ones. The first run starts with the header.
+  const char *RunBegin = Bytes;
+  FilterState State;
+  std::vector<InstWord> TransformedInst;
   size_t InsnSize = 0;
   for (size_t I = 0; I < NumWords; I += InsnSize) {
     SPIRVinst Insn(WordsPtr + I);
     InsnSize = Insn.size();
     assert(InsnSize && "Invalid instruction size, will loop forever!");
 
-    if (Insn.isEntryPoint())
-      EntryPoints.insert(Insn.entryPointName());
-
-    if (Insn.isExtension() && Insn.getExtension() == "SPV_KHR_linkonce_odr")
-      // Drop SPV_KHR_linkonce_odr and LinkOnceODR linkage attributes
-      // (below) for improving portability. They appear for inline and
-      // template functions. Dealing with fully linked device code the
-      // attribute is no longer needed.
-      continue;
+    // The kernel info is collected from the original instructions. None
+    // of the instructions the filter drops or changes matter to it.
+    Mod.parseInstruction(Insn);
 
-    // A workaround for https://github.com/CHIP-SPV/chipStar/issues/48.
-    //
-    // Some Intel Compute Runtime versions fails to compile valid SPIR-V
-    // modules correctly on OpenCL if there are OpEntryPoints and
-    // functions or export linkage attributes by the same name.
-    //
-    // This workaround drops OpName instructions, whose string matches one of
-    // the OpEntryPoint names, and all linkage attribute OpDecorations from the
-    // binary we don't need to preserve. OpNames do not have semantical meaning
-    // and we are not currently linking the SPIR-V modules with anything else.
-    if (Insn.isName() && EntryPoints.count(Insn.getName()))
+    auto Action = filterInstruction(Insn, State, TransformedInst);
+    if (Action == FilterAction::Keep)
       continue;
+    assert((Action == FilterAction::Drop || Action == FilterAction::Replace) &&
+           "Unknown instruction filter action!");
+
+    Dst.append(RunBegin, (const char *)(WordsPtr + I));
+    RunBegin = (const char *)(WordsPtr + I + InsnSize);
+    if (Action == FilterAction::Replace)
+      Dst.append((const char *)TransformedInst.data(),
+                 TransformedInst.size() * sizeof(InstWord));
+  }
+  Dst.append(RunBegin, (const char *)(WordsPtr + NumWords));
 
-    if (Insn.isDecoration(spv::DecorationLinkageAttributes)) {
-      auto LinkName = parseLinkageAttributeName(Insn);
-      if (EntryPoints.count(LinkName))
-        continue;
-      if (parseLinkageAttributeType(Insn) == spv::LinkageTypeLinkOnceODR)
-        // Drop because the SPV_KHR_linkonce_odr is dropped in the above.
-        continue;
-      if (parseLinkageAttributeType(Insn) == spv::LinkageTypeImport)
-        // We are currently supposed to receive only fully linked
-        // device code (from the user perspective). The user probably
-        // forgot a definition.
-        //
-        // Issue warning unless it's a builtin, magic chipStar or
-        // llvm-spirv symbol.
-        if (!std::regex_match(LinkName.begin(), LinkName.end(),
-                              CompilerMagicSymbol) &&
-            !BuiltIns.count(Insn.getWord(1)))
-          MissingDefs[Insn.getWord(1)] = LinkName;
+  for (auto &[Ignored, Name] : State.MissingDefs)
+    logWarn("Missing definition for '{}'", Name);
+  if (Imports)
+    Imports->assign(State.Imports.begin(), State.Imports.end());
+
+  if (Mod.hasStaleKernelInfoTable()) {
+    // The module was probably modified after it was compiled.
+    logWarn("SPIR-V Parser: The kernel info table does not match the entry "
+            "points. Decoding the kernel parameters instead.");
+    SPIRVmodule FullMod(/*UseKernelInfoTable=*/false);
+    WordsPtr = (const InstWord *)Bytes;
+    NumWords = NumBytes / sizeof(InstWord);
+    FullMod.parseHeader(WordsPtr, NumWords);
+    for (size_t I = 0; I < NumWords; I += InsnSize) {
+      SPIRVinst Insn(WordsPtr + I);
+      InsnSize = Insn.size();
+      FullMod.parseInstruction(Insn);
     }
+    return FullMod.fillModuleInfo(FuncInfoMap);
+  }
 
-    if (Insn.isDecoration(spv::DecorationBuiltIn)) {
-      BuiltIns.insert(Insn.getWord(1));
-      MissingDefs.erase(Insn.getWord(1));
-    }
+  return Mod.fillModuleInfo(FuncInfoMap);
+}
 
-#ifdef CHIP_MALI_GPU_WORKAROUNDS
-    // (Old) Mali GPU drivers have issues consuming valid SPIR-V
-    // modules with NoWrite and NoReadWrite parameter attributes so
-    // drop them. Dropping these should not affect the module's
-    // behavior.
-    if (Insn.isDecoration(spv::DecorationFuncParamAttr)) {
-      auto FnAttr = parseFunctionParameterAttribute(Insn);
-      if (FnAttr == spv::FunctionParameterAttributeNoWrite ||
-          FnAttr == spv::FunctionParameterAttributeNoReadWrite)
-        continue;
-    }
-#endif
+std::vector<std::string> getExportedSymbols(std::string_view Binary) {
+  auto *WordsPtr = (const InstWord *)Binary.data();
+  size_t NumWords = Binary.size() / sizeof(InstWord);
+  std::vector<std::string> Exports;
+  if (!parseHeader(WordsPtr, NumWords))
+    return Exports;
 
-    std::vector<InstWord> TransformedInst;
-    switch (workaroundLlvmSpirvIssue2008(Insn, TransformedInst, ResultIdMap,
-                                         SampledImgs)) {
-    default:
-      assert(false && "Unknown instruction filter action!");
-      // FALLTHROUGH
-    case FilterAction::Keep:
+  size_t InsnSize = 0;
+  for (size_t I = 0; I < NumWords; I += InsnSize) {
+    SPIRVinst Insn(WordsPtr + I);
+    InsnSize = Insn.size();
+    assert(InsnSize && "Invalid instruction size, will loop forever!");
+    if (Insn.isDecoration(spv::DecorationLinkageAttributes) &&
+        parseLinkageAttributeType(Insn) == spv::LinkageTypeExport)
+      Exports.emplace_back(parseLinkageAttributeName(Insn));
+    // The decorations precede the function definitions.
+    if (Insn.isa<spv::OpFunction>())
       break;
-    case FilterAction::Drop:
-      continue;
-    case FilterAction::Replace: {
-      Dst.append((const char *)&*TransformedInst.begin(),
-                 (const char *)&*TransformedInst.end());
-      continue;
-    }
-    }
-
-    Dst.append((const char *)(WordsPtr + I), InsnSize * sizeof(InstWord));
   }
-
-  for (auto &[Ignored, Name] : MissingDefs)
-    logWarn("Missing definition for '{}'", Name);
-
-  return true;
-}
-
-bool parseSPIR(InstWord *Stream, size_t NumWords,
-               OpenCLFunctionInfoMap &Output) {
-  SPIRVmodule Mod;
-  if (!Mod.parseSPIRV(Stream, NumWords))
-    return false;
-  return Mod.fillModuleInfo(Output);
+  return Exports;
 }
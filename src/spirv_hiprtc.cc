@@ -26,11 +26,16 @@ THE SOFTWARE.
 #include "logging.hh"
 #include "CHIPBackend.hh"
 #include "Utils.hh"
+#include "spirv_hiprtc_cache.hh"
+#ifdef CHIP_HIPRTC_IN_PROCESS
+#include "spirv_hiprtc_inproc.hh"
+#endif
 
 #include <cstdlib>
 #include <regex>
 #include <set>
 #include <fstream>
+#include <sstream>
 
 struct CompileOptions {
   std::vector<std::string> Options; /// All accepted user options.
@@ -43,6 +48,19 @@ static bool saveTemps() {
   return false;
 }
 
+#ifdef CHIP_HIPRTC_IN_PROCESS
+/// Return true if programs should be compiled in-process instead of by
+/// invoking hipcc.
+static bool useInProcessCompiler() {
+  // The intermediate files are only produced by hipcc.
+  if (saveTemps())
+    return false;
+  if (auto *Value = std::getenv("CHIP_RTC_IN_PROCESS"))
+    return std::string_view(Value) != "0";
+  return true;
+}
+#endif
+
 /// Checks the name is valid string for #include (both the "" and <>
 /// forms) and is sensible name for shells as is (doesn't need escaping).
 static bool checkIncludeName(std::string_view Name) {
@@ -59,12 +77,12 @@ static bool createHeaderFiles(const chipstar::Program &Program,
   return true;
 }
 
-static bool createSourceFile(const chipstar::Program &Program,
-                             const fs::path OutputFile,
-                             // A file to output lowered name expressions.
-                             const fs::path LoweredNamesFile) {
-
-  std::ofstream File(OutputFile);
+/// Return the source of 'Program' with its name expressions
+/// appended. 'LoweredNamesFile' is where HipEmitLoweredNames.cpp writes the
+/// lowered names to or empty if they are read from the module directly.
+static std::string createSource(const chipstar::Program &Program,
+                                const fs::path &LoweredNamesFile) {
+  std::ostringstream File;
   File << Program.getSource() << "\n";
 
   // Insert name expressions at the end of the program. They are used
@@ -72,7 +90,7 @@ static bool createSourceFile(const chipstar::Program &Program,
   // instantiate templates.
   const auto &NameExprMap = Program.getNameExpressionMap();
   if (NameExprMap.empty())
-    return File.good();
+    return File.str();
 
   // CUDA NVRTC guide: "... The characters in the name expression
   // string are parsed as a C++ constant expression at the end of the
@@ -81,6 +99,8 @@ static bool createSourceFile(const chipstar::Program &Program,
   for (auto &Kv : Program.getNameExpressionMap())
     File << "    (void *)" << Kv.first << ",\n";
   File << "};\n";
+  if (LoweredNamesFile.empty())
+    return File.str();
 
   // The lowered name expressions are extracted by a LLVM pass which
   // detects the magic variable in the above. Because HIPSPV tool
@@ -92,7 +112,14 @@ extern  "C" __device__ const char *_chip_name_expr_output_file =
     )---"
        << LoweredNamesFile << ";";
 
-  return File.good();
+  return File.str();
+}
+
+static bool createSourceFile(const chipstar::Program &Program,
+                             const fs::path OutputFile,
+                             // A file to output lowered name expressions.
+                             const fs::path LoweredNamesFile) {
+  return writeToFile(OutputFile, createSource(Program, LoweredNamesFile));
 }
 
 /// Filter and translate user given options. Return true if an error
@@ -258,8 +285,8 @@ static void getLoweredNameExpressions(chipstar::Program &Program,
 
 // Compiles sources stored in 'chipstar::Program'. Uses 'WorkingDirectory' for
 // temporary compilation I/O.
-static hiprtcResult compile(chipstar::Program &Program, int NumRawOptions,
-                            const char **RawOptions,
+static hiprtcResult compile(chipstar::Program &Program,
+                            const CompileOptions &ProcessedOptions,
                             fs::path WorkingDirectory) {
   // Create source and header files.
   auto SourceFile = WorkingDirectory / "program.hip";
@@ -267,10 +294,6 @@ static hiprtcResult compile(chipstar::Program &Program, int NumRawOptions,
   auto LoweredNamesFile = WorkingDirectory / "lowerednames.txt";
   auto CompileLogFile = WorkingDirectory / "compile.log";
 
-  CompileOptions ProcessedOptions;
-  if (processOptions(Program, NumRawOptions, RawOptions, ProcessedOptions))
-    return HIPRTC_ERROR_INVALID_INPUT;
-
   if (!createHeaderFiles(Program, WorkingDirectory)) {
     logError("hiprtc: could not create user header files.");
     return HIPRTC_ERROR_COMPILATION;
@@ -309,6 +332,148 @@ static hiprtcResult compile(chipstar::Program &Program, int NumRawOptions,
   return HIPRTC_SUCCESS;
 }
 
+/// Map the name expressions of 'Program' to 'LoweredNames' given in the
+/// name expression order.
+static void setLoweredNames(chipstar::Program &Program,
+                            const std::vector<std::string> &LoweredNames) {
+  auto &NameExprMap = Program.getNameExpressionMap();
+  assert(LoweredNames.size() == NameExprMap.size() || NameExprMap.empty());
+  auto NameIt = LoweredNames.begin();
+  for (auto &Kv : NameExprMap)
+    if (NameIt != LoweredNames.end())
+      Kv.second = *NameIt++;
+}
+
+#ifdef CHIP_HIPRTC_IN_PROCESS
+// Compiles sources stored in 'chipstar::Program' without invoking hipcc or
+// using temporary files.
+static hiprtcResult compileInProcess(chipstar::Program &Program,
+                                     const CompileOptions &ProcessedOptions) {
+  std::string Log, Bundle;
+  std::vector<std::string> LoweredNames;
+  bool Success = chipstar::rtc::compileInProcess(
+      createSource(Program, fs::path()), Program.getHeaders(),
+      ProcessedOptions.Options, Log, Bundle, LoweredNames);
+  Program.appendToLog(Log);
+  if (!Success)
+    return HIPRTC_ERROR_COMPILATION;
+
+  Program.addCode(Bundle);
+  setLoweredNames(Program, LoweredNames);
+  return HIPRTC_SUCCESS;
+}
+#endif
+
+/// Return true if the program is compiled with the in-process compiler
+/// instead of hipcc.
+static bool isCompiledInProcess(const CompileOptions &ProcessedOptions) {
+#ifdef CHIP_HIPRTC_IN_PROCESS
+  if (useInProcessCompiler() && chipstar::rtc::isInProcessCompilerAvailable()) {
+    if (chipstar::rtc::supportsOptions(ProcessedOptions.Options))
+      return true;
+    logDebug("hiprtc: -mllvm options are passed to hipcc.");
+  }
+#endif
+  return false;
+}
+
+static hiprtcResult compileProgram(chipstar::Program &Program,
+                                   const CompileOptions &ProcessedOptions) {
+#ifdef CHIP_HIPRTC_IN_PROCESS
+  if (isCompiledInProcess(ProcessedOptions))
+    return compileInProcess(Program, ProcessedOptions);
+#endif
+
+  // Create temporary directory for compilation I/O.
+  auto TmpDir = createTemporaryDirectory();
+  if (!TmpDir) {
+    logError("hiprtc: Failed to create a temporary directory for compilation.");
+    return HIPRTC_ERROR_COMPILATION;
+  }
+
+  logDebug("hiprtc: Temp directory: '{}'", TmpDir->string());
+  hiprtcResult Result = compile(Program, ProcessedOptions, *TmpDir);
+
+  if (!saveTemps()) {
+    assert(!TmpDir->empty() && *TmpDir != TmpDir->root_path() &&
+           "Attempted to delete a root directory!");
+
+    logDebug("Removing '{}'", TmpDir->string());
+    std::error_code IgnoreErrors;
+    fs::remove_all(*TmpDir, IgnoreErrors);
+  }
+
+  return Result;
+}
+
+/// Return a fingerprint of the files of the toolchain which the compilation
+/// output depends on besides the program: the hipcc configuration, the
+/// headers, the device library and the pass plugin. This tells apart
+/// rebuilds and reinstalls of the same chipStar version.
+static const std::string &getToolchainIdentity(bool InProcess) {
+  static std::once_flag Flags[2];
+  static std::string Identities[2];
+
+  std::call_once(Flags[InProcess], [=]() {
+    std::optional<fs::path> Dir;
+#ifdef CHIP_HIPRTC_IN_PROCESS
+    if (InProcess)
+      Dir = chipstar::rtc::getToolchainPath();
+#endif
+    if (auto HIPCC = getHIPCCPath(); !Dir && HIPCC)
+      Dir = HIPCC->parent_path().parent_path();
+
+    std::vector<fs::path> Paths;
+    if (Dir)
+      for (const char *File :
+           {"bin/hipcc", "share/.hipInfo", "include/hip", "lib/hip-device-lib",
+            "lib/libLLVMHipSpvPasses.so", "lib/llvm/libLLVMHipSpvPasses.so"})
+        Paths.push_back(*Dir / File);
+#ifdef CHIP_SOURCE_DIR
+    // The headers of the source directory (see createCompileCommand()).
+    Paths.push_back(fs::path(CHIP_SOURCE_DIR) / "include/hip");
+    Paths.push_back(fs::path(CHIP_SOURCE_DIR) / "HIP/include/hip");
+#endif
+    Identities[InProcess] = chipstar::rtc::fingerprintFiles(Paths);
+  });
+
+  return Identities[InProcess];
+}
+
+/// Return true if the output of the compilation may depend on files the
+/// cache key does not cover. processOptions() does not pass include paths
+/// through for now, this keeps the cache correct if it starts to.
+static bool hasIncludePaths(const CompileOptions &ProcessedOptions) {
+  for (const auto &Opt : ProcessedOptions.Options)
+    if (startsWith(Opt, "-I") || startsWith(Opt, "-include") ||
+        startsWith(Opt, "--include") || startsWith(Opt, "-isystem"))
+      return true;
+  return false;
+}
+
+/// Return the key of the compilation cache for 'Program'. It covers
+/// everything the compilation output depends on: the program, the options,
+/// the compiler used and the files of the toolchain. Headers outside the
+/// toolchain, such as the C++ standard library headers, are not covered.
+static std::string createCacheKey(const chipstar::Program &Program,
+                                  const CompileOptions &ProcessedOptions) {
+  std::vector<std::string> NameExprs;
+  for (const auto &Kv : Program.getNameExpressionMap())
+    NameExprs.push_back(Kv.first);
+
+  bool InProcess = isCompiledInProcess(ProcessedOptions);
+  return chipstar::rtc::CacheKeyBuilder()
+      .add(CHIPSTAR_VERSION)
+      .add(CHIP_LLVM_VERSION)
+      .add(InProcess ? "in-process" : "hipcc")
+      .add(getToolchainIdentity(InProcess))
+      .add(Program.getSource())
+      .add(Program.getHeaders())
+      .add(ProcessedOptions.Options)
+      .add(NameExprs)
+      .take();
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -397,24 +562,35 @@ hiprtcResult hiprtcCompileProgram(hiprtcProgram Prog, int NumOptions,
   try {
     auto &Program = *(chipstar::Program *)Prog;
 
-    // Create temporary directory for compilation I/O.
-    auto TmpDir = createTemporaryDirectory();
-    if (!TmpDir) {
-      logError(
-          "hiprtc: Failed to create a temporary directory for compilation.");
-      return HIPRTC_ERROR_COMPILATION;
+    CompileOptions ProcessedOptions;
+    if (processOptions(Program, NumOptions, Options, ProcessedOptions))
+      return HIPRTC_ERROR_INVALID_INPUT;
+
+    // The temporary files are only produced by actual compilations. The
+    // headers found through include paths are not part of the cache key.
+    auto *Cache = saveTemps() || hasIncludePaths(ProcessedOptions)
+                      ? nullptr
+                      : chipstar::rtc::getCompileCache();
+    std::string CacheKey;
+    if (Cache) {
+      CacheKey = createCacheKey(Program, ProcessedOptions);
+      if (auto Cached = Cache->lookup(CacheKey)) {
+        Program.appendToLog(Cached->Log);
+        Program.addCode(Cached->Code);
+        setLoweredNames(Program, Cached->LoweredNames);
+        return HIPRTC_SUCCESS;
+      }
     }
 
-    logDebug("hiprtc: Temp directory: '{}'", TmpDir->string());
-    hiprtcResult Result = compile(Program, NumOptions, Options, *TmpDir);
-
-    if (!saveTemps()) {
-      assert(!TmpDir->empty() && *TmpDir != TmpDir->root_path() &&
-             "Attempted to delete a root directory!");
-
-      logDebug("Removing '{}'", TmpDir->string());
-      std::error_code IgnoreErrors;
-      fs::remove_all(*TmpDir, IgnoreErrors);
+    size_t LogStart = Program.getProgramLog().size();
+    hiprtcResult Result = compileProgram(Program, ProcessedOptions);
+    if (Cache && Result == HIPRTC_SUCCESS) {
+      chipstar::rtc::CompileResult ToCache;
+      ToCache.Code = Program.getCode();
+      ToCache.Log = Program.getProgramLog().substr(LogStart);
+      for (const auto &Kv : Program.getNameExpressionMap())
+        ToCache.LoweredNames.push_back(Kv.second);
+      Cache->insert(CacheKey, ToCache);
     }
 
     return Result;
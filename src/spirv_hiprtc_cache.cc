@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "spirv_hiprtc_cache.hh"
+
+#include "logging.hh"
+#include "macros.hh"
+#include "Utils.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+namespace chipstar {
+namespace rtc {
+
+// An entry file starts with this and continues with the key, the code, the
+// log and the lowered names as length-prefixed fields.
+static constexpr std::string_view EntryMagic = "CHIPRTC1";
+
+constexpr size_t DefaultCacheSize = 64 << 20;
+
+static void appendField(std::string &Out, std::string_view Field) {
+  uint64_t Size = Field.size();
+  Out.append(reinterpret_cast<const char *>(&Size), sizeof(Size));
+  Out.append(Field);
+}
+
+CacheKeyBuilder &CacheKeyBuilder::add(std::string_view Field) {
+  appendField(Key_, Field);
+  return *this;
+}
+
+CacheKeyBuilder &
+CacheKeyBuilder::add(const std::map<std::string, std::string> &Fields) {
+  add(std::to_string(Fields.size()));
+  for (const auto &[Name, Value] : Fields)
+    add(Name).add(Value);
+  return *this;
+}
+
+CacheKeyBuilder &CacheKeyBuilder::add(const std::vector<std::string> &Fields) {
+  add(std::to_string(Fields.size()));
+  for (const auto &Field : Fields)
+    add(Field);
+  return *this;
+}
+
+std::string hashKey(std::string_view Key) {
+  // FNV-1a.
+  uint64_t Hash = 0xcbf29ce484222325ull;
+  for (unsigned char C : Key)
+    Hash = (Hash ^ C) * 0x100000001b3ull;
+
+  char Digits[17];
+  snprintf(Digits, sizeof(Digits), "%016llx", (unsigned long long)Hash);
+  return Digits;
+}
+
+std::string fingerprintFiles(const std::vector<fs::path> &Paths) {
+  // Ordered by path, unlike the directory iteration.
+  std::map<std::string, std::string> Files;
+  auto AddFile = [&](const fs::path &Path) {
+    std::error_code EC;
+    auto Size = fs::file_size(Path, EC);
+    if (EC)
+      return;
+    auto Time = fs::last_write_time(Path, EC);
+    if (EC)
+      return;
+    Files[Path.string()] = std::to_string(Size) + ":" +
+                           std::to_string(Time.time_since_epoch().count());
+  };
+
+  for (const auto &Path : Paths) {
+    std::error_code EC;
+    if (!fs::is_directory(Path, EC)) {
+      AddFile(Path);
+      continue;
+    }
+    for (fs::recursive_directory_iterator It(Path, EC), End; !EC && It != End;
+         It.increment(EC)) {
+      std::error_code FileEC;
+      if (fs::is_regular_file(It->path(), FileEC))
+        AddFile(It->path());
+    }
+  }
+
+  return hashKey(CacheKeyBuilder().add(Files).take());
+}
+
+CompileCache::CompileCache(fs::path Dir, size_t MaxBytes)
+    : Dir_(std::move(Dir)), MaxBytes_(MaxBytes) {}
+
+fs::path CompileCache::getEntryPath(const std::string &Key) const {
+  return Dir_ / (hashKey(Key) + std::string(FileExtension));
+}
+
+static size_t getSize(const std::string &Key, const CompileResult &Result) {
+  size_t Size = Key.size() + Result.Code.size() + Result.Log.size();
+  for (const auto &Name : Result.LoweredNames)
+    Size += Name.size();
+  return Size;
+}
+
+std::optional<CompileResult> CompileCache::lookup(const std::string &Key) {
+  {
+    LOCK(Mtx_); // CompileCache::Entries_
+    auto It = Index_.find(Key);
+    if (It != Index_.end()) {
+      Entries_.splice(Entries_.begin(), Entries_, It->second);
+      logDebug("hiprtc: cache hit in memory");
+      return It->second->Result;
+    }
+  }
+
+  auto Result = readFromDisk(Key);
+  if (Result) {
+    logDebug("hiprtc: cache hit on disk");
+    insertToMemory(Key, *Result);
+  }
+  return Result;
+}
+
+void CompileCache::insert(const std::string &Key,
+                          const CompileResult &Result) {
+  if (getSize(Key, Result) > MaxBytes_)
+    return;
+  insertToMemory(Key, Result);
+  writeToDisk(Key, Result);
+}
+
+void CompileCache::insertToMemory(const std::string &Key,
+                                  const CompileResult &Result) {
+  size_t Size = getSize(Key, Result);
+  if (Size > MaxBytes_)
+    return;
+
+  LOCK(Mtx_); // CompileCache::Entries_
+  if (Index_.count(Key))
+    return;
+
+  while (!Entries_.empty() && MemoryBytes_ + Size > MaxBytes_) {
+    MemoryBytes_ -= Entries_.back().Size;
+    Index_.erase(Entries_.back().Key);
+    Entries_.pop_back();
+  }
+
+  Entries_.push_front(Entry{Key, Result, Size});
+  Index_[Entries_.front().Key] = Entries_.begin();
+  MemoryBytes_ += Size;
+}
+
+std::optional<CompileResult>
+CompileCache::readFromDisk(const std::string &Key) {
+  if (Dir_.empty())
+    return std::nullopt;
+
+  auto Path = getEntryPath(Key);
+  std::ifstream File(Path, std::ios::binary);
+  if (!File)
+    return std::nullopt;
+  std::string Data((std::istreambuf_iterator<char>(File)),
+                   std::istreambuf_iterator<char>());
+
+  std::string_view Rest(Data);
+  auto ReadU64 = [&](uint64_t &Value) -> bool {
+    if (Rest.size() < sizeof(Value))
+      return false;
+    std::memcpy(&Value, Rest.data(), sizeof(Value));
+    Rest.remove_prefix(sizeof(Value));
+    return true;
+  };
+  auto ReadField = [&](std::string_view &Field) -> bool {
+    uint64_t Size;
+    if (!ReadU64(Size) || Rest.size() < Size)
+      return false;
+    Field = Rest.substr(0, Size);
+    Rest.remove_prefix(Size);
+    return true;
+  };
+
+  std::string_view StoredKey, Code, Log;
+  uint64_t NumNames;
+  if (!startsWith(Rest, EntryMagic))
+    return std::nullopt;
+  Rest.remove_prefix(EntryMagic.size());
+  if (!ReadField(StoredKey) || !ReadField(Code) || !ReadField(Log) ||
+      !ReadU64(NumNames))
+    return std::nullopt;
+  // A different program with the same hash.
+  if (StoredKey != Key)
+    return std::nullopt;
+
+  CompileResult Result;
+  Result.Code = Code;
+  Result.Log = Log;
+  for (uint64_t I = 0; I < NumNames; I++) {
+    std::string_view Name;
+    if (!ReadField(Name)) {
+      logWarn("hiprtc: truncated cache entry '{}'", Path.string());
+      return std::nullopt;
+    }
+    Result.LoweredNames.emplace_back(Name);
+  }
+
+  // Mark the entry as recently used for evictFromDisk().
+  std::error_code IgnoreErrors;
+  fs::last_write_time(Path, fs::file_time_type::clock::now(), IgnoreErrors);
+  return Result;
+}
+
+void CompileCache::writeToDisk(const std::string &Key,
+                               const CompileResult &Result) {
+  if (Dir_.empty())
+    return;
+
+  std::error_code EC;
+  fs::create_directories(Dir_, EC);
+  if (EC) {
+    logWarn("hiprtc: could not create cache directory '{}': {}",
+            Dir_.string(), EC.message());
+    return;
+  }
+
+  std::string Data(EntryMagic);
+  appendField(Data, Key);
+  appendField(Data, Result.Code);
+  appendField(Data, Result.Log);
+  uint64_t NumNames = Result.LoweredNames.size();
+  Data.append(reinterpret_cast<const char *>(&NumNames), sizeof(NumNames));
+  for (const auto &Name : Result.LoweredNames)
+    appendField(Data, Name);
+
+  // Write to a private file first so that other processes never see
+  // partially written entries.
+  auto Path = getEntryPath(Key);
+  // An entry replaced by the rename below is not counted twice.
+  auto ReplacedSize = fs::file_size(Path, EC);
+  if (EC)
+    ReplacedSize = 0;
+  auto TmpPath = Path;
+  TmpPath += ".tmp" + getRandomString(8);
+  {
+    std::ofstream File(TmpPath, std::ios::binary);
+    File.write(Data.data(), Data.size());
+    if (!File.good()) {
+      logWarn("hiprtc: could not write cache entry '{}'", TmpPath.string());
+      File.close();
+      fs::remove(TmpPath, EC);
+      return;
+    }
+  }
+  fs::rename(TmpPath, Path, EC);
+  if (EC) {
+    fs::remove(TmpPath, EC);
+    return;
+  }
+
+  evictFromDisk(Data.size() - std::min<uintmax_t>(ReplacedSize, Data.size()));
+}
+
+void CompileCache::evictFromDisk(uintmax_t AddedBytes) {
+  LOCK(DiskMtx_); // CompileCache::DiskBytes_
+  // The directory is only scanned initially and when it may need an
+  // eviction.
+  if (DiskBytes_) {
+    *DiskBytes_ += AddedBytes;
+    if (*DiskBytes_ <= MaxBytes_)
+      return;
+  }
+
+  struct EntryFile {
+    fs::file_time_type Time;
+    uintmax_t Size;
+    fs::path Path;
+  };
+  std::vector<EntryFile> Files;
+  uintmax_t TotalSize = 0;
+
+  std::error_code EC;
+  for (fs::directory_iterator It(Dir_, EC), End; !EC && It != End;
+       It.increment(EC)) {
+    const auto &Path = It->path();
+    if (Path.extension() != FileExtension)
+      continue;
+    std::error_code FileEC;
+    auto Size = fs::file_size(Path, FileEC);
+    auto Time = fs::last_write_time(Path, FileEC);
+    if (FileEC)
+      continue;
+    Files.push_back({Time, Size, Path});
+    TotalSize += Size;
+  }
+  DiskBytes_ = TotalSize;
+  if (TotalSize <= MaxBytes_)
+    return;
+
+  std::sort(Files.begin(), Files.end(),
+            [](const EntryFile &A, const EntryFile &B) {
+              return A.Time < B.Time;
+            });
+  for (const auto &File : Files) {
+    if (TotalSize <= MaxBytes_)
+      break;
+    logDebug("hiprtc: evicting cache entry '{}'", File.Path.string());
+    fs::remove(File.Path, EC);
+    TotalSize -= File.Size;
+  }
+  DiskBytes_ = TotalSize;
+}
+
+static fs::path getDefaultCacheDir() {
+  if (auto *Dir = std::getenv("XDG_CACHE_HOME"); Dir && *Dir)
+    return fs::path(Dir) / "chipStar/hiprtc";
+  if (auto *Dir = std::getenv("HOME"); Dir && *Dir)
+    return fs::path(Dir) / ".cache/chipStar/hiprtc";
+  return fs::path();
+}
+
+CompileCache *getCompileCache() {
+  static std::once_flag Flag;
+  static std::unique_ptr<CompileCache> Cache;
+
+  std::call_once(Flag, []() {
+    size_t MaxBytes = DefaultCacheSize;
+    if (auto *Value = std::getenv("CHIP_RTC_CACHE_SIZE")) {
+      try {
+        MaxBytes = std::stoull(Value);
+      } catch (const std::logic_error &) {
+        logWarn("Invalid CHIP_RTC_CACHE_SIZE value '{}', using {}", Value,
+                MaxBytes);
+      }
+    }
+    if (!MaxBytes) {
+      logDebug("hiprtc: compilation cache is disabled");
+      return;
+    }
+
+    fs::path Dir = getDefaultCacheDir();
+    if (auto *Value = std::getenv("CHIP_RTC_CACHE_DIR"))
+      Dir = Value; // An empty value disables the on-disk tier.
+
+    logDebug("hiprtc: compilation cache of {} bytes in '{}'", MaxBytes,
+             Dir.string());
+    Cache = std::make_unique<CompileCache>(Dir, MaxBytes);
+  });
+
+  return Cache.get();
+}
+
+} // namespace rtc
+} // namespace chipstar
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SRC_SPIRV_HIPRTC_CACHE_HH
+#define SRC_SPIRV_HIPRTC_CACHE_HH
+
+#include "Filesystem.hh"
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace chipstar {
+namespace rtc {
+
+/// Outcome of a successful hiprtc compilation.
+struct CompileResult {
+  std::string Code;                      ///< The code bundle.
+  std::vector<std::string> LoweredNames; ///< In name expression order.
+  std::string Log;                       ///< The compiler output.
+};
+
+/// Builds a key describing everything a compilation result depends on.
+/// The fields are length-prefixed so different inputs never produce the
+/// same key.
+class CacheKeyBuilder {
+  std::string Key_;
+
+public:
+  CacheKeyBuilder &add(std::string_view Field);
+  CacheKeyBuilder &add(const std::map<std::string, std::string> &Fields);
+  CacheKeyBuilder &add(const std::vector<std::string> &Fields);
+  std::string take() { return std::move(Key_); }
+};
+
+/// Return a 64-bit hash of 'Key' as 16 hexadecimal digits.
+std::string hashKey(std::string_view Key);
+
+/// Return a fingerprint of the files under the 'Paths' (files or
+/// directories, recursively). The files are identified by their path, size
+/// and modification time. Nonexistent paths are skipped.
+std::string fingerprintFiles(const std::vector<fs::path> &Paths);
+
+/// A cache of compilation results with an in-memory tier and an optional
+/// on-disk tier shared between processes. The entries are addressed by a
+/// hash of their key and the whole key is compared on lookups. Both tiers
+/// evict the least recently used entries when they grow beyond the size
+/// limit. The size of the on-disk tier is scanned from the directory on the
+/// first write and then counted by the writes of this instance, so the
+/// entries written by other processes meanwhile are only accounted for at
+/// the next eviction.
+class CompileCache {
+public:
+  static constexpr std::string_view FileExtension = ".hiprtc";
+
+  /// Construct a cache storing up to 'MaxBytes' bytes in memory and in the
+  /// 'Dir' directory. An empty 'Dir' disables the on-disk tier.
+  CompileCache(fs::path Dir, size_t MaxBytes);
+
+  std::optional<CompileResult> lookup(const std::string &Key);
+  void insert(const std::string &Key, const CompileResult &Result);
+
+  /// Return the file which stores the entry for 'Key' on disk.
+  fs::path getEntryPath(const std::string &Key) const;
+
+private:
+  struct Entry {
+    std::string Key;
+    CompileResult Result;
+    size_t Size;
+  };
+
+  std::mutex Mtx_;
+  fs::path Dir_;
+  size_t MaxBytes_;
+
+  /// The in-memory tier, most recently used first.
+  std::list<Entry> Entries_;
+  std::unordered_map<std::string_view, std::list<Entry>::iterator> Index_;
+  size_t MemoryBytes_ = 0;
+
+  /// The size of the on-disk tier, once scanned.
+  std::mutex DiskMtx_;
+  std::optional<uintmax_t> DiskBytes_;
+
+  void insertToMemory(const std::string &Key, const CompileResult &Result);
+  std::optional<CompileResult> readFromDisk(const std::string &Key);
+  void writeToDisk(const std::string &Key, const CompileResult &Result);
+  void evictFromDisk(uintmax_t AddedBytes);
+};
+
+/// Return the cache configured by the CHIP_RTC_CACHE_* environment
+/// variables or nullptr if caching is disabled.
+CompileCache *getCompileCache();
+
+} // namespace rtc
+} // namespace chipstar
+
+#endif
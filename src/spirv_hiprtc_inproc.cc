@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// In-process hiprtc compiler. Does the same steps as the HIPSPV toolchain
+// driven by hipcc (see createCompileCommand() in spirv_hiprtc.cc) but with
+// Clang, LLVM and the SPIR-V translator as libraries:
+//
+//   1. The clang driver expands the hipcc options into the device side cc1
+//      invocation which also links the device library in.
+//   2. The HIP passes are run from the pass plugin loaded into the process.
+//   3. The module is translated to SPIR-V and wrapped into an offload bundle.
+//
+// The source and the headers are served from an in-memory file system and
+// the device library is read from the disk only once.
+
+#include "spirv_hiprtc_inproc.hh"
+
+#include "logging.hh"
+#include "Utils.hh"
+#include "chipStarConfig.hh"
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/CodeGen/CodeGenAction.h"
+#include "clang/Driver/Compilation.h"
+#include "clang/Driver/Driver.h"
+#include "clang/Driver/Job.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "LLVMSPIRVLib.h"
+
+#include <mutex>
+#include <optional>
+#include <sstream>
+
+namespace {
+
+/// Directory of the in-memory source and headers.
+constexpr const char *VirtualDir = "/chipstar-hiprtc";
+
+/// The driver options of hipcc using the build and the installation
+/// directory of chipStar (HIP_OFFLOAD_COMPILE_OPTIONS in .hipInfo).
+const std::vector<const char *> BuildOptions = {CHIP_HIPRTC_OPTIONS_BUILD};
+const std::vector<const char *> InstallOptions = {
+    CHIP_HIPRTC_OPTIONS_INSTALL};
+
+struct Toolchain {
+  fs::path HipPath;
+  std::vector<const char *> Options;
+  std::string DeviceLibPath;
+  std::unique_ptr<llvm::MemoryBuffer> DeviceLib;
+  std::optional<llvm::PassPlugin> Passes;
+};
+
+static std::optional<fs::path>
+getHipPath(const std::vector<const char *> &Options) {
+  constexpr std::string_view Prefix = "--hip-path=";
+  for (auto *Opt : Options)
+    if (startsWith(Opt, Prefix))
+      return fs::path(std::string_view(Opt).substr(Prefix.size()));
+  return std::nullopt;
+}
+
+/// Load the pass plugin and the device library installed under the
+/// --hip-path in 'Options'.
+static std::unique_ptr<Toolchain>
+loadToolchain(const std::vector<const char *> &Options) {
+  auto HipPath = getHipPath(Options);
+  if (!HipPath)
+    return nullptr;
+
+  auto TC = std::make_unique<Toolchain>();
+  TC->HipPath = *HipPath;
+  TC->Options = Options;
+  TC->DeviceLibPath =
+      (*HipPath / "lib/hip-device-lib/hipspv-spirv64.bc").string();
+  auto DeviceLib = llvm::MemoryBuffer::getFile(TC->DeviceLibPath);
+  if (!DeviceLib) {
+    logDebug("hiprtc: no device library at '{}'", TC->DeviceLibPath);
+    return nullptr;
+  }
+  TC->DeviceLib = std::move(*DeviceLib);
+
+  for (const char *Dir : {"lib", "lib/llvm"}) {
+    auto PluginPath = *HipPath / Dir / "libLLVMHipSpvPasses.so";
+    if (!fs::exists(PluginPath))
+      continue;
+    auto Plugin = llvm::PassPlugin::Load(PluginPath.string());
+    if (!Plugin) {
+      logWarn("hiprtc: could not load '{}': {}", PluginPath.string(),
+              llvm::toString(Plugin.takeError()));
+      continue;
+    }
+    TC->Passes.emplace(*Plugin);
+    logDebug("hiprtc: in-process toolchain at '{}'", HipPath->string());
+    return TC;
+  }
+
+  logDebug("hiprtc: no pass plugin under '{}'", HipPath->string());
+  return nullptr;
+}
+
+static const Toolchain *getToolchain() {
+  static std::once_flag Flag;
+  static std::unique_ptr<Toolchain> TC;
+
+  // Search in the same order as getHIPCCPath().
+  std::call_once(Flag, []() {
+#if !CHIP_DEBUG_BUILD
+    TC = loadToolchain(InstallOptions);
+#endif
+    if (!TC)
+      TC = loadToolchain(BuildOptions);
+    if (!TC)
+      logWarn("hiprtc: in-process compiler is not available, using hipcc.");
+  });
+
+  return TC.get();
+}
+
+/// Return the names of the functions in the '_chip_name_exprs' array.
+static std::vector<std::string> getLoweredNames(const llvm::Module &M) {
+  std::vector<std::string> Result;
+  auto *NameExprs = M.getGlobalVariable("_chip_name_exprs");
+  if (!NameExprs || !NameExprs->hasInitializer())
+    return Result;
+
+  auto *Init = NameExprs->getInitializer()->stripPointerCasts();
+  if (auto *CA = llvm::dyn_cast<llvm::ConstantAggregate>(Init))
+    for (llvm::Value *Op : CA->operand_values()) {
+      auto *COp = llvm::cast<llvm::Constant>(Op)->stripPointerCasts();
+      auto *F = llvm::dyn_cast<llvm::Function>(COp);
+      Result.emplace_back(F && F->hasName() ? F->getName().str() : "");
+    }
+  return Result;
+}
+
+/// Run the device side cc1 job which the driver creates for 'Args'.
+static std::unique_ptr<llvm::Module>
+runFrontend(const Toolchain &TC, const std::vector<const char *> &Args,
+            llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> MemFS,
+            llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> VFS,
+            llvm::LLVMContext &Ctx, llvm::raw_ostream &Log) {
+  llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts =
+      new clang::DiagnosticOptions();
+  clang::TextDiagnosticPrinter DriverDiagPrinter(Log, DiagOpts.get());
+  clang::DiagnosticsEngine DriverDiags(
+      llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
+      DiagOpts, &DriverDiagPrinter, false);
+
+  // The clang executable is not run. The driver locates the resource
+  // directory relative to it.
+  clang::driver::Driver Driver(CHIP_HIPRTC_CLANG, LLVM_DEFAULT_TARGET_TRIPLE,
+                               DriverDiags, "chipStar hiprtc", VFS);
+  std::unique_ptr<clang::driver::Compilation> C(
+      Driver.BuildCompilation(Args));
+  if (!C || C->containsError())
+    return nullptr;
+
+  const llvm::opt::ArgStringList *CC1Args = nullptr;
+  for (const clang::driver::Command &Job : C->getJobs())
+    if (llvm::StringRef(Job.getCreator().getName()) == "clang") {
+      CC1Args = &Job.getArguments();
+      break;
+    }
+  if (!CC1Args) {
+    Log << "error: no device compilation job\n";
+    return nullptr;
+  }
+
+  llvm::ArrayRef<const char *> CC1ArgsRef(*CC1Args);
+  if (!CC1ArgsRef.empty() && llvm::StringRef(CC1ArgsRef[0]) == "-cc1")
+    CC1ArgsRef = CC1ArgsRef.drop_front();
+
+  // Serve the device library from memory.
+  for (size_t I = 0; I + 1 < CC1ArgsRef.size(); I++)
+    if (llvm::StringRef(CC1ArgsRef[I]) == "-mlink-builtin-bitcode" &&
+        TC.DeviceLibPath == CC1ArgsRef[I + 1])
+      MemFS->addFile(TC.DeviceLibPath, 0,
+                     llvm::MemoryBuffer::getMemBuffer(
+                         TC.DeviceLib->getMemBufferRef(), false));
+
+  auto Invocation = std::make_shared<clang::CompilerInvocation>();
+  if (!clang::CompilerInvocation::CreateFromArgs(*Invocation, CC1ArgsRef,
+                                                 DriverDiags))
+    return nullptr;
+  // Catch the LLVM options reaching cc1 in other forms than the ones
+  // supportsOptions() checks for, e.g. through -Xclang.
+  if (!Invocation->getFrontendOpts().LLVMArgs.empty()) {
+    Log << "error: -mllvm options are not supported by the in-process "
+           "compiler\n";
+    return nullptr;
+  }
+
+  clang::CompilerInstance Clang;
+  Clang.setInvocation(std::move(Invocation));
+  // The driver asks for skipping the cleanup for a faster exit.
+  Clang.getFrontendOpts().DisableFree = false;
+  Clang.getCodeGenOpts().DisableFree = false;
+  Clang.createDiagnostics(
+      new clang::TextDiagnosticPrinter(Log, &Clang.getDiagnosticOpts()));
+  Clang.createFileManager(VFS);
+
+  clang::EmitLLVMOnlyAction Action(&Ctx);
+  if (!Clang.ExecuteAction(Action))
+    return nullptr;
+  return Action.takeModule();
+}
+
+/// Run the passes hipcc runs on the device code after linking.
+static bool runHipPasses(const Toolchain &TC, llvm::Module &M,
+                         llvm::raw_ostream &Log) {
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+
+  llvm::PassBuilder PB;
+  TC.Passes->registerPassBuilderCallbacks(PB);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM;
+  if (auto Err = PB.parsePassPipeline(MPM, "hip-post-link-passes")) {
+    Log << "error: " << llvm::toString(std::move(Err)) << "\n";
+    return false;
+  }
+  MPM.run(M, MAM);
+
+  return !llvm::verifyModule(M, &Log);
+}
+
+} // namespace
+
+namespace chipstar {
+namespace rtc {
+
+bool isInProcessCompilerAvailable() { return getToolchain(); }
+
+fs::path getToolchainPath() {
+  const auto *TC = getToolchain();
+  assert(TC && "In-process compiler is not available!");
+  return TC->HipPath;
+}
+
+bool supportsOptions(const std::vector<std::string> &Options) {
+  auto IsLLVMOption = [](std::string_view Opt) {
+    return Opt == "-mllvm" || startsWith(Opt, "-mllvm=");
+  };
+  if (const auto *TC = getToolchain())
+    for (const char *Opt : TC->Options)
+      if (IsLLVMOption(Opt))
+        return false;
+  for (const auto &Opt : Options)
+    if (IsLLVMOption(Opt))
+      return false;
+  return true;
+}
+
+bool compileInProcess(const std::string &Source,
+                      const std::map<std::string, std::string> &Headers,
+                      const std::vector<std::string> &Options,
+                      std::string &Log, std::string &Bundle,
+                      std::vector<std::string> &LoweredNames) {
+  const auto *TC = getToolchain();
+  assert(TC && "In-process compiler is not available!");
+
+  auto SourceFile = std::string(VirtualDir) + "/program.hip";
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> MemFS(
+      new llvm::vfs::InMemoryFileSystem);
+  MemFS->addFile(SourceFile, 0, llvm::MemoryBuffer::getMemBuffer(Source));
+  for (auto &Header : Headers)
+    MemFS->addFile(std::string(VirtualDir) + "/" + Header.first, 0,
+                   llvm::MemoryBuffer::getMemBuffer(Header.second));
+  llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> VFS(
+      new llvm::vfs::OverlayFileSystem(llvm::vfs::getRealFileSystem()));
+  VFS->pushOverlay(MemFS);
+
+  std::string IncludeOpt = std::string("-I") + VirtualDir;
+  std::vector<const char *> Args = {"clang++", "-x", "hip"};
+  Args.insert(Args.end(), TC->Options.begin(), TC->Options.end());
+  // Stop at the device bitcode. The rest of the HIPSPV toolchain is done
+  // below.
+  for (const char *Opt : {"--cuda-device-only", "--no-gpu-bundle-output",
+                          "-emit-llvm", "-c", IncludeOpt.c_str(),
+                          "--include=hip/hip_runtime.h"})
+    Args.push_back(Opt);
+  bool HasO = false;
+  for (const auto &Opt : Options) {
+    Args.push_back(Opt.c_str());
+    HasO |= startsWith(Opt, "-O");
+  }
+  if (!HasO)
+    Args.push_back("-O2");
+  Args.push_back(SourceFile.c_str());
+
+  llvm::raw_string_ostream LogStream(Log);
+  llvm::LLVMContext Ctx;
+  auto M = runFrontend(*TC, Args, MemFS, VFS, Ctx, LogStream);
+  if (!M)
+    return false;
+
+  LoweredNames = getLoweredNames(*M);
+
+  if (!runHipPasses(*TC, *M, LogStream))
+    return false;
+
+  // Same as the options passed to llvm-spirv by the HIPSPV toolchain.
+  SPIRV::TranslatorOpts TranslatorOpts(SPIRV::VersionNumber::SPIRV_1_1);
+  TranslatorOpts.enableAllExtensions();
+  std::ostringstream SPIRV;
+  std::string ErrorMsg;
+  if (!llvm::writeSpirv(M.get(), TranslatorOpts, SPIRV, ErrorMsg)) {
+    LogStream << "error: SPIR-V translation failed: " << ErrorMsg << "\n";
+    return false;
+  }
+
+  Bundle = createSPIRVBundle(SPIRV.str());
+  return true;
+}
+
+} // namespace rtc
+} // namespace chipstar
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2024 chipStar developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SRC_SPIRV_HIPRTC_INPROC_HH
+#define SRC_SPIRV_HIPRTC_INPROC_HH
+
+#include "Filesystem.hh"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace chipstar {
+namespace rtc {
+
+/// Return true if the toolchain parts needed by compileInProcess() - the HIP
+/// pass plugin and the device library - were found.
+bool isInProcessCompilerAvailable();
+
+/// Return the chipStar build or installation directory the pass plugin and
+/// the device library were loaded from.
+fs::path getToolchainPath();
+
+/// Return true if compileInProcess() can apply all the 'Options' and the
+/// options of the toolchain. The -mllvm options are not: clang applies them
+/// to the LLVM command line of its own cc1 process, which would be global
+/// and permanent state here.
+bool supportsOptions(const std::vector<std::string> &Options);
+
+/// Compile HIP 'Source' into a clang offload bundle holding a SPIR-V module
+/// using Clang and LLVM as libraries, without spawning processes or writing
+/// files. 'Headers' maps include names to their contents. 'Options' are
+/// hiprtc options accepted by the caller. Compiler diagnostics are appended
+/// to 'Log'.
+///
+/// If the source ends with the '_chip_name_exprs' array (see
+/// HipEmitLoweredNames.cpp), the lowered names of its elements are stored in
+/// 'LoweredNames' in order.
+///
+/// Return false on compilation errors.
+bool compileInProcess(const std::string &Source,
+                      const std::map<std::string, std::string> &Headers,
+                      const std::vector<std::string> &Options,
+                      std::string &Log, std::string &Bundle,
+                      std::vector<std::string> &LoweredNames);
+
+} // namespace rtc
+} // namespace chipstar
+
+#endif
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Check the device variables are lowered to the table shadow kernels only, so
+# the runtime doesn't launch a shadow kernel per variable.
+set -eu
+
+SRC_DIR=@CMAKE_CURRENT_SOURCE_DIR@
+OUT_DIR=@CMAKE_CURRENT_BINARY_DIR@/@TEST_NAME@.d
+HIPCC=@CMAKE_BINARY_DIR@/bin/hipcc
+LLVM_DIS=@CLANG_ROOT_PATH_BIN@/llvm-dis
+
+rm -rf ${OUT_DIR}
+mkdir -p ${OUT_DIR}
+cd ${OUT_DIR}
+# The *-lower.bc temporary is the device code after the chipStar passes.
+${HIPCC} --save-temps -c ${SRC_DIR}/inputs/device-vars.hip -o device-vars.o
+${LLVM_DIS} -o device-vars-lower.ll *-lower.bc
+for KERNEL in __chip_vars_info __chip_vars_bind __chip_vars_init; do
+  if ! grep -q "define .*@${KERNEL}(" device-vars-lower.ll; then
+    echo "The module has no ${KERNEL} kernel"
+    exit 1
+  fi
+done
+if grep -q "define .*@__chip_var_\(info\|bind\|init\)_" device-vars-lower.ll
+then
+  echo "The module has per-variable shadow kernels"
+  exit 1
+fi
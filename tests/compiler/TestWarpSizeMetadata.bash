@@ -0,0 +1,21 @@
+#!/bin/bash
+# Check the kernels calling only a warp vote or a shuffle overload other than
+# int/float are given the fixed subgroup size by the HipWarps pass.
+set -eu
+
+SRC_DIR=@CMAKE_CURRENT_SOURCE_DIR@
+OUT_DIR=@CMAKE_CURRENT_BINARY_DIR@/@TEST_NAME@.d
+HIPCC=@CMAKE_BINARY_DIR@/bin/hipcc
+LLVM_DIS=@CLANG_ROOT_PATH_BIN@/llvm-dis
+
+for INPUT in ballot-only shfl-double; do
+  rm -rf ${OUT_DIR}/${INPUT}
+  mkdir -p ${OUT_DIR}/${INPUT}
+  cd ${OUT_DIR}/${INPUT}
+  # The *-lower.bc temporary is the device code after the chipStar passes.
+  ${HIPCC} --save-temps -c ${SRC_DIR}/inputs/${INPUT}.hip -o ${INPUT}.o
+  if ! ${LLVM_DIS} -o - *-lower.bc | grep -q "intel_reqd_sub_group_size"; then
+    echo "${INPUT}: the kernel has no intel_reqd_sub_group_size"
+    exit 1
+  fi
+done
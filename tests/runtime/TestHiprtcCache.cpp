@@ -0,0 +1,163 @@
+// Checks the hiprtc compilation cache (see spirv_hiprtc_cache.hh): key
+// building, LRU eviction in memory and on disk and sharing the entries
+// between cache instances through the cache directory.
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <cassert>
+
+#include "spirv_hiprtc_cache.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+using chipstar::rtc::CacheKeyBuilder;
+using chipstar::rtc::CompileCache;
+using chipstar::rtc::CompileResult;
+using chipstar::rtc::fingerprintFiles;
+
+static CompileResult makeResult(const std::string &Code) {
+  CompileResult Result;
+  Result.Code = Code;
+  Result.Log = "log of " + Code;
+  Result.LoweredNames = {"_Z3fooIiEvv", "_Z3barv"};
+  return Result;
+}
+
+static bool isResult(const std::optional<CompileResult> &Result,
+                     const std::string &Code) {
+  auto Expected = makeResult(Code);
+  return Result && Result->Code == Expected.Code &&
+         Result->Log == Expected.Log &&
+         Result->LoweredNames == Expected.LoweredNames;
+}
+
+static void checkKeys() {
+  assert(CacheKeyBuilder().add("ab").add("c").take() !=
+         CacheKeyBuilder().add("a").add("bc").take());
+  assert(CacheKeyBuilder().add(std::vector<std::string>{"a", "b"}).take() !=
+         CacheKeyBuilder().add(std::vector<std::string>{"ab"}).take());
+  std::map<std::string, std::string> Headers = {{"a.h", "x"}};
+  assert(CacheKeyBuilder().add(Headers).take() ==
+         CacheKeyBuilder().add(Headers).take());
+  Headers["a.h"] = "y";
+  assert(CacheKeyBuilder().add(Headers).take() !=
+         CacheKeyBuilder().add(std::map<std::string, std::string>{
+                                   {"a.h", "x"}})
+                             .take());
+}
+
+static void checkFingerprint() {
+  auto Dir = fs::temp_directory_path() /
+             ("chipstar-hiprtc-fingerprint-test-" + std::to_string(getpid()));
+  fs::remove_all(Dir);
+  fs::create_directories(Dir / "sub");
+  std::ofstream(Dir / "sub/a.h") << "a";
+
+  auto Initial = fingerprintFiles({Dir, Dir / "missing.bc"});
+  assert(Initial == fingerprintFiles({Dir}));
+  // A changed file in a subdirectory.
+  std::ofstream(Dir / "sub/a.h", std::ios::trunc) << "ab";
+  auto Changed = fingerprintFiles({Dir});
+  assert(Changed != Initial);
+  // A new file.
+  std::ofstream(Dir / "b.bc") << "b";
+  assert(fingerprintFiles({Dir}) != Changed);
+  assert(fingerprintFiles({Dir / "sub"}) == fingerprintFiles({Dir / "sub"}));
+
+  fs::remove_all(Dir);
+}
+
+static void checkMemoryEviction() {
+  // Each entry takes 188 bytes.
+  CompileCache Cache(fs::path(), 600);
+  std::string Code(80, 'c');
+  Cache.insert("A", makeResult(Code + "A"));
+  Cache.insert("B", makeResult(Code + "B"));
+  Cache.insert("C", makeResult(Code + "C"));
+  assert(isResult(Cache.lookup("A"), Code + "A"));
+
+  // 'B' is the least recently used one now.
+  Cache.insert("D", makeResult(Code + "D"));
+  assert(!Cache.lookup("B"));
+  assert(isResult(Cache.lookup("A"), Code + "A"));
+  assert(isResult(Cache.lookup("C"), Code + "C"));
+  assert(isResult(Cache.lookup("D"), Code + "D"));
+
+  // Entries larger than the cache are not stored.
+  Cache.insert("E", makeResult(std::string(400, 'e')));
+  assert(!Cache.lookup("E"));
+  assert(isResult(Cache.lookup("A"), Code + "A"));
+}
+
+static uintmax_t getDirSize(const fs::path &Dir) {
+  uintmax_t Size = 0;
+  for (const auto &File : fs::directory_iterator(Dir))
+    Size += fs::file_size(File.path());
+  return Size;
+}
+
+static void checkDisk() {
+  auto Dir = fs::temp_directory_path() /
+             ("chipstar-hiprtc-cache-test-" + std::to_string(getpid()));
+  fs::remove_all(Dir);
+
+  {
+    CompileCache Cache(Dir, 1 << 20);
+    Cache.insert("A", makeResult("A"));
+    Cache.insert("B", makeResult("B"));
+  }
+  {
+    // A new instance, like one in another process, sees the entries.
+    CompileCache Cache(Dir, 1 << 20);
+    assert(isResult(Cache.lookup("A"), "A"));
+    assert(isResult(Cache.lookup("B"), "B"));
+    assert(!Cache.lookup("C"));
+
+    // An entry stored at the path of another key is not used.
+    fs::copy_file(Cache.getEntryPath("A"), Cache.getEntryPath("C"));
+    assert(!Cache.lookup("C"));
+  }
+  {
+    CompileCache Cache(Dir, 1 << 20);
+    std::ofstream(Cache.getEntryPath("B"), std::ios::trunc) << "garbage";
+    assert(!Cache.lookup("B"));
+    std::ofstream(Cache.getEntryPath("B"), std::ios::trunc);
+    assert(!Cache.lookup("B"));
+  }
+
+  fs::remove_all(Dir);
+  {
+    CompileCache Cache(Dir, 1000);
+    for (int I = 0; I < 20; I++) {
+      std::string Key = "K" + std::to_string(I);
+      Cache.insert(Key, makeResult(std::string(100, 'x') + Key));
+      assert(getDirSize(Dir) <= 1000);
+    }
+  }
+  {
+    // The most recently written entry survives the eviction.
+    CompileCache Cache(Dir, 1000);
+    assert(isResult(Cache.lookup("K19"), std::string(100, 'x') + "K19"));
+    assert(!Cache.lookup("K0"));
+  }
+  {
+    // The entries written by an earlier instance are accounted for.
+    CompileCache Cache(Dir, 1000);
+    Cache.insert("L", makeResult(std::string(100, 'x') + "L"));
+    assert(getDirSize(Dir) <= 1000);
+  }
+
+  fs::remove_all(Dir);
+}
+
+int main() {
+  checkKeys();
+  checkFingerprint();
+  checkMemoryEviction();
+  checkDisk();
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,215 @@
+// Checks the formatting of printf buffer records (see CHIPPrintf.hh) written
+// the way the device side in bitcode/_chip_printf_buffer.cl does, including
+// records wrapping around the end of the buffer and a full buffer.
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <cassert>
+
+#include "CHIPPrintf.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using chipstar::PrintfBuffer;
+using Words = std::vector<uint32_t>;
+
+/// Writes records like the kernels do.
+class DeviceEmulator {
+  uint32_t *Header_;
+  uint32_t *Data_;
+  uint32_t Capacity_;
+
+public:
+  DeviceEmulator(void *Storage)
+      : Header_(static_cast<uint32_t *>(Storage)),
+        Data_(Header_ + PrintfBuffer::NumHeaderWords),
+        Capacity_(Header_[PrintfBuffer::CapacityWord]) {}
+
+  /// Mirrors _chip_printf_reserve().
+  uint32_t *reserve(uint32_t NumWords) {
+    uint32_t Pos = Header_[PrintfBuffer::WritePosWord];
+    uint32_t Off = Pos & (Capacity_ - 1);
+    uint32_t Pad = Off + NumWords > Capacity_ ? Capacity_ - Off : 0;
+    if (Pos + Pad + NumWords - Header_[PrintfBuffer::ReadPosWord] >
+        Capacity_) {
+      Header_[PrintfBuffer::DroppedWord]++;
+      return nullptr;
+    }
+    Header_[PrintfBuffer::WritePosWord] = Pos + Pad + NumWords;
+    if (Pad)
+      Data_[Off] = Pad | PrintfBuffer::Padding << 24;
+    return Data_ + ((Pos + Pad) & (Capacity_ - 1));
+  }
+
+  /// Write 'Record' (without the header word) and return its position.
+  uint32_t *write(const Words &Record, bool Commit = true) {
+    uint32_t NumWords = Record.size() + 1;
+    uint32_t *Rec = reserve(NumWords);
+    if (!Rec)
+      return nullptr;
+    std::memcpy(Rec + 1, Record.data(), Record.size() * sizeof(uint32_t));
+    if (Commit)
+      commit(Rec, NumWords);
+    return Rec;
+  }
+
+  /// Mirrors _chip_printf_commit().
+  void commit(uint32_t *Rec, uint32_t NumWords) {
+    *Rec = NumWords | PrintfBuffer::Printf << 24;
+  }
+};
+
+struct RecordBuilder {
+  Words Record;
+
+  explicit RecordBuilder(uint32_t FmtOffset) : Record{FmtOffset} {}
+  explicit RecordBuilder(const char *InlineFmt)
+      : Record{PrintfBuffer::InlineFormat} {
+    str(InlineFmt);
+  }
+
+  RecordBuilder &word(uint32_t Value) {
+    Record.push_back(Value);
+    return *this;
+  }
+  RecordBuilder &dword(uint64_t Value) {
+    Record.push_back(static_cast<uint32_t>(Value));
+    Record.push_back(static_cast<uint32_t>(Value >> 32));
+    return *this;
+  }
+  RecordBuilder &dbl(double Value) {
+    uint64_t Bits;
+    std::memcpy(&Bits, &Value, sizeof(Bits));
+    return dword(Bits);
+  }
+  RecordBuilder &str(const char *Str) {
+    if (!Str)
+      return word(PrintfBuffer::NullString);
+    uint32_t Len = std::strlen(Str);
+    word(Len);
+    Words Data((Len + 3) / 4, 0);
+    std::memcpy(Data.data(), Str, Len);
+    Record.insert(Record.end(), Data.begin(), Data.end());
+    return *this;
+  }
+};
+
+struct FormatTable {
+  std::string Formats;
+
+  uint32_t add(std::string_view Fmt) {
+    uint32_t Offset = Formats.size();
+    Formats += Fmt;
+    Formats += '\0';
+    return Offset;
+  }
+};
+
+static void checkFormatting() {
+  FormatTable Table;
+  uint32_t Ints = Table.add("x=%d y=%u z=%hhd\n");
+  uint32_t Mixed = Table.add("%s|%5.2f|%lld|%c|%x|%%|%-4s|\n");
+  uint32_t Stars = Table.add("%*d|%.*f|%.*e|%zu|%n%p\n");
+
+  size_t Size = PrintfBuffer::getStorageSize(0);
+  Words Storage(Size / sizeof(uint32_t), 0);
+  PrintfBuffer Buffer(Storage.data(), Size, Table.Formats);
+  DeviceEmulator Dev(Buffer.getStorage());
+
+  Dev.write(RecordBuilder(Ints).word(-5).word(7).word(300).Record);
+  Dev.write(RecordBuilder(Mixed)
+                .str("abc")
+                .dbl(3.14159)
+                .dword(-1234567890123ll)
+                .word('q')
+                .word(255)
+                .str(nullptr)
+                .Record);
+  Dev.write(RecordBuilder(Stars)
+                .word(4)
+                .word(42)
+                .word(-1) // A negative precision is ignored.
+                .dbl(0.5)
+                .word(1)
+                .dbl(1500.0)
+                .dword(1ull << 40)
+                .dword(0) // %n
+                .dword(0x1000)
+                .Record);
+  Dev.write(RecordBuilder("dynamic %s %s %d\n")
+                .str("format")
+                .str(nullptr)
+                .word(1)
+                .Record);
+  // A record with missing arguments is printed up to them.
+  Dev.write(RecordBuilder(Ints).word(1).Record);
+
+  std::string Expected = "x=-5 y=7 z=44\n"
+                         "abc| 3.14|-1234567890123|q|ff|%|(null)|\n"
+                         "  42|0.500000|1.5e+03|1099511627776|0x1000\n"
+                         "dynamic format (null) 1\n"
+                         "x=1 y=";
+  std::string Out = Buffer.drain();
+  if (Out != Expected) {
+    printf("Unexpected output:\n%s\nExpected:\n%s\n", Out.c_str(),
+           Expected.c_str());
+    assert(false);
+  }
+  assert(Buffer.drain().empty());
+}
+
+static void checkWrapAround() {
+  FormatTable Table;
+  uint32_t Fmt = Table.add("%d:%s\n");
+  size_t Size = PrintfBuffer::getStorageSize(0);
+  Words Storage(Size / sizeof(uint32_t), 0);
+  PrintfBuffer Buffer(Storage.data(), Size, Table.Formats);
+  DeviceEmulator Dev(Buffer.getStorage());
+  uint32_t Capacity = Storage[PrintfBuffer::CapacityWord];
+
+  // Records of an odd size get padded at the end of the buffer many times.
+  std::string Payload(301, 'p');
+  for (int I = 0; I < 100; I++) {
+    assert(Dev.write(RecordBuilder(Fmt).word(I).str(Payload.c_str()).Record));
+    assert(Buffer.drain() == std::to_string(I) + ":" + Payload + "\n");
+  }
+  // The consumed records are cleared.
+  for (uint32_t I = 0; I < Capacity; I++)
+    assert(Storage[PrintfBuffer::NumHeaderWords + I] == 0);
+
+  // Records of unfinished printf() calls and the ones after them are left
+  // for later.
+  Words FirstRecord = RecordBuilder(Fmt).word(1).str("a").Record;
+  uint32_t *First = Dev.write(FirstRecord, false);
+  Dev.write(RecordBuilder(Fmt).word(2).str("b").Record);
+  assert(Buffer.drain().empty());
+  Dev.commit(First, FirstRecord.size() + 1);
+  assert(Buffer.drain() == "1:a\n2:b\n");
+
+  // The printf() calls are dropped while the buffer is full.
+  std::string Expected;
+  unsigned NumWritten = 0;
+  while (Dev.write(RecordBuilder(Fmt).word(NumWritten).str("full").Record))
+    Expected += std::to_string(NumWritten++) + ":full\n";
+  assert(NumWritten > 0 && NumWritten <= Capacity / 5);
+  assert(Storage[PrintfBuffer::DroppedWord] == 1);
+  assert(Buffer.drain() == Expected);
+  assert(Storage[PrintfBuffer::DroppedWord] == 0);
+  assert(Dev.write(RecordBuilder(Fmt).word(0).str("again").Record));
+  assert(Buffer.drain() == "0:again\n");
+}
+
+int main() {
+  assert(PrintfBuffer::getStorageSize(0) ==
+         (PrintfBuffer::NumHeaderWords + 1024) * sizeof(uint32_t));
+  assert(PrintfBuffer::getStorageSize(1 << 20) ==
+         (PrintfBuffer::NumHeaderWords + (1 << 18)) * sizeof(uint32_t));
+  checkFormatting();
+  checkWrapAround();
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,269 @@
+// Checks the SPIR-V post-processing and kernel info extraction on a large
+// generated module, with and without a kernel info table (see
+// HipKernelInfo.cpp), and reports the throughput of it. Also checks the
+// symbol linkage queries used for linking the runtime device library and
+// the symbol index of the library built at build time against them.
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <cassert>
+
+#include "common.hh"
+#include "spirv.hh"
+#include "rtdevlib-modules.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string_view>
+#include <vector>
+
+using Words = std::vector<uint32_t>;
+
+constexpr unsigned NumKernels = 2000;
+constexpr unsigned NumAddsPerKernel = 270;
+constexpr int NumReps = 5;
+
+enum : uint32_t { VoidTy = 1, IntTy, PtrTy, FnTy, OpenCLStd, OdrFn, ChipFn };
+
+enum class TableKind { None, Matching, Stale };
+
+static Words packString(std::string_view Str) {
+  // Nul-terminated and padded to the word boundary.
+  std::vector<char> Bytes(Str.begin(), Str.end());
+  Bytes.resize((Bytes.size() / 4 + 1) * 4, '\0');
+  const auto *Packed = reinterpret_cast<const uint32_t *>(Bytes.data());
+  return Words(Packed, Packed + Bytes.size() / 4);
+}
+
+static Words inst(spv::Op Op, Words Operands, std::string_view Str = {},
+                  Words Tail = {}) {
+  Words Insn{static_cast<uint32_t>(Op)};
+  Insn.insert(Insn.end(), Operands.begin(), Operands.end());
+  if (Str.data()) {
+    auto Packed = packString(Str);
+    Insn.insert(Insn.end(), Packed.begin(), Packed.end());
+  }
+  Insn.insert(Insn.end(), Tail.begin(), Tail.end());
+  Insn[0] |= Insn.size() << 16;
+  return Insn;
+}
+
+struct ModuleBuilder {
+  Words Original;
+  Words Expected; ///< The instructions the filter is expected to keep.
+
+  void add(const Words &Insn, bool Kept = true) {
+    Original.insert(Original.end(), Insn.begin(), Insn.end());
+    if (Kept)
+      Expected.insert(Expected.end(), Insn.begin(), Insn.end());
+  }
+};
+
+static std::string kernelName(unsigned K) {
+  return "kernel_" + std::to_string(K);
+}
+
+/// Return the kernel info table for the kernels of buildModule(). The table
+/// annotates the second argument as spilled, which the SPIR-V does not, to
+/// tell which of them the kernel info came from. A stale table misses the
+/// last kernel.
+static Words kernelInfoTable(TableKind Kind) {
+  unsigned NumDescribed = NumKernels - (Kind == TableKind::Stale);
+  Words Table{1, NumDescribed};
+  for (unsigned K = 0; K < NumDescribed; K++) {
+    auto Name = packString(kernelName(K));
+    Table.push_back(Name.size());
+    Table.insert(Table.end(), Name.begin(), Name.end());
+    Table.push_back(2);
+    Table.push_back(8 | 2u << 24u | 1u << 28u); // CrossWorkgroup pointer.
+    Table.push_back(4 | 1u << 24u);             // Private POD.
+    Table.push_back(1);
+    Table.push_back(4u << 16u | 1); // Spilled second argument.
+  }
+  return Table;
+}
+
+static ModuleBuilder buildModule(TableKind Kind) {
+  ModuleBuilder B;
+  const uint32_t FirstKernelID = 100;
+  uint32_t NextID = FirstKernelID + NumKernels;
+
+  Words Header{spv::MagicNumber, 0x00010200, 0, 0, 0};
+  B.add(Header);
+  for (auto Capability : {spv::CapabilityAddresses, spv::CapabilityLinkage,
+                          spv::CapabilityKernel, spv::CapabilityInt64})
+    B.add(inst(spv::OpCapability, {static_cast<uint32_t>(Capability)}));
+  B.add(inst(spv::OpExtension, {}, "SPV_KHR_linkonce_odr"), false);
+  B.add(inst(spv::OpExtInstImport, {OpenCLStd}, "OpenCL.std"));
+  B.add(inst(spv::OpMemoryModel,
+             {spv::AddressingModelPhysical64, spv::MemoryModelOpenCL}));
+  for (unsigned K = 0; K < NumKernels; K++)
+    B.add(inst(spv::OpEntryPoint,
+               {spv::ExecutionModelKernel, FirstKernelID + K}, kernelName(K)));
+  for (unsigned K = 0; K < NumKernels; K++)
+    B.add(inst(spv::OpName, {FirstKernelID + K}, kernelName(K)), false);
+  B.add(inst(spv::OpName, {ChipFn}, "chip_helper"));
+  for (unsigned K = 0; K < NumKernels; K++)
+    B.add(inst(spv::OpDecorate,
+               {FirstKernelID + K, spv::DecorationLinkageAttributes},
+               kernelName(K), {spv::LinkageTypeExport}),
+          false);
+  B.add(inst(spv::OpDecorate, {OdrFn, spv::DecorationLinkageAttributes},
+             "odr_helper", {spv::LinkageTypeLinkOnceODR}),
+        false);
+  B.add(inst(spv::OpDecorate, {ChipFn, spv::DecorationLinkageAttributes},
+             "_Z11__chip_helper", {spv::LinkageTypeImport}));
+  uint32_t TableVar = NextID++;
+  if (Kind != TableKind::None)
+    B.add(inst(spv::OpDecorate, {TableVar, spv::DecorationLinkageAttributes},
+               ChipKernelInfoVarName, {spv::LinkageTypeExport}));
+
+  B.add(inst(spv::OpTypeVoid, {VoidTy}));
+  B.add(inst(spv::OpTypeInt, {IntTy, 32, 0}));
+  B.add(inst(spv::OpTypePointer, {PtrTy, spv::StorageClassCrossWorkgroup,
+                                  IntTy}));
+  B.add(inst(spv::OpTypeFunction, {FnTy, VoidTy, PtrTy, IntTy}));
+
+  if (Kind != TableKind::None) {
+    // The table as an OpVariable initialized by a constant array with
+    // a constant per distinct value like llvm-spirv does.
+    auto Table = kernelInfoTable(Kind);
+    std::map<uint32_t, uint32_t> ConstIDs;
+    auto getConst = [&](uint32_t Value) {
+      auto [It, New] = ConstIDs.emplace(Value, NextID);
+      if (New)
+        B.add(inst(spv::OpConstant, {IntTy, NextID++, Value}));
+      return It->second;
+    };
+    uint32_t Len = getConst(Table.size());
+    uint32_t ArrTy = NextID++, ArrPtrTy = NextID++;
+    B.add(inst(spv::OpTypeArray, {ArrTy, IntTy, Len}));
+    B.add(inst(spv::OpTypePointer,
+               {ArrPtrTy, spv::StorageClassCrossWorkgroup, ArrTy}));
+    Words Constituents;
+    for (auto Value : Table)
+      Constituents.push_back(getConst(Value));
+    uint32_t Init = NextID++;
+    B.add(inst(spv::OpConstantComposite, {ArrTy, Init}, {}, Constituents));
+    B.add(inst(spv::OpVariable, {ArrPtrTy, TableVar,
+                                 spv::StorageClassCrossWorkgroup, Init}));
+  }
+
+  // A declaration of the imported function.
+  B.add(inst(spv::OpFunction, {VoidTy, ChipFn, 0, FnTy}));
+  B.add(inst(spv::OpFunctionParameter, {PtrTy, NextID++}));
+  B.add(inst(spv::OpFunctionParameter, {IntTy, NextID++}));
+  B.add(inst(spv::OpFunctionEnd, {}));
+
+  for (unsigned K = 0; K < NumKernels; K++) {
+    B.add(inst(spv::OpFunction, {VoidTy, FirstKernelID + K, 0, FnTy}));
+    B.add(inst(spv::OpFunctionParameter, {PtrTy, NextID++}));
+    uint32_t Value = NextID++;
+    B.add(inst(spv::OpFunctionParameter, {IntTy, Value}));
+    B.add(inst(spv::OpLabel, {NextID++}));
+    for (unsigned I = 0; I < NumAddsPerKernel; I++) {
+      uint32_t Sum = NextID++;
+      B.add(inst(spv::OpIAdd, {IntTy, Sum, Value, Value}));
+      Value = Sum;
+    }
+    B.add(inst(spv::OpReturn, {}));
+    B.add(inst(spv::OpFunctionEnd, {}));
+  }
+
+  B.Original[3] = B.Expected[3] = NextID; // The ID bound.
+  return B;
+}
+
+static void checkModule(TableKind Kind) {
+  auto B = buildModule(Kind);
+  const char *Bytes = reinterpret_cast<const char *>(B.Original.data());
+  size_t NumBytes = B.Original.size() * sizeof(uint32_t);
+  assert(NumBytes > 10 * 1024 * 1024 && "The module should be large.");
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration Elapsed{};
+  for (int Rep = 0; Rep < NumReps; Rep++) {
+    std::string Filtered;
+    OpenCLFunctionInfoMap FuncInfos;
+    std::vector<std::string> Imports;
+    auto Start = Clock::now();
+    bool Ok = filterSPIRV(Bytes, NumBytes, Filtered, FuncInfos, &Imports);
+    Elapsed += Clock::now() - Start;
+    assert(Ok);
+    assert(Imports == std::vector<std::string>{"_Z11__chip_helper"});
+
+    assert(Filtered.size() == B.Expected.size() * sizeof(uint32_t));
+    assert(Filtered.compare(0, Filtered.size(),
+                            reinterpret_cast<const char *>(B.Expected.data()),
+                            Filtered.size()) == 0);
+
+    assert(FuncInfos.size() == NumKernels);
+    for (unsigned K = 0; K < NumKernels; K++) {
+      auto It = FuncInfos.find(kernelName(K));
+      assert(It != FuncInfos.end());
+      const auto &FI = *It->second;
+      assert(FI.getNumKernelArgs() == 2);
+      assert(FI.hasByRefArgs() == (Kind == TableKind::Matching));
+      FI.visitKernelArgs([&](const SPVFuncInfo::KernelArg &Arg) {
+        if (Arg.Index == 0)
+          assert(Arg.Kind == SPVTypeKind::Pointer && Arg.Size == 8 &&
+                 Arg.StorageClass == SPVStorageClass::CrossWorkgroup);
+        else if (Kind == TableKind::Matching)
+          assert(Arg.Kind == SPVTypeKind::PODByRef && Arg.Size == 4);
+        else
+          assert(Arg.Kind == SPVTypeKind::POD && Arg.Size == 4);
+      });
+    }
+  }
+
+  // The exports of the original binary. The LinkOnceODR function and the
+  // import are not among them.
+  auto Exports = getExportedSymbols(std::string_view(Bytes, NumBytes));
+  assert(Exports.size() == NumKernels + (Kind != TableKind::None));
+  assert(Exports.front() == kernelName(0));
+  if (Kind != TableKind::None)
+    assert(Exports.back() == ChipKernelInfoVarName);
+
+  const char *TableDesc[] = {"no", "a", "a stale"};
+  double Seconds = std::chrono::duration<double>(Elapsed).count() / NumReps;
+  printf("%.1f MB module with %u kernels and %s kernel info table: "
+         "%.2f ms, %.0f MB/s\n",
+         NumBytes / 1e6, NumKernels, TableDesc[static_cast<int>(Kind)],
+         Seconds * 1e3, NumBytes / 1e6 / Seconds);
+}
+
+// The build-time symbol index of an rtdevlib module must list the exports
+// of the SPIR-V binary embedded along it.
+template <size_t N, size_t M>
+static void checkSymbolIndex(const std::array<unsigned char, N> &Module,
+                             const std::array<const char *, M> &Symbols) {
+  auto Exports = getExportedSymbols(std::string_view(
+      reinterpret_cast<const char *>(Module.data()), Module.size()));
+  std::sort(Exports.begin(), Exports.end());
+  assert(!Exports.empty());
+  assert(std::equal(Exports.begin(), Exports.end(), Symbols.begin(),
+                    Symbols.end()));
+}
+
+static void checkRuntimeDeviceLibrary() {
+#define CHECK_INDEX(Name)                                                     \
+  checkSymbolIndex(chipstar::Name, chipstar::Name##_symbols)
+  CHECK_INDEX(atomicAddFloat_native);
+  CHECK_INDEX(atomicAddFloat_emulation);
+  CHECK_INDEX(atomicAddDouble_native);
+  CHECK_INDEX(atomicAddDouble_emulation);
+  CHECK_INDEX(ballot_native);
+  CHECK_INDEX(ballot_emulation);
+#undef CHECK_INDEX
+}
+
+int main() {
+  checkRuntimeDeviceLibrary();
+  checkModule(TableKind::None);
+  checkModule(TableKind::Matching);
+  checkModule(TableKind::Stale);
+  printf("PASSED\n");
+  return 0;
+}